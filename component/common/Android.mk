@@ -21,3 +21,5 @@ LOCAL_SHARED_LIBRARIES :=               \
 LOCAL_MODULE:= libOMX_Basecomponent
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
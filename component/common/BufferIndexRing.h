@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BUFFER_INDEX_RING_H_
+
+#define BUFFER_INDEX_RING_H_
+
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+// Fixed size multi-producer/single-consumer ring of buffer indices.
+// The producers are the OMX client's binder threads calling
+// emptyThisBuffer or fillThisBuffer, several of which may push to the
+// same port at once; the consumer is the component's looper thread.
+// Each slot carries a sequence number that says whose turn it is, so
+// producers claim slots with a compare-and-swap on mTail and publish
+// them in any order, and the consumer only takes published slots.
+// Storage is embedded so neither side ever touches the heap.
+struct BufferIndexRing {
+    enum {
+        kCapacity = 64,  // must be a power of two
+    };
+
+    BufferIndexRing() {
+        reset();
+    }
+
+    // Neither side may be running.
+    void reset() {
+        mHead = 0;
+        mTail = 0;
+        for (int32_t i = 0; i < kCapacity; ++i) {
+            mSlots[i].mSeq = i;
+            mSlots[i].mIndex = 0;
+        }
+    }
+
+    // Any thread. Fails when the ring is full.
+    bool push(int32_t index) {
+        int32_t tail = android_atomic_acquire_load(&mTail);
+        Slot *slot;
+
+        for (;;) {
+            slot = &mSlots[tail & (kCapacity - 1)];
+            int32_t diff = android_atomic_acquire_load(&slot->mSeq) - tail;
+
+            if (diff == 0) {
+                // The slot is free for this lap, try to claim it.
+                if (android_atomic_acquire_cas(tail, tail + 1, &mTail) == 0) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // The consumer has not freed it since the last lap.
+                return false;
+            }
+            tail = android_atomic_acquire_load(&mTail);
+        }
+
+        slot->mIndex = index;
+        android_atomic_release_store(tail + 1, &slot->mSeq);
+        return true;
+    }
+
+    // Consumer side only. A slot claimed but not yet published reads as
+    // empty; its producer wakes the consumer again once it is.
+    bool pop(int32_t *index) {
+        int32_t head = mHead;
+        Slot *slot = &mSlots[head & (kCapacity - 1)];
+
+        if (android_atomic_acquire_load(&slot->mSeq) - (head + 1) < 0) {
+            return false;
+        }
+
+        *index = slot->mIndex;
+        android_atomic_release_store(head + kCapacity, &slot->mSeq);
+        mHead = head + 1;
+        return true;
+    }
+
+private:
+    struct Slot {
+        volatile int32_t mSeq;
+        int32_t mIndex;
+    };
+
+    int32_t mHead;           // only touched by the consumer
+    volatile int32_t mTail;  // next slot for the producers to claim
+    Slot mSlots[kCapacity];
+};
+
+}  // namespace android
+
+#endif  // BUFFER_INDEX_RING_H_
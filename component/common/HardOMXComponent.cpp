@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "HardOMXComponent.h"
+#include "HardOMXVendorExt.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 
@@ -191,6 +192,30 @@ OMX_ERRORTYPE HardOMXComponent::GetExtensionIndexWrapper(
     // *index = (OMX_INDEXTYPE) OMX_IndexParamUseAndroidNativeBuffer;
     }else if (strcmp(name, "OMX.lume.android.index.setShContext") == 0) {
       *index = (OMX_INDEXTYPE)0x7F000014;
+    }else if (strcmp(name, OMX_LUME_INDEX_VIDEO_DEC_STATS) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexConfigLumeVideoDecStats;
+    }else if (strcmp(name, OMX_LUME_INDEX_DECODER_THREADS) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeDecoderThreads;
+    }else if (strcmp(name, OMX_LUME_INDEX_DECODE_AHEAD) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeDecodeAhead;
+    }else if (strcmp(name, OMX_LUME_INDEX_LOW_LATENCY) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeLowLatency;
+    }else if (strcmp(name, OMX_LUME_INDEX_MEDIA_CLOCK) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexConfigLumeMediaClock;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_BATCH) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeAudioBatch;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_PASSTHROUGH) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeAudioPassthrough;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_GAPLESS) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeAudioGapless;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_PREROLL) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeAudioPreroll;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_OUTPUT_RATE) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexParamLumeAudioOutputRate;
+    }else if (strcmp(name, OMX_LUME_INDEX_AUDIO_DEC_STATS) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexConfigLumeAudioDecStats;
+    }else if (strcmp(name, OMX_LUME_INDEX_VIDEO_ENC_STATS) == 0) {
+      *index = (OMX_INDEXTYPE)OMX_IndexConfigLumeVideoEncStats;
     }else{
        ALOGE("411111111111111111111111111SOFT");
       return me->getExtensionIndex(name, index);
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARD_OMX_VENDOR_EXT_H_
+
+#define HARD_OMX_VENDOR_EXT_H_
+
+#include <OMX_Types.h>
+#include <OMX_Core.h>
+
+/*
+ * Vendor extension indices understood by the hard components. The names
+ * are resolved by HardOMXComponent::GetExtensionIndexWrapper; 0x7F000011
+ * to 0x7F000014 are taken by the android native buffer and sh context
+ * extensions.
+ */
+#define OMX_LUME_INDEX_VIDEO_DEC_STATS  "OMX.lume.android.index.videoDecStats"
+#define OMX_LUME_INDEX_DECODER_THREADS  "OMX.lume.android.index.decoderThreads"
+#define OMX_LUME_INDEX_DECODE_AHEAD     "OMX.lume.android.index.decodeAhead"
+#define OMX_LUME_INDEX_LOW_LATENCY      "OMX.lume.android.index.lowLatency"
+#define OMX_LUME_INDEX_MEDIA_CLOCK      "OMX.lume.android.index.mediaClock"
+#define OMX_LUME_INDEX_AUDIO_BATCH      "OMX.lume.android.index.audioBatch"
+#define OMX_LUME_INDEX_AUDIO_PASSTHROUGH "OMX.lume.android.index.audioPassthrough"
+#define OMX_LUME_INDEX_AUDIO_GAPLESS    "OMX.lume.android.index.audioGapless"
+#define OMX_LUME_INDEX_AUDIO_PREROLL    "OMX.lume.android.index.audioPreroll"
+#define OMX_LUME_INDEX_AUDIO_OUTPUT_RATE "OMX.lume.android.index.audioOutputRate"
+#define OMX_LUME_INDEX_AUDIO_DEC_STATS  "OMX.lume.android.index.audioDecStats"
+#define OMX_LUME_INDEX_VIDEO_ENC_STATS  "OMX.lume.android.index.videoEncStats"
+
+enum {
+    OMX_IndexConfigLumeVideoDecStats = 0x7F000020,
+    OMX_IndexParamLumeDecoderThreads = 0x7F000021,
+    OMX_IndexParamLumeDecodeAhead    = 0x7F000022,
+    OMX_IndexParamLumeLowLatency     = 0x7F000023,
+    OMX_IndexConfigLumeMediaClock    = 0x7F000024,
+    OMX_IndexParamLumeAudioBatch     = 0x7F000025,
+    OMX_IndexParamLumeAudioPassthrough = 0x7F000026,
+    OMX_IndexParamLumeAudioGapless   = 0x7F000027,
+    OMX_IndexParamLumeAudioPreroll   = 0x7F000028,
+    OMX_IndexParamLumeAudioOutputRate = 0x7F000029,
+    OMX_IndexConfigLumeAudioDecStats = 0x7F00002A,
+    OMX_IndexConfigLumeVideoEncStats = 0x7F00002B,
+};
+
+/* OMX_IndexConfigLumeVideoDecStats, getConfig only. */
+typedef struct OMX_CONFIG_LUME_VIDEODECSTATSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nInputQueueDepth;      /* inputs waiting for the decode thread */
+    OMX_U32 nMaxInputQueueDepth;
+    OMX_U32 nOutputQueueDepth;     /* empty outputs held by the decode thread */
+    OMX_U32 nInputStalls;          /* decode thread waited for input */
+    OMX_U32 nOutputStalls;         /* decode thread waited for an output buffer */
+    OMX_U32 nFramesDecoded;
+    OMX_U64 nDecodeTimeUs;         /* accumulated time spent in DecodeVideo */
+    OMX_U64 nInputBytesCopied;     /* bitstream copied out of foreign input buffers */
+    OMX_U32 nInputBytesCopiedPerSec;
+    OMX_U32 nReorderDepth;         /* pictures the decoder delays for reordering */
+    OMX_U32 nPendingPictures;      /* decoded pictures waiting for an output buffer */
+    OMX_U32 nMaxPendingPictures;
+    OMX_U32 nDropLevel;            /* 0 none, 1 no deblocking, 2 no non-ref frames, 3 key frames only */
+    OMX_U32 nMaxDropLevel;
+    OMX_U32 nLoopFilterSkips;      /* frames decoded without deblocking */
+    OMX_U32 nFramesDropped;        /* inputs skipped by the decoder to catch up */
+    OMX_S64 nLatenessUs;           /* last input pts behind the media clock, 0 without one */
+    OMX_U32 nLatencyFrames;        /* outputs matched to an input by timestamp */
+    OMX_U32 nLastLatencyUs;        /* input taken to output returned, last such output */
+    OMX_U32 nMaxLatencyUs;
+    OMX_U64 nTotalLatencyUs;
+} OMX_CONFIG_LUME_VIDEODECSTATSTYPE;
+
+/*
+ * OMX_IndexParamLumeDecoderThreads, input port. Slice threads for the
+ * software libavcodec decoders that split frames into slices (MPEG-1,
+ * DV), 1 by default; 0 and 1 decode single threaded and the other
+ * codecs ignore it. Takes effect when the decoder is opened on the
+ * first buffer.
+ */
+typedef struct OMX_PARAM_LUME_DECODERTHREADSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nThreadCount;
+} OMX_PARAM_LUME_DECODERTHREADSTYPE;
+
+/*
+ * OMX_IndexParamLumeDecodeAhead, output port, any state. Pictures the
+ * decode thread may decode beyond the free output buffers, 0 to 4.
+ */
+typedef struct OMX_PARAM_LUME_DECODEAHEADTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nDecodeAhead;
+} OMX_PARAM_LUME_DECODEAHEADTYPE;
+
+/*
+ * OMX_IndexParamLumeLowLatency, input port, Loaded state only (setting it
+ * later fails with OMX_ErrorIncorrectStateOperation). For video
+ * calls and camera preview: fewer port buffers, no B-frame reordering,
+ * no decode ahead, and frames before the first I frame (at start and
+ * after a seek) are shown instead of withheld.
+ */
+typedef struct OMX_PARAM_LUME_LOWLATENCYTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_BOOL bEnable;
+} OMX_PARAM_LUME_LOWLATENCYTYPE;
+
+/*
+ * OMX_IndexConfigLumeMediaClock, setConfig only, takes an
+ * OMX_TIME_CONFIG_TIMESTAMPTYPE on the output port. nTimestamp is the
+ * media time being presented now, in us. The video decoder extrapolates
+ * it to tell how late its input is and drops work to catch up; it stops
+ * trusting the clock a second after the last update.
+ */
+
+/*
+ * OMX_IndexParamLumeAudioBatch, audio decoder output port, Loaded state
+ * only. Milliseconds of PCM packed into each output buffer from
+ * consecutive access units, 0 returns every access unit on its own.
+ * The output buffer size follows the batch and the stream format.
+ */
+typedef struct OMX_PARAM_LUME_AUDIOBATCHTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nBatchMs;
+} OMX_PARAM_LUME_AUDIOBATCHTYPE;
+
+/*
+ * OMX_IndexParamLumeAudioPassthrough, audio decoder input port, Loaded
+ * state only. AC-3, E-AC-3 and DTS (16 bit big endian core) streams are
+ * not decoded but put out as IEC 61937 bursts in 16 bit stereo PCM, for
+ * a HDMI or S/PDIF sink. E-AC-3 goes out at four times its sample rate.
+ * Other streams are decoded as usual. Once decoding has started,
+ * getParameter reports in bActive whether the stream is passed through.
+ */
+typedef struct OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_BOOL bEnable;
+    OMX_BOOL bActive;
+} OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE;
+
+/*
+ * OMX_IndexParamLumeAudioGapless, audio decoder input port, before the
+ * first buffer is decoded. Encoder delay and padding in samples as the
+ * container reports them (LAME tag, iTunSMPB, edit list), given next to
+ * the sh_audio_t context (0x7F000014). The decoder cuts them from the
+ * start and the end of the stream, adding its own delay for the codec.
+ * Without it MP3 takes them from an in-band LAME tag and AAC drops its
+ * first frame.
+ */
+typedef struct OMX_PARAM_LUME_AUDIOGAPLESSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nEncoderDelay;
+    OMX_U32 nEncoderPadding;
+} OMX_PARAM_LUME_AUDIOGAPLESSTYPE;
+
+/*
+ * OMX_IndexParamLumeAudioPreroll, audio decoder input port. Setting it
+ * opens the decoder for the sh_audio_t context right away, in the
+ * caller's thread, instead of on the first input buffer: a player can
+ * prime the next track while the current one plays. Set the other
+ * parameters first. getParameter reports in bPrimed whether the decoder
+ * is open.
+ */
+typedef struct OMX_PARAM_LUME_AUDIOPREROLLTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_BOOL bPrimed;
+} OMX_PARAM_LUME_AUDIOPREROLLTYPE;
+
+/*
+ * OMX_IndexParamLumeAudioOutputRate, audio decoder output port, Loaded
+ * state only. The rate of the sink, 8000 to 192000, or 0 for the rate of
+ * the stream. The decoder resamples to it (up to 8 times up or down,
+ * else the stream rate is kept) so the framework need not, and the
+ * output port reports it. Pass-through bursts are never resampled.
+ */
+typedef struct OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nSamplingRate;
+} OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE;
+
+/*
+ * OMX_IndexConfigLumeAudioDecStats, audio decoder output port, getConfig
+ * only. Counted from the opening of the codec on, always. Decode times
+ * are cpu time of the decoding thread including the downmix, so
+ * nRealTimePermille is the share of one cpu the codec takes. Setting the
+ * system property media.lume.audiostats to a file name makes every audio
+ * decoder append the same report to it every 30 s, at EOS and when it
+ * is freed.
+ */
+#define OMX_LUME_AUDIO_DEC_STATS_BUCKETS 12
+
+typedef struct OMX_CONFIG_LUME_AUDIODECSTATSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U8 cCodec[32];             /* codecs.conf name, empty before the first buffer */
+    OMX_U32 nDecodeCalls;
+    OMX_U32 nDecodeErrors;
+    OMX_U64 nDecodeTimeUs;
+    OMX_U32 nMaxDecodeTimeUs;
+    OMX_U32 nDecodeTimeHist[OMX_LUME_AUDIO_DEC_STATS_BUCKETS]; /* calls under 64 << i us, the last the longer ones */
+    OMX_U64 nAudioUs;              /* duration of the PCM decoded */
+    OMX_U32 nRealTimePermille;     /* nDecodeTimeUs per nAudioUs, in 1/1000 */
+    OMX_U32 nInputQueueDepth;      /* input buffers held by the decoder */
+    OMX_U32 nMaxInputQueueDepth;
+    OMX_U32 nOutputQueueDepth;     /* output buffers held by the decoder */
+    OMX_U32 nMaxOutputQueueDepth;
+    OMX_U32 nInputUnderruns;       /* ran out of input while playing, with output buffers to fill */
+    OMX_U32 nOutputStalls;         /* PCM or input waited for an output buffer */
+} OMX_CONFIG_LUME_AUDIODECSTATSTYPE;
+
+/*
+ * OMX_IndexConfigLumeVideoEncStats, video encoder input port, getConfig
+ * only. Input buffers and gralloc sources are DMMU mapped the first time
+ * they are encoded and stay mapped until freed, so in steady state
+ * nMapCalls and nUnmapCalls do not move.
+ */
+typedef struct OMX_CONFIG_LUME_VIDEOENCSTATSTYPE {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nFramesEncoded;
+    OMX_U32 nMapCalls;             /* dmmu_map_user_memory on input memory */
+    OMX_U32 nUnmapCalls;
+    OMX_U32 nMapFailures;
+    OMX_U32 nMappedBuffers;        /* input mappings currently held */
+} OMX_CONFIG_LUME_VIDEOENCSTATSTYPE;
+
+#endif  // HARD_OMX_VENDOR_EXT_H_
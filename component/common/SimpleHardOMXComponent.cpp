@@ -23,6 +23,7 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <cutils/atomic.h>
 #include <HardwareAPI.h>
 
 namespace android {
@@ -112,7 +113,9 @@ OMX_ERRORTYPE SimpleHardOMXComponent::setParameter(
         OMX_INDEXTYPE index, const OMX_PTR params) {
     Mutex::Autolock autoLock(mLock);
 
-    CHECK(isSetParameterAllowed(index, params));
+    if (!isSetParameterAllowed(index, params)) {
+        return OMX_ErrorIncorrectStateOperation;
+    }
 
     return internalSetParameter(index, params);
 }
@@ -191,6 +194,17 @@ OMX_ERRORTYPE SimpleHardOMXComponent::useBuffer(
     Mutex::Autolock autoLock(mLock);
     CHECK_LT(portIndex, mPorts.size());
 
+    // Every buffer of the port must fit in its pending index ring.
+    if (mPorts.itemAt(portIndex).mDef.nBufferCountActual
+            > (OMX_U32)BufferIndexRing::kCapacity) {
+        ALOGE("Port %d wants %d buffers, at most %d are supported.",
+              (int)portIndex,
+              (int)mPorts.itemAt(portIndex).mDef.nBufferCountActual,
+              BufferIndexRing::kCapacity);
+        *header = NULL;
+        return OMX_ErrorInsufficientResources;
+    }
+
     *header = new OMX_BUFFERHEADERTYPE;
     (*header)->nSize = sizeof(OMX_BUFFERHEADERTYPE);
     (*header)->nVersion.s.nVersionMajor = 1;
@@ -227,6 +241,8 @@ OMX_ERRORTYPE SimpleHardOMXComponent::useBuffer(
     buffer->mHeader = *header;
     buffer->mOwnedByUs = false;
 
+    setBufferIndex(port, port->mBuffers.size() - 1);
+
     if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
         port->mDef.bPopulated = OMX_TRUE;
         checkTransitions();
@@ -293,6 +309,11 @@ OMX_ERRORTYPE SimpleHardOMXComponent::freeBuffer(
             port->mBuffers.removeAt(i);
             port->mDef.bPopulated = OMX_FALSE;
 
+            // The buffers behind the removed one moved down by one slot.
+            for (size_t j = i; j < port->mBuffers.size(); ++j) {
+                setBufferIndex(port, j);
+            }
+
             checkTransitions();
 
             found = true;
@@ -307,18 +328,40 @@ OMX_ERRORTYPE SimpleHardOMXComponent::freeBuffer(
 
 OMX_ERRORTYPE SimpleHardOMXComponent::emptyThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatEmptyThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
-
-    return OMX_ErrorNone;
+    return queueBuffer(buffer->nInputPortIndex, OMX_DirInput, buffer);
 }
 
 OMX_ERRORTYPE SimpleHardOMXComponent::fillThisBuffer(
         OMX_BUFFERHEADERTYPE *buffer) {
-    sp<AMessage> msg = new AMessage(kWhatFillThisBuffer, mHandler->id());
-    msg->setPointer("header", buffer);
-    msg->post();
+    return queueBuffer(buffer->nOutputPortIndex, OMX_DirOutput, buffer);
+}
+
+OMX_ERRORTYPE SimpleHardOMXComponent::queueBuffer(
+        OMX_U32 portIndex, OMX_DIRTYPE dir, OMX_BUFFERHEADERTYPE *header) {
+    // Runs on one of the client's binder threads without mLock, possibly
+    // on several at once for the same port; mPending is multi-producer.
+    // The port's buffer index was stamped into the header by useBuffer,
+    // so all we do here is hand that index to the looper; no allocation
+    // and no search.
+    CHECK_LT(portIndex, mPorts.size());
+
+    PortInfo *port = &mPorts.editItemAt(portIndex);
+    CHECK_EQ((int)port->mDef.eDir, (int)dir);
+
+    intptr_t index = (intptr_t)((dir == OMX_DirInput)
+            ? header->pInputPortPrivate : header->pOutputPortPrivate);
+
+    if (!port->mPending.push(index)) {
+        // Only possible if the client queues a buffer it already queued.
+        ALOGE("Port %d: too many buffers queued.", (int)portIndex);
+        return OMX_ErrorInsufficientResources;
+    }
+
+    // Only wake up the looper if it is not already on its way to drain
+    // this port. mDrainMsg is preallocated and at most one is in flight.
+    if (android_atomic_acquire_cas(0, 1, &port->mDrainPosted) == 0) {
+        port->mDrainMsg->post();
+    }
 
     return OMX_ErrorNone;
 }
@@ -341,50 +384,92 @@ void SimpleHardOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
             CHECK(msg->findInt32("cmd", &cmd));
             CHECK(msg->findInt32("param", &param));
 
+            // Buffers queued before this command must be seen by it,
+            // e.g. a flush has to return them.
+            drainAllPendingBuffers();
+
             onSendCommand((OMX_COMMANDTYPE)cmd, (OMX_U32)param);
             break;
         }
 
-        case kWhatEmptyThisBuffer:
-        case kWhatFillThisBuffer:
+        case kWhatBuffersQueued:
         {
-            OMX_BUFFERHEADERTYPE *header;
-            CHECK(msg->findPointer("header", (void **)&header));
+            int32_t portIndex;
+            CHECK(msg->findInt32("port", &portIndex));
 
-            CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+            onBuffersQueued(portIndex, true /* notifyQueueFilled */);
+            break;
+        }
+
+        case kWhatQueueFilled:
+        {
+            int32_t portIndex;
+            CHECK(msg->findInt32("port", &portIndex));
+
+            if (mState == OMX_StateExecuting && mTargetState == mState) {
+                onQueueFilled(portIndex);
+            }
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
 
-            bool found = false;
-            size_t portIndex = (kWhatEmptyThisBuffer == msgType)?
-                    header->nInputPortIndex: header->nOutputPortIndex;
-            PortInfo *port = &mPorts.editItemAt(portIndex);
+bool SimpleHardOMXComponent::onBuffersQueued(
+        OMX_U32 portIndex, bool notifyQueueFilled) {
+    CHECK_LT(portIndex, mPorts.size());
 
-            for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-                BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+    PortInfo *port = &mPorts.editItemAt(portIndex);
 
-                if (buffer->mHeader == header) {
-                    CHECK(!buffer->mOwnedByUs);
+    if (notifyQueueFilled) {
+        // Clear before popping so that a buffer pushed concurrently either
+        // is seen below or posts a fresh drain message.
+        android_atomic_acquire_cas(1, 0, &port->mDrainPosted);
+    }
 
-                    buffer->mOwnedByUs = true;
+    bool queued = false;
+    int32_t index;
+    while (port->mPending.pop(&index)) {
+        CHECK_LT((size_t)index, port->mBuffers.size());
 
-                    CHECK((msgType == kWhatEmptyThisBuffer
-                            && port->mDef.eDir == OMX_DirInput)
-                            || (port->mDef.eDir == OMX_DirOutput));
+        BufferInfo *buffer = &port->mBuffers.editItemAt(index);
+        CHECK(!buffer->mOwnedByUs);
 
-                    port->mQueue.push_back(buffer);
-                    onQueueFilled(portIndex);
+        buffer->mOwnedByUs = true;
+        port->mQueue.push_back(buffer);
+        queued = true;
 
-                    found = true;
-                    break;
-                }
-            }
+        if (notifyQueueFilled) {
+            CHECK(mState == OMX_StateExecuting && mTargetState == mState);
 
-            CHECK(found);
-            break;
+            onQueueFilled(portIndex);
         }
+    }
 
-        default:
-            TRESPASS();
-            break;
+    return queued;
+}
+
+void SimpleHardOMXComponent::drainAllPendingBuffers() {
+    for (size_t i = 0; i < mPorts.size(); ++i) {
+        // The drain message posted for these buffers may still be in
+        // flight and will find nothing left to pop, so the component
+        // has to be told about them separately.
+        if (onBuffersQueued(i, false /* notifyQueueFilled */)) {
+            postQueueFilled(i);
+        }
+    }
+}
+
+void SimpleHardOMXComponent::setBufferIndex(PortInfo *port, size_t index) {
+    OMX_BUFFERHEADERTYPE *header = port->mBuffers.editItemAt(index).mHeader;
+
+    if (port->mDef.eDir == OMX_DirInput) {
+        header->pInputPortPrivate = (OMX_PTR)index;
+    } else {
+        header->pOutputPortPrivate = (OMX_PTR)index;
     }
 }
 
@@ -457,6 +542,8 @@ void SimpleHardOMXComponent::onPortEnable(OMX_U32 portIndex, bool enable) {
     CHECK(port->mDef.bEnabled == !enable);
 
     if (!enable) {
+        onPortFlushPrepare(portIndex);
+
         port->mDef.bEnabled = OMX_FALSE;
         port->mTransition = PortInfo::DISABLING;
 
@@ -502,6 +589,8 @@ void SimpleHardOMXComponent::onPortFlush(
     PortInfo *port = &mPorts.editItemAt(portIndex);
     CHECK_EQ((int)port->mTransition, (int)PortInfo::NONE);
 
+    onPortFlushPrepare(portIndex);
+
     for (size_t i = 0; i < port->mBuffers.size(); ++i) {
         BufferInfo *buffer = &port->mBuffers.editItemAt(i);
 
@@ -617,11 +706,18 @@ void SimpleHardOMXComponent::addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def) {
     PortInfo *info = &mPorts.editItemAt(mPorts.size() - 1);
     info->mDef = def;
     info->mTransition = PortInfo::NONE;
+    info->mPending.reset();
+    info->mDrainPosted = 0;
+    info->mDrainMsg = new AMessage(kWhatBuffersQueued, mHandler->id());
+    info->mDrainMsg->setInt32("port", def.nPortIndex);
 }
 
 void SimpleHardOMXComponent::onQueueFilled(OMX_U32 portIndex) {
 }
 
+void SimpleHardOMXComponent::onPortFlushPrepare(OMX_U32 portIndex) {
+}
+
 void SimpleHardOMXComponent::onPortFlushCompleted(OMX_U32 portIndex) {
 }
 
@@ -641,4 +737,10 @@ SimpleHardOMXComponent::PortInfo *SimpleHardOMXComponent::editPortInfo(
     return &mPorts.editItemAt(portIndex);
 }
 
+void SimpleHardOMXComponent::postQueueFilled(OMX_U32 portIndex) {
+    sp<AMessage> msg = new AMessage(kWhatQueueFilled, mHandler->id());
+    msg->setInt32("port", portIndex);
+    msg->post();
+}
+
 }  // namespace android
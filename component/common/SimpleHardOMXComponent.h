@@ -19,8 +19,10 @@
 #define SIMPLE_HARD_OMX_COMPONENT_H_
 
 #include "HardOMXComponent.h"
+#include "BufferIndexRing.h"
 
 #include <media/stagefright/foundation/AHandlerReflector.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
@@ -51,6 +53,12 @@ protected:
         Vector<BufferInfo> mBuffers;
         List<BufferInfo *> mQueue;
 
+        // Buffers handed to us by emptyThisBuffer/fillThisBuffer that the
+        // looper has not picked up yet, by index into mBuffers.
+        BufferIndexRing mPending;
+        volatile int32_t mDrainPosted;
+        sp<AMessage> mDrainMsg;
+
         enum {
             NONE,
             DISABLING,
@@ -66,19 +74,32 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    // Everything may be set in Loaded, only the port settings of a
+    // disabled port otherwise. Components with parameters that can be
+    // changed while running say so here.
+    virtual bool isSetParameterAllowed(
+            OMX_INDEXTYPE index, const OMX_PTR params) const;
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
 
+    // Called on the looper right before every buffer we own on portIndex
+    // is handed back (flush, port disable, leaving Executing).
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
 
     PortInfo *editPortInfo(OMX_U32 portIndex);
 
+    // May be called from any thread, schedules onQueueFilled(portIndex)
+    // on the looper.
+    void postQueueFilled(OMX_U32 portIndex);
+
 private:
     enum {
         kWhatSendCommand,
-        kWhatEmptyThisBuffer,
-        kWhatFillThisBuffer,
+        kWhatBuffersQueued,
+        kWhatQueueFilled,
     };
 
     Mutex mLock;
@@ -91,9 +112,6 @@ private:
 
     Vector<PortInfo> mPorts;
 
-    bool isSetParameterAllowed(
-            OMX_INDEXTYPE index, const OMX_PTR params) const;
-
     virtual OMX_ERRORTYPE sendCommand(
             OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data);
 
@@ -128,6 +146,12 @@ private:
 
     virtual OMX_ERRORTYPE getState(OMX_STATETYPE *state);
 
+    OMX_ERRORTYPE queueBuffer(
+            OMX_U32 portIndex, OMX_DIRTYPE dir, OMX_BUFFERHEADERTYPE *header);
+    bool onBuffersQueued(OMX_U32 portIndex, bool notifyQueueFilled);
+    void drainAllPendingBuffers();
+    void setBufferIndex(PortInfo *port, size_t index);
+
     void onSendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param);
     void onChangeState(OMX_STATETYPE state);
     void onPortEnable(OMX_U32 portIndex, bool enable);
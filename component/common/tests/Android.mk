@@ -0,0 +1,27 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+        BufferHandoffBench.cpp
+
+LOCAL_C_INCLUDES += \
+        $(LOCAL_PATH)/.. \
+        $(TOP)/frameworks/native/include/media/openmax
+
+LOCAL_STATIC_LIBRARIES := \
+        libOMX_Basecomponent
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libbinder                       \
+        libmedia                        \
+        libutils                        \
+        libui                           \
+        libcutils                       \
+        libstagefright_foundation       \
+        libdl
+
+LOCAL_MODULE:= buffer_handoff_bench
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
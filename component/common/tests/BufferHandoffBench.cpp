@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the cost of handing a buffer from the client's thread to the
+// component's looper through SimpleHardOMXComponent itself: the client
+// calls OMX_EmptyThisBuffer, queueBuffer pushes the index to the port's
+// BufferIndexRing, onBuffersQueued moves it to the port's queue and the
+// component's onQueueFilled returns it with EmptyBufferDone.
+//
+// Each producer thread owns kBatch buffers; it queues all of them and
+// waits for the component to return the last one before queueing them
+// again. With -c every batch of the first producer has a flush of the
+// (unused) output port sent in its middle, so buffers sit in the ring
+// when the command drains it; a batch that does not come back within a
+// second fails the run.
+//
+// usage: buffer_handoff_bench [-n batches] [-p producers] [-c]
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "BufferHandoffBench"
+#include <utils/Log.h>
+
+#include "SimpleHardOMXComponent.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <OMX_Core.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+enum {
+    kBatch = 16,
+    kMaxProducers = 2,
+    kNumBuffers = kBatch * kMaxProducers,
+};
+
+template<class T>
+static void InitOMXParams(T *params) {
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+// Hands every input buffer straight back.
+struct BenchComponent : public SimpleHardOMXComponent {
+    BenchComponent(
+            const OMX_CALLBACKTYPE *callbacks,
+            OMX_PTR appData,
+            OMX_COMPONENTTYPE **component)
+        : SimpleHardOMXComponent(
+                "handoff_bench", callbacks, appData, component) {
+        OMX_PARAM_PORTDEFINITIONTYPE def;
+        InitOMXParams(&def);
+
+        def.nPortIndex = 0;
+        def.eDir = OMX_DirInput;
+        def.nBufferCountMin = kNumBuffers;
+        def.nBufferCountActual = def.nBufferCountMin;
+        def.nBufferSize = 16;
+        def.bEnabled = OMX_TRUE;
+        def.bPopulated = OMX_FALSE;
+        def.eDomain = OMX_PortDomainOther;
+        def.bBuffersContiguous = OMX_FALSE;
+        def.nBufferAlignment = 1;
+        def.format.other.eFormat = OMX_OTHER_FormatBinary;
+
+        addPort(def);
+
+        // Only there to be flushed, so it never needs buffers.
+        def.nPortIndex = 1;
+        def.eDir = OMX_DirOutput;
+        def.nBufferCountMin = 1;
+        def.nBufferCountActual = def.nBufferCountMin;
+        def.bEnabled = OMX_FALSE;
+
+        addPort(def);
+    }
+
+protected:
+    virtual void onQueueFilled(OMX_U32 portIndex) {
+        if (portIndex != 0) {
+            return;
+        }
+
+        List<BufferInfo *> &inQueue = getPortQueue(0);
+        while (!inQueue.empty()) {
+            BufferInfo *info = *inQueue.begin();
+            inQueue.erase(inQueue.begin());
+            info->mOwnedByUs = false;
+            notifyEmptyBufferDone(info->mHeader);
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(BenchComponent);
+};
+
+// The client side: owns the component and gets its callbacks.
+struct HandoffBench {
+    HandoffBench()
+        : mState(OMX_StateLoaded) {
+        mCallbacks.EventHandler = OnEvent;
+        mCallbacks.EmptyBufferDone = OnEmptyBufferDone;
+        mCallbacks.FillBufferDone = OnFillBufferDone;
+        for (int i = 0; i < kMaxProducers; ++i) {
+            mReturned[i] = 0;
+        }
+
+        BenchComponent *component =
+            new BenchComponent(&mCallbacks, this, &mHandle);
+        component->incStrong(NULL);
+    }
+
+    ~HandoffBench() {
+        mHandle->ComponentDeInit(mHandle);
+    }
+
+    void start() {
+        sendCommand(OMX_CommandStateSet, OMX_StateIdle);
+        for (int i = 0; i < kNumBuffers; ++i) {
+            CHECK_EQ(mHandle->AllocateBuffer(
+                        mHandle, &mHeaders[i], 0, (OMX_PTR)(intptr_t)i, 16),
+                     OMX_ErrorNone);
+        }
+        waitForState(OMX_StateIdle);
+        sendCommand(OMX_CommandStateSet, OMX_StateExecuting);
+        waitForState(OMX_StateExecuting);
+    }
+
+    void stop() {
+        sendCommand(OMX_CommandStateSet, OMX_StateIdle);
+        waitForState(OMX_StateIdle);
+        sendCommand(OMX_CommandStateSet, OMX_StateLoaded);
+        for (int i = 0; i < kNumBuffers; ++i) {
+            CHECK_EQ(mHandle->FreeBuffer(mHandle, 0, mHeaders[i]),
+                     OMX_ErrorNone);
+        }
+        waitForState(OMX_StateLoaded);
+    }
+
+    // Producer side, any thread.
+    void queue(int producer, int i) {
+        CHECK_EQ(mHandle->EmptyThisBuffer(
+                    mHandle, mHeaders[producer * kBatch + i]),
+                 OMX_ErrorNone);
+    }
+
+    void sendCommand(OMX_COMMANDTYPE cmd, OMX_U32 param) {
+        CHECK_EQ(mHandle->SendCommand(mHandle, cmd, param, NULL),
+                 OMX_ErrorNone);
+    }
+
+    // Blocks until the component has returned every buffer of the
+    // producer, false if that takes more than a second.
+    bool waitForBatch(int producer) {
+        Mutex::Autolock autoLock(mLock);
+        while (mReturned[producer] < kBatch) {
+            if (mCondition.waitRelative(mLock, s2ns(1)) == TIMED_OUT) {
+                return false;
+            }
+        }
+        mReturned[producer] = 0;
+        return true;
+    }
+
+private:
+    OMX_CALLBACKTYPE mCallbacks;
+    OMX_COMPONENTTYPE *mHandle;
+    OMX_BUFFERHEADERTYPE *mHeaders[kNumBuffers];
+
+    Mutex mLock;
+    Condition mCondition;
+    OMX_STATETYPE mState;
+    int mReturned[kMaxProducers];
+
+    void waitForState(OMX_STATETYPE state) {
+        Mutex::Autolock autoLock(mLock);
+        while (mState != state) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2,
+            OMX_PTR data) {
+        HandoffBench *me = (HandoffBench *)appData;
+
+        if (event == OMX_EventCmdComplete && data1 == OMX_CommandStateSet) {
+            Mutex::Autolock autoLock(me->mLock);
+            me->mState = (OMX_STATETYPE)data2;
+            me->mCondition.broadcast();
+        }
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_BUFFERHEADERTYPE *header) {
+        HandoffBench *me = (HandoffBench *)appData;
+        int producer = (intptr_t)header->pAppPrivate / kBatch;
+
+        Mutex::Autolock autoLock(me->mLock);
+        if (++me->mReturned[producer] == kBatch) {
+            me->mCondition.broadcast();
+        }
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData,
+            OMX_BUFFERHEADERTYPE *header) {
+        TRESPASS();
+        return OMX_ErrorNone;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(HandoffBench);
+};
+
+struct ProducerArgs {
+    HandoffBench *mBench;
+    int mProducer;
+    int mNumBatches;
+    bool mCommands;
+    bool mStalled;
+};
+
+static void *producerThread(void *arg) {
+    ProducerArgs *args = (ProducerArgs *)arg;
+
+    for (int n = 0; n < args->mNumBatches; ++n) {
+        for (int i = 0; i < kBatch; ++i) {
+            if (args->mCommands && i == kBatch / 2) {
+                args->mBench->sendCommand(OMX_CommandFlush, 1);
+            }
+            args->mBench->queue(args->mProducer, i);
+        }
+        if (!args->mBench->waitForBatch(args->mProducer)) {
+            args->mStalled = true;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void run(int numProducers, int numBatches, bool commands) {
+    HandoffBench bench;
+    bench.start();
+
+    pthread_t threads[kMaxProducers];
+    ProducerArgs args[kMaxProducers];
+
+    nsecs_t startNs = systemTime();
+    for (int i = 0; i < numProducers; ++i) {
+        args[i].mBench = &bench;
+        args[i].mProducer = i;
+        args[i].mNumBatches = numBatches;
+        args[i].mCommands = commands && i == 0;
+        args[i].mStalled = false;
+        CHECK_EQ(pthread_create(&threads[i], NULL, producerThread, &args[i]), 0);
+    }
+    bool stalled = false;
+    for (int i = 0; i < numProducers; ++i) {
+        pthread_join(threads[i], NULL);
+        stalled = stalled || args[i].mStalled;
+    }
+    nsecs_t elapsedNs = systemTime() - startNs;
+
+    if (stalled) {
+        // The component still owns buffers and cannot go back to Loaded.
+        fprintf(stderr, "%d producer(s): a batch was not returned\n",
+                numProducers);
+        exit(1);
+    }
+
+    bench.stop();
+
+    int64_t numBuffers = (int64_t)numProducers * numBatches * kBatch;
+    printf("%d producer(s)%s: %lld buffers, %lld ns/buffer\n",
+           numProducers, commands ? " with commands" : "",
+           (long long)numBuffers, (long long)(elapsedNs / numBuffers));
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-n batches] [-p producers] [-c]\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    int numBatches = 20000;
+    int numProducers = 1;
+    bool commands = false;
+
+    int res;
+    while ((res = getopt(argc, argv, "n:p:c")) >= 0) {
+        switch (res) {
+            case 'n':
+                numBatches = atoi(optarg);
+                break;
+
+            case 'p':
+                numProducers = atoi(optarg);
+                break;
+
+            case 'c':
+                commands = true;
+                break;
+
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (numBatches <= 0 || numProducers < 1 || numProducers > kMaxProducers) {
+        usage(argv[0]);
+    }
+
+    run(numProducers, numBatches, commands);
+
+    return 0;
+}
@@ -25,6 +25,7 @@ LOCAL_STATIC_LIBRARIES := \
 LOCAL_STATIC_LIBRARIES += \
 		libstagefright_mad \
 		libstagefright_faad2 \
+		libstagefright_tremor \
 		libstagefright_mpeg2 \
 		libstagefright_vlumedecoder \
 		libstagefright_alumedecoder \
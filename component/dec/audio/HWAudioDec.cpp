@@ -21,7 +21,9 @@
 #include "HWAudioDec.h"
 
 #include <cutils/properties.h>
+#include <errno.h>
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaErrors.h>
 #include <LUMEDefs.h>
@@ -30,11 +32,12 @@
 
 #define DRC_DEFAULT_MOBILE_REF_LEVEL 64  /* 64*-0.25dB = -16 dB below full scale for mobile conf */
 #define DRC_DEFAULT_MOBILE_DRC_CUT   127 /* maximum compression of dynamic range for mobile conf */
-#define MAX_CHANNEL_COUNT            6  /* maximum number of audio channels that can be decoded */
 // names of properties that can be used to override the default DRC settings
 #define PROP_DRC_OVERRIDE_REF_LEVEL  "aac_drc_reference_level"
 #define PROP_DRC_OVERRIDE_CUT        "aac_drc_cut"
 #define PROP_DRC_OVERRIDE_BOOST      "aac_drc_boost"
+// file the decoders append OMX_IndexConfigLumeAudioDecStats reports to
+#define PROP_AUDIO_STATS_FILE        "media.lume.audiostats"
 
 using namespace android;
 extern "C" {
@@ -45,6 +48,11 @@ AudioDecoder* CreateLUMEAudioDecoder(void);
 OMX_BOOL ALumeDecInit(AudioDecoder*audioD);
 void ALumeDecDeinit(AudioDecoder*audioD);
 OMX_BOOL AudioDecSetConext(AudioDecoder*audioD,sh_audio_t *sh);
+void AudioDecSetMaxChannels(AudioDecoder*audioD,OMX_U32 channels);
+void AudioDecSetPassthrough(AudioDecoder*audioD,OMX_BOOL enable);
+OMX_BOOL AudioDecIsPassthrough(AudioDecoder*audioD);
+int AudioDecGetSampleFormat(AudioDecoder*audioD);
+void AudioDecGetStats(AudioDecoder*audioD,AudioDecStats *stats);
 int DecodeAudio(AudioDecoder*audioD,
 		     OMX_S16* aOutBuff,OMX_U32* aOutputLength,
 		     OMX_U8** aInputBuf,OMX_U32* aInBufSize,
@@ -76,17 +84,56 @@ HWAudioDec::HWAudioDec(
       mIsADTS(false),
       mSignalledError(false),
       mDecInited(false),
-      mAnchorTimeUs(0),
       mNumChannels(2),
       mSamplingRate(44100),
+      mDecoderRate(44100),
+      mMaxChannels(kDefaultOutputChannels),
+      mPassthrough(false),
+      mPassthroughActive(false),
       mNumSamplesOutput(0),
+      mBatchMs(kDefaultBatchMs),
+      mPcm(NULL),
+      mPcmOut(NULL),
+      mPcmOffset(0),
+      mPcmLength(0),
+      mPcmFrameSize(2 * sizeof(int16_t)),
+      mOutFilled(0),
+      mSawInputEOS(false),
       mAudioFormat(AF_INVAL),
-      mOutputPortSettingsChange(NONE) {
+      mOutputPortSettingsChange(NONE),
+      mGaplessSet(false),
+      mEncoderDelay(0),
+      mEncoderPadding(0),
+      mStreamStarted(false),
+      mStreamStartUs(0),
+      mTrimStart(0),
+      mTrimEnd(0),
+      mDropFirstFrame(false),
+      mHeldOutputs(0),
+      mHeldBytes(0),
+      mOutputRate(0),
+      mConvert(NULL),
+      mConvertFormat(0),
+      mConvertRate(0),
+      mConvertChannels(0),
+      mConvPcm(NULL),
+      mConvPcmSize(0),
+      mStarved(true),
+      mOutputStalled(false),
+      mStatsDumpUs(0) {
+    memset(&mStats, 0, sizeof(mStats));
+    InitOMXParams(&mStats);
+    mStats.nPortIndex = 1;
+    property_get(PROP_AUDIO_STATS_FILE, mStatsFile, "");
+
     initPorts();
     //CHECK_EQ(initDecoder(), (status_t)OK);
 }
 
 HWAudioDec::~HWAudioDec() {
+  if (mStatsFile[0]) {
+    dumpStats("freed");
+  }
   if(mAudioDecoder){
     delete mAudioDecoder;
   }
@@ -95,6 +142,11 @@ HWAudioDec::~HWAudioDec() {
     delete aContext;
     aContext = NULL;
   }
+
+  free(mPcm);
+  mPcm = NULL;
+  af_convert_close(mConvert);
+  free(mConvPcm);
 }
 
 void HWAudioDec::initPorts() {
@@ -123,7 +175,7 @@ void HWAudioDec::initPorts() {
     def.eDir = OMX_DirOutput;
     def.nBufferCountMin = kNumOutputBuffers;
     def.nBufferCountActual = def.nBufferCountMin;
-    def.nBufferSize = MAX_AUDIO_DECODER_BUFFER_SIZE;
+    def.nBufferSize = outputBufferSize();
     def.bEnabled = OMX_TRUE;
     def.bPopulated = OMX_FALSE;
     def.eDomain = OMX_PortDomainAudio;
@@ -143,12 +195,19 @@ status_t HWAudioDec::initDecoder() {
     mIsFirst = true;
     ALOGV("initDecoder in");
 
-    mAudioDecoder = CreateLUMEAudioDecoder();
-    CHECK(mAudioDecoder);
+    AudioDecoder *audioDecoder = CreateLUMEAudioDecoder();
+    CHECK(audioDecoder);
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        mAudioDecoder = audioDecoder;
+    }
 
     /**/
-    if(ALumeDecInit(mAudioDecoder) != OMX_TRUE)
-      return OMX_ErrorUndefined;
+    if(ALumeDecInit(mAudioDecoder) != OMX_TRUE){
+      ALOGE("ALumeDecInit failed!");
+      freeDecoder();
+      return UNKNOWN_ERROR;
+    }
 
     if(!aContext) {
       aContext = new sh_audio_t;
@@ -157,14 +216,38 @@ status_t HWAudioDec::initDecoder() {
       mAContextNeedFree = true;
     }
 
+    AudioDecSetMaxChannels(mAudioDecoder, mMaxChannels);
+    AudioDecSetPassthrough(mAudioDecoder, mPassthrough ? OMX_TRUE : OMX_FALSE);
     if(AudioDecSetConext(mAudioDecoder,aContext)==OMX_FALSE){
       ALOGE("AudioDecSetConext failed!");
-      return OMX_FALSE;
+      freeDecoder();
+      return UNKNOWN_ERROR;
     }  
+    mPassthroughActive = AudioDecIsPassthrough(mAudioDecoder) == OMX_TRUE;
+
+    // The decoders write a whole input buffer worth of PCM without
+    // bounds, so they decode here and the output buffers only get
+    // what fits.
+    if (!mPcm) {
+      mPcm = (uint8_t *)malloc(MAX_AUDIO_DECODER_BUFFER_SIZE);
+      if (!mPcm)
+        return NO_MEMORY;
+    }
 
     return OK;
 }
 
+// A decoder that failed to open, so a later initDecoder starts afresh.
+void HWAudioDec::freeDecoder() {
+    AudioDecoder *audioDecoder;
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        audioDecoder = mAudioDecoder;
+        mAudioDecoder = NULL;
+    }
+    delete audioDecoder;
+}
+
 OMX_ERRORTYPE HWAudioDec::internalGetParameter(
         OMX_INDEXTYPE index, OMX_PTR params) {
     switch (index) {
@@ -191,7 +274,7 @@ OMX_ERRORTYPE HWAudioDec::internalGetParameter(
             aacParams->eChannelMode = OMX_AUDIO_ChannelModeStereo;
 
 	    aacParams->nChannels = mNumChannels;
-	    aacParams->nSampleRate = mSamplingRate;
+	    aacParams->nSampleRate = mDecoderRate;
 	    aacParams->nFrameLength = 0;
 
             return OMX_ErrorNone;
@@ -211,12 +294,20 @@ OMX_ERRORTYPE HWAudioDec::internalGetParameter(
             pcmParams->bInterleaved = OMX_TRUE;
             pcmParams->nBitPerSample = 16;
             pcmParams->ePCMMode = OMX_AUDIO_PCMModeLinear;
-            pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelLF;
-            pcmParams->eChannelMapping[1] = OMX_AUDIO_ChannelRF;
-            // pcmParams->eChannelMapping[2] = OMX_AUDIO_ChannelCF;
-            // pcmParams->eChannelMapping[3] = OMX_AUDIO_ChannelLFE;
-            // pcmParams->eChannelMapping[4] = OMX_AUDIO_ChannelLS;
-            // pcmParams->eChannelMapping[5] = OMX_AUDIO_ChannelRS;
+
+            // The decoder hands out multichannel PCM in WAVEEX order.
+            static const OMX_AUDIO_CHANNELTYPE kChannelMap[kMaxOutputChannels] = {
+                OMX_AUDIO_ChannelLF, OMX_AUDIO_ChannelRF, OMX_AUDIO_ChannelCF,
+                OMX_AUDIO_ChannelLFE, OMX_AUDIO_ChannelLR, OMX_AUDIO_ChannelRR,
+                OMX_AUDIO_ChannelLS, OMX_AUDIO_ChannelRS,
+            };
+            if (mNumChannels == 1) {
+                pcmParams->eChannelMapping[0] = OMX_AUDIO_ChannelCF;
+            } else {
+                for (int32_t i = 0; i < mNumChannels && i < kMaxOutputChannels; ++i) {
+                    pcmParams->eChannelMapping[i] = kChannelMap[i];
+                }
+            }
 
 	    pcmParams->nChannels = mNumChannels;
 	    pcmParams->nSamplingRate = mSamplingRate;
@@ -224,6 +315,73 @@ OMX_ERRORTYPE HWAudioDec::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case OMX_IndexParamLumeAudioBatch:
+        {
+            OMX_PARAM_LUME_AUDIOBATCHTYPE *batchParams =
+                (OMX_PARAM_LUME_AUDIOBATCHTYPE *)params;
+
+            if (batchParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            batchParams->nBatchMs = mBatchMs;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioPassthrough:
+        {
+            OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE *passParams =
+                (OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE *)params;
+
+            if (passParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            passParams->bEnable = mPassthrough ? OMX_TRUE : OMX_FALSE;
+            passParams->bActive = mPassthroughActive ? OMX_TRUE : OMX_FALSE;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioGapless:
+        {
+            OMX_PARAM_LUME_AUDIOGAPLESSTYPE *gaplessParams =
+                (OMX_PARAM_LUME_AUDIOGAPLESSTYPE *)params;
+
+            if (gaplessParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            gaplessParams->nEncoderDelay = mEncoderDelay;
+            gaplessParams->nEncoderPadding = mEncoderPadding;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioPreroll:
+        {
+            OMX_PARAM_LUME_AUDIOPREROLLTYPE *prerollParams =
+                (OMX_PARAM_LUME_AUDIOPREROLLTYPE *)params;
+
+            if (prerollParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            prerollParams->bPrimed = mDecInited ? OMX_TRUE : OMX_FALSE;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioOutputRate:
+        {
+            OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE *rateParams =
+                (OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE *)params;
+
+            if (rateParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            rateParams->nSamplingRate = mOutputRate;
+            return OMX_ErrorNone;
+        }
+
         default:
             return SimpleHardOMXComponent::internalGetParameter(index, params);
     }
@@ -287,6 +445,128 @@ OMX_ERRORTYPE HWAudioDec::internalSetParameter(
                 return OMX_ErrorUndefined;
             }
 
+            // nChannels is the most the sink takes: 1 or 2 downmixes,
+            // up to 8 passes multichannel streams through. The codec
+            // learns it when it is opened on the first buffer.
+            if (pcmParams->nChannels < 1
+                    || pcmParams->nChannels > kMaxOutputChannels) {
+                return OMX_ErrorBadParameter;
+            }
+            if (mDecInited) {
+                if (pcmParams->nChannels != mMaxChannels) {
+                    ALOGW("output channels can not change once decoding, "
+                          "keeping %lu", mMaxChannels);
+                }
+                return OMX_ErrorNone;
+            }
+
+            mMaxChannels = pcmParams->nChannels;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioBatch:
+        {
+            const OMX_PARAM_LUME_AUDIOBATCHTYPE *batchParams =
+                (const OMX_PARAM_LUME_AUDIOBATCHTYPE *)params;
+
+            if (batchParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+            if (batchParams->nBatchMs > kMaxBatchMs) {
+                return OMX_ErrorBadParameter;
+            }
+            // The output buffer size follows the batch.
+            OMX_PARAM_PORTDEFINITIONTYPE *outDef = &editPortInfo(1)->mDef;
+            if (outDef->bPopulated) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mBatchMs = batchParams->nBatchMs;
+            outDef->nBufferSize = outputBufferSize();
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioPassthrough:
+        {
+            const OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE *passParams =
+                (const OMX_PARAM_LUME_AUDIOPASSTHROUGHTYPE *)params;
+
+            if (passParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+            // The codec is picked when the decoder is opened.
+            if (mDecInited) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mPassthrough = passParams->bEnable == OMX_TRUE;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioGapless:
+        {
+            const OMX_PARAM_LUME_AUDIOGAPLESSTYPE *gaplessParams =
+                (const OMX_PARAM_LUME_AUDIOGAPLESSTYPE *)params;
+
+            if (gaplessParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+            // Read when the first frame is decoded.
+            if (mStreamStarted) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mGaplessSet = true;
+            mEncoderDelay = gaplessParams->nEncoderDelay;
+            mEncoderPadding = gaplessParams->nEncoderPadding;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioPreroll:
+        {
+            const OMX_PARAM_LUME_AUDIOPREROLLTYPE *prerollParams =
+                (const OMX_PARAM_LUME_AUDIOPREROLLTYPE *)params;
+
+            if (prerollParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+            if (mDecInited) {
+                return OMX_ErrorNone;
+            }
+            // Nothing to open before the extractor has passed the stream.
+            if (!aContext) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+            if (initDecoder() != OK) {
+                ALOGE("Failed to preroll the decoder");
+                return OMX_ErrorUndefined;
+            }
+            mDecInited = true;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeAudioOutputRate:
+        {
+            const OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE *rateParams =
+                (const OMX_PARAM_LUME_AUDIOOUTPUTRATETYPE *)params;
+
+            if (rateParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+            if (rateParams->nSamplingRate != 0
+                    && (rateParams->nSamplingRate < 8000
+                        || rateParams->nSamplingRate > 192000)) {
+                return OMX_ErrorBadParameter;
+            }
+            // The output buffer size follows the rate.
+            OMX_PARAM_PORTDEFINITIONTYPE *outDef = &editPortInfo(1)->mDef;
+            if (outDef->bPopulated) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mOutputRate = rateParams->nSamplingRate;
+            mSamplingRate = outputRate(mDecoderRate);
+            outDef->nBufferSize = outputBufferSize();
             return OMX_ErrorNone;
         }
 
@@ -295,6 +575,56 @@ OMX_ERRORTYPE HWAudioDec::internalSetParameter(
     }
 }
 
+OMX_ERRORTYPE HWAudioDec::getConfig(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexConfigLumeAudioDecStats:
+        {
+            OMX_CONFIG_LUME_AUDIODECSTATSTYPE *statsParams =
+                (OMX_CONFIG_LUME_AUDIODECSTATSTYPE *)params;
+
+            if (statsParams->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            getStats(statsParams);
+
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_U32 HWAudioDec::outputBufferSize() const {
+    OMX_U32 ms = mBatchMs > kMinOutputBufferMs ? mBatchMs : kMinOutputBufferMs;
+    OMX_U32 size = (OMX_U32)(((int64_t)mSamplingRate * mNumChannels
+                              * sizeof(int16_t) * ms + 999) / 1000);
+
+    return (size + 4095) & ~4095;
+}
+
+// The rate the output port runs at for a stream at decoderRate. The sink
+// rate where the conversion stage reaches it, the framework resamples
+// the rest.
+int32_t HWAudioDec::outputRate(int32_t decoderRate) const {
+    if (!mOutputRate || mPassthroughActive
+            || (int64_t)decoderRate * AF_CONVERT_MAX_RATIO < mOutputRate
+            || (int64_t)mOutputRate * AF_CONVERT_MAX_RATIO < decoderRate) {
+        return decoderRate;
+    }
+    return mOutputRate;
+}
+
+// The end padding, counted in samples of the stream, in output bytes.
+size_t HWAudioDec::endPaddingBytes() const {
+    if (mDecoderRate <= 0) {
+        return (size_t)mTrimEnd * mPcmFrameSize;
+    }
+    return (size_t)((int64_t)mTrimEnd * mSamplingRate / mDecoderRate) * mPcmFrameSize;
+}
+
 void HWAudioDec::onQueueFilled(OMX_U32 portIndex) {
     if(!mDecInited){
       ALOGE("onQueueFilled initDecoder");
@@ -310,225 +640,635 @@ void HWAudioDec::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    UCHAR* inBuffer[FILEREAD_MAX_LAYERS];
-    UINT inBufferLength[FILEREAD_MAX_LAYERS] = {0};
-    UINT bytesValid[FILEREAD_MAX_LAYERS] = {0};
-
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
-    while (!inQueue.empty() && !outQueue.empty()) {
-        BufferInfo *inInfo = *inQueue.begin();
-        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+    {
+        Mutex::Autolock autoLock(mStatsLock);
+        mStats.nInputQueueDepth = inQueue.size();
+        if (mStats.nInputQueueDepth > mStats.nMaxInputQueueDepth) {
+            mStats.nMaxInputQueueDepth = mStats.nInputQueueDepth;
+        }
+        mStats.nOutputQueueDepth = outQueue.size();
+        if (mStats.nOutputQueueDepth > mStats.nMaxOutputQueueDepth) {
+            mStats.nMaxOutputQueueDepth = mStats.nOutputQueueDepth;
+        }
+    }
+    if (mStatsFile[0] && ALooper::GetNowUs() >= mStatsDumpUs) {
+        dumpStats("playing");
+    }
+
+    // The held buffers are at the head of the queue, the one to fill
+    // follows them.
+    while (outQueue.size() > mHeldOutputs) {
+        if (mPcmLength == 0 && !mSawInputEOS) {
+            if (inQueue.empty()) {
+                if (!mStarved) {
+                    mStarved = true;
+                    Mutex::Autolock autoLock(mStatsLock);
+                    ++mStats.nInputUnderruns;
+                }
+                break;
+            }
+            if (!decodeInputBuffer()) {
+                return;
+            }
+            mStarved = mSawInputEOS;
+            continue;
+        }
+        mOutputStalled = false;
 
-        BufferInfo *outInfo = *outQueue.begin();
+        List<BufferInfo *>::iterator it = outQueue.begin();
+        for (size_t i = 0; i < mHeldOutputs; ++i) {
+            ++it;
+        }
+        BufferInfo *outInfo = *it;
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
-	OMX_U32 outLength = 0;
-	OMX_U8 * pStream = inHeader->pBuffer + inHeader->nOffset;
-	OMX_U32 inLength = inHeader->nFilledLen;
-	OMX_AUDIO_PARAM_PCMMODETYPE AudioPcmMode;
-	OMX_S32 frameCount = 0;
-	OMX_BOOL resizeNeeded = OMX_FALSE;
-
-        if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-            inQueue.erase(inQueue.begin());
-            inInfo->mOwnedByUs = false;
-            notifyEmptyBufferDone(inHeader);
-            if (!mIsFirst) {
-                // flush out the decoder's delayed data by calling DecodeFrame
-                // one more time, with the AACDEC_FLUSH flag set
-                INT_PCM *outBuffer =
-                        reinterpret_cast<INT_PCM *>(
-                                outHeader->pBuffer + outHeader->nOffset);
-
-		int result = DecodeAudio(mAudioDecoder,
-					   (OMX_S16*)outBuffer,
-					   (OMX_U32*)&outLength,
-					   (OMX_U8**)(&pStream),
-					   &inLength,
-					   &frameCount,
-					   &AudioPcmMode,
-					   (OMX_BOOL)1,
-					   &resizeNeeded);
-
-		if(outLength <= 0){
-		  ALOGE("Error: audio decode failed with outputlen:%d", (int)outLength);
-		  outLength = 0;//AudioPlayer could handle a empty buffer. So,it is OK to decode fail and pass a empty frame.
-		}else{
-		  if(AudioPcmMode.nBitPerSample != 8)
-		    outLength *= 2;//The outputlen from decoder has been devided with 2 for a 16 bits sample. recover it to a Byte of 8 bits
-		}
-
-                outHeader->nFilledLen = outLength;
-            } else {
-                // Since we never discarded frames from the start, we won't have
-                // to add any padding at the end either.
+        if (mOutFilled == 0) {
+            outHeader->nFilledLen = 0;
+            outHeader->nTimeStamp = mTimeStamp.GetCurrentTimestamp();
+        }
 
-                outHeader->nFilledLen = 0;
-            }
+        // Whole samples only, whatever does not fit goes into the next
+        // output buffer.
+        size_t space = outHeader->nAllocLen - outHeader->nOffset - mOutFilled;
+        size_t copy = mPcmLength;
+        if (copy > space) {
+            copy = space - space % mPcmFrameSize;
+        }
 
-            outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+        memcpy(outHeader->pBuffer + outHeader->nOffset + mOutFilled,
+               mPcmOut + mPcmOffset, copy);
+        mOutFilled += copy;
+        mPcmOffset += copy;
+        mPcmLength -= copy;
+        mTimeStamp.UpdateTimestamp(copy / mPcmFrameSize);
+
+        bool eos = mSawInputEOS && mPcmLength == 0;
+        size_t batchBytes =
+            (size_t)((int64_t)mSamplingRate * mPcmFrameSize * mBatchMs / 1000);
+
+        if (eos) {
+            trimEndPadding();
+        } else {
+            releaseHeldOutputs(false);
+        }
 
-            outQueue.erase(outQueue.begin());
-            outInfo->mOwnedByUs = false;
-            notifyFillBufferDone(outHeader);
+        if (eos || mPcmLength > 0
+                || (mOutFilled > 0 && mOutFilled >= batchBytes)) {
+            returnOutputBuffer(eos);
+        }
+
+        if (eos) {
+            mSawInputEOS = false;
+            if (mStatsFile[0]) {
+                dumpStats("eos");
+            }
             return;
         }
+    }
+
+    if (outQueue.size() <= mHeldOutputs
+            && (mPcmLength > 0 || !inQueue.empty()) && !mOutputStalled) {
+        mOutputStalled = true;
+        Mutex::Autolock autoLock(mStatsLock);
+        ++mStats.nOutputStalls;
+    }
+}
+
+// Decodes the input buffer at the head of the queue into mPcm. Returns
+// false when the output port has to be reconfigured or on an error.
+bool HWAudioDec::decodeInputBuffer() {
+    List<BufferInfo *> &inQueue = getPortQueue(0);
 
-        if (inHeader->nOffset == 0) {
-            mAnchorTimeUs = inHeader->nTimeStamp;
-            mNumSamplesOutput = 0;
+    BufferInfo *inInfo = *inQueue.begin();
+    OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+
+    OMX_U32 outLength = 0;
+    OMX_U8 * pStream = inHeader->pBuffer + inHeader->nOffset;
+    OMX_U32 inLength = inHeader->nFilledLen;
+    OMX_AUDIO_PARAM_PCMMODETYPE AudioPcmMode;
+    OMX_S32 frameCount = 0;
+    OMX_BOOL resizeNeeded = OMX_FALSE;
+
+    if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+        if (!mIsFirst) {
+            // flush out the decoder's delayed data by calling DecodeFrame
+            // one more time, with the AACDEC_FLUSH flag set. Data the EOS
+            // buffer still carries is decoded first, the flush is a call
+            // of its own without input (the pass-through decoder only
+            // closes its last E-AC-3 burst on an empty call).
+            for (int pass = inLength > 0 ? 0 : 1; pass < 2; ++pass) {
+                OMX_U32 passLength = 0;
+                if (pass == 1) {
+                    inLength = 0;
+                }
+                DecodeAudio(mAudioDecoder,
+                            (OMX_S16*)(mPcm + outLength),
+                            &passLength,
+                            (OMX_U8**)(&pStream),
+                            &inLength,
+                            &frameCount,
+                            &AudioPcmMode,
+                            (OMX_BOOL)1,
+                            &resizeNeeded);
+
+                if(passLength <= 0){
+                  ALOGE("Error: audio decode failed with outputlen:%d", (int)passLength);
+                  passLength = 0;//AudioPlayer could handle a empty buffer. So,it is OK to decode fail and pass a empty frame.
+                }else{
+                  if(AudioPcmMode.nBitPerSample != 8)
+                    passLength *= 2;//The outputlen from decoder has been devided with 2 for a 16 bits sample. recover it to a Byte of 8 bits
+                }
+                outLength += passLength;
+            }
+
+            // The conversion stage gives out what is left in its filter.
+            size_t frameSize = mNumChannels * (AudioPcmMode.nBitPerSample / 8);
+            if (frameSize == 0 || !convertPcm(mPcm, outLength / frameSize,
+                        AudioDecGetSampleFormat(mAudioDecoder), true)) {
+                mPcmLength = 0;
+            }
         }
+        mSawInputEOS = true;
 
-        size_t adtsHeaderSize = 0;
-        if (mIsADTS) {
-            // skip 30 bits, aac_frame_length follows.
-            // ssssssss ssssiiip ppffffPc ccohCCll llllllll lll?????
+        inQueue.erase(inQueue.begin());
+        inInfo->mOwnedByUs = false;
+        notifyEmptyBufferDone(inHeader);
+        return true;
+    }
 
-            const uint8_t *adtsHeader = inHeader->pBuffer + inHeader->nOffset;
+    if (inHeader->nOffset == 0) {
+        mTimeStamp.SetFromInputTimestamp(inHeader->nTimeStamp);
+        mNumSamplesOutput = 0;
+    }
 
-            bool signalError = false;
-            if (inHeader->nFilledLen < 7) {
-                ALOGE("Audio data too short to contain even the ADTS header. "
-                      "Got %ld bytes.", inHeader->nFilledLen);
+    size_t adtsHeaderSize = 0;
+    if (mIsADTS) {
+        // skip 30 bits, aac_frame_length follows.
+        // ssssssss ssssiiip ppffffPc ccohCCll llllllll lll?????
+
+        const uint8_t *adtsHeader = inHeader->pBuffer + inHeader->nOffset;
+
+        bool signalError = false;
+        if (inHeader->nFilledLen < 7) {
+            ALOGE("Audio data too short to contain even the ADTS header. "
+                  "Got %ld bytes.", inHeader->nFilledLen);
+            hexdump(adtsHeader, inHeader->nFilledLen);
+            signalError = true;
+        } else {
+            bool protectionAbsent = (adtsHeader[1] & 1);
+
+            unsigned aac_frame_length =
+                ((adtsHeader[3] & 3) << 11)
+                | (adtsHeader[4] << 3)
+                | (adtsHeader[5] >> 5);
+
+            if (inHeader->nFilledLen < aac_frame_length) {
+                ALOGE("Not enough audio data for the complete frame. "
+                      "Got %ld bytes, frame size according to the ADTS "
+                      "header is %u bytes.",
+                      inHeader->nFilledLen, aac_frame_length);
                 hexdump(adtsHeader, inHeader->nFilledLen);
                 signalError = true;
             } else {
-                bool protectionAbsent = (adtsHeader[1] & 1);
-
-                unsigned aac_frame_length =
-                    ((adtsHeader[3] & 3) << 11)
-                    | (adtsHeader[4] << 3)
-                    | (adtsHeader[5] >> 5);
-
-                if (inHeader->nFilledLen < aac_frame_length) {
-                    ALOGE("Not enough audio data for the complete frame. "
-                          "Got %ld bytes, frame size according to the ADTS "
-                          "header is %u bytes.",
-                          inHeader->nFilledLen, aac_frame_length);
-                    hexdump(adtsHeader, inHeader->nFilledLen);
-                    signalError = true;
-                } else {
-                    adtsHeaderSize = (protectionAbsent ? 7 : 9);
-
-                    pStream = (UCHAR *)adtsHeader + adtsHeaderSize;
-                    inLength = aac_frame_length - adtsHeaderSize;
-
-                    inHeader->nOffset += adtsHeaderSize;
-                    inHeader->nFilledLen -= adtsHeaderSize;
-                }
+                adtsHeaderSize = (protectionAbsent ? 7 : 9);
+
+                pStream = (UCHAR *)adtsHeader + adtsHeaderSize;
+                inLength = aac_frame_length - adtsHeaderSize;
+
+                inHeader->nOffset += adtsHeaderSize;
+                inHeader->nFilledLen -= adtsHeaderSize;
             }
+        }
 
-            if (signalError) {
-                mSignalledError = true;
+        if (signalError) {
+            mSignalledError = true;
 
-                notify(OMX_EventError,
-                       OMX_ErrorStreamCorrupt,
-                       ERROR_MALFORMED,
-                       NULL);
+            notify(OMX_EventError,
+                   OMX_ErrorStreamCorrupt,
+                   ERROR_MALFORMED,
+                   NULL);
 
-                return;
-            }
+            return false;
         }
+    }
+
+    if (mIsFirst) {
+        startTrimming(pStream, inLength, inHeader->nTimeStamp);
+    }
 
-	INT_PCM *outBuffer =reinterpret_cast<INT_PCM *>(
-			            outHeader->pBuffer + outHeader->nOffset);
-
-	int result = DecodeAudio(mAudioDecoder,
-				 (OMX_S16*)outBuffer,
-				 (OMX_U32*)&outLength,
-				 (OMX_U8**)(&pStream),
-				 &inLength,
-				 &frameCount,
-				 &AudioPcmMode,
-				 (OMX_BOOL)1,
-				 &resizeNeeded);
-
-	if (AudioPcmMode.nSamplingRate != mSamplingRate ||
-	    AudioPcmMode.nChannels != mNumChannels) {
-	  ALOGI("Reconfiguring decoder: %d Hz, %d channels",
-		AudioPcmMode.nSamplingRate,
-		AudioPcmMode.nChannels);
-	  mSamplingRate = AudioPcmMode.nSamplingRate;
-	  mNumChannels = AudioPcmMode.nChannels;
-
-	  inHeader->nOffset -= adtsHeaderSize;
-	  inHeader->nFilledLen += adtsHeaderSize;
-
-	  notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-	  mOutputPortSettingsChange = AWAITING_DISABLED;
-	  return;
-        } else if (!AudioPcmMode.nSamplingRate || !AudioPcmMode.nChannels) {
-            ALOGW("Invalid stream");
+    int result = DecodeAudio(mAudioDecoder,
+                             (OMX_S16*)mPcm,
+                             (OMX_U32*)&outLength,
+                             (OMX_U8**)(&pStream),
+                             &inLength,
+                             &frameCount,
+                             &AudioPcmMode,
+                             (OMX_BOOL)1,
+                             &resizeNeeded);
+
+    // A new stream rate the stage takes to the sink rate needs no new
+    // output format.
+    if (outputRate(AudioPcmMode.nSamplingRate) != mSamplingRate ||
+        AudioPcmMode.nChannels != mNumChannels) {
+      ALOGI("Reconfiguring decoder: %d Hz, %d channels",
+            AudioPcmMode.nSamplingRate,
+            AudioPcmMode.nChannels);
+      mDecoderRate = AudioPcmMode.nSamplingRate;
+      mSamplingRate = outputRate(mDecoderRate);
+      mNumChannels = AudioPcmMode.nChannels;
+
+      inHeader->nOffset -= adtsHeaderSize;
+      inHeader->nFilledLen += adtsHeaderSize;
+
+      // The batch so far is in the old format, it must not wait for the
+      // new buffers, nor may the held ones.
+      if (mOutFilled > 0) {
+          returnOutputBuffer(false);
+      }
+      releaseHeldOutputs(true);
+      editPortInfo(1)->mDef.nBufferSize = outputBufferSize();
+
+      notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
+      mOutputPortSettingsChange = AWAITING_DISABLED;
+      return false;
+    } else if (!AudioPcmMode.nSamplingRate || !AudioPcmMode.nChannels) {
+        ALOGW("Invalid stream");
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorUndefined, result, NULL);
+        return false;
+    }
+    mDecoderRate = AudioPcmMode.nSamplingRate;
+
+    if (result == ALUMEDEC_SUCCESS) {
+        inHeader->nOffset += inHeader->nFilledLen - inLength;
+        inHeader->nFilledLen = inLength;
+    } else {
+        ALOGW("decoder returned error %d, substituting silence",
+              result);
+        // Discard input buffer.
+        inHeader->nFilledLen = 0;
+        inHeader->nOffset = 0;
+    }
+
+    if (result == ALUMEDEC_SUCCESS || mNumSamplesOutput > 0) {
+        // We'll only output data if we successfully decoded it or
+        // we've previously decoded valid data, in the latter case
+        // (decode failed) we'll output a silent frame.
+        mIsFirst = false;
+
+        if(outLength <= 0){
+          ALOGE("Error: audio decode failed with outputlen:%d", (int)outLength);
+          outLength = 0;//AudioPlayer could handle a empty buffer. So,it is OK to decode fail and pass a empty frame.
+        }else{
+          if(AudioPcmMode.nBitPerSample != 8)
+            outLength *= 2;//The outputlen from decoder has been devided with 2 for a 16 bits sample. recover it to a Byte of 8 bits
+        }
+
+        // Samples of the decoder until the conversion, 16 bit after it.
+        size_t frameSize = AudioPcmMode.nChannels * (AudioPcmMode.nBitPerSample / 8);
+        mPcmFrameSize = AudioPcmMode.nChannels * sizeof(int16_t);
+
+        // Priming is skipped where it lies, the samples do not count
+        // for the timestamps.
+        if (mDropFirstFrame) {
+            mDropFirstFrame = false;
+            mTrimStart = outLength / frameSize;
+        }
+        size_t skip = (size_t)mTrimStart * frameSize;
+        if (skip > outLength) {
+            skip = outLength - outLength % frameSize;
+        }
+        mTrimStart -= skip / frameSize;
+        outLength -= skip;
+
+        if (!convertPcm(mPcm + skip, outLength / frameSize,
+                        AudioDecGetSampleFormat(mAudioDecoder), false)) {
             mSignalledError = true;
-            notify(OMX_EventError, OMX_ErrorUndefined, result, NULL);
-            return;
+            notify(OMX_EventError, OMX_ErrorInsufficientResources, NO_MEMORY, NULL);
+            return false;
         }
+        mNumSamplesOutput += mPcmLength / mPcmFrameSize;
+        mTimeStamp.SetParameters(mSamplingRate, mPcmLength / mPcmFrameSize);
+    }
 
-        if (result == ALUMEDEC_SUCCESS) {
-            inHeader->nOffset += inHeader->nFilledLen - inLength;
-            inHeader->nFilledLen = inLength;
-	} else {
-            ALOGW("decoder returned error %d, substituting silence",
-                  result);
-            // Discard input buffer.
-            inHeader->nFilledLen = 0;
-	    inHeader->nOffset = 0;
-        }
-
-        if (result == ALUMEDEC_SUCCESS || mNumSamplesOutput > 0) {
-            // We'll only output data if we successfully decoded it or
-            // we've previously decoded valid data, in the latter case
-            // (decode failed) we'll output a silent frame.
-            if (mIsFirst) {
-                mIsFirst = false;
-                // the first decoded frame should be discarded to account
-                // for decoder delay
-                outLength = 0;
-            }
-
-	    if(outLength <= 0){
-	      ALOGE("Error: audio decode failed with outputlen:%d", (int)outLength);
-	      outLength = 0;//AudioPlayer could handle a empty buffer. So,it is OK to decode fail and pass a empty frame.
-	    }else{
-	      if(AudioPcmMode.nBitPerSample != 8)
-		outLength *= 2;//The outputlen from decoder has been devided with 2 for a 16 bits sample. recover it to a Byte of 8 bits
-	    }
+    if (inHeader->nFilledLen == 0) {
+        inInfo->mOwnedByUs = false;
+        inQueue.erase(inQueue.begin());
+        inInfo = NULL;
+        notifyEmptyBufferDone(inHeader);
+        inHeader = NULL;
+    }
+
+    return true;
+}
+
+// Hands the decoded PCM to the drain: as it is when it is 16 bit at the
+// rate of the output port, else converted into mConvPcm. At eos the
+// samples still in the filter follow. Returns false when the stage can
+// not be set up.
+bool HWAudioDec::convertPcm(uint8_t *pcm, size_t frames, int format, bool eos) {
+    mPcmOffset = 0;
+    if (!af_convert_needed(format, mDecoderRate, mSamplingRate)) {
+        mPcmOut = pcm;
+        mPcmLength = frames * mPcmFrameSize;
+        return true;
+    }
+
+    if (!mConvert || format != mConvertFormat
+            || mDecoderRate != mConvertRate || mNumChannels != mConvertChannels) {
+        af_convert_close(mConvert);
+        mConvert = af_convert_open(format, mDecoderRate, mSamplingRate, mNumChannels);
+        mConvertFormat = format;
+        mConvertRate = mDecoderRate;
+        mConvertChannels = mNumChannels;
+        if (!mConvert) {
+            ALOGE("no conversion from %s %d Hz to s16 %d Hz",
+                  af_fmt2str_short(format), mDecoderRate, mSamplingRate);
+            return false;
+        }
+    }
+
+    size_t size = af_convert_out_frames(mConvert, frames) * mPcmFrameSize;
+    if (size > mConvPcmSize) {
+        int16_t *buf = (int16_t *)realloc(mConvPcm, size);
+        if (!buf) {
+            return false;
+        }
+        mConvPcm = buf;
+        mConvPcmSize = size;
+    }
+
+    int n = af_convert_run(mConvert, pcm, frames, mConvPcm);
+    if (eos) {
+        n += af_convert_flush(mConvert, mConvPcm + n * mNumChannels);
+    }
+    mPcmOut = (uint8_t *)mConvPcm;
+    mPcmLength = n * mPcmFrameSize;
+    return true;
+}
+
+// Finds the MP3 frame at the start of data and its Xing/Info tag with
+// the LAME extension. Returns the samples of that frame, which decodes
+// to silence, and the encoder delay and padding from the tag.
+static bool parseLameTag(const OMX_U8 *data, OMX_U32 size, OMX_U32 *frameSamples,
+                         OMX_U32 *delay, OMX_U32 *padding) {
+    if (size < 4 || data[0] != 0xff || (data[1] & 0xe6) != 0xe2) {
+        return false;   // no sync or not layer III
+    }
+    bool mpeg1 = (data[1] & 0x18) == 0x18;
+    bool mono = (data[3] & 0xc0) == 0xc0;
+    OMX_U32 offset = 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+
+    if (size < offset + 8
+            || (memcmp(data + offset, "Xing", 4) && memcmp(data + offset, "Info", 4))) {
+        return false;
+    }
+    const OMX_U8 *f = data + offset + 4;
+    OMX_U32 flags = (f[0] << 24) | (f[1] << 16) | (f[2] << 8) | f[3];
+    offset += 8;
+    if (flags & 1) offset += 4;     // frames
+    if (flags & 2) offset += 4;     // bytes
+    if (flags & 4) offset += 100;   // seek table
+    if (flags & 8) offset += 4;     // quality
+
+    // encoder string (9), revision, lowpass, replay gain (8), flags,
+    // bitrate, then 12 bits of delay and 12 of padding
+    if (size < offset + 24 || memcmp(data + offset, "LAME", 4)) {
+        return false;
+    }
+    const OMX_U8 *p = data + offset + 21;
+    *frameSamples = mpeg1 ? 1152 : 576;
+    *delay = (p[0] << 4) | (p[1] >> 4);
+    *padding = ((p[1] & 0x0f) << 8) | p[2];
+    return true;
+}
+
+// Sets up the samples to cut from the start and the end of the stream,
+// before the first frame after opening or a flush is decoded.
+void HWAudioDec::startTrimming(const OMX_U8 *data, OMX_U32 size, OMX_TICKS timeUs) {
+    sh_audio_t *sh = mAudioDecoder->GetAudiosh();
+    bool streamStart = !mStreamStarted || timeUs == mStreamStartUs;
+
+    if (!mStreamStarted) {
+        mStreamStarted = true;
+        mStreamStartUs = timeUs;
+    }
+    mTrimStart = 0;
+    mTrimEnd = 0;
+    mDropFirstFrame = false;
+
+    // Bursts carry no delay and a sink needs every one of them.
+    if (mPassthroughActive || !sh->codec) {
+        return;
+    }
+    const char *drv = sh->codec->drv;
+    const char *dll = sh->codec->dll ? sh->codec->dll : "";
+    bool mp3 = !strcmp(drv, "libmad")
+        || (!strcmp(drv, "ffmpeg") && !strncmp(dll, "mp3", 3));
+    bool aac = !strcmp(drv, "faad")
+        || (!strcmp(drv, "ffmpeg") && !strcmp(dll, "aac"));
+
+    OMX_U32 delay = mEncoderDelay;
+    OMX_U32 padding = mEncoderPadding;
+    bool known = mGaplessSet;
+    OMX_U32 tagSamples, tagDelay, tagPadding;
+
+    if (mp3 && parseLameTag(data, size, &tagSamples, &tagDelay, &tagPadding)) {
+        mTrimStart += tagSamples;
+        if (!known) {
+            delay = tagDelay;
+            padding = tagPadding;
+            known = true;
+        }
+    }
 
-            outHeader->nFilledLen = outLength;
-            outHeader->nFlags = 0;
+    if (mp3) {
+        // The decoder delay shifts the padding into the last frame.
+        mTrimStart += kMp3DecoderDelay;
+        padding = padding > kMp3DecoderDelay ? padding - kMp3DecoderDelay : 0;
+    } else if (aac && !known) {
+        mDropFirstFrame = true;
+    }
+    if (streamStart) {
+        mTrimStart += delay;
+    }
+    mTrimEnd = padding;
+    ALOGV("trimming %lu samples at the start, %lu at the end",
+          mTrimStart, mTrimEnd);
+}
 
-            outHeader->nTimeStamp =
-                mAnchorTimeUs
-                    + (mNumSamplesOutput * 1000000ll) / AudioPcmMode.nSamplingRate;
+// Cuts the padding from the end of the stream at EOS: from the buffer
+// being filled, then from the held buffers, newest first.
+void HWAudioDec::trimEndPadding() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+    size_t trim = endPaddingBytes();
+    size_t cut = trim < mOutFilled ? trim : mOutFilled;
 
-            mNumSamplesOutput += outLength/ 2 / sizeof(int16_t);
+    mOutFilled -= cut;
+    trim -= cut;
 
-            outInfo->mOwnedByUs = false;
+    List<BufferInfo *>::iterator it = outQueue.begin();
+    for (size_t i = 0; i < mHeldOutputs; ++i) {
+        ++it;
+    }
+    while (trim > 0 && it != outQueue.begin()) {
+        --it;
+        OMX_BUFFERHEADERTYPE *header = (*it)->mHeader;
+        cut = trim < header->nFilledLen ? trim : header->nFilledLen;
+        header->nFilledLen -= cut;
+        mHeldBytes -= cut;
+        trim -= cut;
+    }
+    mTrimEnd = 0;
+}
+
+// Completes the buffer being filled. While the end padding may still
+// be in it the buffer is held, else it goes back after the held ones.
+void HWAudioDec::returnOutputBuffer(bool eos) {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    List<BufferInfo *>::iterator it = outQueue.begin();
+    for (size_t i = 0; i < mHeldOutputs; ++i) {
+        ++it;
+    }
+    BufferInfo *outInfo = *it;
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+    outHeader->nFilledLen = mOutFilled;
+    outHeader->nFlags = eos ? OMX_BUFFERFLAG_EOS : 0;
+    mOutFilled = 0;
+
+    if (!eos && mTrimEnd > 0) {
+        mHeldOutputs++;
+        mHeldBytes += outHeader->nFilledLen;
+        // One buffer to fill and one for the client to play at least.
+        while (mHeldOutputs + 2 > editPortInfo(1)->mDef.nBufferCountActual) {
+            OMX_BUFFERHEADERTYPE *oldest = (*outQueue.begin())->mHeader;
+            mHeldBytes -= oldest->nFilledLen;
+            mHeldOutputs--;
+            (*outQueue.begin())->mOwnedByUs = false;
             outQueue.erase(outQueue.begin());
-            outInfo = NULL;
-            notifyFillBufferDone(outHeader);
-            outHeader = NULL;
+            notifyFillBufferDone(oldest);
         }
+        return;
+    }
+
+    releaseHeldOutputs(true);
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outQueue.begin());
+    notifyFillBufferDone(outHeader);
+}
+
+// Gives back the held buffers the end padding no longer reaches into,
+// all of them with all.
+void HWAudioDec::releaseHeldOutputs(bool all) {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+    size_t padding = endPaddingBytes();
+
+    while (mHeldOutputs > 0) {
+        BufferInfo *outInfo = *outQueue.begin();
+        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
-        if (inHeader->nFilledLen == 0) {
-            inInfo->mOwnedByUs = false;
-            inQueue.erase(inQueue.begin());
-            inInfo = NULL;
-            notifyEmptyBufferDone(inHeader);
-            inHeader = NULL;
+        if (!all && mHeldBytes - outHeader->nFilledLen + mOutFilled < padding) {
+            break;
         }
+        mHeldBytes -= outHeader->nFilledLen;
+        mHeldOutputs--;
+        outInfo->mOwnedByUs = false;
+        outQueue.erase(outQueue.begin());
+        notifyFillBufferDone(outHeader);
     }
 }
 
+void HWAudioDec::getStats(OMX_CONFIG_LUME_AUDIODECSTATSTYPE *stats) {
+    AudioDecStats decStats;
+    memset(&decStats, 0, sizeof(decStats));
+
+    Mutex::Autolock autoLock(mStatsLock);
+    if (mAudioDecoder) {
+        AudioDecGetStats(mAudioDecoder, &decStats);
+    }
+
+    memcpy(stats, &mStats, sizeof(mStats));
+    strlcpy((char *)stats->cCodec, decStats.codec ? decStats.codec : "",
+            sizeof(stats->cCodec));
+    stats->nDecodeCalls = decStats.calls;
+    stats->nDecodeErrors = decStats.errors;
+    stats->nDecodeTimeUs = decStats.decodeUs;
+    stats->nMaxDecodeTimeUs = decStats.maxDecodeUs;
+    for (int i = 0; i < OMX_LUME_AUDIO_DEC_STATS_BUCKETS
+                 && i < AUDIO_DEC_HIST_BUCKETS; ++i) {
+        stats->nDecodeTimeHist[i] = decStats.hist[i];
+    }
+    stats->nAudioUs = decStats.audioUs;
+    stats->nRealTimePermille = decStats.audioUs > 0
+        ? (OMX_U32)(decStats.decodeUs * 1000 / decStats.audioUs) : 0;
+}
+
+// Appends the stats to mStatsFile, a line for the codec, one for the
+// decode time histogram and one for the queues.
+void HWAudioDec::dumpStats(const char *why) {
+    OMX_CONFIG_LUME_AUDIODECSTATSTYPE stats;
+    getStats(&stats);
+    mStatsDumpUs = ALooper::GetNowUs() + kStatsDumpIntervalUs;
+    if (stats.nDecodeCalls == 0) {
+        return;
+    }
+
+    FILE *fp = fopen(mStatsFile, "a");
+    if (!fp) {
+        ALOGW("can not append audio stats to %s: %s", mStatsFile, strerror(errno));
+        mStatsFile[0] = '\0';
+        return;
+    }
+    fprintf(fp, "%ld %p %s %s: %u calls, %u errors, %llu us for %llu us of audio,"
+            " %u.%u%% cpu, max %u us\n",
+            (long)time(NULL), this, why, stats.cCodec,
+            (unsigned)stats.nDecodeCalls, (unsigned)stats.nDecodeErrors,
+            (unsigned long long)stats.nDecodeTimeUs,
+            (unsigned long long)stats.nAudioUs,
+            (unsigned)stats.nRealTimePermille / 10,
+            (unsigned)stats.nRealTimePermille % 10,
+            (unsigned)stats.nMaxDecodeTimeUs);
+    fprintf(fp, "  decode us");
+    for (int i = 0; i < OMX_LUME_AUDIO_DEC_STATS_BUCKETS - 1; ++i) {
+        fprintf(fp, " <%u:%u", 64u << i, (unsigned)stats.nDecodeTimeHist[i]);
+    }
+    fprintf(fp, " more:%u\n",
+            (unsigned)stats.nDecodeTimeHist[OMX_LUME_AUDIO_DEC_STATS_BUCKETS - 1]);
+    fprintf(fp, "  queues in %u (max %u) out %u (max %u), %u input underruns,"
+            " %u output stalls\n",
+            (unsigned)stats.nInputQueueDepth, (unsigned)stats.nMaxInputQueueDepth,
+            (unsigned)stats.nOutputQueueDepth, (unsigned)stats.nMaxOutputQueueDepth,
+            (unsigned)stats.nInputUnderruns, (unsigned)stats.nOutputStalls);
+    fclose(fp);
+}
+
 void HWAudioDec::onPortFlushCompleted(OMX_U32 portIndex) {
     if (portIndex == 0) {
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
         mIsFirst = true;
-	if (mAudioDecoder->GetAudiosh()->ds)
+	if (mAudioDecoder && mAudioDecoder->GetAudiosh()->ds)
 	    mAudioDecoder->GetAudiosh()->ds->seek_flag = 1;
+
+        mPcmLength = 0;
+        mSawInputEOS = false;
+        mNumSamplesOutput = 0;
+        mTimeStamp = ALumeTimeStampCalc();
+        mStarved = true;
+        if (mConvert) {
+            af_convert_reset(mConvert);
+        }
+    } else {
+        // The buffer being filled and the held ones went back with the
+        // flush.
+        mOutFilled = 0;
+        mHeldOutputs = 0;
+        mHeldBytes = 0;
     }
 }
 
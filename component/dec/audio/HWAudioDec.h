@@ -18,7 +18,11 @@
 #define HARD_AAC_2_H_
 
 #include "SimpleHardOMXComponent.h"
+#include <cutils/properties.h>
+#include <utils/threads.h>
+#include "HardOMXVendorExt.h"
 #include "lume_audio_dec.h"
+#include "lume_audio_timestamp.h"
 #include "aacdecoder_lib.h"
 
 namespace android {
@@ -38,6 +42,8 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
@@ -46,6 +52,19 @@ private:
     enum {
         kNumInputBuffers        = 4,
         kNumOutputBuffers       = 4,
+        // Output buffers hold at least this much PCM at the current
+        // format, enough for one access unit when batching is off.
+        kMinOutputBufferMs      = 32,
+        kMaxBatchMs             = 500,
+        kDefaultBatchMs         = 0,
+        // Streams with more channels than the client asked for on the
+        // output port are downmixed to stereo.
+        kMaxOutputChannels      = 8,
+        kDefaultOutputChannels  = 2,
+        // Samples libmad and libavcodec put out before the first
+        // sample of an MP3 stream.
+        kMp3DecoderDelay        = 529,
+        kStatsDumpIntervalUs    = 30000000,
     };
 
     enum AudioFormat {
@@ -61,14 +80,69 @@ private:
     bool mAContextNeedFree;
 
     int32_t mNumChannels;
-    int32_t mSamplingRate;
+    int32_t mSamplingRate;      // of the output port
+    int32_t mDecoderRate;
+    OMX_U32 mMaxChannels;
+    bool mPassthrough;          // IEC 61937 bursts instead of PCM if the codec allows
+    bool mPassthroughActive;
 
     bool mIsADTS;
     bool mIsFirst;
     bool mSignalledError;
-    int64_t mAnchorTimeUs;
     int64_t mNumSamplesOutput;
 
+    // Decoded PCM waits in mPcm until it is copied into the output buffer
+    // at the head of the queue, which goes back to the client once it
+    // holds mBatchMs of audio. Timestamps count the copied samples from
+    // the last input timestamp.
+    OMX_U32 mBatchMs;
+    uint8_t *mPcm;
+    uint8_t *mPcmOut;       // mPcm, or mConvPcm after conversion
+    size_t mPcmOffset;
+    size_t mPcmLength;
+    size_t mPcmFrameSize;   // bytes per sample of all channels, 16 bit out
+    size_t mOutFilled;      // bytes in the output buffer being filled
+    bool mSawInputEOS;
+    ALumeTimeStampCalc mTimeStamp;
+
+    // Gapless playback: mTrimStart samples are skipped in mPcm as they
+    // come out of the decoder, the last mTrimEnd samples are cut from
+    // the output buffers at EOS. Up to all but one output buffer may be
+    // held back (mHeldOutputs at the head of the queue) so the padding
+    // can still be cut from them.
+    bool mGaplessSet;           // delay and padding came from the client
+    OMX_U32 mEncoderDelay;
+    OMX_U32 mEncoderPadding;
+    bool mStreamStarted;
+    OMX_TICKS mStreamStartUs;   // first input timestamp, tells a seek to the start
+    OMX_U32 mTrimStart;
+    OMX_U32 mTrimEnd;
+    bool mDropFirstFrame;       // no delay known, the first frame is priming
+    size_t mHeldOutputs;
+    size_t mHeldBytes;
+
+    // PCM at another rate than the sink's (mOutputRate, 0 for the rate
+    // of the stream) or not in 16 bit goes through mConvert, which is
+    // opened for the format, rate and channels of the decoder.
+    OMX_U32 mOutputRate;
+    af_convert_t *mConvert;
+    int mConvertFormat;
+    int32_t mConvertRate;
+    int32_t mConvertChannels;
+    int16_t *mConvPcm;
+    size_t mConvPcmSize;
+
+    // The queue counters of OMX_IndexConfigLumeAudioDecStats, the codec
+    // ones come from mAudioDecoder. An underrun or a stall counts once
+    // until decoding goes on; the decoder is starved as well before the
+    // first input, after a flush and after EOS, which do not count.
+    Mutex mStatsLock;
+    OMX_CONFIG_LUME_AUDIODECSTATSTYPE mStats;
+    bool mStarved;
+    bool mOutputStalled;
+    char mStatsFile[PROPERTY_VALUE_MAX];    // media.lume.audiostats, empty for none
+    int64_t mStatsDumpUs;
+
     enum {
         NONE,
         AWAITING_DISABLED,
@@ -77,6 +151,18 @@ private:
 
     void initPorts();
     status_t initDecoder();
+    void freeDecoder();
+    OMX_U32 outputBufferSize() const;
+    int32_t outputRate(int32_t decoderRate) const;
+    size_t endPaddingBytes() const;
+    bool convertPcm(uint8_t *pcm, size_t frames, int format, bool eos);
+    bool decodeInputBuffer();
+    void startTrimming(const OMX_U8 *data, OMX_U32 size, OMX_TICKS timeUs);
+    void trimEndPadding();
+    void returnOutputBuffer(bool eos);
+    void releaseHeldOutputs(bool all);
+    void getStats(OMX_CONFIG_LUME_AUDIODECSTATSTYPE *stats);
+    void dumpStats(const char *why);
 
     DISALLOW_EVIL_CONSTRUCTORS(HWAudioDec);
 };
@@ -8,7 +8,10 @@ LOCAL_SRC_FILES := \
 		faad_decoder.cpp \
 		mp3_decoder.cpp \
 		pcm_decoder.cpp \
-	        dvdpcm_decoder.cpp
+	        dvdpcm_decoder.cpp \
+		spdif_decoder.cpp \
+		tremor_decoder.cpp \
+		lume_audio_timestamp.cpp
 
 LOCAL_C_INCLUDES := \
         $(LOCAL_PATH)/include \
@@ -30,6 +33,13 @@ LOCAL_CFLAGS := \
         $(STAGEFRIGHT_FLAGS) \
 	-DOSCL_UNUSED_ARG=
 
+# rebuild every IEC 61937 burst from its frame headers and compare it
+# byte for byte, logging the bad ones (spdif_decoder.cpp)
+SPDIF_CHECK ?= false
+ifeq ($(SPDIF_CHECK),true)
+LOCAL_CFLAGS += -DSPDIF_CHECK
+endif
+
 
 LOCAL_MODULE := libstagefright_alume_codec
 
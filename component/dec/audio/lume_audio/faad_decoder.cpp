@@ -166,6 +166,12 @@ int faadDecoder::control(sh_audio_t *sh,int cmd,void* arg, ...)
 	case ADCTRL_RESYNC_STREAM:
 		aac_sync(sh);
 		return CONTROL_TRUE;
+	case ADCTRL_SET_OUTPUT_CHANNELS:
+		audio_output_channels = *(int *)arg;
+		return CONTROL_TRUE;
+	case ADCTRL_QUERY_CHANNEL_LAYOUT:
+		*(int *)arg = AF_CHANNEL_LAYOUT_AAC_DEFAULT;
+		return CONTROL_TRUE;
     }
 	return CONTROL_UNKNOWN;
 }
@@ -333,9 +339,7 @@ int faadDecoder::decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *in
 			//break;
 		} else {
 			/* XXX: samples already multiplied by channels! */
-			if (sh_audio->channels >= 5)
-				mp_msg(MSGT_DECAUDIO,MSGL_DBG2,"FAAD: 5 channel not support now!\n");
-			//else if(faac_sample_buffer)
+			//if(faac_sample_buffer)
 			//	memcpy(outbuf,faac_sample_buffer, sh_audio->samplesize*faac_finfo.samples);
 			//ALOGE("sh_audio->samplesize*faac_finfo.samples %d",sh_audio->samplesize*faac_finfo.samples);
 			//ALOGE("faac_sample_buffer = %x",faac_sample_buffer);
@@ -20,9 +20,11 @@
 
 
 #include <OMX_Component.h>
+#include <utils/threads.h>
 
 #include "mp_decoder.h"
 #include "lume_decoder.h"
+#include "af_convert.h"
 
 namespace android{
 
@@ -32,10 +34,28 @@ public:
     DecFactor();
     virtual ~DecFactor();
 	mpDecorder* CreateAudioDecoder(char *drv);
+	void DiscardAudioDecoder();	// for a decoder that failed to init
 private:
 	mpDecorder * m_dec;
 };
 
+/*
+ * Decode cost of the open codec, always counted. The time is the cpu
+ * time of the decoding thread; hist[i] counts the DecodeAudio calls that
+ * took less than 64 << i us, the last bucket the longer ones.
+ */
+#define AUDIO_DEC_HIST_BUCKETS 12
+
+struct AudioDecStats {
+    const char *codec;		// codecs.conf name, NULL before one is open
+    uint32_t calls;
+    uint32_t errors;		// calls the decoder failed
+    uint64_t decodeUs;
+    uint32_t maxDecodeUs;
+    uint64_t audioUs;		// duration of the PCM put out
+    uint32_t hist[AUDIO_DEC_HIST_BUCKETS];
+};
+
 class AudioDecoder{
 public:
 	AudioDecoder();
@@ -54,6 +74,11 @@ public:
 	OMX_S32 iInputUsedLength;
 	OMX_S32 FindAudioCodec(sh_audio_t *sh_audio);
 	OMX_BOOL AudioDecSetConext(sh_audio_t *sh);
+	void SetMaxChannels(OMX_U32 channels);
+	void SetPassthrough(OMX_BOOL enable);
+	OMX_BOOL IsPassthrough();
+	int GetSampleFormat();
+	void GetStats(AudioDecStats *stats);
 	
 	sh_audio_t* GetAudiosh(){
 	    return shContext;
@@ -62,11 +87,24 @@ public:
 private:
 	int init_audio_codec(sh_audio_t *sh_audio);
 	void uninit_audio(sh_audio_t *sh_audio);
+	OMX_U32 outputChannels(OMX_S16* aOutBuff, OMX_U32* aOutputLength);
+	bool openNarrow(int channels);
+	void narrowOutput(OMX_S16* aOutBuff, OMX_U32* aOutputLength, int channels);
 	DecFactor decFactor;
 	int iInitFlag;
 	unsigned int iSaveOutputLen;
 	sh_audio_t *shContext;
-	
+	OMX_U32 iMaxChannels;	// channels the sink takes, more get downmixed
+	OMX_BOOL iPassthrough;	// wrap AC-3/E-AC-3/DTS in IEC 61937 bursts
+	OMX_BOOL iPassthroughActive;
+	int iOutFormat;		// AF_FORMAT_* of the last DecodeAudio output
+	af_convert_t *iNarrow;	// 32 bit multichannel to S16 for the downmix
+	int iNarrowFormat;
+	int iNarrowChannels;
+	Mutex iStatsLock;	// GetStats comes from other threads
+	AudioDecStats iStats;
+	void resetStats(const char *codec);
+	void countDecode(int64_t decodeUs, OMX_U32 outLength, OMX_U32 channels, bool failed);
 };
 
 }
@@ -18,6 +18,9 @@
 #ifndef MP3_TIMESTAMP_H_INCLUDED
 #define MP3_TIMESTAMP_H_INCLUDED
 
+#include <stdint.h>
+#include <OMX_Types.h>
+
 namespace android{
 
 #define DEFAULT_SAMPLING_FREQ_ALUME 44100
@@ -35,11 +38,11 @@ class ALumeTimeStampCalc
             iSamplesPerFrame = DEFAULT_SAMPLES_PER_FRAME_ALUME;
         };
 		~ALumeTimeStampCalc(){}; 
-        void SetParameters(uint32 aFreq, uint32 aSamples);
+        void SetParameters(uint32_t aFreq, uint32_t aSamples);
 
         void SetFromInputTimestamp(OMX_TICKS aValue);
 
-        void UpdateTimestamp(uint32 aValue);
+        void UpdateTimestamp(uint32_t aValue);
 
         OMX_TICKS GetConvertedTs();
 
@@ -49,10 +52,10 @@ class ALumeTimeStampCalc
 
 
     private:
-        uint32 iSamplingFreq;
+        uint32_t iSamplingFreq;
         OMX_TICKS iCurrentTs;
-        uint32 iCurrentSamples;
-        uint32 iSamplesPerFrame;
+        uint32_t iCurrentSamples;
+        uint32_t iSamplesPerFrame;
 };
 
 }
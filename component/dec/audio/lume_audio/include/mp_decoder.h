@@ -39,6 +39,13 @@ extern "C"{
 
 namespace android{
 
+// Most channels the sink takes, arg is an int*. Sent before init, decoders
+// that can downmix internally decode no more channels than this.
+#define ADCTRL_SET_OUTPUT_CHANNELS 5
+// Channel order of the decoded PCM, arg is an int* set to one of the
+// AF_CHANNEL_LAYOUT_*_DEFAULT sources. Unhandled means WAVEEX order.
+#define ADCTRL_QUERY_CHANNEL_LAYOUT 6
+
 typedef struct mp_codec_info_s
 {
     /* codec long name ("Autodesk FLI/FLC Animation decoder" */
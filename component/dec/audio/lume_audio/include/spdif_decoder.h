@@ -0,0 +1,89 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#ifndef SPDIF_DECODER_H_INCLUDED
+#define SPDIF_DECODER_H_INCLUDED
+
+#include "mp_decoder.h"
+
+namespace android{
+
+#define ADCTRL_RESYNC_STREAM 1
+#define CONTROL_TRUE		1
+#define CONTROL_UNKNOWN -1
+
+class DecFactor;
+
+/*
+ * AC-3, E-AC-3 and DTS pass-through: the frames are not decoded but
+ * wrapped in IEC 61937 bursts, which go out as 16 bit stereo PCM for a
+ * HDMI/S/PDIF sink to decode.
+ */
+class SpdifDecoder: public mpDecorder
+{
+public:
+
+	SpdifDecoder();
+	virtual ~SpdifDecoder();
+	int preinit(sh_audio_t *sh);
+	int init(sh_audio_t *sh);
+	void uninit(sh_audio_t *sh);
+	int control(sh_audio_t *sh,int cmd,void* arg, ...);
+	int decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inslen,unsigned char* outbuf,int *outlen);
+	static bool supports(unsigned int format);
+	static ad_info_t m_info;
+private:
+	enum {
+	    SPDIF_NONE,
+	    SPDIF_AC3,
+	    SPDIF_EAC3,
+	    SPDIF_DTS,
+	};
+
+	// What the burst of a frame needs from its header.
+	struct SpdifFrame {
+	    int size;		// bytes
+	    int sample_rate;
+	    int data_type;	// IEC 61937 Pc
+	    int period;		// burst bytes of a DTS frame
+	    int blocks;		// E-AC-3 audio blocks, 0 for dependent frames
+	};
+
+	int parse_frame(const uint8_t *buf, int len, SpdifFrame *frame);
+	int put_frame(sh_audio_t *sh, const uint8_t *buf, int len,
+		      const SpdifFrame *frame, uint8_t *out);
+	int put_eac3_burst(uint8_t *out);
+	int put_burst(uint8_t *out, int data_type, int length_code,
+		      const uint8_t *data, int size, int period);
+#ifdef SPDIF_CHECK
+	void check_burst(const uint8_t *burst, int period, const uint8_t *data, int size);
+	int check_bursts;
+	int check_errors;
+#endif
+	static int codec_from_format(unsigned int format);
+
+	friend class DecFactor;
+	int codec;
+	uint8_t *carry;		// frame split over input buffers
+	int carry_len;
+	uint8_t *eac3_buf;	// E-AC-3 frames of the burst being gathered
+	int eac3_len;
+	int eac3_blocks;
+};
+
+}
+#endif  //#ifndef SPDIF_DECODER_H_INCLUDED
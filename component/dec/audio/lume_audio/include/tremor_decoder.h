@@ -0,0 +1,55 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+#ifndef TREMOR_DECODER_H_INCLUDED
+#define TREMOR_DECODER_H_INCLUDED
+
+#include "mp_decoder.h"
+
+namespace android{
+
+class DecFactor;
+
+/*
+ * Vorbis on the integer Tremor decoder (lume/tremor), whose IMDCT and
+ * residue unpacking run on the MXU. codecs.conf lists it ahead of the
+ * float libavcodec decoder, which the XBurst FPU makes slow.
+ */
+class tremorDecoder: public mpDecorder
+{
+public:
+
+	tremorDecoder();
+	virtual ~tremorDecoder();
+	int preinit(sh_audio_t *sh);
+	int init(sh_audio_t *sh);
+	void uninit(sh_audio_t *sh);
+	int control(sh_audio_t *sh,int cmd,void* arg, ...);
+	int decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inslen,unsigned char* outbuf,int *outlen);
+	static ad_info_t m_info;
+private:
+	struct TremorState;
+	int read_headers(sh_audio_t *sh);
+	int put_pcm(unsigned char *outbuf);
+	void restart();
+
+	friend class DecFactor;
+	TremorState *ov;
+};
+
+}
+#endif  //#ifndef TREMOR_DECODER_H_INCLUDED
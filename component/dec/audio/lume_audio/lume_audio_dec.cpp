@@ -29,6 +29,8 @@
 #include "faad_decoder.h"
 #include "pcm_decoder.h"
 #include "dvdpcm_decoder.h"
+#include "spdif_decoder.h"
+#include "tremor_decoder.h"
 
 #define LOG_TAG "lume_audio_dec"
 #include <utils/Log.h>
@@ -56,6 +58,26 @@ OMX_BOOL AudioDecSetConext(AudioDecoder*audioD,sh_audio_t *sh){
   return audioD->AudioDecSetConext(sh);
 }
 
+void AudioDecSetMaxChannels(AudioDecoder*audioD,OMX_U32 channels){
+  audioD->SetMaxChannels(channels);
+}
+
+void AudioDecSetPassthrough(AudioDecoder*audioD,OMX_BOOL enable){
+  audioD->SetPassthrough(enable);
+}
+
+OMX_BOOL AudioDecIsPassthrough(AudioDecoder*audioD){
+  return audioD->IsPassthrough();
+}
+
+int AudioDecGetSampleFormat(AudioDecoder*audioD){
+  return audioD->GetSampleFormat();
+}
+
+void AudioDecGetStats(AudioDecoder*audioD,AudioDecStats *stats){
+  audioD->GetStats(stats);
+}
+
 int DecodeAudio(AudioDecoder*audioD,
 		     OMX_S16* aOutBuff,OMX_U32* aOutputLength,
 		     OMX_U8** aInputBuf,OMX_U32* aInBufSize,
@@ -72,11 +94,23 @@ int DecodeAudio(AudioDecoder*audioD,
 }
 namespace android{
 
-static int frmcnt = 0;
-static int tst,ten;
-static int readdata = 0;
-static int ttime = 0;
+// The PCM the decoders put out: 32 bit integer or float as libavcodec and
+// the PCM decoder pass it on, 8 bit, else 16 bit in host order (the
+// decoders swap and cut everything else down to it).
+static int outputFormat(sh_audio_t *sh){
+    switch (sh->samplesize) {
+    case 1:
+	return AF_FORMAT_U8;
+    case 4:
+	if (sh->sample_format == AF_FORMAT_S32_NE || sh->sample_format == AF_FORMAT_FLOAT_NE)
+	    return sh->sample_format;
+	break;
+    }
+    return AF_FORMAT_S16_NE;
+}
+
 #include <sys/time.h>
+#include <time.h>
 
 // Returns current time in microseconds
 unsigned int GetTimer(void){
@@ -86,38 +120,32 @@ unsigned int GetTimer(void){
     return tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-void consum(){
-    if(frmcnt == 0)
-    {
-	tst = GetTimer();
-	ttime = GetTimer() - tst;
-    }
-
-    frmcnt++;
-    
-    if(frmcnt == 100)
-    {
-	ten = GetTimer();
-	ALOGE("frames = 100 time diff = %d audio decode time = %d",ten-tst,readdata);
-	frmcnt = 0;
-	readdata = 0;
-    }
-}
-
-void difftime(int s){
-    readdata += GetTimer() - s - ttime*2;
+// Cpu time of the calling thread in microseconds, what the codec costs
+// whatever else runs on the cpu.
+static int64_t threadCpuUs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
 }
 
-
 AudioDecoder::AudioDecoder(){
     shContext = new sh_audio_t;
     memset(shContext,0,sizeof(sh_audio_t));
     iInitFlag = 0;
+    iMaxChannels = 2;
+    iPassthrough = OMX_FALSE;
+    iPassthroughActive = OMX_FALSE;
+    iOutFormat = AF_FORMAT_S16_NE;
+    iNarrow = NULL;
+    iNarrowFormat = 0;
+    iNarrowChannels = 0;
+    memset(&iStats, 0, sizeof(iStats));
 }
 
 AudioDecoder::~AudioDecoder(){
     uninit_audio(shContext);
     delete shContext;
+    af_convert_close(iNarrow);
 }
 
 OMX_BOOL AudioDecoder::AudioDecSetConext(sh_audio_t *sh){
@@ -165,6 +193,62 @@ OMX_BOOL AudioDecoder::ALumeDecInit(OMX_AUDIO_CONFIG_EQUALIZERTYPE* aEqualizerTy
 void AudioDecoder::ResetDecoder(){
 }
 
+// Takes effect on the codec opened by the next AudioDecSetConext.
+void AudioDecoder::SetMaxChannels(OMX_U32 channels){
+    iMaxChannels = channels < 1 ? 1 : channels > 8 ? 8 : channels;
+}
+
+// Takes effect on the codec opened by the next AudioDecSetConext.
+void AudioDecoder::SetPassthrough(OMX_BOOL enable){
+    iPassthrough = enable;
+}
+
+OMX_BOOL AudioDecoder::IsPassthrough(){
+    return iPassthroughActive;
+}
+
+// U8, S16, S32 or float, as the PCM of the last DecodeAudio call is.
+int AudioDecoder::GetSampleFormat(){
+    return iOutFormat;
+}
+
+void AudioDecoder::GetStats(AudioDecStats *stats){
+    Mutex::Autolock autoLock(iStatsLock);
+    *stats = iStats;
+}
+
+// For the codec just opened.
+void AudioDecoder::resetStats(const char *codec){
+    Mutex::Autolock autoLock(iStatsLock);
+    memset(&iStats, 0, sizeof(iStats));
+    iStats.codec = codec;
+}
+
+// Books a DecodeAudio call that took decodeUs and put out outLength, as
+// DecodeAudio reports it, of channels in iOutFormat.
+void AudioDecoder::countDecode(int64_t decodeUs, OMX_U32 outLength, OMX_U32 channels, bool failed){
+    int bits = af_fmt2bits(iOutFormat);
+    int bucket = 0;
+    int64_t audioUs = 0;
+
+    if (!failed && shContext->samplerate > 0 && channels > 0 && bits >= 8) {
+	uint64_t bytes = bits == 8 ? outLength : (uint64_t)outLength * 2;
+	audioUs = bytes / (channels * bits / 8) * 1000000LL / shContext->samplerate;
+    }
+    while (bucket < AUDIO_DEC_HIST_BUCKETS - 1 && decodeUs >= (64LL << bucket))
+	bucket++;
+
+    Mutex::Autolock autoLock(iStatsLock);
+    iStats.calls++;
+    if (failed)
+	iStats.errors++;
+    iStats.decodeUs += decodeUs;
+    if (decodeUs > iStats.maxDecodeUs)
+	iStats.maxDecodeUs = decodeUs;
+    iStats.audioUs += audioUs;
+    iStats.hist[bucket]++;
+}
+
 void AudioDecoder::ALumeDecDeinit(){
 }
     
@@ -189,12 +273,13 @@ int AudioDecoder::DecodeAudio(OMX_S16* aOutBuff,OMX_U32* aOutputLength,
     ALOGE("%s", in_str);
 #endif
 
-#ifdef DEBUG_AUDIODEC_COST_TIME
-    unsigned int pre_time = GetTimer();
-#endif
+    // The output stage counts with the codec.
+    int64_t startUs = threadCpuUs();
+    bool counted = false;
 
     if(shContext && shContext->ad_driver){	    
 	len = ((mpDecorder*)(shContext->ad_driver))->decode_audio(shContext,(unsigned char **)aInputBuf,(int *)aInBufSize,(unsigned char *)aOutBuff,(int *)aOutputLength);   
+	counted = true;
     }
     else{
 	ALOGE("Error:There is no shContext or shContext->ad_driver!!!");
@@ -205,10 +290,6 @@ int AudioDecoder::DecodeAudio(OMX_S16* aOutBuff,OMX_U32* aOutputLength,
 	*aInputBuf += *aInBufSize;
 	*aInBufSize = 0;
     }
-	
-#ifdef DEBUG_AUDIODEC_COST_TIME
-    ALOGE("audiodec costTime = %u us", GetTimer() - pre_time);
-#endif
 
 #ifdef DEBUG_AUDIODEC_COUNTED_BUFVALUE
     char out_str[128] = "audiodec outbuf:";
@@ -221,11 +302,12 @@ int AudioDecoder::DecodeAudio(OMX_S16* aOutBuff,OMX_U32* aOutputLength,
 #endif
 	
     aAudioPcmParam->nSamplingRate = shContext->samplerate;
-    aAudioPcmParam->nChannels = shContext->channels > 2 ? 2 : shContext->channels == 0 ? 2 : shContext->channels;
-    if(shContext->samplesize > 2)
-	aAudioPcmParam->nBitPerSample = 16;
-    else
-	aAudioPcmParam->nBitPerSample = shContext->samplesize*8;
+    iOutFormat = outputFormat(shContext);
+    aAudioPcmParam->nChannels = outputChannels(aOutBuff, aOutputLength);
+    // The caller converts S32 and float, GetSampleFormat tells them apart.
+    aAudioPcmParam->nBitPerSample = af_fmt2bits(iOutFormat);
+    if (counted)
+	countDecode(threadCpuUs() - startUs, *aOutputLength, aAudioPcmParam->nChannels, len < 0);
     
     EL_P2("aAudioPcmParam->nBitPerSample=%d;samplerate:%d;channels:%d", aAudioPcmParam->nBitPerSample, aAudioPcmParam->nSamplingRate, aAudioPcmParam->nChannels);
 
@@ -244,12 +326,98 @@ int AudioDecoder::DecodeAudio(OMX_S16* aOutBuff,OMX_U32* aOutputLength,
     return Status;
 }
 
+/*
+ * Output stage: PCM with more channels than the sink takes is downmixed
+ * to stereo (mono for a mono sink) in one pass, multichannel PCM the sink
+ * takes is reordered to the WAVEEX order of android. Decoders that downmix
+ * internally never get here with too many channels.
+ */
+OMX_U32 AudioDecoder::outputChannels(OMX_S16* aOutBuff, OMX_U32* aOutputLength){
+    mpDecorder *dec = (mpDecorder*)(shContext->ad_driver);
+    int channels = shContext->channels == 0 ? 2 : shContext->channels;
+    int layout = AF_CHANNEL_LAYOUT_WAVEEX_DEFAULT;
+
+    if (channels <= 2)
+	return channels;
+    // Only 16 bit PCM is mixed, 32 bit is narrowed first and 8 bit
+    // keeps the old clamp. The count and format depend on the decoder
+    // and the sink only, an empty call reports what a full one does.
+    if (!dec)
+	return 2;
+    if (af_fmt2bits(iOutFormat) == 32) {
+	if (!openNarrow(channels))
+	    return 2;
+	if (*aOutputLength > 0)
+	    narrowOutput(aOutBuff, aOutputLength, channels);
+	iOutFormat = AF_FORMAT_S16_NE;
+    }
+    if (iOutFormat != AF_FORMAT_S16_NE)
+	return 2;
+
+    dec->control(shContext, ADCTRL_QUERY_CHANNEL_LAYOUT, &layout);
+
+    if ((OMX_U32)channels > iMaxChannels) {
+	int outChannels = iMaxChannels > 1 ? 2 : 1;
+
+	if (*aOutputLength > 0) {
+	    int samples = downmix_channel_nch(aOutBuff, layout, aOutBuff, channels,
+					      outChannels, *aOutputLength);
+	    if (!samples)
+		return 2;
+	    *aOutputLength = samples;
+	}
+	return outChannels;
+    }
+
+    if (*aOutputLength > 0)
+	reorder_channel_nch(aOutBuff, layout, AF_CHANNEL_LAYOUT_WAVEEX_DEFAULT,
+			    channels, *aOutputLength, 2);
+    return channels;
+}
+
+// The S32 or float to S16 stage for iOutFormat, false if there is none.
+bool AudioDecoder::openNarrow(int channels){
+    if (!iNarrow || iNarrowFormat != iOutFormat || iNarrowChannels != channels) {
+	af_convert_close(iNarrow);
+	iNarrow = af_convert_open(iOutFormat, shContext->samplerate,
+				  shContext->samplerate, channels);
+	iNarrowFormat = iOutFormat;
+	iNarrowChannels = channels;
+    }
+    return iNarrow != NULL;
+}
+
+// S32 or float PCM to S16 in place, at the same rate, through the stage
+// openNarrow set up. The S16 samples are written behind the ones still
+// to read.
+void AudioDecoder::narrowOutput(OMX_S16* aOutBuff, OMX_U32* aOutputLength, int channels){
+    int frames = *aOutputLength * 2 / (4 * channels);
+
+    *aOutputLength = af_convert_run(iNarrow, aOutBuff, frames, aOutBuff) * channels;
+}
+
 OMX_S32 AudioDecoder::FindAudioCodec(sh_audio_t *sh_audio){
     unsigned int orig_fourcc = sh_audio->wf ? sh_audio->wf->wFormatTag : 0;
     int force = 0;
     unsigned int i;
     sh_audio->codec = NULL;
     sh_audio->ad_driver = 0;
+    iPassthroughActive = OMX_FALSE;
+
+    // Pass-through needs no codec from codecs.conf, a stream it can not
+    // sync to is decoded instead.
+    if (iPassthrough && SpdifDecoder::supports(sh_audio->format)) {
+	sh_audio->ad_driver = (ad_functions *)decFactor.CreateAudioDecoder((char *)SpdifDecoder::m_info.short_name);
+	if (sh_audio->ad_driver && init_audio_codec(sh_audio)) {
+	    ALOGI("audio format 0x%x passed through as IEC 61937", sh_audio->format);
+	    iPassthroughActive = OMX_TRUE;
+	    resetStats(SpdifDecoder::m_info.short_name);
+	    return 1;
+	}
+	ALOGW("audio format 0x%x can not be passed through, decoding", sh_audio->format);
+	decFactor.DiscardAudioDecoder();
+	sh_audio->ad_driver = 0;
+    }
 
     // restore original fourcc:
     if (sh_audio->wf)
@@ -269,16 +437,21 @@ OMX_S32 AudioDecoder::FindAudioCodec(sh_audio_t *sh_audio){
 
 	if(!sh_audio->ad_driver)
 	  continue;
+	int maxChannels = iMaxChannels;
+	((mpDecorder*)(sh_audio->ad_driver))->control(sh_audio, ADCTRL_SET_OUTPUT_CHANNELS, &maxChannels);
 	ALOGE("sh_audio->codec->drv=%s dll=%s",sh_audio->codec->drv,sh_audio->codec->dll);	
 	if (init_audio_codec(sh_audio)) {
 	  break;
-	}else
-	  decFactor.~DecFactor();	
+	}else{
+	  decFactor.DiscardAudioDecoder();
+	  sh_audio->ad_driver = 0;
+	}
       }
 
     if (sh_audio->wf)
 	sh_audio->wf->wFormatTag = i;
 
+    resetStats(sh_audio->codec->name);
     return 1;
 }
 
@@ -361,6 +534,14 @@ mpDecorder* DecFactor::CreateAudioDecoder(char *drv){
       EL_P1("Audio dec create DvdpcmDecoder\n");
       m_dec = new DvdpcmDecoder;
     }
+    if(strcmp(SpdifDecoder::m_info.short_name,drv) == 0){
+      EL_P1("Audio dec create SpdifDecoder\n");
+      m_dec = new SpdifDecoder;
+    }
+    if(strcmp(tremorDecoder::m_info.short_name,drv) == 0){
+      EL_P1("Audio dec create tremorDecoder\n");
+      m_dec = new tremorDecoder;
+    }
     return m_dec;
 }
 
@@ -368,21 +549,15 @@ DecFactor::DecFactor(){
     m_dec = NULL;
 }
 
+void DecFactor::DiscardAudioDecoder(){
+    delete m_dec;
+    m_dec = NULL;
+}
+
+// The owning AudioDecoder has uninit the decoder by now.
 DecFactor:: ~DecFactor(){
-  //if(strcmp(lumeDecoder::m_info.short_name,"lume") == 0)
-    {
-#if 0
-	lumeDecoder *m = (lumeDecoder *)m_dec;
-	if(m)
-	{
-	    free(m);
-	}
-#else
-        delete m_dec;
-#endif //by xqliang
-	
-    }
-    
+    delete m_dec;
+    m_dec = NULL;
 }
     
 }
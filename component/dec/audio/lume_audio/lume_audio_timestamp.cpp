@@ -27,7 +27,7 @@ namespace android{
 #define EL(x,y...)
 #define EL11(x,y...)
 //Initialize the parameters
-void ALumeTimeStampCalc::SetParameters(uint32 aFreq, uint32 aSamples)
+void ALumeTimeStampCalc::SetParameters(uint32_t aFreq, uint32_t aSamples)
 {
     if (0 != aFreq)
     {
@@ -51,7 +51,7 @@ void ALumeTimeStampCalc::SetFromInputTimestamp(OMX_TICKS aValue)
 }
 
 
-void ALumeTimeStampCalc::UpdateTimestamp(uint32 aValue)
+void ALumeTimeStampCalc::UpdateTimestamp(uint32_t aValue)
 {
     iCurrentSamples += aValue;
 	EL("iCurrentSamples = %d %d",iCurrentSamples,aValue);
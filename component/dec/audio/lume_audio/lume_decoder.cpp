@@ -20,6 +20,7 @@
 
 #define CONVERT_TO_CLASS(x) ((mpDecorder*)(x))
 #include <utils/Log.h>
+#include <pthread.h>
 #define EL(x,y...) //{ALOGE("%s %d",__FILE__,__LINE__); ALOGE(x,##y); }
 //#define EL(x,y...)
 
@@ -38,7 +39,6 @@ lumeDecoder::lumeDecoder()
 {
 	audio_output_channels = 2;
 	aframe_cnt=0;
-	avcodec_initialized=0;
 }
 
 lumeDecoder::~lumeDecoder()
@@ -93,13 +93,22 @@ static int setup_format(sh_audio_t *sh_audio, const AVCodecContext *lavc_context
     return 0;
 }
 
+// Registration rewrites libavcodec's codec list, which every decoder of
+// the process walks when it opens: do it once, and again only when
+// cooknplaying changes the set of codecs registered.
+static pthread_mutex_t avcodec_lock = PTHREAD_MUTEX_INITIALIZER;
+static int avcodec_registered_cook = -1;
+
 void init_avcodec(void)
 {
-    if (!avcodec_initialized) {
+    pthread_mutex_lock(&avcodec_lock);
+    if (!avcodec_initialized || avcodec_registered_cook != cooknplaying) {
         avcodec_init();
         audio_avcodec_register_all(cooknplaying);
         avcodec_initialized = 1;
+        avcodec_registered_cook = cooknplaying;
     }
+    pthread_mutex_unlock(&avcodec_lock);
 }
 
 int lumeDecoder::init(sh_audio_t *sh_audio)
@@ -231,6 +240,13 @@ int lumeDecoder::control(sh_audio_t *sh,int cmd,void* arg, ...)
     case ADCTRL_RESYNC_STREAM:
         avcodec_flush_buffers(lavc_context);
 	return CONTROL_TRUE;
+    case ADCTRL_SET_OUTPUT_CHANNELS:
+        // AC-3 and DTS downmix to stereo while decoding.
+        audio_output_channels = *(int *)arg;
+        return CONTROL_TRUE;
+    case ADCTRL_QUERY_CHANNEL_LAYOUT:
+        *(int *)arg = AF_CHANNEL_LAYOUT_LAVC_DEFAULT;
+        return CONTROL_TRUE;
     }
 
     return CONTROL_UNKNOWN;
@@ -75,21 +75,6 @@ int Mp3Decoder::preinit(sh_audio_t *sh)
     return 1;
 }
 
-/* utility to scale and round samples to 16 bits */
-static inline signed int scale(mad_fixed_t sample) {
-  /* round */
-  sample += (1L << (MAD_F_FRACBITS - 16));
-
-  /* clip */
-  if (sample >= MAD_F_ONE)
-    sample = MAD_F_ONE - 1;
-  else if (sample < -MAD_F_ONE)
-    sample = -MAD_F_ONE;
-
-  /* quantize */
-  return sample >> (MAD_F_FRACBITS + 1 - 16);
-}
-
 int Mp3Decoder::decode_frame(sh_audio_t *sh,unsigned char *outdata,int *outlen){
     mad_decoder_t *mad_dec = (mad_decoder_t *) sh->context;
     int len;
@@ -126,26 +111,12 @@ int Mp3Decoder::decode_frame(sh_audio_t *sh,unsigned char *outdata,int *outlen){
 			return (inbuf - buffer);
 
 		if (ret == 0){
+			int nsamples;
 			mad_synth_frame (&mad_dec->synth, &mad_dec->frame);
-			{
-				unsigned int         nchannels, nsamples;
-				mad_fixed_t const   *left_ch, *right_ch;
-				struct mad_pcm      *pcm = &mad_dec->synth.pcm;
-				
-				nchannels = pcm->channels;
-				nsamples  = pcm->length;
-				left_ch   = pcm->samples[0];
-				right_ch  = pcm->samples[1];
-				*outlen += nchannels*nsamples;
-				
-				while (nsamples--) {
-					/* output sample(s) in 16-bit signed little-endian PCM */
-					*output++ = scale(*left_ch++);
-					if (nchannels == 2)
-						*output++ = scale(*right_ch++);
-						
-				}
-			}
+			/* output sample(s) in 16-bit signed little-endian PCM */
+			nsamples = mad_synth_pcm16(&mad_dec->synth, (signed short *)output);
+			output += nsamples;
+			*outlen += nsamples;
 		}else if(!MAD_RECOVERABLE(mad_dec->stream.error))
 		{
 			if(mad_dec->stream.error == MAD_ERROR_BUFLEN)
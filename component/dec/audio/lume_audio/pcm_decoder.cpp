@@ -154,13 +154,9 @@ int PcmDecoder::control(sh_audio_t *sh,int cmd,void* arg, ...)
 int PcmDecoder::decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inlen,unsigned char* outbuf,int *outlen)
 {
     *outlen = 0;
-    
-    if (*inlen > 0 && sh_audio->channels >= 5) {
-        reorder_channel_nch(*inbuf, AF_CHANNEL_LAYOUT_WAVEEX_DEFAULT,
-                            AF_CHANNEL_LAYOUT_MPLAYER_DEFAULT,
-                            sh_audio->channels,
-                            *inlen / sh_audio->samplesize, sh_audio->samplesize);
-    }
+
+    // Multichannel PCM stays in WAVEEX order, the order AudioDecoder
+    // hands to android (or downmixes from).
 //    *outlen = *inlen/sh_audio->samplesize/sh_audio->channels*2;
 
     //  memcpy(outbuf,*inbuf,*outlen*sh_audio->samplesize);
@@ -187,8 +183,11 @@ int PcmDecoder::decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inl
 #else
     memcpy(outbuf,*inbuf,*inlen);
 #endif
-    /*outlen is out sample num*/
-    *outlen = *inlen/sh_audio->samplesize;
+    /*outlen is out sample num, 32 bit samples count twice*/
+    if (sh_audio->samplesize == 4)
+      *outlen = *inlen/2;
+    else
+      *outlen = *inlen/sh_audio->samplesize;
     *inbuf += *inlen;
     *inlen = 0;
     return *outlen;
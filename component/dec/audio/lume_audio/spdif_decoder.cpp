@@ -0,0 +1,412 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#include "spdif_decoder.h"
+
+extern "C"{
+#include "get_bits.h"
+#include "ac3_parser.h"
+#include "dca.h"
+}
+
+#include <utils/Log.h>
+#define EL(x,y...) //{ALOGE("%s %d",__FILE__,__LINE__); ALOGE(x,##y); }
+
+#define SPDIF_SYNCWORD1		0xF872
+#define SPDIF_SYNCWORD2		0x4E1F
+#define SPDIF_HEADER_SIZE	8
+
+/* IEC 61937 data types (Pc) */
+#define IEC61937_AC3		0x01
+#define IEC61937_DTS1		0x0B	/* 512 samples */
+#define IEC61937_DTS2		0x0C	/* 1024 samples */
+#define IEC61937_DTS3		0x0D	/* 2048 samples */
+#define IEC61937_EAC3		0x15
+
+#define AC3_BURST_SIZE		(1536 * 4)
+#define EAC3_BURST_SIZE		(AC3_BURST_SIZE * 4)	/* at 4x the sample rate */
+#define SPDIF_MAX_FRAME		16384			/* largest DTS core frame */
+#define SPDIF_MAX_OUTPUT	(512 * 1024)		/* left for the next call */
+#define SPDIF_CHECK_REPORT	1000			/* bursts between check logs */
+
+namespace android{
+
+#ifdef SPDIF_CHECK
+static const int eac3_blocks_per_frame[4] = { 1, 2, 3, 6 };
+#endif
+
+static const int dts_sample_rates[16] = {
+    0, 8000, 16000, 32000, 0, 0, 11025, 22050,
+    44100, 0, 0, 12000, 24000, 48000, 0, 0
+};
+
+SpdifDecoder::SpdifDecoder()
+{
+	codec = SPDIF_NONE;
+	carry = (uint8_t *)malloc(SPDIF_MAX_FRAME * 2);
+	carry_len = 0;
+	eac3_buf = (uint8_t *)malloc(EAC3_BURST_SIZE);
+	eac3_len = 0;
+	eac3_blocks = 0;
+#ifdef SPDIF_CHECK
+	check_bursts = 0;
+	check_errors = 0;
+#endif
+}
+
+SpdifDecoder::~SpdifDecoder()
+{
+#ifdef SPDIF_CHECK
+	if (check_bursts)
+		ALOGI("spdif check: %d bursts, %d bad", check_bursts, check_errors);
+#endif
+	free(carry);
+	free(eac3_buf);
+}
+
+int SpdifDecoder::codec_from_format(unsigned int format)
+{
+	switch (format) {
+	case 0x2000:
+	case mmioFOURCC('a','c','-','3'):
+		return SPDIF_AC3;
+	case mmioFOURCC('E','A','C','3'):
+	case mmioFOURCC('e','c','-','3'):
+		return SPDIF_EAC3;
+	case 0x2001:
+	case mmioFOURCC('d','t','s',' '):
+		return SPDIF_DTS;
+	}
+	return SPDIF_NONE;
+}
+
+bool SpdifDecoder::supports(unsigned int format)
+{
+	return codec_from_format(format) != SPDIF_NONE;
+}
+
+int SpdifDecoder::preinit(sh_audio_t *sh)
+{
+	// A frame can close two E-AC-3 bursts past SPDIF_MAX_OUTPUT.
+	sh->audio_out_minsize = SPDIF_MAX_OUTPUT + 2 * EAC3_BURST_SIZE;
+	return 1;
+}
+
+int SpdifDecoder::init(sh_audio_t *sh)
+{
+	codec = codec_from_format(sh->format);
+	if (codec == SPDIF_NONE || !carry || !eac3_buf)
+		return 0;
+
+	// The real rate comes with the first frame.
+	sh->samplerate = sh->wf && sh->wf->nSamplesPerSec ? sh->wf->nSamplesPerSec : 48000;
+	if (codec == SPDIF_EAC3)
+		sh->samplerate *= 4;
+	sh->channels = 2;
+	sh->samplesize = 2;
+	sh->sample_format = AF_FORMAT_S16_NE;
+	if (sh->wf && sh->wf->nAvgBytesPerSec)
+		sh->i_bps = sh->wf->nAvgBytesPerSec;
+	return 1;
+}
+
+void SpdifDecoder::uninit(sh_audio_t *sh)
+{
+}
+
+int SpdifDecoder::control(sh_audio_t *sh,int cmd,void* arg, ...)
+{
+	switch (cmd) {
+	case ADCTRL_RESYNC_STREAM:
+		carry_len = 0;
+		eac3_len = 0;
+		eac3_blocks = 0;
+		return CONTROL_TRUE;
+	}
+	return CONTROL_UNKNOWN;
+}
+
+// Returns the frame size, 0 if buf holds less than the header, -1 if no
+// frame starts at buf.
+int SpdifDecoder::parse_frame(const uint8_t *buf, int len, SpdifFrame *frame)
+{
+	GetBitContext gb;
+
+	memset(frame, 0, sizeof(*frame));
+
+	if (codec == SPDIF_DTS) {
+		int blocks, amode;
+
+		if (len < 10)
+			return 0;
+		// Only the 16 bit big endian core, as carried by MKV, TS and WAV.
+		if (AV_RB32(buf) != DCA_MARKER_RAW_BE)
+			return -1;
+		init_get_bits(&gb, buf + 4, (len - 4) * 8);
+		skip_bits(&gb, 1 + 5 + 1);	// frame type, deficit samples, crc
+		blocks = get_bits(&gb, 7) + 1;
+		frame->size = get_bits(&gb, 14) + 1;
+		amode = get_bits(&gb, 6);
+		frame->sample_rate = dts_sample_rates[get_bits(&gb, 4)];
+		if (blocks < 6 || frame->size < 96 || !frame->sample_rate || amode > 15)
+			return -1;
+
+		switch (blocks * 32) {
+		case 512:  frame->data_type = IEC61937_DTS1; break;
+		case 1024: frame->data_type = IEC61937_DTS2; break;
+		case 2048: frame->data_type = IEC61937_DTS3; break;
+		default:
+			return -1;
+		}
+		frame->period = blocks * 32 * 4;
+		return frame->size;
+	} else {
+		AC3HeaderInfo hdr;
+
+		if (len < 7)
+			return 0;
+		init_get_bits(&gb, buf, len * 8);
+		if (ff_ac3_parse_header(&gb, &hdr) < 0)
+			return -1;
+		// An E-AC-3 stream may start with plain AC-3 frames and
+		// the other way round, the burst follows each frame.
+		frame->size = hdr.frame_size;
+		frame->sample_rate = hdr.sample_rate;
+		if (hdr.bitstream_id <= 10) {
+			frame->data_type = IEC61937_AC3 | ((buf[5] & 7) << 8);	// bsmod
+		} else {
+			frame->data_type = IEC61937_EAC3;
+			if (hdr.frame_type != EAC3_FRAME_TYPE_DEPENDENT)
+				frame->blocks = hdr.num_blocks;
+		}
+		return frame->size;
+	}
+}
+
+// Pa Pb Pc Pd, then the payload as 16 bit words and zeros up to the
+// burst period. The stream is big endian, the PCM words little endian.
+int SpdifDecoder::put_burst(uint8_t *out, int data_type, int length_code,
+			    const uint8_t *data, int size, int period)
+{
+	int i;
+
+	AV_WL16(out,     SPDIF_SYNCWORD1);
+	AV_WL16(out + 2, SPDIF_SYNCWORD2);
+	AV_WL16(out + 4, data_type);
+	AV_WL16(out + 6, length_code);
+	out += SPDIF_HEADER_SIZE;
+
+	for (i = 0; i + 1 < size; i += 2) {
+		out[i]     = data[i + 1];
+		out[i + 1] = data[i];
+	}
+	if (size & 1) {
+		out[i]     = 0;
+		out[i + 1] = data[i];
+		i += 2;
+	}
+	memset(out + i, 0, period - SPDIF_HEADER_SIZE - i);
+#ifdef SPDIF_CHECK
+	check_burst(out - SPDIF_HEADER_SIZE, period, data, size);
+#endif
+	return period;
+}
+
+#ifdef SPDIF_CHECK
+// Rebuilds what IEC 61937-3/-5 (and libavformat's spdifenc) put in the
+// burst of the frames in data from their headers alone, and compares it
+// with the burst byte for byte.
+void SpdifDecoder::check_burst(const uint8_t *burst, int period,
+			       const uint8_t *data, int size)
+{
+	const uint8_t *payload = burst + SPDIF_HEADER_SIZE;
+	int want_pc, want_pd, want_period;
+	const char *err = NULL;
+	int i, end;
+
+	if (codec == SPDIF_DTS) {
+		int samples = ((((data[4] & 1) << 6) | (data[5] >> 2)) + 1) * 32;
+
+		want_pc = samples == 512 ? IEC61937_DTS1 :
+			  samples == 1024 ? IEC61937_DTS2 : IEC61937_DTS3;
+		want_pd = FFALIGN(size, 2) * 8;
+		want_period = samples * 4;
+	} else if ((data[5] >> 3) <= 10) {	// bsid
+		want_pc = IEC61937_AC3 | ((data[5] & 7) << 8);
+		want_pd = FFALIGN(size, 2) * 8;
+		want_period = AC3_BURST_SIZE;
+	} else {
+		int pos, blocks = 0;
+
+		// Six blocks of the independent frames, with the dependent
+		// frames of each, Pd in bytes.
+		if ((data[2] >> 6) == EAC3_FRAME_TYPE_DEPENDENT)
+			err = "E-AC-3 frames";
+		for (pos = 0; pos + 5 <= size; ) {
+			if ((data[pos + 2] >> 6) != EAC3_FRAME_TYPE_DEPENDENT)
+				blocks += (data[pos + 4] >> 6) == 3 ? 6 :	// fscod
+					  eac3_blocks_per_frame[(data[pos + 4] >> 4) & 3];
+			pos += ((((data[pos + 2] & 7) << 8) | data[pos + 3]) + 1) * 2;
+		}
+		if (pos != size || blocks != 6)
+			err = "E-AC-3 frames";
+		want_pc = IEC61937_EAC3;
+		want_pd = size;
+		want_period = EAC3_BURST_SIZE;
+	}
+
+	if (AV_RL16(burst) != SPDIF_SYNCWORD1 || AV_RL16(burst + 2) != SPDIF_SYNCWORD2)
+		err = "Pa/Pb";
+	else if (AV_RL16(burst + 4) != want_pc)
+		err = "Pc";
+	else if (AV_RL16(burst + 6) != want_pd)
+		err = "Pd";
+	else if (period != want_period)
+		err = "burst period";
+
+	for (i = 0; !err && i < size; i++)
+		if (payload[i ^ 1] != data[i])
+			err = "payload";
+	// An odd frame is padded to a whole word, then the burst with zeros.
+	end = period - SPDIF_HEADER_SIZE;
+	for (i = size; !err && i < end; i++)
+		if (payload[i ^ 1])
+			err = "padding";
+
+	check_bursts++;
+	if (err) {
+		check_errors++;
+		ALOGE("spdif check: burst %d of %d bytes, bad %s", check_bursts, size, err);
+	}
+	if (check_bursts % SPDIF_CHECK_REPORT == 0)
+		ALOGI("spdif check: %d bursts, %d bad", check_bursts, check_errors);
+}
+#endif
+
+int SpdifDecoder::put_eac3_burst(uint8_t *out)
+{
+	put_burst(out, IEC61937_EAC3, eac3_len, eac3_buf, eac3_len, EAC3_BURST_SIZE);
+	eac3_len = 0;
+	eac3_blocks = 0;
+	return EAC3_BURST_SIZE;
+}
+
+// Writes the bursts the frame completes, returns their size or 0. len is
+// what buf holds from the frame on.
+int SpdifDecoder::put_frame(sh_audio_t *sh, const uint8_t *buf, int len,
+			    const SpdifFrame *frame, uint8_t *out)
+{
+	if (frame->data_type == IEC61937_EAC3) {
+		int olen = 0;
+
+		// Six blocks (1536 samples) per burst, at 4x the rate. The
+		// dependent frames after the sixth block go in the burst too,
+		// so it is closed by the next independent frame, or as soon as
+		// the frame after the last one is seen not to be dependent.
+		if (frame->blocks && eac3_blocks >= 6)
+			olen = put_eac3_burst(out);
+		if (eac3_len + frame->size > EAC3_BURST_SIZE - SPDIF_HEADER_SIZE) {
+			ALOGW("spdif: E-AC-3 burst overflow, dropping %d bytes", eac3_len);
+			eac3_len = 0;
+			eac3_blocks = 0;
+		}
+		memcpy(eac3_buf + eac3_len, buf, frame->size);
+		eac3_len += frame->size;
+		eac3_blocks += frame->blocks;
+		sh->samplerate = frame->sample_rate * 4;
+
+		if (eac3_blocks >= 6 && len >= frame->size + 3
+		    && (buf[frame->size + 2] >> 6) != EAC3_FRAME_TYPE_DEPENDENT)
+			olen += put_eac3_burst(out + olen);
+		return olen;
+	}
+
+	if (codec == SPDIF_DTS) {
+		if (frame->size > frame->period - SPDIF_HEADER_SIZE) {
+			ALOGW("spdif: DTS frame of %d bytes does not fit a burst", frame->size);
+			return 0;
+		}
+		sh->samplerate = frame->sample_rate;
+		return put_burst(out, frame->data_type, FFALIGN(frame->size, 2) * 8,
+				 buf, frame->size, frame->period);
+	}
+
+	sh->samplerate = frame->sample_rate;
+	return put_burst(out, frame->data_type, FFALIGN(frame->size, 2) * 8,
+			 buf, frame->size, AC3_BURST_SIZE);
+}
+
+int SpdifDecoder::decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inlen,unsigned char* outbuf,int *outlen)
+{
+	int olen = 0;
+
+	*outlen = 0;
+	if (*inlen <= 0) {
+		// End of stream, no frame follows the last E-AC-3 burst.
+		if (eac3_blocks >= 6) {
+			olen = put_eac3_burst(outbuf);
+			*outlen = olen / 2;
+		}
+		return olen;
+	}
+
+	while (*inlen > 0 && olen < SPDIF_MAX_OUTPUT) {
+		SpdifFrame frame;
+		int pos = 0, size;
+		int n = SPDIF_MAX_FRAME * 2 - carry_len;
+
+		if (n > *inlen)
+			n = *inlen;
+		memcpy(carry + carry_len, *inbuf, n);
+		carry_len += n;
+		*inbuf += n;
+		*inlen -= n;
+
+		while (olen < SPDIF_MAX_OUTPUT) {
+			size = parse_frame(carry + pos, carry_len - pos, &frame);
+			if (size < 0) {
+				pos++;		// resync
+				continue;
+			}
+			if (size == 0 || size > carry_len - pos)
+				break;
+			olen += put_frame(sh_audio, carry + pos, carry_len - pos,
+					  &frame, outbuf + olen);
+			pos += size;
+		}
+
+		carry_len -= pos;
+		memmove(carry, carry + pos, carry_len);
+		// No frame is that long, the carry is garbage.
+		if (olen < SPDIF_MAX_OUTPUT && carry_len >= SPDIF_MAX_FRAME)
+			carry_len = 0;
+	}
+
+	*outlen = olen / 2;
+	return olen;
+}
+
+ad_info_t SpdifDecoder::m_info = {
+	"AC-3/E-AC-3/DTS pass-through IEC 61937",
+	"spdif",
+	"",
+	"",
+	"wraps the frames in IEC 61937 bursts"
+};
+
+}
@@ -0,0 +1,262 @@
+/* ------------------------------------------------------------------
+ * Copyright (C) 1998-2009 PacketVideo
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ * -------------------------------------------------------------------
+ */
+
+#include "tremor_decoder.h"
+
+extern "C"{
+#include "tremor/ivorbiscodec.h"
+}
+
+#define ADCTRL_RESYNC_STREAM 1       /* resync, called after seeking! */
+#define CONTROL_TRUE 1
+#define CONTROL_UNKNOWN -1
+
+#include <utils/Log.h>
+#define EL(x,y...) //{ALOGE("%s %d",__FILE__,__LINE__); ALOGE(x,##y); }
+
+#define TREMOR_MAX_CHANNELS 8
+#define TREMOR_MAX_FRAMES 4096		/* half the longest Vorbis block */
+
+namespace android{
+
+struct tremorDecoder::TremorState {
+	vorbis_info vi;
+	vorbis_dsp_state vd;
+	vorbis_block vb;
+	ogg_int64_t packetno;
+};
+
+tremorDecoder::tremorDecoder()
+{
+	ov = NULL;
+}
+
+tremorDecoder::~tremorDecoder()
+{
+}
+
+int tremorDecoder::preinit(sh_audio_t *sh)
+{
+	// A packet completes at most one window, twice for safety.
+	sh->audio_out_minsize = TREMOR_MAX_FRAMES * TREMOR_MAX_CHANNELS * 2 * 2;
+	return 1;
+}
+
+// The identification, comment and setup headers, Xiph laced in the
+// extradata as the demuxers put them.
+int tremorDecoder::read_headers(sh_audio_t *sh)
+{
+	unsigned char *extradata;
+	int size, offset = 1, i;
+	int hsizes[3];
+	vorbis_comment vc;
+	ogg_packet op;
+
+	if (sh->wf && sh->wf->cbSize) {
+		extradata = (unsigned char *)(sh->wf + 1);
+		size = sh->wf->cbSize;
+	} else if (sh->codecdata && sh->codecdata_len) {
+		extradata = sh->codecdata;
+		size = sh->codecdata_len;
+	} else {
+		ALOGE("tremor: no Vorbis headers in the extradata");
+		return 0;
+	}
+	if (size < 3 || extradata[0] != 2) {
+		ALOGE("tremor: Vorbis track does not contain valid headers");
+		return 0;
+	}
+
+	for (i = 0; i < 2; i++) {
+		hsizes[i] = 0;
+		while (offset < size && extradata[offset] == 0xFF) {
+			hsizes[i] += 255;
+			offset++;
+		}
+		if (offset >= size - 1) {
+			ALOGE("tremor: Vorbis track does not contain valid headers");
+			return 0;
+		}
+		hsizes[i] += extradata[offset++];
+	}
+	hsizes[2] = size - offset - hsizes[0] - hsizes[1];
+	if (hsizes[2] <= 0) {
+		ALOGE("tremor: Vorbis track does not contain valid headers");
+		return 0;
+	}
+
+	vorbis_comment_init(&vc);
+	memset(&op, 0, sizeof(op));
+	for (i = 0; i < 3; i++) {
+		op.packet = extradata + offset;
+		op.bytes = hsizes[i];
+		op.b_o_s = i == 0;
+		op.packetno = i;
+		if (vorbis_synthesis_headerin(&ov->vi, &vc, &op) < 0) {
+			ALOGE("tremor: header %d broken, len=%ld", i, op.bytes);
+			vorbis_comment_clear(&vc);
+			return 0;
+		}
+		offset += hsizes[i];
+	}
+	EL("tremor: encoded by %s", vc.vendor);
+	vorbis_comment_clear(&vc);
+	return 1;
+}
+
+int tremorDecoder::init(sh_audio_t *sh)
+{
+	ov = (TremorState *)malloc(sizeof(TremorState));
+	if (!ov)
+		return 0;
+	vorbis_info_init(&ov->vi);
+	if (!read_headers(sh) || ov->vi.channels < 1
+	    || ov->vi.channels > TREMOR_MAX_CHANNELS) {
+		vorbis_info_clear(&ov->vi);
+		free(ov);
+		ov = NULL;
+		return 0;
+	}
+
+	vorbis_synthesis_init(&ov->vd, &ov->vi);
+	vorbis_block_init(&ov->vd, &ov->vb);
+	ov->packetno = 3;
+
+	sh->channels = ov->vi.channels;
+	sh->samplerate = ov->vi.rate;
+	sh->samplesize = 2;
+	sh->sample_format = AF_FORMAT_S16_NE;
+	// assume 128kbit if bitrate not specified in the header
+	sh->i_bps = ((ov->vi.bitrate_nominal > 0) ? ov->vi.bitrate_nominal : 128000) / 8;
+	ALOGI("tremor: %d ch, %ld Hz, %ld bit/s", ov->vi.channels, ov->vi.rate,
+	      ov->vi.bitrate_nominal);
+	return 1;
+}
+
+void tremorDecoder::uninit(sh_audio_t *sh)
+{
+	if (ov) {
+		vorbis_block_clear(&ov->vb);
+		vorbis_dsp_clear(&ov->vd);
+		vorbis_info_clear(&ov->vi);
+		free(ov);
+		ov = NULL;
+	}
+}
+
+// Drops the overlap of the last window, after a seek.
+void tremorDecoder::restart()
+{
+	vorbis_block_clear(&ov->vb);
+	vorbis_dsp_clear(&ov->vd);
+	vorbis_synthesis_init(&ov->vd, &ov->vi);
+	vorbis_block_init(&ov->vd, &ov->vb);
+}
+
+int tremorDecoder::control(sh_audio_t *sh,int cmd,void* arg, ...)
+{
+	switch (cmd) {
+	case ADCTRL_RESYNC_STREAM:
+		if (ov)
+			restart();
+		return CONTROL_TRUE;
+	case ADCTRL_QUERY_CHANNEL_LAYOUT:
+		*(int *)arg = AF_CHANNEL_LAYOUT_VORBIS_DEFAULT;
+		return CONTROL_TRUE;
+	}
+	return CONTROL_UNKNOWN;
+}
+
+// The PCM the last packet completed, 16 bit interleaved.
+int tremorDecoder::put_pcm(unsigned char *outbuf)
+{
+	ogg_int32_t **pcm;
+	int channels = ov->vi.channels;
+	int16_t *out = (int16_t *)outbuf;
+	int samples, olen = 0;
+
+	while ((samples = vorbis_synthesis_pcmout(&ov->vd, &pcm)) > 0) {
+		for (int i = 0; i < channels; i++) {
+			ogg_int32_t *mono = pcm[i];
+			int16_t *ptr = out + i;
+			for (int j = 0; j < samples; j++) {
+				int val = mono[j] >> 9;
+				if (val > 32767)
+					val = 32767;
+				else if (val < -32768)
+					val = -32768;
+				*ptr = val;
+				ptr += channels;
+			}
+		}
+		out += samples * channels;
+		olen += samples * channels * 2;
+		vorbis_synthesis_read(&ov->vd, samples);
+	}
+	return olen;
+}
+
+// Every input buffer is one Vorbis packet.
+int tremorDecoder::decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inlen,unsigned char* outbuf,int *outlen)
+{
+	ogg_packet op;
+	int olen, ret;
+
+	*outlen = 0;
+	if (*inlen <= 0)
+		return 0;
+
+	if (sh_audio->ds && sh_audio->ds->seek_flag > 0) {
+		restart();
+		sh_audio->ds->seek_flag = 0;
+	}
+
+	memset(&op, 0, sizeof(op));
+	op.packet = *inbuf;
+	op.bytes = *inlen;
+	op.packetno = ov->packetno++;
+	// The demuxer has no granule position for the packet. 0 would have
+	// Tremor trim the second packet as a partial first frame.
+	op.granulepos = -1;
+
+	ret = vorbis_synthesis(&ov->vb, &op);
+	if (ret == 0)
+		vorbis_synthesis_blockin(&ov->vd, &ov->vb);
+	olen = put_pcm(outbuf);
+
+	*inbuf += *inlen;
+	*inlen = 0;
+
+	// Headers repeated in band are no audio, not an error.
+	if (ret < 0 && ret != OV_ENOTAUDIO && olen == 0) {
+		EL("tremor: packet of %ld bytes broken (%d)", op.bytes, ret);
+		return -1;
+	}
+	*outlen = olen / 2;
+	return olen;
+}
+
+ad_info_t tremorDecoder::m_info = {
+	"Ogg/Vorbis audio decoder",
+	"tremor",
+	"Felix Buenemann, A'rpi",
+	"libvorbis",
+	"uses the integer Tremor decoder"
+};
+
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the output stage HWAudioDec runs decoded PCM through
+// (lume/libaf/af_convert.c):
+//  - THD+N of a sine at -1 dBFS for each input format and a few rate
+//    pairs, failing above a limit per case (-80 dB for 44.1 to 48 kHz).
+//    The sine is fitted to the output by least squares, the rest is
+//    distortion and noise; the edges the filter ramps in and out are
+//    left out. 1 kHz shows the noise floor, 15 kHz the images a short
+//    or badly windowed filter lets through.
+//  - the output is the same however the input is cut into calls.
+//  - throughput in samples per second of cpu time, printed only.
+//
+// usage: af_convert_check
+
+#include "af_format.h"
+#include "af_convert.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#undef printf
+
+typedef std::vector<int16_t> Pcm;
+
+static const char *formatName(int format) {
+    switch (format) {
+    case AF_FORMAT_U8:       return "u8";
+    case AF_FORMAT_S16_NE:   return "s16";
+    case AF_FORMAT_S32_NE:   return "s32";
+    default:                 return "float";
+    }
+}
+
+static int bytesPerSample(int format) {
+    switch (format) {
+    case AF_FORMAT_U8:       return 1;
+    case AF_FORMAT_S16_NE:   return 2;
+    default:                 return 4;
+    }
+}
+
+// frames * channels samples of x(i), in the format.
+static std::vector<uint8_t> makeInput(int format, int frames, int channels,
+                                      double (*x)(int i, void *), void *arg) {
+    std::vector<uint8_t> in(frames * channels * bytesPerSample(format));
+    for (int i = 0; i < frames * channels; ++i) {
+        double v = x(i, arg);
+        switch (format) {
+        case AF_FORMAT_U8:     in[i] = 128 + lrint(v * 127); break;
+        case AF_FORMAT_S16_NE: ((int16_t *)&in[0])[i] = lrint(v * 32767); break;
+        case AF_FORMAT_S32_NE: ((int32_t *)&in[0])[i] = lrint(v * 2147483647.0); break;
+        default:               ((float *)&in[0])[i] = v; break;
+        }
+    }
+    return in;
+}
+
+// Runs in through a fresh stage in calls of at most maxChunk frames (all
+// at once for 0) and flushes it.
+static bool convert(int format, int inRate, int outRate, int channels,
+                    const std::vector<uint8_t> &in, int maxChunk, Pcm *out) {
+    af_convert_t *s = af_convert_open(format, inRate, outRate, channels);
+    if (s == NULL)
+        return false;
+
+    int frameSize = bytesPerSample(format) * channels;
+    int frames = in.size() / frameSize;
+    out->resize((af_convert_out_frames(s, frames) + maxChunk + 16) * channels);
+
+    int n = 0;
+    for (int pos = 0; pos < frames; ) {
+        int len = frames - pos;
+        if (maxChunk > 0) {
+            int chunk = 1 + rand() % maxChunk;
+            if (len > chunk)
+                len = chunk;
+        }
+        n += af_convert_run(s, &in[pos * frameSize], len, &(*out)[n * channels]);
+        pos += len;
+    }
+    n += af_convert_flush(s, &(*out)[n * channels]);
+    out->resize(n * channels);
+
+    af_convert_close(s);
+    return true;
+}
+
+static double sine(int i, void *arg) {
+    return 0.891 * sin(*(double *)arg * i);
+}
+
+static bool checkThdN(int format, int inRate, int outRate, int freq, double limit) {
+    double w = 2 * M_PI * freq / inRate;
+    Pcm out;
+    if (!convert(format, inRate, outRate, 1,
+                 makeInput(format, inRate / 4, 1, sine, &w), 0, &out)) {
+        printf("%-5s %5d -> %5d Hz: not opened\n", formatName(format), inRate, outRate);
+        return false;
+    }
+
+    double ss = 0, cc = 0, sc = 0, ys = 0, yc = 0, sig = 0, err = 0;
+    int n = out.size();
+    int skip = 16 * outRate / inRate + 16;
+
+    w = 2 * M_PI * freq / outRate;
+    for (int i = skip; i < n - skip; ++i) {
+        double si = sin(w * i), co = cos(w * i);
+        ss += si * si;
+        cc += co * co;
+        sc += si * co;
+        ys += out[i] * si;
+        yc += out[i] * co;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    for (int i = skip; i < n - skip; ++i) {
+        double fit = a * sin(w * i) + b * cos(w * i);
+        sig += fit * fit;
+        err += (out[i] - fit) * (out[i] - fit);
+    }
+
+    double thdn = 10 * log10(err / sig);
+    bool ok = thdn <= limit;
+    printf("%-5s %5d -> %5d Hz, %5d Hz sine: THD+N %.1f dB (limit %.0f)%s\n",
+           formatName(format), inRate, outRate, freq, thdn, limit, ok ? "" : " FAIL");
+    return ok;
+}
+
+static double noise(int, void *) {
+    return (rand() % 65536 - 32768) / 32768.0 * 0.5;
+}
+
+static bool checkChunking(int format, int inRate, int outRate) {
+    std::vector<uint8_t> in = makeInput(format, inRate, 2, noise, NULL);
+    Pcm whole, split;
+    if (!convert(format, inRate, outRate, 2, in, 0, &whole)
+            || !convert(format, inRate, outRate, 2, in, 700, &split)) {
+        printf("%-5s %5d -> %5d Hz: not opened\n", formatName(format), inRate, outRate);
+        return false;
+    }
+
+    bool ok = whole == split;
+    printf("%-5s %5d -> %5d Hz: %zu samples, split input %s\n",
+           formatName(format), inRate, outRate, whole.size(),
+           ok ? "matches" : "differs FAIL");
+    return ok;
+}
+
+static void throughput(int format, int inRate, int outRate) {
+    std::vector<uint8_t> in = makeInput(format, inRate * 10, 2, noise, NULL);
+    Pcm out;
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+    convert(format, inRate, outRate, 2, in, 4096, &out);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+
+    double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%-5s %5d -> %5d Hz, 2 ch: %.1fM samples/s per core\n",
+           formatName(format), inRate, outRate, out.size() / s / 1e6);
+}
+
+int main(int, char **) {
+    static const struct {
+        int format;
+        int inRate;
+        int outRate;
+        int freq;
+        double limit;
+    } kThdN[] = {
+        { AF_FORMAT_S16_NE,   44100, 48000, 1000, -80 },
+        { AF_FORMAT_S32_NE,   44100, 48000, 1000, -80 },
+        { AF_FORMAT_FLOAT_NE, 44100, 48000, 1000, -80 },
+        { AF_FORMAT_S16_NE,   44100, 48000, 15000, -80 },
+        { AF_FORMAT_S16_NE,   48000, 44100, 1000, -80 },
+        { AF_FORMAT_S16_NE,   48000, 44100, 15000, -80 },
+        { AF_FORMAT_S16_NE,   22050, 48000, 1000, -80 },
+        { AF_FORMAT_S16_NE,   48000, 16000, 1000, -80 },
+        { AF_FORMAT_S32_NE,   48000, 48000, 1000, -85 },
+        { AF_FORMAT_FLOAT_NE, 48000, 48000, 1000, -85 },
+        // the 8 bit source itself is at -49 dB
+        { AF_FORMAT_U8,       44100, 48000, 1000, -45 },
+    };
+    bool ok = true;
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(kThdN) / sizeof(kThdN[0]); ++i)
+        ok = checkThdN(kThdN[i].format, kThdN[i].inRate, kThdN[i].outRate,
+                       kThdN[i].freq, kThdN[i].limit) && ok;
+
+    ok = checkChunking(AF_FORMAT_S16_NE, 44100, 48000) && ok;
+    ok = checkChunking(AF_FORMAT_FLOAT_NE, 48000, 44100) && ok;
+    ok = checkChunking(AF_FORMAT_S32_NE, 48000, 48000) && ok;
+
+    throughput(AF_FORMAT_S16_NE, 44100, 48000);
+    throughput(AF_FORMAT_S16_NE, 48000, 48000);
+
+    printf(ok ? "OK\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
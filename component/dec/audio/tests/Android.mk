@@ -0,0 +1,100 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# MXU libmad against its plain C build (ref_c.c, compiled here with the
+# libmp3.mk flags), over data/*.mp3 or the files given
+MAD_PATH := hardware/ingenic/xb4780/xbomx/component/dec/lume/madlib/libmad-0.15.1b
+
+LOCAL_SRC_FILES:= \
+        MadMxuCheck.cpp \
+        ../../lume/madlib/libmad-0.15.1b/ref_c.c
+
+LOCAL_CFLAGS := -O2 -ffast-math -fno-builtin -DHAVE_CONFIG_H \
+        -D_REENTRANT -D_LITTLE_ENDIAN=1 -DFPM_MIPS -DHAVE_MADD_ASM \
+        -imacros hardware/ingenic/xb4780/xbomx/component/dec/lume/libjzcommon/com_config.h
+
+LOCAL_C_INCLUDES += \
+        $(MAD_PATH) \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavcodec \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavutil \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libmpcodecs \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libcutils                       \
+        libutils
+
+LOCAL_STATIC_LIBRARIES :=               \
+        libstagefright_mad
+
+LOCAL_MODULE:= mad_mxu_check
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# THD+N and throughput of the output stage (lume/libaf/af_convert.c) as
+# libstagefright_alumedecoder builds it, with the MXU dot products;
+# "make check-host" runs the same checks on the build machine
+LOCAL_SRC_FILES:= \
+        AfConvertCheck.cpp
+
+LOCAL_C_INCLUDES += \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libaf \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavutil \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libcutils                       \
+        libutils
+
+LOCAL_STATIC_LIBRARIES :=               \
+        libstagefright_alumedecoder     \
+        libstagefright_ffmpcommon
+
+LOCAL_MODULE:= af_convert_check
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+# Tremor as HWAudioDec runs it (lume_audio/tremor_decoder.cpp) against
+# the float libavcodec Vorbis decoder, over data/vorbis.ogg or the files
+# given: the same length and at most 2 LSB apart, with the cpu time of each
+LOCAL_SRC_FILES:= \
+        TremorCheck.cpp
+
+LOCAL_C_INCLUDES += \
+        hardware/ingenic/xb4780/xbomx/component/dec/audio/lume_audio/include \
+        hardware/ingenic/xb4780/xbdemux/lume \
+        hardware/ingenic/xb4780/xbdemux/lume/stream \
+        hardware/ingenic/xb4780/xbdemux/lume/libmpdemux \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libaf \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavutil \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavcodec \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libmpcodecs \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libjzcommon \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libcutils                       \
+        libutils                        \
+        libdl
+
+LOCAL_STATIC_LIBRARIES :=               \
+        libstagefright_alume_codec      \
+        libstagefright_tremor           \
+        libstagefright_alumedecoder     \
+        libstagefright_ffmpcommon       \
+        libstagefright_ffavutil         \
+        libstagefright_ffavcore
+
+LOCAL_MODULE:= tremor_check
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
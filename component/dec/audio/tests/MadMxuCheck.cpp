@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes MP3 files with the MXU build of libmad the decoder links
+// (libstagefright_mad) and with the plain C build of the same sources
+// (ref_c.c), and fails on any difference: in the frames decoded, the
+// errors reported or a single 16-bit output sample. Prints the cpu time
+// of each build. The default files are the Layer III streams in data/
+// (see host/mp3_refs.cpp); on the device, push them next to the binary.
+//
+// usage: mad_mxu_check [file.mp3 ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+extern "C" {
+#include "mad.h"
+}
+#include "ref_c.h"
+
+typedef std::vector<unsigned char> Bytes;
+
+// One build of the frame decoding and synthesis; the stream and bit
+// reader are shared by both.
+struct MadBuild {
+    const char *name;
+    void (*frameInit)(struct mad_frame *);
+    void (*frameFinish)(struct mad_frame *);
+    int (*frameDecode)(struct mad_frame *, struct mad_stream *);
+    void (*synthInit)(struct mad_synth *);
+    void (*synthFrame)(struct mad_synth *, struct mad_frame const *);
+    unsigned int (*synthPcm16)(struct mad_synth const *, signed short *);
+};
+
+static const MadBuild kMxu = {
+    "mxu", mad_frame_init, mad_frame_finish, mad_frame_decode,
+    mad_synth_init, mad_synth_frame, mad_synth_pcm16,
+};
+
+static const MadBuild kC = {
+    "c", mad_c_frame_init, mad_c_frame_finish, mad_c_frame_decode,
+    mad_c_synth_init, mad_c_synth_frame, mad_c_synth_pcm16,
+};
+
+struct Decoded {
+    std::vector<int> errors;        // per frame, MAD_ERROR_NONE if decoded
+    std::vector<short> pcm;
+    int64_t ns;
+};
+
+static int64_t cpuNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static bool readFile(const char *path, Bytes *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    out->resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(&(*out)[0], 1, out->size(), f) == out->size();
+    fclose(f);
+    // libmad needs MAD_BUFFER_GUARD bytes past the last frame to decode it
+    out->resize(out->size() + MAD_BUFFER_GUARD, 0);
+    return ok;
+}
+
+static void decode(const MadBuild &b, const Bytes &in, Decoded *out) {
+    struct mad_stream stream;
+    struct mad_frame frame;
+    struct mad_synth synth;
+    short pcm[2 * 1152];
+
+    mad_stream_init(&stream);
+    b.frameInit(&frame);
+    b.synthInit(&synth);
+    mad_stream_buffer(&stream, &in[0], in.size());
+
+    int64_t start = cpuNs();
+    for (;;) {
+        if (b.frameDecode(&frame, &stream)) {
+            if (stream.error == MAD_ERROR_BUFLEN)
+                break;
+            out->errors.push_back(stream.error);
+            if (!MAD_RECOVERABLE(stream.error))
+                break;
+            continue;
+        }
+        out->errors.push_back(MAD_ERROR_NONE);
+        b.synthFrame(&synth, &frame);
+        unsigned int n = b.synthPcm16(&synth, pcm);
+        out->pcm.insert(out->pcm.end(), pcm, pcm + n);
+    }
+    out->ns = cpuNs() - start;
+
+    b.frameFinish(&frame);
+    mad_stream_finish(&stream);
+}
+
+static bool check(const char *path) {
+    Bytes in;
+    if (!readFile(path, &in))
+        return false;
+
+    Decoded mxu, c;
+    decode(kMxu, in, &mxu);
+    decode(kC, in, &c);
+
+    int bad = 0;
+    for (size_t i = 0; i < mxu.errors.size(); ++i) {
+        if (mxu.errors[i] != MAD_ERROR_NONE)
+            ++bad;
+    }
+    printf("%s: %zu frames, %d not decoded, %s %lld us, %s %lld us\n",
+           path, mxu.errors.size(), bad,
+           kMxu.name, (long long)(mxu.ns / 1000),
+           kC.name, (long long)(c.ns / 1000));
+
+    if (mxu.errors != c.errors) {
+        size_t i = 0;
+        while (i < mxu.errors.size() && i < c.errors.size()
+                && mxu.errors[i] == c.errors[i])
+            ++i;
+        printf("  frame %zu: %s error 0x%04x, %s error 0x%04x\n", i,
+               kMxu.name, i < mxu.errors.size() ? mxu.errors[i] : -1,
+               kC.name, i < c.errors.size() ? c.errors[i] : -1);
+        return false;
+    }
+
+    if (mxu.pcm.size() != c.pcm.size()) {
+        printf("  %s %zu samples, %s %zu samples\n",
+               kMxu.name, mxu.pcm.size(), kC.name, c.pcm.size());
+        return false;
+    }
+
+    size_t first = mxu.pcm.size();
+    int maxDiff = 0;
+    for (size_t i = 0; i < mxu.pcm.size(); ++i) {
+        int d = abs(mxu.pcm[i] - c.pcm[i]);
+        if (d > 0 && first == mxu.pcm.size())
+            first = i;
+        if (d > maxDiff)
+            maxDiff = d;
+    }
+    if (maxDiff > 0) {
+        printf("  %zu samples, first difference at %zu (%d, %d), max %d\n",
+               mxu.pcm.size(), first, mxu.pcm[first], c.pcm[first], maxDiff);
+        return false;
+    }
+    printf("  %zu samples bit exact\n", mxu.pcm.size());
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const char *kDefault[] = {
+        "data/l3_joint.mp3",
+        "data/l3_lsf_mono.mp3",
+    };
+    const char **files = argc > 1 ? (const char **)argv + 1 : kDefault;
+    int numFiles = argc > 1 ? argc - 1 : sizeof(kDefault) / sizeof(kDefault[0]);
+    bool ok = true;
+
+    for (int i = 0; i < numFiles; ++i)
+        ok = check(files[i]) && ok;
+
+    printf(ok ? "OK\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs SpdifDecoder on the host over the AC-3, E-AC-3 and DTS streams in
+// data/ and compares its output with the IEC 61937 bursts next to them
+// (see host/spdif_refs.cpp). Each stream is fed twice: in one piece, and
+// cut at random points the way extractor buffers may split frames. Both
+// end with the zero-length call HWAudioDec makes at EOS, which has to
+// flush the E-AC-3 burst still being gathered.
+//
+// usage: spdif-check [data dir]
+
+#include "spdif_decoder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#undef printf
+#undef perror
+
+using namespace android;
+
+typedef std::vector<uint8_t> Bytes;
+
+static bool readFile(const char *dir, const char *name, Bytes *out) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    out->resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(&(*out)[0], 1, out->size(), f) == out->size();
+    fclose(f);
+    return ok;
+}
+
+// maxChunk 0 feeds the whole stream in one call.
+static bool check(const char *name, unsigned format,
+                  const Bytes &in, const Bytes &want, int maxChunk) {
+    SpdifDecoder dec;
+    sh_audio_t sh;
+    memset(&sh, 0, sizeof(sh));
+    sh.format = format;
+    dec.preinit(&sh);
+    if (!dec.init(&sh)) {
+        printf("%-5s init failed\n", name);
+        return false;
+    }
+
+    Bytes out(want.size() + sh.audio_out_minsize);
+    size_t outLen = 0;
+    size_t pos = 0;
+    bool eos = false;
+
+    while (!eos) {
+        int n = in.size() - pos;
+        if (maxChunk > 0 && n > 0) {
+            n = 1 + rand() % maxChunk;
+            if (pos + n > in.size())
+                n = in.size() - pos;
+        }
+        eos = n == 0;
+
+        unsigned char *inbuf = eos ? NULL : (unsigned char *)&in[pos];
+        int inlen = n;
+        do {
+            int outlen = 0;
+            if (outLen + sh.audio_out_minsize > out.size()) {
+                printf("%-5s more output than the %zu reference bytes\n",
+                       name, want.size());
+                return false;
+            }
+            outLen += dec.decode_audio(&sh, &inbuf, &inlen, &out[outLen], &outlen);
+        } while (inlen > 0);
+        pos += n;
+    }
+    dec.uninit(&sh);
+
+    size_t diff = 0;
+    while (diff < outLen && diff < want.size() && out[diff] == want[diff])
+        ++diff;
+
+    const char *how = maxChunk ? "split" : "whole";
+    if (outLen != want.size() || diff != outLen) {
+        printf("%-5s %s: %zu bytes out, %zu expected, first difference at %zu\n",
+               name, how, outLen, want.size(), diff);
+        return false;
+    }
+    printf("%-5s %s: %zu bytes match\n", name, how, outLen);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const struct {
+        const char *name;
+        const char *stream;
+        const char *bursts;
+        unsigned format;
+    } kStreams[] = {
+        { "ac3",  "ac3.ac3",   "ac3.spdif",  0x2000 },
+        { "eac3", "eac3.eac3", "eac3.spdif", mmioFOURCC('E','A','C','3') },
+        { "dts",  "dts.dts",   "dts.spdif",  0x2001 },
+    };
+    const char *dir = argc > 1 ? argv[1] : "data";
+    bool ok = true;
+
+    srand(1);
+    for (size_t i = 0; i < sizeof(kStreams) / sizeof(kStreams[0]); ++i) {
+        Bytes in, want;
+        if (!readFile(dir, kStreams[i].stream, &in)
+                || !readFile(dir, kStreams[i].bursts, &want)) {
+            return 1;
+        }
+        ok = check(kStreams[i].name, kStreams[i].format, in, want, 0) && ok;
+        ok = check(kStreams[i].name, kStreams[i].format, in, want, 700) && ok;
+    }
+
+    printf(ok ? "OK\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
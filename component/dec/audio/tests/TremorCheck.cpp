@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Decodes Ogg Vorbis files with the integer Tremor decoder HWAudioDec
+// picks for Vorbis (lume_audio/tremor_decoder.cpp) and with libavcodec's
+// float decoder, and fails unless both put out the same number of
+// samples, none of them more than 2 LSB apart. Prints the cpu time of
+// each as a share of the audio's duration. libavcodec keeps 2 channels
+// at most, so the files are mono or stereo. The default file is the
+// stream in data/ (see host/vorbis_refs.cpp); on the device, push it
+// next to the binary.
+//
+// usage: tremor_check [file.ogg ...]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "tremor_decoder.h"
+
+#undef printf
+#undef perror
+
+extern "C" void init_avcodec(void);
+
+using namespace android;
+
+enum { kMaxDiff = 2 };
+
+typedef std::vector<unsigned char> Bytes;
+
+struct Decoded {
+    std::vector<int16_t> pcm;
+    int64_t ns;
+};
+
+static int64_t cpuNs() {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static bool readFile(const char *path, Bytes *out) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    out->resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = fread(&(*out)[0], 1, out->size(), f) == out->size();
+    fclose(f);
+    return ok;
+}
+
+// The packets of the first logical stream, joined across pages, each
+// with FF_INPUT_BUFFER_PADDING_SIZE zeros behind it for libavcodec.
+static bool readPackets(const char *path, std::vector<Bytes> *packets) {
+    Bytes file, packet;
+    if (!readFile(path, &file))
+        return false;
+
+    size_t pos = 0;
+    uint32_t serial = 0;
+    while (pos + 27 <= file.size()) {
+        const unsigned char *page = &file[pos];
+        int segments = page[26];
+        size_t data = pos + 27 + segments;
+        if (memcmp(page, "OggS", 4) || data > file.size()) {
+            printf("%s: no Ogg page at %zu\n", path, pos);
+            return false;
+        }
+        uint32_t s = page[14] | page[15] << 8 | page[16] << 16 | page[17] << 24;
+        if (pos == 0)
+            serial = s;
+        for (int i = 0; i < segments; ++i) {
+            int len = page[27 + i];
+            if (data + len > file.size()) {
+                printf("%s: page at %zu cut short\n", path, pos);
+                return false;
+            }
+            if (s == serial) {
+                packet.insert(packet.end(), &file[data], &file[data] + len);
+                if (len < 255) {
+                    packets->push_back(packet);
+                    packet.clear();
+                }
+            }
+            data += len;
+        }
+        pos = data;
+    }
+    if (packets->size() < 4) {
+        printf("%s: %zu Vorbis packets\n", path, packets->size());
+        return false;
+    }
+    for (size_t i = 0; i < packets->size(); ++i)
+        (*packets)[i].resize((*packets)[i].size() + FF_INPUT_BUFFER_PADDING_SIZE, 0);
+    return true;
+}
+
+// The three headers Xiph laced, as the demuxers hand them to the decoders.
+static void extradata(const std::vector<Bytes> &packets, Bytes *out) {
+    out->push_back(2);
+    for (int i = 0; i < 2; ++i) {
+        size_t len = packets[i].size() - FF_INPUT_BUFFER_PADDING_SIZE;
+        for (; len >= 255; len -= 255)
+            out->push_back(255);
+        out->push_back(len);
+    }
+    for (int i = 0; i < 3; ++i)
+        out->insert(out->end(), packets[i].begin(),
+                    packets[i].end() - FF_INPUT_BUFFER_PADDING_SIZE);
+}
+
+static bool decodeTremor(const std::vector<Bytes> &packets, Bytes &headers,
+                         int *channels, int *rate, Decoded *out) {
+    tremorDecoder dec;
+    sh_audio_t sh;
+
+    memset(&sh, 0, sizeof(sh));
+    sh.codecdata = &headers[0];
+    sh.codecdata_len = headers.size();
+    dec.preinit(&sh);
+    if (!dec.init(&sh)) {
+        printf("  tremor: headers not taken\n");
+        return false;
+    }
+    *channels = sh.channels;
+    *rate = sh.samplerate;
+
+    std::vector<int16_t> pcm(sh.audio_out_minsize / 2);
+    int64_t start = cpuNs();
+    for (size_t i = 3; i < packets.size(); ++i) {
+        unsigned char *in = (unsigned char *)&packets[i][0];
+        int inlen = packets[i].size() - FF_INPUT_BUFFER_PADDING_SIZE;
+        int outlen;
+        int len = dec.decode_audio(&sh, &in, &inlen, (unsigned char *)&pcm[0], &outlen);
+        if (len > 0)
+            out->pcm.insert(out->pcm.end(), &pcm[0], &pcm[0] + len / 2);
+    }
+    out->ns = cpuNs() - start;
+
+    dec.uninit(&sh);
+    return true;
+}
+
+static bool decodeLavc(const std::vector<Bytes> &packets, const Bytes &headers,
+                       int channels, int rate, Decoded *out) {
+    AVCodec *codec;
+    AVCodecContext *avctx;
+
+    init_avcodec();
+    codec = avcodec_find_decoder_by_name("vorbis");
+    avctx = avcodec_alloc_context();
+    if (codec == NULL || avctx == NULL) {
+        printf("  libavcodec: no vorbis decoder\n");
+        av_free(avctx);
+        return false;
+    }
+    avctx->channels = channels;
+    avctx->sample_rate = rate;
+    avctx->codec_type = CODEC_TYPE_AUDIO;
+    avctx->codec_id = codec->id;
+    avctx->extradata = (uint8_t *)av_mallocz(headers.size() + FF_INPUT_BUFFER_PADDING_SIZE);
+    avctx->extradata_size = headers.size();
+    if (avctx->extradata)
+        memcpy(avctx->extradata, &headers[0], headers.size());
+    if (avctx->extradata == NULL || avcodec_open(avctx, codec) < 0) {
+        printf("  libavcodec: headers not taken\n");
+        av_freep(&avctx->extradata);
+        av_free(avctx);
+        return false;
+    }
+
+    int16_t *pcm = (int16_t *)av_malloc(AVCODEC_MAX_AUDIO_FRAME_SIZE);
+    int64_t start = cpuNs();
+    for (size_t i = 3; pcm != NULL && i < packets.size(); ++i) {
+        AVPacket pkt;
+        int len = AVCODEC_MAX_AUDIO_FRAME_SIZE;
+        av_init_packet(&pkt);
+        pkt.data = (uint8_t *)&packets[i][0];
+        pkt.size = packets[i].size() - FF_INPUT_BUFFER_PADDING_SIZE;
+        if (avcodec_decode_audio3(avctx, pcm, &len, &pkt) >= 0 && len > 0)
+            out->pcm.insert(out->pcm.end(), pcm, pcm + len / 2);
+    }
+    out->ns = cpuNs() - start;
+
+    av_free(pcm);
+    avcodec_close(avctx);
+    av_freep(&avctx->extradata);
+    av_free(avctx);
+    return true;
+}
+
+static bool check(const char *path) {
+    std::vector<Bytes> packets;
+    Bytes headers;
+    int channels, rate;
+
+    if (!readPackets(path, &packets))
+        return false;
+    extradata(packets, &headers);
+
+    Decoded tremor, lavc;
+    if (!decodeTremor(packets, headers, &channels, &rate, &tremor)
+            || !decodeLavc(packets, headers, channels, rate, &lavc))
+        return false;
+
+    double audioNs = tremor.pcm.size() * 1e9 / channels / rate;
+    printf("%s: %zu packets, %d ch %d Hz, %.1f s, tremor %.1f%% cpu, ffvorbis %.1f%% cpu\n",
+           path, packets.size() - 3, channels, rate, audioNs / 1e9,
+           tremor.ns * 100.0 / audioNs, lavc.ns * 100.0 / audioNs);
+
+    if (channels > 2) {
+        printf("  %d channels, libavcodec keeps 2\n", channels);
+        return false;
+    }
+    if (tremor.pcm.size() != lavc.pcm.size()) {
+        printf("  tremor %zu samples, ffvorbis %zu samples\n",
+               tremor.pcm.size(), lavc.pcm.size());
+        return false;
+    }
+
+    size_t worst = 0;
+    int maxDiff = 0;
+    for (size_t i = 0; i < tremor.pcm.size(); ++i) {
+        int d = abs(tremor.pcm[i] - lavc.pcm[i]);
+        if (d > maxDiff) {
+            maxDiff = d;
+            worst = i;
+        }
+    }
+    if (maxDiff > kMaxDiff) {
+        printf("  %zu samples, max difference %d at %zu (%d, %d), limit %d\n",
+               tremor.pcm.size(), maxDiff, worst, tremor.pcm[worst],
+               lavc.pcm[worst], kMaxDiff);
+        return false;
+    }
+    printf("  %zu samples, max difference %d\n", tremor.pcm.size(), maxDiff);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const char *kDefault[] = {
+        "data/vorbis.ogg",
+    };
+    const char **files = argc > 1 ? (const char **)argv + 1 : kDefault;
+    int numFiles = argc > 1 ? argc - 1 : sizeof(kDefault) / sizeof(kDefault[0]);
+    bool ok = true;
+
+    for (int i = 0; i < numFiles; ++i)
+        ok = check(files[i]) && ok;
+
+    printf(ok ? "OK\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
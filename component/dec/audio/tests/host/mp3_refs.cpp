@@ -0,0 +1,194 @@
+/*
+ * mp3_refs.cpp: writes the Layer III streams mad_mxu_check decodes with
+ * the MXU and the plain C build of libmad, into the given directory.
+ *
+ * There is no encoder on the build machine, so the frames carry valid
+ * headers and side info over random main data: random scalefactors,
+ * gains and Huffman codes still go through requantisation, the stereo
+ * processing, alias reduction, long, short and mixed block IMDCT and
+ * the synthesis filter, which is what the MXU kernels replace.
+ *   l3_joint.mp3    MPEG-1 44.1 kHz 128 kbps joint stereo, M/S and
+ *                   intensity stereo switched per frame
+ *   l3_lsf_mono.mp3 MPEG-2 22.05 kHz 64 kbps mono
+ *
+ * usage: mp3-refs dir
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+struct BitWriter {
+    Bytes &b;
+    int bit;
+
+    BitWriter(Bytes &bytes) : b(bytes), bit(0) {}
+
+    void put(unsigned v, int n) {
+        for (int i = n - 1; i >= 0; i--) {
+            if (bit % 8 == 0)
+                b.push_back(0);
+            if ((v >> i) & 1)
+                b.back() |= 0x80 >> (bit % 8);
+            bit++;
+        }
+    }
+};
+
+static int rnd(int lo, int hi)
+{
+    return lo + rand() % (hi - lo + 1);
+}
+
+/* Huffman tables 4 and 14 do not exist */
+static int table_select(void)
+{
+    int t;
+    do {
+        t = rnd(0, 31);
+    } while (t == 4 || t == 14);
+    return t;
+}
+
+struct Granule {
+    int part2_3_length;
+    int window_switching;
+    int block_type;
+    int mixed;
+};
+
+/* what both channels of a granule share, M/S and intensity stereo need
+ * the same block type on both */
+static Granule granule_blocks(void)
+{
+    Granule g;
+    g.part2_3_length = 0;
+    g.window_switching = rnd(0, 2) > 0;
+    g.block_type = g.window_switching ? rnd(1, 3) : 0;
+    g.mixed = g.block_type == 2 ? rnd(0, 1) : 0;
+    return g;
+}
+
+static void put_granule(BitWriter &w, const Granule &g, bool lsf)
+{
+    w.put(g.part2_3_length, 12);
+    w.put(rnd(8, g.part2_3_length / 10), 9);    // big_values
+    /* low enough that the output seldom clips, which would hide a
+     * difference between the two builds */
+    w.put(rnd(100, 140), 8);                    // global_gain
+    w.put(rnd(0, lsf ? 499 : 15), lsf ? 9 : 4); // scalefac_compress
+    w.put(g.window_switching, 1);
+    if (g.window_switching) {
+        w.put(g.block_type, 2);
+        w.put(g.mixed, 1);
+        w.put(table_select(), 5);
+        w.put(table_select(), 5);
+        for (int i = 0; i < 3; i++)
+            w.put(rnd(0, 7), 3);                // subblock_gain
+    } else {
+        w.put(table_select(), 5);
+        w.put(table_select(), 5);
+        w.put(table_select(), 5);
+        w.put(rnd(0, 15), 4);                   // region0_count
+        w.put(rnd(0, 7), 3);                    // region1_count
+    }
+    if (!lsf)
+        w.put(rnd(0, 1), 1);                    // preflag
+    w.put(rnd(0, 1), 1);                        // scalefac_scale
+    w.put(rnd(0, 1), 1);                        // count1table_select
+}
+
+/*
+ * One frame without CRC and with main_data_begin 0: header, side info,
+ * then the main data the granules split between them.
+ */
+static void put_frame(Bytes &out, bool lsf, int channels, int frame_size,
+                      int bitrate_index, int sf_index)
+{
+    int granules = lsf ? 1 : 2;
+    int side_info = lsf ? (channels == 1 ? 9 : 17) : (channels == 1 ? 17 : 32);
+    int main_bits = (frame_size - 4 - side_info) * 8;
+    int mode_ext = channels == 2 ? rnd(0, 3) : 0;
+    Granule g[2][2];
+    Bytes f;
+    BitWriter w(f);
+
+    for (int gr = 0; gr < granules; gr++) {
+        Granule blocks = granule_blocks();
+        for (int ch = 0; ch < channels; ch++) {
+            g[gr][ch] = blocks;
+            g[gr][ch].part2_3_length =
+                rnd(main_bits / (granules * channels) / 2,
+                    main_bits / (granules * channels));
+        }
+    }
+
+    w.put(0xFFF, 12);
+    w.put(lsf ? 0 : 1, 1);          // ID
+    w.put(1, 2);                    // layer III
+    w.put(1, 1);                    // no CRC
+    w.put(bitrate_index, 4);
+    w.put(sf_index, 2);
+    w.put(0, 1);                    // padding
+    w.put(0, 1);                    // private
+    w.put(channels == 2 ? 1 : 3, 2);// joint stereo or mono
+    w.put(mode_ext, 2);
+    w.put(0, 4);                    // copyright, original, emphasis
+
+    w.put(0, lsf ? 8 : 9);          // main_data_begin
+    if (lsf)
+        w.put(0, channels == 1 ? 1 : 2);
+    else
+        w.put(0, channels == 1 ? 5 : 3);
+    if (!lsf)
+        w.put(0, 4 * channels);     // scfsi
+    for (int gr = 0; gr < granules; gr++)
+        for (int ch = 0; ch < channels; ch++)
+            put_granule(w, g[gr][ch], lsf);
+
+    while ((int)f.size() < frame_size)
+        f.push_back(rand() & 0xff);
+    out.insert(out.end(), f.begin(), f.end());
+}
+
+static int write_file(const char *dir, const char *name, const Bytes &b)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(&b[0], 1, b.size(), f) != b.size()) {
+        perror(path);
+        return 1;
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Bytes out;
+    int ret = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s dir\n", argv[0]);
+        return 2;
+    }
+    srand(1);
+
+    /* 144 * 128000 / 44100 */
+    for (int i = 0; i < 200; i++)
+        put_frame(out, false, 2, 417, 9, 0);
+    ret |= write_file(argv[1], "l3_joint.mp3", out);
+
+    /* 72 * 64000 / 22050 */
+    out.clear();
+    for (int i = 0; i < 200; i++)
+        put_frame(out, true, 1, 208, 8, 0);
+    ret |= write_file(argv[1], "l3_lsf_mono.mp3", out);
+
+    return ret;
+}
@@ -0,0 +1,71 @@
+/*
+ * mp_decoder.h: what SpdifDecoder needs of the lume decoder interface
+ * in host builds, without the demuxer headers of the device tree.
+ */
+#ifndef MP_DECODER_H_INCLUDED
+#define MP_DECODER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+}
+
+#define mmioFOURCC(a, b, c, d) \
+    ((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | \
+     ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+#define AF_FORMAT_S16_NE 1
+
+typedef struct __attribute__((packed)) {
+    unsigned short wFormatTag;
+    unsigned short nChannels;
+    unsigned int   nSamplesPerSec;
+    unsigned int   nAvgBytesPerSec;
+    unsigned short nBlockAlign;
+    unsigned short wBitsPerSample;
+    unsigned short cbSize;
+} WAVEFORMATEX;
+
+typedef struct {
+    unsigned int format;
+    WAVEFORMATEX *wf;
+    int channels;
+    int samplerate;
+    int samplesize;
+    int sample_format;
+    int i_bps;
+    int audio_out_minsize;
+} sh_audio_t;
+
+namespace android{
+
+typedef struct mp_codec_info_s
+{
+    const char *name;
+    const char *short_name;
+    const char *maintainer;
+    const char *author;
+    const char *comment;
+} mp_codec_info_t;
+
+typedef mp_codec_info_t ad_info_t;
+
+class mpDecorder{
+public:
+    mpDecorder(){}
+    virtual ~mpDecorder(){}
+    virtual int preinit(sh_audio_t *sh){return 0;}
+    virtual int init(sh_audio_t *sh){return 0;}
+    virtual void uninit(sh_audio_t *sh){};
+    virtual int control(sh_audio_t *sh,int cmd,void* arg, ...){return 0;}
+    virtual int decode_audio(sh_audio_t *sh_audio,unsigned char **inbuf,int *inlen,unsigned char* outbuf,int *outlen){
+	return 0;
+    }
+};
+
+}
+#endif  //#ifndef  MP_DECODER_H_INCLUDED
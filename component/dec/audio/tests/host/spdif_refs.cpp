@@ -0,0 +1,186 @@
+/*
+ * spdif_refs.cpp: writes the streams spdif_check feeds to SpdifDecoder
+ * and the IEC 61937 bursts it expects back, into the given directory.
+ *
+ * The frames carry valid AC-3 (bsid 8, 256 bytes, bsmod cycling),
+ * E-AC-3 (two-block independent frames, each followed by a dependent
+ * one) and DTS (512-sample core, odd and even sizes) headers over
+ * random payload. The bursts are laid out as libavformat's spdifenc
+ * writes them by default (little-endian words):
+ *   AC-3    Pc 0x01 | bsmod << 8, Pd FFALIGN(size, 2) * 8, 6144 bytes
+ *   E-AC-3  Pc 0x15, Pd in bytes, six audio blocks (a dependent frame
+ *           stays with its independent one), 24576 bytes
+ *   DTS     Pc 0x0B, Pd FFALIGN(size, 2) * 8, 512 * 4 bytes
+ * "make refs-ffmpeg" rewrites the .spdif files with spdifenc itself.
+ *
+ * usage: spdif-refs dir
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+struct BitWriter {
+    Bytes &b;
+    int bit;
+
+    BitWriter(Bytes &bytes) : b(bytes), bit(0) {}
+
+    void put(unsigned v, int n) {
+        for (int i = n - 1; i >= 0; i--) {
+            if (bit % 8 == 0)
+                b.push_back(0);
+            if ((v >> i) & 1)
+                b.back() |= 0x80 >> (bit % 8);
+            bit++;
+        }
+    }
+};
+
+static void fill(Bytes &f, size_t size)
+{
+    while (f.size() < size)
+        f.push_back(rand() & 0xff);
+}
+
+static Bytes ac3_frame(int bsmod)
+{
+    Bytes f;
+    BitWriter w(f);
+    w.put(0x0B77, 16);
+    w.put(0, 16);       // crc1
+    w.put(0, 2);        // fscod, 48 kHz
+    w.put(8, 6);        // frmsizecod, 96 kbps: 256 bytes
+    w.put(8, 5);        // bsid
+    w.put(bsmod, 3);
+    w.put(2, 3);        // acmod, 2/0
+    w.put(0, 2);        // dsurmod
+    w.put(0, 1);        // lfeon
+    fill(f, 256);
+    return f;
+}
+
+static Bytes eac3_frame(int strmtyp, int words)
+{
+    Bytes f;
+    BitWriter w(f);
+    w.put(0x0B77, 16);
+    w.put(strmtyp, 2);  // 0 independent, 1 dependent
+    w.put(0, 3);        // substreamid
+    w.put(words - 1, 11);
+    w.put(0, 2);        // fscod, 48 kHz
+    w.put(1, 2);        // numblkscod, two blocks
+    w.put(2, 3);        // acmod
+    w.put(0, 1);        // lfeon
+    w.put(16, 5);       // bsid
+    fill(f, words * 2);
+    return f;
+}
+
+static Bytes dts_frame(int size)
+{
+    Bytes f;
+    BitWriter w(f);
+    w.put(0x7FFE8001, 32);
+    w.put(1, 1);        // normal frame
+    w.put(31, 5);       // deficit samples
+    w.put(0, 1);        // no crc
+    w.put(15, 7);       // 16 blocks of 32 samples
+    w.put(size - 1, 14);
+    w.put(2, 6);        // amode, stereo
+    w.put(13, 4);       // 48 kHz
+    w.put(15, 5);       // 768 kbps
+    w.put(0, 9);        // fixed, drc, timestamp, aux, hdcd, ext type, ext
+    w.put(0, 1);        // aspf
+    w.put(0, 2);        // no lfe
+    w.put(0, 1);        // predictor history
+    w.put(0, 1);        // multirate interpolator
+    w.put(7, 4);        // encoder revision
+    w.put(0, 2);        // copy history
+    w.put(0, 3);        // 16 bit source
+    w.put(0, 6);        // sumdiff, dialog normalization
+    fill(f, size);
+    return f;
+}
+
+static void put_burst(Bytes &out, int pc, int pd, const Bytes &data, int period)
+{
+    size_t start = out.size();
+    out.resize(start + period, 0);
+    uint8_t *p = &out[start];
+    p[0] = 0x72; p[1] = 0xF8;
+    p[2] = 0x1F; p[3] = 0x4E;
+    p[4] = pc;   p[5] = pc >> 8;
+    p[6] = pd;   p[7] = pd >> 8;
+    // byte-swapped words, a lone last byte goes in the high half
+    for (size_t i = 0; i < data.size(); i++)
+        p[8 + (i ^ 1)] = data[i];
+}
+
+static int write_file(const char *dir, const char *name, const Bytes &b)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(&b[0], 1, b.size(), f) != b.size()) {
+        perror(path);
+        return 1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void append(Bytes &to, const Bytes &from)
+{
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+int main(int argc, char **argv)
+{
+    Bytes in, want;
+    int ret = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s dir\n", argv[0]);
+        return 2;
+    }
+    srand(1);
+
+    for (int i = 0; i < 12; i++) {
+        Bytes f = ac3_frame(i % 8);
+        append(in, f);
+        put_burst(want, 0x01 | (i % 8) << 8, ((f.size() + 1) & ~1) * 8, f, 6144);
+    }
+    ret |= write_file(argv[1], "ac3.ac3", in);
+    ret |= write_file(argv[1], "ac3.spdif", want);
+
+    in.clear();
+    want.clear();
+    for (int i = 0; i < 6; i++) {
+        Bytes burst;
+        for (int k = 0; k < 3; k++) {
+            append(burst, eac3_frame(0, 300 + k));
+            append(burst, eac3_frame(1, 50));
+        }
+        append(in, burst);
+        put_burst(want, 0x15, burst.size(), burst, 24576);
+    }
+    ret |= write_file(argv[1], "eac3.eac3", in);
+    ret |= write_file(argv[1], "eac3.spdif", want);
+
+    in.clear();
+    want.clear();
+    for (int i = 0; i < 16; i++) {
+        Bytes f = dts_frame(i & 1 ? 1001 : 1006);
+        append(in, f);
+        put_burst(want, 0x0B, ((f.size() + 1) & ~1) * 8, f, 512 * 4);
+    }
+    ret |= write_file(argv[1], "dts.dts", in);
+    ret |= write_file(argv[1], "dts.spdif", want);
+
+    return ret;
+}
@@ -0,0 +1,19 @@
+/*
+ * utils/Log.h: stand-in for the Android log header in host builds
+ */
+#ifndef SPDIF_HOST_LOG_H
+#define SPDIF_HOST_LOG_H
+
+#include <stdio.h>
+
+/* libavutil/internal.h poisons fprintf */
+#undef fprintf
+#define SPDIF_HOST_LOG(...) ( fprintf( stderr, __VA_ARGS__ ), fputc( '\n', stderr ) )
+
+#define ALOGE SPDIF_HOST_LOG
+#define ALOGW SPDIF_HOST_LOG
+#define ALOGI SPDIF_HOST_LOG
+#define ALOGD(...)
+#define ALOGV(...)
+
+#endif
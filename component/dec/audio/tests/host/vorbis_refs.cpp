@@ -0,0 +1,316 @@
+/*
+ * vorbis_refs.cpp: writes the Ogg Vorbis stream tremor_check decodes with
+ * Tremor and with libavcodec's float decoder, into the given directory.
+ *
+ * There is no encoder on the build machine. The headers set up a small
+ * but complete decoder: 256 and 2048 sample blocks, a two point floor 1
+ * per block size, residue 2 over both channels with a 1 bit classbook
+ * and a 4x4 VQ book of -1.5..1.5, and square polar coupling. The audio
+ * packets are random past the mode and floor fields, so the windows
+ * switch between long and short at random and every floor, residue,
+ * coupling, IMDCT and overlap path runs.
+ *   vorbis.ogg    44.1 kHz stereo, 200 packets
+ *
+ * usage: vorbis-refs dir
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+/* Vorbis packs its fields from the least significant bit up */
+struct BitWriter {
+    Bytes &b;
+    int bit;
+
+    BitWriter(Bytes &bytes) : b(bytes), bit(0) {}
+
+    void put(uint32_t v, int n) {
+        for (int i = 0; i < n; i++) {
+            if (bit % 8 == 0)
+                b.push_back(0);
+            if ((v >> i) & 1)
+                b.back() |= 1 << (bit % 8);
+            bit++;
+        }
+    }
+
+    void bytes(const char *s) {
+        while (*s)
+            put(*s++, 8);
+    }
+};
+
+enum {
+    kChannels = 2,
+    kRate = 44100,
+    kShortLog2 = 8,
+    kLongLog2 = 11,
+};
+
+static int rnd(int lo, int hi)
+{
+    return lo + rand() % (hi - lo + 1);
+}
+
+static Bytes identification(void)
+{
+    Bytes p;
+    BitWriter w(p);
+    w.put(1, 8);
+    w.bytes("vorbis");
+    w.put(0, 32);               // version
+    w.put(kChannels, 8);
+    w.put(kRate, 32);
+    w.put(0, 32);               // bitrate maximum
+    w.put(128000, 32);          // nominal
+    w.put(0, 32);               // minimum
+    w.put(kShortLog2, 4);
+    w.put(kLongLog2, 4);
+    w.put(1, 1);                // framing
+    return p;
+}
+
+static Bytes comment(void)
+{
+    static const char kVendor[] = "vorbis_refs";
+    Bytes p;
+    BitWriter w(p);
+    w.put(3, 8);
+    w.bytes("vorbis");
+    w.put(sizeof(kVendor) - 1, 32);
+    w.bytes(kVendor);
+    w.put(0, 32);               // user comments
+    w.put(1, 1);
+    return p;
+}
+
+/* mantissa * 2^(exponent - 788), the codebook float format */
+static void put_float(BitWriter &w, int mantissa, int exponent)
+{
+    uint32_t v = (mantissa < 0 ? 0x80000000u : 0)
+        | (uint32_t)(exponent << 21) | (uint32_t)abs(mantissa);
+    w.put(v, 32);
+}
+
+/* floor 1 with no partitions: the line between X 0 and X n/2 */
+static void put_floor(BitWriter &w, int log2_half)
+{
+    w.put(1, 16);               // floor type
+    w.put(0, 5);                // partitions
+    w.put(1, 2);                // multiplier 2, range 128
+    w.put(log2_half, 4);        // rangebits
+}
+
+static void put_residue(BitWriter &w, int half)
+{
+    w.put(2, 16);               // residue type, channels interleaved
+    w.put(0, 24);               // begin
+    w.put(half * kChannels, 24);// end
+    w.put(31, 24);              // partition size 32
+    w.put(1, 6);                // two classifications
+    w.put(0, 8);                // classbook
+    w.put(0, 3);                // class 0: nothing coded
+    w.put(0, 1);
+    w.put(1, 3);                // class 1: book 1 in the first pass
+    w.put(0, 1);
+    w.put(1, 8);
+}
+
+static Bytes setup(void)
+{
+    Bytes p;
+    BitWriter w(p);
+    w.put(5, 8);
+    w.bytes("vorbis");
+
+    w.put(1, 8);                // two codebooks
+    /* 0: the classbook, two one bit entries */
+    w.put(0x564342, 24);
+    w.put(1, 16);               // dimensions
+    w.put(2, 24);               // entries
+    w.put(0, 1);                // not ordered
+    w.put(0, 1);                // not sparse
+    w.put(0, 5);                // length 1
+    w.put(0, 5);
+    w.put(0, 4);                // no lookup
+    /* 1: 16 four bit entries, pairs of -1.5, -0.5, 0.5 and 1.5 */
+    w.put(0x564342, 24);
+    w.put(2, 16);
+    w.put(16, 24);
+    w.put(0, 1);
+    w.put(0, 1);
+    for (int i = 0; i < 16; i++)
+        w.put(3, 5);
+    w.put(1, 4);                // lookup type 1
+    put_float(w, -3, 787);      // minimum
+    put_float(w, 1, 788);       // delta
+    w.put(1, 4);                // 2 bit multiplicands
+    w.put(0, 1);                // not a sequence
+    for (int i = 0; i < 4; i++)
+        w.put(i, 2);
+
+    w.put(0, 6);                // time domain transforms
+    w.put(0, 16);
+
+    w.put(1, 6);                // floors: short, long
+    put_floor(w, kShortLog2 - 1);
+    put_floor(w, kLongLog2 - 1);
+
+    w.put(1, 6);                // residues: short, long
+    put_residue(w, 1 << (kShortLog2 - 1));
+    put_residue(w, 1 << (kLongLog2 - 1));
+
+    w.put(1, 6);                // mappings: short, long
+    for (int m = 0; m < 2; m++) {
+        w.put(0, 16);           // mapping type
+        w.put(0, 1);            // one submap
+        w.put(1, 1);            // coupling
+        w.put(0, 8);            // one step
+        w.put(0, 1);            // magnitude channel 0
+        w.put(1, 1);            // angle channel 1
+        w.put(0, 2);
+        w.put(0, 8);            // time
+        w.put(m, 8);            // floor
+        w.put(m, 8);            // residue
+    }
+
+    w.put(1, 6);                // modes: short, long
+    for (int m = 0; m < 2; m++) {
+        w.put(m, 1);            // blockflag
+        w.put(0, 16);
+        w.put(0, 16);
+        w.put(m, 8);            // mapping
+    }
+    w.put(1, 1);
+    return p;
+}
+
+/*
+ * Mode and window flags, both floors, then enough random bits for the
+ * whole residue so no decoder runs off the end of the packet.
+ */
+static Bytes audio(int mode, int prev_long, int next_long)
+{
+    int half = mode ? 1 << (kLongLog2 - 1) : 1 << (kShortLog2 - 1);
+    Bytes p;
+    BitWriter w(p);
+
+    w.put(0, 1);                // audio
+    w.put(mode, 1);
+    if (mode) {
+        w.put(prev_long, 1);
+        w.put(next_long, 1);
+    }
+    for (int ch = 0; ch < kChannels; ch++) {
+        w.put(1, 1);            // floor in use
+        w.put(rnd(60, 95), 7);
+        w.put(rnd(60, 95), 7);
+    }
+    int bits = half * kChannels / 32 + half * kChannels * 2;
+    for (int i = 0; i < bits; i += 8)
+        w.put(rand() & 0xff, 8);
+    return p;
+}
+
+static uint32_t crc_table[256];
+
+static void crc_init(void)
+{
+    for (int i = 0; i < 256; i++) {
+        uint32_t r = (uint32_t)i << 24;
+        for (int k = 0; k < 8; k++)
+            r = r & 0x80000000u ? (r << 1) ^ 0x04c11db7 : r << 1;
+        crc_table[i] = r;
+    }
+}
+
+/* One packet per page, granule the last sample it completes */
+static void put_page(Bytes &out, const Bytes &packet, int flags,
+                     int64_t granule, int sequence)
+{
+    Bytes page;
+    int segments = packet.size() / 255 + 1;
+
+    if (segments > 255) {
+        fprintf(stderr, "packet of %zu bytes too long\n", packet.size());
+        exit(1);
+    }
+    page.insert(page.end(), (const uint8_t *)"OggS", (const uint8_t *)"OggS" + 4);
+    page.push_back(0);
+    page.push_back(flags);
+    for (int i = 0; i < 8; i++)
+        page.push_back(granule >> (8 * i));
+    for (int i = 0; i < 4; i++)
+        page.push_back(0x56524546 >> (8 * i));  // serial
+    for (int i = 0; i < 4; i++)
+        page.push_back(sequence >> (8 * i));
+    for (int i = 0; i < 4; i++)
+        page.push_back(0);                      // crc
+    page.push_back(segments);
+    for (int i = 0; i < segments - 1; i++)
+        page.push_back(255);
+    page.push_back(packet.size() % 255);
+    page.insert(page.end(), packet.begin(), packet.end());
+
+    uint32_t crc = 0;
+    for (size_t i = 0; i < page.size(); i++)
+        crc = (crc << 8) ^ crc_table[(crc >> 24) ^ page[i]];
+    for (int i = 0; i < 4; i++)
+        page[22 + i] = crc >> (8 * i);
+    out.insert(out.end(), page.begin(), page.end());
+}
+
+static int write_file(const char *dir, const char *name, const Bytes &b)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(&b[0], 1, b.size(), f) != b.size()) {
+        perror(path);
+        return 1;
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    enum { kPackets = 200 };
+    Bytes out;
+    int modes[kPackets];
+    int64_t granule = 0;
+    int seq = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s dir\n", argv[0]);
+        return 2;
+    }
+    srand(1);
+    crc_init();
+
+    /* mostly long blocks, with runs of short ones */
+    for (int i = 0; i < kPackets; i++)
+        modes[i] = i > 0 && modes[i - 1] == 0 ? rnd(0, 2) > 0 : rnd(0, 5) > 0;
+
+    put_page(out, identification(), 2, 0, seq++);
+    put_page(out, comment(), 0, 0, seq++);
+    put_page(out, setup(), 0, 0, seq++);
+    for (int i = 0; i < kPackets; i++) {
+        int mode = modes[i];
+        int prev = i > 0 ? modes[i - 1] : 0;
+        int next = i + 1 < kPackets ? modes[i + 1] : 0;
+        int n = 1 << (mode ? kLongLog2 : kShortLog2);
+        int prev_n = 1 << (prev ? kLongLog2 : kShortLog2);
+        /* the first packet only primes the overlap */
+        if (i > 0)
+            granule += prev_n / 4 + n / 4;
+        put_page(out, audio(mode, prev, next),
+                 i + 1 == kPackets ? 4 : 0, granule, seq++);
+    }
+    return write_file(argv[1], "vorbis.ogg", out);
+}
@@ -80,7 +80,6 @@ namespace android{
 ///////////Dis/Enable the below macro will enable printf some key debugging info.
 
 //#define DEBUG_VIDEODEC_COST_TIME
-//#define DEBUG_AUDIODEC_COST_TIME
 
 //Printf 6(modifiable) in&out buffer values for video decoder.
 //#define DEBUG_VIDEODEC_COUNTED_BUFVALUE 6
@@ -22,4 +22,5 @@ include $(LUME_TOP)/mk/libmp3.mk
 include $(LUME_TOP)/mk/libmpeg2.mk
 include $(LUME_TOP)/mk/libmpeg4.mk
 include $(LUME_TOP)/mk/libfaad2.mk
+include $(LUME_TOP)/mk/libtremor.mk
 include $(LUME_TOP)/mk/libjzmpeg2.mk
\ No newline at end of file
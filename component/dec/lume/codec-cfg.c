@@ -40,6 +40,7 @@
 #include <ctype.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "config.h"
 #include "mp_msg.h"
@@ -533,6 +534,115 @@ static codecs_t *audio_codecs=NULL;
 static int nr_vcodecs = 0;
 static int nr_acodecs = 0;
 
+#ifndef CODECS2HTML
+/*
+ * FourCC index over the builtin tables, built once per process and
+ * shared by every decoder component. Each chain lists the (codec, fourcc
+ * slot) pairs of a hash bucket in table order, so a lookup returns the
+ * same codec the linear scan of find_codec would. Codecs with the "null"
+ * driver match any fourcc and are kept apart.
+ */
+#define CODEC_HASH_BITS 8
+#define CODEC_HASH(f)   ((((f) * 0x9E3779B1U) >> (32 - CODEC_HASH_BITS)))
+
+typedef struct {
+    unsigned int fourcc;
+    short codec;        /* index into the table */
+    short slot;         /* index into fourcc[] and fourccmap[] */
+    int next;           /* next entry of the bucket, -1 ends it */
+} codec_hash_entry_t;
+
+typedef struct {
+    codecs_t *codecs;
+    int nr_codecs;
+    int head[1 << CODEC_HASH_BITS];
+    codec_hash_entry_t *entries;
+    int first_null;     /* first "null" driver codec, nr_codecs if none */
+} codec_index_t;
+
+static codec_index_t video_index, audio_index;
+static pthread_once_t builtin_once = PTHREAD_ONCE_INIT;
+static int builtin_ready = 0;
+
+static void codec_index_build(codec_index_t *idx, codecs_t *codecs, int nr_codecs)
+{
+    int i, j, n = 0;
+
+    idx->codecs = codecs;
+    idx->nr_codecs = nr_codecs;
+    idx->first_null = nr_codecs;
+    for (i = 0; i < (1 << CODEC_HASH_BITS); i++)
+        idx->head[i] = -1;
+    for (i = 0; i < nr_codecs; i++)
+        for (j = 0; j < CODECS_MAX_FOURCC; j++)
+            n += codecs[i].fourcc[j] != 0xffffffff;
+    idx->entries = malloc(n * sizeof(*idx->entries));
+    n = 0;
+    if (!idx->entries)
+        return;
+
+    /* pushed from the table end, so the chains come out in table order */
+    for (i = nr_codecs; i--; ) {
+        if (codecs[i].drv && !strcmp(codecs[i].drv, "null"))
+            idx->first_null = i;
+        for (j = CODECS_MAX_FOURCC; j--; ) {
+            unsigned int f = codecs[i].fourcc[j];
+            int h;
+            if (f == 0xffffffff)
+                continue;
+            h = CODEC_HASH(f);
+            idx->entries[n].fourcc = f;
+            idx->entries[n].codec = i;
+            idx->entries[n].slot = j;
+            idx->entries[n].next = idx->head[h];
+            idx->head[h] = n++;
+        }
+    }
+}
+
+static void builtin_codecs_init(void)
+{
+    codec_index_build(&video_index, builtin_video_codecs,
+                      sizeof(builtin_video_codecs)/sizeof(codecs_t));
+    codec_index_build(&audio_index, builtin_audio_codecs,
+                      sizeof(builtin_audio_codecs)/sizeof(codecs_t));
+    builtin_ready = video_index.entries && audio_index.entries;
+}
+
+/* find_codec on the index: the first codec after start taking fourcc. */
+static codecs_t *codec_index_find(codec_index_t *idx, unsigned int fourcc,
+                                  unsigned int *fourccmap, codecs_t *start)
+{
+    int from = start ? start - idx->codecs + 1 : 0;
+    int best = idx->nr_codecs, slot = 0;
+    int e, i;
+
+    for (e = idx->head[CODEC_HASH(fourcc)]; e >= 0; e = idx->entries[e].next) {
+        codec_hash_entry_t *ent = &idx->entries[e];
+        if (ent->fourcc == fourcc && ent->codec >= from) {
+            best = ent->codec;
+            slot = ent->slot;
+            break;
+        }
+    }
+
+    /* a "null" codec before it matches first, on its first slot */
+    for (i = idx->first_null > from ? idx->first_null : from; i < best; i++) {
+        if (idx->codecs[i].drv && !strcmp(idx->codecs[i].drv, "null")) {
+            best = i;
+            slot = 0;
+            break;
+        }
+    }
+
+    if (best >= idx->nr_codecs)
+        return NULL;
+    if (fourccmap)
+        *fourccmap = idx->codecs[best].fourccmap[slot];
+    return &idx->codecs[best];
+}
+#endif
+
 int parse_codec_cfg(const char *cfgfile)
 {
     codecs_t *codec = NULL; // current codec
@@ -542,6 +652,19 @@ int parse_codec_cfg(const char *cfgfile)
     int codec_type;     /* TYPE_VIDEO/TYPE_AUDIO */
     int tmp, i;
 
+#ifndef CODECS2HTML
+    // The builtin tables never change: index them once and leave them in
+    // place, other components may be looking codecs up right now.
+    if (cfgfile == NULL) {
+        pthread_once(&builtin_once, builtin_codecs_init);
+        video_codecs = builtin_video_codecs;
+        audio_codecs = builtin_audio_codecs;
+        nr_vcodecs = video_index.nr_codecs;
+        nr_acodecs = audio_index.nr_codecs;
+        return 1;
+    }
+#endif
+
     // in case we call it a second time
     codecs_uninit_free();
 
@@ -845,6 +968,14 @@ codecs_t* find_codec(unsigned int fourcc,unsigned int *fourccmap,
             }
         }
     } else
+#endif
+#ifndef CODECS2HTML
+    if (builtin_ready && !force) {
+        if (audioflag && audio_codecs == builtin_audio_codecs)
+            return codec_index_find(&audio_index, fourcc, fourccmap, start);
+        if (!audioflag && video_codecs == builtin_video_codecs)
+            return codec_index_find(&video_index, fourcc, fourccmap, start);
+    }
 #endif
     {
         if (audioflag) {
@@ -0,0 +1,368 @@
+/*
+ * sample format conversion and resampling stage for the decoder output
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "af_format.h"
+#include "af_convert.h"
+#include "mp_msg.h"
+
+#if defined(JZ4750_OPT) && !defined(AF_NO_MXU)
+#define AF_MXU
+#include "../libjzcommon/jzmedia.h"
+#endif
+
+#define NTAPS       16          // taps per phase
+#define MAX_PHASES  512         // finer steps use the nearest phase
+#define CHUNK       1024        // input frames filtered at a time
+#define HIST_LEN    (NTAPS + CHUNK)
+#define KAISER_BETA 8.0
+#define CUTOFF      0.91        // of the lower of the two Nyquist rates
+#define TAP_SHIFT   30          // taps are Q30, samples Q23
+
+struct af_convert_s {
+    int format;
+    int channels;
+    int frame_size;     // input bytes per frame
+    int in_rate;
+    int out_rate;
+    int up;             // out_rate / in_rate reduced, 0 for the same rate
+    int down;
+    int step;           // down / up and down % up
+    int step_frac;
+    int phases;
+    int32_t *taps;      // phases * NTAPS
+    int32_t *hist;      // channels * HIST_LEN, planar
+    int avail;          // frames in hist
+    int pos;            // first tap of the next output in hist
+    int frac;           // and the step beyond it, in 1/up of a sample
+    uint32_t seed;      // dither
+};
+
+static int gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Kaiser windowed sinc, one set of taps for each fraction of a sample the
+// output may fall on. Every phase is scaled to a DC gain of 1.
+static int init_taps(af_convert_t *s)
+{
+    double fc = CUTOFF;
+    double h[NTAPS];
+    int p, k;
+
+    if (s->out_rate < s->in_rate)
+        fc = CUTOFF * s->out_rate / s->in_rate;
+
+    s->taps = malloc(s->phases * NTAPS * sizeof(int32_t));
+    if (!s->taps)
+        return 0;
+
+    for (p = 0; p < s->phases; p++) {
+        double t = (double)p / s->phases, sum = 0;
+
+        for (k = 0; k < NTAPS; k++) {
+            double x = k - (NTAPS / 2 - 1) - t;
+            double w = x / (NTAPS / 2);
+            double y = M_PI * fc * x;
+
+            w = 1.0 - w * w;
+            h[k] = (y == 0 ? 1.0 : sin(y) / y)
+                * bessel_i0(KAISER_BETA * sqrt(w > 0 ? w : 0)) / bessel_i0(KAISER_BETA);
+            sum += h[k];
+        }
+        for (k = 0; k < NTAPS; k++)
+            s->taps[p * NTAPS + k] = (int32_t)lrint(h[k] / sum * (1 << TAP_SHIFT));
+    }
+    return 1;
+}
+
+static inline int32_t float_q23(float f)
+{
+    if (f >= 1.0f)
+        return (1 << 23) - 1;
+    if (f <= -1.0f)
+        return -(1 << 23);
+    return (int32_t)lrintf(f * 8388608.0f);
+}
+
+// Widens frames of the input format to Q23 behind the history.
+static void load(af_convert_t *s, const uint8_t *in, int frames)
+{
+    int ch = s->channels;
+    int c, i;
+
+    for (c = 0; c < ch; c++) {
+        int32_t *h = s->hist + c * HIST_LEN + s->avail;
+
+        switch (s->format) {
+        case AF_FORMAT_U8: {
+            const uint8_t *p = in + c;
+            for (i = 0; i < frames; i++)
+                h[i] = (p[i * ch] - 128) << 16;
+            break;
+        }
+        case AF_FORMAT_S16_NE: {
+            const int16_t *p = (const int16_t *)in + c;
+            for (i = 0; i < frames; i++)
+                h[i] = p[i * ch] << 8;
+            break;
+        }
+        case AF_FORMAT_S32_NE: {
+            const int32_t *p = (const int32_t *)in + c;
+            for (i = 0; i < frames; i++)
+                h[i] = p[i * ch] >> 8;
+            break;
+        }
+        default: {
+            const float *p = (const float *)in + c;
+            for (i = 0; i < frames; i++)
+                h[i] = float_q23(p[i * ch]);
+            break;
+        }
+        }
+    }
+    s->avail += frames;
+}
+
+// Q23 to S16 with triangular dither of +-1 LSB.
+static inline int16_t dither_s16(af_convert_t *s, int32_t v)
+{
+    uint32_t r;
+
+    s->seed = s->seed * 1664525 + 1013904223;
+    r = s->seed;
+    v += (int32_t)(r >> 24) - (int32_t)((r >> 16) & 0xff) + 128;
+    v >>= 8;
+    if (v > 32767)
+        v = 32767;
+    else if (v < -32768)
+        v = -32768;
+    return v;
+}
+
+#ifdef AF_MXU
+// The products add up in the 64 bit xr1:xr2 accumulator, the result is
+// truncated where the C version rounds: 1 LSB of Q23 off at most.
+static inline int32_t dot(const int32_t *x, const int32_t *h)
+{
+    int k;
+
+    S32MUL(xr1, xr2, x[0], h[0]);
+    for (k = 1; k < NTAPS; k++)
+        S32MADD(xr1, xr2, x[k], h[k]);
+    return (int32_t)(((uint32_t)S32M2I(xr1) << (32 - TAP_SHIFT))
+                     | ((uint32_t)S32M2I(xr2) >> TAP_SHIFT));
+}
+#else
+static inline int32_t dot(const int32_t *x, const int32_t *h)
+{
+    int64_t acc = 1 << (TAP_SHIFT - 1);
+    int k;
+
+    for (k = 0; k < NTAPS; k++)
+        acc += (int64_t)x[k] * h[k];
+    return (int32_t)(acc >> TAP_SHIFT);
+}
+#endif
+
+// Puts out every sample the history covers the taps of, then keeps the
+// history the next ones need.
+static int filter(af_convert_t *s, int16_t *out)
+{
+    int ch = s->channels;
+    int n = 0, c;
+
+    while (s->pos + NTAPS <= s->avail) {
+        const int32_t *h = s->taps
+            + (int)((int64_t)s->frac * s->phases / s->up) * NTAPS;
+
+        for (c = 0; c < ch; c++)
+            *out++ = dither_s16(s, dot(s->hist + c * HIST_LEN + s->pos, h));
+        n++;
+
+        s->pos += s->step;
+        s->frac += s->step_frac;
+        if (s->frac >= s->up) {
+            s->frac -= s->up;
+            s->pos++;
+        }
+    }
+
+    if (s->pos >= s->avail) {
+        s->pos -= s->avail;
+        s->avail = 0;
+    } else if (s->pos > 0) {
+        for (c = 0; c < ch; c++)
+            memmove(s->hist + c * HIST_LEN, s->hist + c * HIST_LEN + s->pos,
+                    (s->avail - s->pos) * sizeof(int32_t));
+        s->avail -= s->pos;
+        s->pos = 0;
+    }
+    return n;
+}
+
+int af_convert_needed(int format, int in_rate, int out_rate)
+{
+    return format != AF_FORMAT_S16_NE || (out_rate && in_rate != out_rate);
+}
+
+af_convert_t *af_convert_open(int format, int in_rate, int out_rate, int channels)
+{
+    af_convert_t *s;
+    int bytes, d;
+
+    switch (format) {
+    case AF_FORMAT_U8:       bytes = 1; break;
+    case AF_FORMAT_S16_NE:   bytes = 2; break;
+    case AF_FORMAT_S32_NE:
+    case AF_FORMAT_FLOAT_NE: bytes = 4; break;
+    default:
+        return NULL;
+    }
+    if (channels < 1 || channels > 8 || in_rate <= 0 || out_rate <= 0
+        || in_rate > out_rate * AF_CONVERT_MAX_RATIO
+        || out_rate > in_rate * AF_CONVERT_MAX_RATIO)
+        return NULL;
+
+    s = calloc(1, sizeof(*s));
+    if (!s)
+        return NULL;
+    s->format = format;
+    s->channels = channels;
+    s->frame_size = bytes * channels;
+    s->in_rate = in_rate;
+    s->out_rate = out_rate;
+    s->seed = 0x1234567;
+
+    if (in_rate != out_rate) {
+        d = gcd(in_rate, out_rate);
+        s->up = out_rate / d;
+        s->down = in_rate / d;
+        s->step = s->down / s->up;
+        s->step_frac = s->down % s->up;
+        s->phases = s->up < MAX_PHASES ? s->up : MAX_PHASES;
+        if (!init_taps(s))
+            goto fail;
+    }
+    s->hist = malloc(channels * HIST_LEN * sizeof(int32_t));
+    if (!s->hist)
+        goto fail;
+    af_convert_reset(s);
+
+    mp_msg(MSGT_AFILTER, MSGL_V, "af_convert: %s %d Hz -> s16 %d Hz, %d channels, %d phases\n",
+           af_fmt2str_short(format), in_rate, out_rate, channels, s->phases);
+    return s;
+
+fail:
+    af_convert_close(s);
+    return NULL;
+}
+
+void af_convert_close(af_convert_t *s)
+{
+    if (!s)
+        return;
+    free(s->taps);
+    free(s->hist);
+    free(s);
+}
+
+void af_convert_reset(af_convert_t *s)
+{
+    // The zeros ahead of the first sample put it in the centre of the
+    // taps, the output starts at the same time as the input.
+    memset(s->hist, 0, s->channels * HIST_LEN * sizeof(int32_t));
+    s->avail = s->up ? NTAPS / 2 - 1 : 0;
+    s->pos = 0;
+    s->frac = 0;
+}
+
+int af_convert_out_frames(af_convert_t *s, int in_frames)
+{
+    if (!s->up)
+        return in_frames;
+    return (int)((int64_t)(in_frames + NTAPS) * s->up / s->down) + 1;
+}
+
+int af_convert_run(af_convert_t *s, const void *in, int in_frames, int16_t *out)
+{
+    const uint8_t *p = in;
+    int ch = s->channels;
+    int n = 0, len, i, c;
+
+    while (in_frames > 0) {
+        len = HIST_LEN - s->avail;
+        if (len > in_frames)
+            len = in_frames;
+        load(s, p, len);
+        p += len * s->frame_size;
+        in_frames -= len;
+
+        if (s->up) {
+            n += filter(s, out + n * ch);
+        } else {
+            for (i = 0; i < len; i++)
+                for (c = 0; c < ch; c++)
+                    out[(n + i) * ch + c] = dither_s16(s, s->hist[c * HIST_LEN + i]);
+            n += len;
+            s->avail = 0;
+        }
+    }
+
+    return n;
+}
+
+int af_convert_flush(af_convert_t *s, int16_t *out)
+{
+    int n, c;
+
+    if (!s->up)
+        return 0;
+    // Zeros up to the last sample in the centre of the taps.
+    for (c = 0; c < s->channels; c++)
+        memset(s->hist + c * HIST_LEN + s->avail, 0, NTAPS / 2 * sizeof(int32_t));
+    s->avail += NTAPS / 2;
+    n = filter(s, out);
+    af_convert_reset(s);
+    return n;
+}
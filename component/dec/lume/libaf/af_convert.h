@@ -0,0 +1,69 @@
+/*
+ * sample format conversion and resampling stage for the decoder output
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_AF_CONVERT_H
+#define MPLAYER_AF_CONVERT_H
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Converts interleaved U8, S16, S32 or float PCM to S16 at another rate
+ * in a single pass: the samples are widened as they are loaded, run
+ * through a 16 tap polyphase windowed sinc filter and TPDF dithered to
+ * 16 bit. With the same rate on both sides only the format is converted.
+ *
+ * The dot products run on the MXU when built for a JZ47xx (JZ4750_OPT
+ * from libjzcommon/com_config.h) unless AF_NO_MXU is defined.
+ * af_convert_check (dec/audio/tests) measures the THD+N and throughput.
+ */
+typedef struct af_convert_s af_convert_t;
+
+/// The furthest the rate may go up or down.
+#define AF_CONVERT_MAX_RATIO 8
+
+/// Returns NULL for a format or rate the stage does not take.
+af_convert_t *af_convert_open(int format, int in_rate, int out_rate, int channels);
+void af_convert_close(af_convert_t *s);
+
+/// Drops the filter history, after a seek.
+void af_convert_reset(af_convert_t *s);
+
+/// Frames out may get from in_frames of input, run or flush.
+int af_convert_out_frames(af_convert_t *s, int in_frames);
+
+/// Converts all of in, returns the frames written to out. At the same
+/// rate out may be in for 16 and 32 bit input, the output stays behind.
+int af_convert_run(af_convert_t *s, const void *in, int in_frames, int16_t *out);
+
+/// At the end of the stream: puts out the samples still in the filter.
+int af_convert_flush(af_convert_t *s, int16_t *out);
+
+/// 1 when PCM in the format at in_rate needs the stage to reach S16 at out_rate.
+int af_convert_needed(int format, int in_rate, int out_rate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPLAYER_AF_CONVERT_H */
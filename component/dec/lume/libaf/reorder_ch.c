@@ -1351,6 +1351,123 @@ void reorder_channel_nch(void *buf,
 }
 
 
+// Speaker roles of the downmix, in the order of the layout comments above.
+enum {
+    DM_L, DM_R, DM_C, DM_LFE, DM_LS, DM_RS, DM_CS, DM_RLS, DM_RRS,
+};
+
+static const int8_t downmix_3_0_a[] = { DM_L, DM_R, DM_C };
+static const int8_t downmix_3_0_b[] = { DM_C, DM_L, DM_R };
+static const int8_t downmix_4_0_b[] = { DM_C, DM_L, DM_R, DM_CS };
+static const int8_t downmix_4_0_c[] = { DM_L, DM_R, DM_LS, DM_RS };
+static const int8_t downmix_5_1_a[] = { DM_L, DM_R, DM_C, DM_LFE, DM_LS, DM_RS };
+static const int8_t downmix_5_1_b[] = { DM_L, DM_R, DM_LS, DM_RS, DM_C, DM_LFE };
+static const int8_t downmix_5_1_c[] = { DM_L, DM_C, DM_R, DM_LS, DM_RS, DM_LFE };
+static const int8_t downmix_5_1_d[] = { DM_C, DM_L, DM_R, DM_LS, DM_RS, DM_LFE };
+static const int8_t downmix_5_0_a[] = { DM_L, DM_R, DM_C, DM_LS, DM_RS };
+static const int8_t downmix_5_0_b[] = { DM_L, DM_R, DM_LS, DM_RS, DM_C };
+static const int8_t downmix_6_1_a[] = { DM_L, DM_R, DM_C, DM_LFE, DM_LS, DM_RS, DM_CS };
+static const int8_t downmix_7_1_a[] = { DM_L, DM_R, DM_C, DM_LFE, DM_LS, DM_RS, DM_RLS, DM_RRS };
+static const int8_t downmix_7_1_b[] = { DM_L, DM_R, DM_LS, DM_RS, DM_C, DM_LFE, DM_RLS, DM_RRS };
+static const int8_t downmix_7_1_c[] = { DM_L, DM_C, DM_R, DM_LS, DM_RS, DM_LFE, DM_RLS, DM_RRS };
+static const int8_t downmix_7_1_d[] = { DM_C, DM_L, DM_R, DM_LS, DM_RS, DM_RLS, DM_RRS, DM_LFE };
+
+static const int8_t *downmix_roles(int src_layout, int chnum)
+{
+    int layout;
+
+    if (chnum == 3)
+        return src_layout == AF_CHANNEL_LAYOUT_AAC_DEFAULT ?
+               downmix_3_0_b : downmix_3_0_a;
+    if (chnum == 4)
+        return src_layout == AF_CHANNEL_LAYOUT_AAC_DEFAULT ?
+               downmix_4_0_b : downmix_4_0_c;
+    if (chnum == 7)
+        return downmix_6_1_a;
+
+    if (chnum == 5)
+        layout = channel_layout_mapping_5ch[src_layout];
+    else if (chnum == 6)
+        layout = channel_layout_mapping_6ch[src_layout];
+    else
+        layout = channel_layout_mapping_8ch[src_layout];
+
+    switch (layout) {
+    // The 5.0 layouts are the 5.1 ones without the trailing LFE.
+    case AF_CHANNEL_LAYOUT_5_0_A: return downmix_5_0_a;
+    case AF_CHANNEL_LAYOUT_5_0_B: return downmix_5_0_b;
+    case AF_CHANNEL_LAYOUT_5_0_C: return downmix_5_1_c;
+    case AF_CHANNEL_LAYOUT_5_0_D: return downmix_5_1_d;
+    case AF_CHANNEL_LAYOUT_5_1_A: return downmix_5_1_a;
+    case AF_CHANNEL_LAYOUT_5_1_B: return downmix_5_1_b;
+    case AF_CHANNEL_LAYOUT_5_1_C: return downmix_5_1_c;
+    case AF_CHANNEL_LAYOUT_5_1_D: return downmix_5_1_d;
+    case AF_CHANNEL_LAYOUT_7_1_A: return downmix_7_1_a;
+    case AF_CHANNEL_LAYOUT_7_1_B: return downmix_7_1_b;
+    case AF_CHANNEL_LAYOUT_7_1_C: return downmix_7_1_c;
+    case AF_CHANNEL_LAYOUT_7_1_D: return downmix_7_1_d;
+    }
+    return NULL;
+}
+
+int downmix_channel_nch(void *src,
+                        int src_layout,
+                        void *dest,
+                        int chnum,
+                        int dest_chnum,
+                        int samples)
+{
+    // Front channels at 0 dB, the others at -3 dB, LFE dropped. The gains
+    // of each output are scaled to sum to one, so the mix cannot clip.
+    static const int weight[] = { 10000, 10000, 7071, 0, 7071, 7071, 7071, 7071, 7071 };
+    static const int to_left[] = { 1, 0, 1, 0, 1, 0, 1, 1, 0 };
+    static const int to_right[] = { 0, 1, 1, 0, 0, 1, 1, 0, 1 };
+    const int8_t *roles;
+    int32_t gain_l[8], gain_r[8];
+    int total_l = 0, total_r = 0;
+    int16_t *in = src, *out = dest;
+    int frames, i, c;
+
+    if (chnum < 3 || chnum > 8 || dest_chnum < 1 || dest_chnum > 2 ||
+            src_layout < 0 || src_layout >= AF_CHANNEL_LAYOUT_SOURCE_NUM)
+        return 0;
+    roles = downmix_roles(src_layout, chnum);
+    if (!roles)
+        return 0;
+
+    for (c = 0; c < chnum; c++) {
+        total_l += to_left[roles[c]] * weight[roles[c]];
+        total_r += to_right[roles[c]] * weight[roles[c]];
+    }
+    for (c = 0; c < chnum; c++) {
+        gain_l[c] = (to_left[roles[c]] * weight[roles[c]] << 15) / total_l;
+        gain_r[c] = (to_right[roles[c]] * weight[roles[c]] << 15) / total_r;
+        if (dest_chnum == 1)
+            gain_l[c] = (gain_l[c] + gain_r[c]) >> 1;
+    }
+
+    // One pass over the input, the reorder is in the gains. In place is
+    // fine, an output frame never goes past the input frame it comes from.
+    frames = samples / chnum;
+    for (i = 0; i < frames; i++) {
+        int32_t l = 1 << 14, r = 1 << 14;
+        for (c = 0; c < chnum; c++) {
+            l += in[c] * gain_l[c];
+            r += in[c] * gain_r[c];
+        }
+        l >>= 15;
+        out[0] = l > 32767 ? 32767 : l < -32768 ? -32768 : l;
+        if (dest_chnum == 2) {
+            r >>= 15;
+            out[1] = r > 32767 ? 32767 : r < -32768 ? -32768 : r;
+        }
+        in += chnum;
+        out += dest_chnum;
+    }
+    return frames * dest_chnum;
+}
+
+
 #ifdef TEST
 
 static void test_copy(int channels) {
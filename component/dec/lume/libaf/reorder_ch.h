@@ -130,4 +130,15 @@ void reorder_channel_nch(void *buf,
                          int samples,
                          int samplesize);
 
+/// Downmix 16 bit samples of an audio source layout with 3 to 8 channels
+/// to stereo or mono in a single pass, the reorder folded into the mix.
+/// Works on a single buffer too. Returns the samples written, 0 when the
+/// layout is not known.
+int downmix_channel_nch(void *src,
+                        int src_layout,
+                        void *dest,
+                        int chnum,
+                        int dest_chnum,
+                        int samples);
+
 #endif /* MPLAYER_REORDER_CH_H */
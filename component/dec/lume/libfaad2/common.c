@@ -32,6 +32,7 @@
 
 #include <stdlib.h>
 #include "syntax.h"
+#include "fixed_mxu.h"
 
 
 /* Returns the sample rate index based on the samplerate */
@@ -517,3 +518,87 @@ real_t log2_fix(uint32_t val)
     return (exp << REAL_BITS) + errcorr + x1;
 }
 #endif
+
+#if defined(FAAD_MXU_BENCH) && defined(FAAD_MXU)
+#include <string.h>
+#include <time.h>
+#include "mp_msg.h"
+
+static const char *mxu_bench_names[MXU_BENCH_KERNELS] = {
+    "imdct pre", "imdct post", "qmfa window", "qmfs window", "hybrid"
+};
+
+static struct {
+    uint32_t calls;
+    int64_t c_ns;
+    int64_t mxu_ns;
+    real_t max_diff;
+} mxu_bench_stats[MXU_BENCH_KERNELS];
+
+static real_t mxu_bench_in_buf[MXU_BENCH_MAX_LEN];
+static real_t mxu_bench_ref_buf[MXU_BENCH_MAX_LEN];
+static real_t *mxu_bench_in_ptr;
+static uint32_t mxu_bench_in_len;
+
+int64_t mxu_bench_ts(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* save the input of an in place kernel, it is put back for the second run */
+void mxu_bench_input(real_t *in, uint32_t len)
+{
+    if (len > MXU_BENCH_MAX_LEN)
+        len = MXU_BENCH_MAX_LEN;
+
+    mxu_bench_in_ptr = in;
+    mxu_bench_in_len = (in != NULL) ? len : 0;
+    if (mxu_bench_in_len)
+        memcpy(mxu_bench_in_buf, in, len * sizeof(real_t));
+}
+
+void mxu_bench_ref(const real_t *out, uint32_t len)
+{
+    if (len > MXU_BENCH_MAX_LEN)
+        len = MXU_BENCH_MAX_LEN;
+
+    memcpy(mxu_bench_ref_buf, out, len * sizeof(real_t));
+    if (mxu_bench_in_len)
+        memcpy(mxu_bench_in_ptr, mxu_bench_in_buf, mxu_bench_in_len * sizeof(real_t));
+}
+
+void mxu_bench_done(uint8_t kernel, int64_t c_ns, int64_t mxu_ns,
+                    const real_t *out, uint32_t len)
+{
+    uint32_t i;
+    real_t diff;
+
+    if (len > MXU_BENCH_MAX_LEN)
+        len = MXU_BENCH_MAX_LEN;
+
+    for (i = 0; i < len; i++)
+    {
+        diff = out[i] - mxu_bench_ref_buf[i];
+        if (diff < 0)
+            diff = -diff;
+        if (diff > mxu_bench_stats[kernel].max_diff)
+            mxu_bench_stats[kernel].max_diff = diff;
+    }
+
+    mxu_bench_stats[kernel].c_ns += c_ns;
+    mxu_bench_stats[kernel].mxu_ns += mxu_ns;
+    if (++mxu_bench_stats[kernel].calls % MXU_BENCH_REPORT == 0)
+    {
+        mp_msg(MSGT_DECAUDIO, MSGL_INFO, "faad mxu %-12s calls %u c %lld ns mxu %lld ns (%lld%%) max diff %d\n",
+            mxu_bench_names[kernel], mxu_bench_stats[kernel].calls,
+            (long long)(mxu_bench_stats[kernel].c_ns / mxu_bench_stats[kernel].calls),
+            (long long)(mxu_bench_stats[kernel].mxu_ns / mxu_bench_stats[kernel].calls),
+            (long long)(mxu_bench_stats[kernel].c_ns ?
+                mxu_bench_stats[kernel].mxu_ns * 100 / mxu_bench_stats[kernel].c_ns : 0),
+            (int)mxu_bench_stats[kernel].max_diff);
+    }
+}
+#endif
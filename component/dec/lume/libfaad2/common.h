@@ -120,12 +120,12 @@ extern "C" {
 //#define SBR_LOW_POWER
 #define PS_DEC
 
-/* FIXED POINT: No MAIN decoding */
+/* FIXED POINT: No MAIN decoding, SBR only with FIXED_POINT_SBR */
 #ifdef FIXED_POINT
 # ifdef MAIN_DEC
 #  undef MAIN_DEC
 # endif
-# ifdef SBR_DEC
+# if defined(SBR_DEC) && !defined(FIXED_POINT_SBR)
 #  undef SBR_DEC
 # endif
 #endif // FIXED_POINT
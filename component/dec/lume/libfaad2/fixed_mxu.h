@@ -0,0 +1,120 @@
+/*
+** FAAD2 - Freeware Advanced Audio (AAC) Decoder including SBR decoding
+** Copyright (C) 2003-2004 M. Bakker, Ahead Software AG, http://www.nero.com
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 2 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+**
+** Any non-GPL usage of this software or parts of this software is strictly
+** forbidden.
+**
+** Commercial non-GPL licensing of this software is possible.
+** For more info contact Ahead Software through Mpeg4AAClicense@nero.com.
+**/
+
+#ifndef __FIXED_MXU_H__
+#define __FIXED_MXU_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * XBurst MXU versions of the fixed point filterbank kernels (IMDCT
+ * twiddles, SBR QMF windows, PS hybrid filters). Every kernel keeps its
+ * plain C version next to it; the MXU one is picked when building fixed
+ * point for a JZ47xx (JZ4750_OPT from libjzcommon/com_config.h) unless
+ * FAAD_NO_MXU is defined.
+ *
+ * The MXU kernels sum products in the 64 bit xr1:xr2 accumulator and
+ * round once, where the C code rounds every MUL_F. Results differ from
+ * the C ones by a few LSBs of a Q31 value.
+ */
+#if defined(FIXED_POINT) && defined(JZ4750_OPT) && !defined(FAAD_NO_MXU)
+#define FAAD_MXU
+#endif
+
+#ifdef FAAD_MXU
+#include "../libjzcommon/jzmedia.h"
+
+/* Q31 value of the xr1:xr2 accumulator: bits 62..31 of the product sum */
+#define MXU_ACC_F() \
+    ((real_t)(((uint32_t)S32M2I(xr1) << 1) | ((uint32_t)S32M2I(xr2) >> 31)))
+
+/* ComplexMult on the MXU, the products of each output are summed first */
+static INLINE void ComplexMult_mxu(real_t *y1, real_t *y2,
+    real_t x1, real_t x2, real_t c1, real_t c2)
+{
+    S32MUL(xr1, xr2, x1, c1);
+    S32MADD(xr1, xr2, x2, c2);
+    *y1 = MXU_ACC_F();
+
+    S32MUL(xr1, xr2, x2, c1);
+    S32MSUB(xr1, xr2, x1, c2);
+    *y2 = MXU_ACC_F();
+}
+#endif
+
+/*
+ * Side by side benchmark. With FAAD_MXU_BENCH defined every FAAD_KERNEL
+ * call runs the C kernel, puts back its input (kernels that work in
+ * place), then runs the MXU kernel. The time of both and the largest
+ * difference of their output are logged every MXU_BENCH_REPORT calls.
+ * The reference buffers are static, bench one decoder at a time.
+ * Without FAAD_MXU_BENCH, FAAD_KERNEL runs just the kernel of the build.
+ */
+enum {
+    MXU_BENCH_IMDCT_PRE,
+    MXU_BENCH_IMDCT_POST,
+    MXU_BENCH_QMFA_WINDOW,
+    MXU_BENCH_QMFS_WINDOW,
+    MXU_BENCH_HYBRID,
+    MXU_BENCH_KERNELS
+};
+
+#if defined(FAAD_MXU_BENCH) && defined(FAAD_MXU)
+#define MXU_BENCH_REPORT 2000
+#define MXU_BENCH_MAX_LEN 1024   /* reals, the 2048 point IMDCT */
+
+int64_t mxu_bench_ts(void);
+void mxu_bench_input(real_t *in, uint32_t len);
+void mxu_bench_ref(const real_t *out, uint32_t len);
+void mxu_bench_done(uint8_t kernel, int64_t c_ns, int64_t mxu_ns,
+                    const real_t *out, uint32_t len);
+
+#define FAAD_KERNEL(kernel, in, in_len, out, out_len, c_call, mxu_call) \
+    do { \
+        int64_t t0_, t1_, t2_; \
+        mxu_bench_input((real_t *)(in), (in_len)); \
+        t0_ = mxu_bench_ts(); \
+        c_call; \
+        t1_ = mxu_bench_ts(); \
+        mxu_bench_ref((const real_t *)(out), (out_len)); \
+        t2_ = mxu_bench_ts(); \
+        mxu_call; \
+        mxu_bench_done((kernel), t1_ - t0_, mxu_bench_ts() - t2_, \
+                       (const real_t *)(out), (out_len)); \
+    } while (0)
+#elif defined(FAAD_MXU)
+#define FAAD_KERNEL(kernel, in, in_len, out, out_len, c_call, mxu_call) \
+    mxu_call
+#else
+#define FAAD_KERNEL(kernel, in, in_len, out, out_len, c_call, mxu_call) \
+    c_call
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -54,6 +54,7 @@
 #include "cfft.h"
 #include "mdct.h"
 #include "mdct_tab.h"
+#include "fixed_mxu.h"
 
 
 mdct_info *faad_mdct_init(uint16_t N)
@@ -116,11 +117,70 @@ void faad_mdct_end(mdct_info *mdct)
     }
 }
 
-void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
+static void imdct_pre_twiddle_c(complex_t *Z1, const real_t *X_in,
+                                complex_t *sincos, uint16_t N2, uint16_t N4)
 {
     uint16_t k;
 
+    for (k = 0; k < N4; k++)
+    {
+        ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
+            X_in[2*k], X_in[N2 - 1 - 2*k], RE(sincos[k]), IM(sincos[k]));
+    }
+}
+
+static void imdct_post_twiddle_c(complex_t *Z1, complex_t *sincos,
+                                 uint16_t N4)
+{
+    uint16_t k;
     complex_t x;
+
+    for (k = 0; k < N4; k++)
+    {
+        RE(x) = RE(Z1[k]);
+        IM(x) = IM(Z1[k]);
+        ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
+            IM(x), RE(x), RE(sincos[k]), IM(sincos[k]));
+    }
+}
+
+#ifdef FAAD_MXU
+static void imdct_pre_twiddle_mxu(complex_t *Z1, const real_t *X_in,
+                                  complex_t *sincos, uint16_t N2, uint16_t N4)
+{
+    const real_t *x0 = X_in;
+    const real_t *x1 = X_in + N2 - 1;
+    uint16_t k;
+
+    for (k = 0; k < N4; k++)
+    {
+        ComplexMult_mxu(&IM(Z1[k]), &RE(Z1[k]),
+            *x0, *x1, RE(sincos[k]), IM(sincos[k]));
+        x0 += 2;
+        x1 -= 2;
+    }
+}
+
+static void imdct_post_twiddle_mxu(complex_t *Z1, complex_t *sincos,
+                                   uint16_t N4)
+{
+    uint16_t k;
+
+    for (k = 0; k < N4; k++)
+    {
+        real_t re = RE(Z1[k]);
+        real_t im = IM(Z1[k]);
+
+        ComplexMult_mxu(&IM(Z1[k]), &RE(Z1[k]),
+            im, re, RE(sincos[k]), IM(sincos[k]));
+    }
+}
+#endif
+
+void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
+{
+    uint16_t k;
+
 #ifdef ALLOW_SMALL_FRAMELENGTH
 #ifdef FIXED_POINT
     real_t scale, b_scale = 0;
@@ -152,11 +212,9 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* pre-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
-    {
-        ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
-            X_in[2*k], X_in[N2 - 1 - 2*k], RE(sincos[k]), IM(sincos[k]));
-    }
+    FAAD_KERNEL(MXU_BENCH_IMDCT_PRE, NULL, 0, Z1, 2*N4,
+        imdct_pre_twiddle_c(Z1, X_in, sincos, N2, N4),
+        imdct_pre_twiddle_mxu(Z1, X_in, sincos, N2, N4));
 
 #ifdef PROFILE
     count1 = faad_get_ts();
@@ -170,24 +228,23 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* post-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
-    {
-        RE(x) = RE(Z1[k]);
-        IM(x) = IM(Z1[k]);
-        ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
-            IM(x), RE(x), RE(sincos[k]), IM(sincos[k]));
+    FAAD_KERNEL(MXU_BENCH_IMDCT_POST, Z1, 2*N4, Z1, 2*N4,
+        imdct_post_twiddle_c(Z1, sincos, N4),
+        imdct_post_twiddle_mxu(Z1, sincos, N4));
 
 #ifdef ALLOW_SMALL_FRAMELENGTH
 #ifdef FIXED_POINT
-        /* non-power of 2 MDCT scaling */
-        if (b_scale)
+    /* non-power of 2 MDCT scaling */
+    if (b_scale)
+    {
+        for (k = 0; k < N4; k++)
         {
             RE(Z1[k]) = MUL_C(RE(Z1[k]), scale);
             IM(Z1[k]) = MUL_C(IM(Z1[k]), scale);
         }
+    }
 #endif
 #endif
-    }
 
     /* reordering */
     for (k = 0; k < N8; k+=2)
@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include "ps_dec.h"
 #include "ps_tables.h"
+#include "fixed_mxu.h"
 
 /* constants */
 #define NEGATE_IPD_MASK            (0x1000)
@@ -220,10 +221,12 @@ static hyb_info *hybrid_init(void)
         memset(hyb->buffer[i], 0, hyb->frame_len * sizeof(qmf_t));
     }
 
+    /* one block, so the filter output can be compared as a whole */
     hyb->temp = (qmf_t**)faad_malloc(hyb->frame_len * sizeof(qmf_t*));
-    for (i = 0; i < hyb->frame_len; i++)
+    hyb->temp[0] = (qmf_t*)faad_malloc(hyb->frame_len * 12 /*max*/ * sizeof(qmf_t));
+    for (i = 1; i < hyb->frame_len; i++)
     {
-        hyb->temp[i] = (qmf_t*)faad_malloc(12 /*max*/ * sizeof(qmf_t));
+        hyb->temp[i] = hyb->temp[0] + i * 12;
     }
 
     return hyb;
@@ -244,11 +247,8 @@ static void hybrid_free(hyb_info *hyb)
     if (hyb->buffer)
         faad_free(hyb->buffer);
 
-    for (i = 0; i < hyb->frame_len; i++)
-    {
-        if (hyb->temp[i])
-            faad_free(hyb->temp[i]);
-    }
+    if (hyb->temp && hyb->temp[0])
+        faad_free(hyb->temp[0]);
     if (hyb->temp)
         faad_free(hyb->temp);
 }
@@ -286,6 +286,49 @@ static void channel_filter2(hyb_info *hyb, uint8_t frame_len, const real_t *filt
     }
 }
 
+#ifdef FAAD_MXU
+static void channel_filter2_mxu(hyb_info *hyb, uint8_t frame_len, const real_t *filter,
+                                qmf_t *buffer, qmf_t **X_hybrid)
+{
+    uint8_t i;
+
+    for (i = 0; i < frame_len; i++)
+    {
+        const qmf_t *b = buffer + i;
+        real_t re_even, re_odd, im_even, im_odd;
+
+        /* the even and the odd taps give both outputs */
+        S32MUL(xr1, xr2, filter[0], QMF_RE(b[0]) + QMF_RE(b[12]));
+        S32MADD(xr1, xr2, filter[2], QMF_RE(b[2]) + QMF_RE(b[10]));
+        S32MADD(xr1, xr2, filter[4], QMF_RE(b[4]) + QMF_RE(b[8]));
+        S32MADD(xr1, xr2, filter[6], QMF_RE(b[6]));
+        re_even = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[1], QMF_RE(b[1]) + QMF_RE(b[11]));
+        S32MADD(xr1, xr2, filter[3], QMF_RE(b[3]) + QMF_RE(b[9]));
+        S32MADD(xr1, xr2, filter[5], QMF_RE(b[5]) + QMF_RE(b[7]));
+        re_odd = MXU_ACC_F();
+
+        S32MUL(xr1, xr2, filter[0], QMF_IM(b[0]) + QMF_IM(b[12]));
+        S32MADD(xr1, xr2, filter[2], QMF_IM(b[2]) + QMF_IM(b[10]));
+        S32MADD(xr1, xr2, filter[4], QMF_IM(b[4]) + QMF_IM(b[8]));
+        S32MADD(xr1, xr2, filter[6], QMF_IM(b[6]));
+        im_even = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[1], QMF_IM(b[1]) + QMF_IM(b[11]));
+        S32MADD(xr1, xr2, filter[3], QMF_IM(b[3]) + QMF_IM(b[9]));
+        S32MADD(xr1, xr2, filter[5], QMF_IM(b[5]) + QMF_IM(b[7]));
+        im_odd = MXU_ACC_F();
+
+        /* q = 0 */
+        QMF_RE(X_hybrid[i][0]) = re_even + re_odd;
+        QMF_IM(X_hybrid[i][0]) = im_even + im_odd;
+
+        /* q = 1 */
+        QMF_RE(X_hybrid[i][1]) = re_even - re_odd;
+        QMF_IM(X_hybrid[i][1]) = im_even - im_odd;
+    }
+}
+#endif
+
 /* complex filter, size 4 */
 static void channel_filter4(hyb_info *hyb, uint8_t frame_len, const real_t *filter,
                             qmf_t *buffer, qmf_t **X_hybrid)
@@ -360,13 +403,61 @@ static void INLINE DCT3_4_unscaled(real_t *y, real_t *x)
     y[1] = f1 + f7;
 }
 
+/* DCT stage of the size 8 filter, shared by the C and MXU versions */
+static void channel_filter8_dct(qmf_t *X_hybrid,
+                                real_t *input_re1, real_t *input_im1,
+                                real_t *input_re2, real_t *input_im2)
+{
+    uint8_t n;
+    real_t x[4];
+
+    for (n = 0; n < 4; n++)
+    {
+        x[n] = input_re1[n] - input_im1[3-n];
+    }
+    DCT3_4_unscaled(x, x);
+    QMF_RE(X_hybrid[7]) = x[0];
+    QMF_RE(X_hybrid[5]) = x[2];
+    QMF_RE(X_hybrid[3]) = x[3];
+    QMF_RE(X_hybrid[1]) = x[1];
+
+    for (n = 0; n < 4; n++)
+    {
+        x[n] = input_re1[n] + input_im1[3-n];
+    }
+    DCT3_4_unscaled(x, x);
+    QMF_RE(X_hybrid[6]) = x[1];
+    QMF_RE(X_hybrid[4]) = x[3];
+    QMF_RE(X_hybrid[2]) = x[2];
+    QMF_RE(X_hybrid[0]) = x[0];
+
+    for (n = 0; n < 4; n++)
+    {
+        x[n] = input_im2[n] + input_re2[3-n];
+    }
+    DCT3_4_unscaled(x, x);
+    QMF_IM(X_hybrid[7]) = x[0];
+    QMF_IM(X_hybrid[5]) = x[2];
+    QMF_IM(X_hybrid[3]) = x[3];
+    QMF_IM(X_hybrid[1]) = x[1];
+
+    for (n = 0; n < 4; n++)
+    {
+        x[n] = input_im2[n] - input_re2[3-n];
+    }
+    DCT3_4_unscaled(x, x);
+    QMF_IM(X_hybrid[6]) = x[1];
+    QMF_IM(X_hybrid[4]) = x[3];
+    QMF_IM(X_hybrid[2]) = x[2];
+    QMF_IM(X_hybrid[0]) = x[0];
+}
+
 /* complex filter, size 8 */
 static void channel_filter8(hyb_info *hyb, uint8_t frame_len, const real_t *filter,
                             qmf_t *buffer, qmf_t **X_hybrid)
 {
-    uint8_t i, n;
+    uint8_t i;
     real_t input_re1[4], input_re2[4], input_im1[4], input_im2[4];
-    real_t x[4];
 
     for (i = 0; i < frame_len; i++)
     {
@@ -380,26 +471,6 @@ static void channel_filter8(hyb_info *hyb, uint8_t frame_len, const real_t *filt
         input_im1[2] = MUL_F(filter[1],(QMF_IM(buffer[11+i]) - QMF_IM(buffer[1+i]))) + MUL_F(filter[3],(QMF_IM(buffer[9+i]) - QMF_IM(buffer[3+i])));
         input_im1[3] = MUL_F(filter[2],(QMF_IM(buffer[10+i]) - QMF_IM(buffer[2+i])));
 
-        for (n = 0; n < 4; n++)
-        {
-            x[n] = input_re1[n] - input_im1[3-n];
-        }
-        DCT3_4_unscaled(x, x);
-        QMF_RE(X_hybrid[i][7]) = x[0];
-        QMF_RE(X_hybrid[i][5]) = x[2];
-        QMF_RE(X_hybrid[i][3]) = x[3];
-        QMF_RE(X_hybrid[i][1]) = x[1];
-
-        for (n = 0; n < 4; n++)
-        {
-            x[n] = input_re1[n] + input_im1[3-n];
-        }
-        DCT3_4_unscaled(x, x);
-        QMF_RE(X_hybrid[i][6]) = x[1];
-        QMF_RE(X_hybrid[i][4]) = x[3];
-        QMF_RE(X_hybrid[i][2]) = x[2];
-        QMF_RE(X_hybrid[i][0]) = x[0];
-
         input_im2[0] =  MUL_F(filter[6],QMF_IM(buffer[6+i]));
         input_im2[1] =  MUL_F(filter[5],(QMF_IM(buffer[5+i]) + QMF_IM(buffer[7+i])));
         input_im2[2] = -MUL_F(filter[0],(QMF_IM(buffer[0+i]) + QMF_IM(buffer[12+i]))) + MUL_F(filter[4],(QMF_IM(buffer[4+i]) + QMF_IM(buffer[8+i])));
@@ -410,27 +481,69 @@ static void channel_filter8(hyb_info *hyb, uint8_t frame_len, const real_t *filt
         input_re2[2] = MUL_F(filter[1],(QMF_RE(buffer[11+i]) - QMF_RE(buffer[1+i]))) + MUL_F(filter[3],(QMF_RE(buffer[9+i]) - QMF_RE(buffer[3+i])));
         input_re2[3] = MUL_F(filter[2],(QMF_RE(buffer[10+i]) - QMF_RE(buffer[2+i])));
 
-        for (n = 0; n < 4; n++)
-        {
-            x[n] = input_im2[n] + input_re2[3-n];
-        }
-        DCT3_4_unscaled(x, x);
-        QMF_IM(X_hybrid[i][7]) = x[0];
-        QMF_IM(X_hybrid[i][5]) = x[2];
-        QMF_IM(X_hybrid[i][3]) = x[3];
-        QMF_IM(X_hybrid[i][1]) = x[1];
+        channel_filter8_dct(X_hybrid[i], input_re1, input_im1, input_re2, input_im2);
+    }
+}
 
-        for (n = 0; n < 4; n++)
-        {
-            x[n] = input_im2[n] - input_re2[3-n];
-        }
-        DCT3_4_unscaled(x, x);
-        QMF_IM(X_hybrid[i][6]) = x[1];
-        QMF_IM(X_hybrid[i][4]) = x[3];
-        QMF_IM(X_hybrid[i][2]) = x[2];
-        QMF_IM(X_hybrid[i][0]) = x[0];
+#ifdef FAAD_MXU
+static void channel_filter8_mxu(hyb_info *hyb, uint8_t frame_len, const real_t *filter,
+                                qmf_t *buffer, qmf_t **X_hybrid)
+{
+    uint8_t i;
+    real_t input_re1[4], input_re2[4], input_im1[4], input_im2[4];
+
+    for (i = 0; i < frame_len; i++)
+    {
+        const qmf_t *b = buffer + i;
+
+        S32MUL(xr1, xr2, filter[6], QMF_RE(b[6]));
+        input_re1[0] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[5], QMF_RE(b[5]) + QMF_RE(b[7]));
+        input_re1[1] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[4], QMF_RE(b[4]) + QMF_RE(b[8]));
+        S32MSUB(xr1, xr2, filter[0], QMF_RE(b[0]) + QMF_RE(b[12]));
+        input_re1[2] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[3], QMF_RE(b[3]) + QMF_RE(b[9]));
+        S32MSUB(xr1, xr2, filter[1], QMF_RE(b[1]) + QMF_RE(b[11]));
+        input_re1[3] = MXU_ACC_F();
+
+        S32MUL(xr1, xr2, filter[5], QMF_IM(b[7]) - QMF_IM(b[5]));
+        input_im1[0] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[0], QMF_IM(b[12]) - QMF_IM(b[0]));
+        S32MADD(xr1, xr2, filter[4], QMF_IM(b[8]) - QMF_IM(b[4]));
+        input_im1[1] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[1], QMF_IM(b[11]) - QMF_IM(b[1]));
+        S32MADD(xr1, xr2, filter[3], QMF_IM(b[9]) - QMF_IM(b[3]));
+        input_im1[2] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[2], QMF_IM(b[10]) - QMF_IM(b[2]));
+        input_im1[3] = MXU_ACC_F();
+
+        S32MUL(xr1, xr2, filter[6], QMF_IM(b[6]));
+        input_im2[0] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[5], QMF_IM(b[5]) + QMF_IM(b[7]));
+        input_im2[1] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[4], QMF_IM(b[4]) + QMF_IM(b[8]));
+        S32MSUB(xr1, xr2, filter[0], QMF_IM(b[0]) + QMF_IM(b[12]));
+        input_im2[2] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[3], QMF_IM(b[3]) + QMF_IM(b[9]));
+        S32MSUB(xr1, xr2, filter[1], QMF_IM(b[1]) + QMF_IM(b[11]));
+        input_im2[3] = MXU_ACC_F();
+
+        S32MUL(xr1, xr2, filter[5], QMF_RE(b[7]) - QMF_RE(b[5]));
+        input_re2[0] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[0], QMF_RE(b[12]) - QMF_RE(b[0]));
+        S32MADD(xr1, xr2, filter[4], QMF_RE(b[8]) - QMF_RE(b[4]));
+        input_re2[1] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[1], QMF_RE(b[11]) - QMF_RE(b[1]));
+        S32MADD(xr1, xr2, filter[3], QMF_RE(b[9]) - QMF_RE(b[3]));
+        input_re2[2] = MXU_ACC_F();
+        S32MUL(xr1, xr2, filter[2], QMF_RE(b[10]) - QMF_RE(b[2]));
+        input_re2[3] = MXU_ACC_F();
+
+        channel_filter8_dct(X_hybrid[i], input_re1, input_im1, input_re2, input_im2);
     }
 }
+#endif
 
 static void INLINE DCT3_6_unscaled(real_t *y, real_t *x)
 {
@@ -528,7 +641,9 @@ static void hybrid_analysis(hyb_info *hyb, qmf_t X[32][64], qmf_t X_hybrid[32][3
         {
         case 2:
             /* Type B real filter, Q[p] = 2 */
-            channel_filter2(hyb, hyb->frame_len, p2_13_20, hyb->work, hyb->temp);
+            FAAD_KERNEL(MXU_BENCH_HYBRID, NULL, 0, hyb->temp[0], hyb->frame_len*12*2,
+                channel_filter2(hyb, hyb->frame_len, p2_13_20, hyb->work, hyb->temp),
+                channel_filter2_mxu(hyb, hyb->frame_len, p2_13_20, hyb->work, hyb->temp));
             break;
         case 4:
             /* Type A complex filter, Q[p] = 4 */
@@ -536,8 +651,11 @@ static void hybrid_analysis(hyb_info *hyb, qmf_t X[32][64], qmf_t X_hybrid[32][3
             break;
         case 8:
             /* Type A complex filter, Q[p] = 8 */
-            channel_filter8(hyb, hyb->frame_len, (use34) ? p8_13_34 : p8_13_20,
-                hyb->work, hyb->temp);
+            FAAD_KERNEL(MXU_BENCH_HYBRID, NULL, 0, hyb->temp[0], hyb->frame_len*12*2,
+                channel_filter8(hyb, hyb->frame_len, (use34) ? p8_13_34 : p8_13_20,
+                    hyb->work, hyb->temp),
+                channel_filter8_mxu(hyb, hyb->frame_len, (use34) ? p8_13_34 : p8_13_20,
+                    hyb->work, hyb->temp));
             break;
         case 12:
             /* Type A complex filter, Q[p] = 12 */
@@ -37,6 +37,7 @@
 #include "sbr_qmf.h"
 #include "sbr_qmf_c.h"
 #include "sbr_syntax.h"
+#include "fixed_mxu.h"
 
 qmfa_info *qmfa_init(uint8_t channels)
 {
@@ -63,6 +64,40 @@ void qmfa_end(qmfa_info *qmfa)
     }
 }
 
+static void qmfa_window_c(real_t *u, const real_t *x)
+{
+    int16_t n;
+
+    for (n = 0; n < 64; n++)
+    {
+        u[n] = MUL_F(x[n], qmf_c[2*n]) +
+            MUL_F(x[n + 64], qmf_c[2*(n + 64)]) +
+            MUL_F(x[n + 128], qmf_c[2*(n + 128)]) +
+            MUL_F(x[n + 192], qmf_c[2*(n + 192)]) +
+            MUL_F(x[n + 256], qmf_c[2*(n + 256)]);
+    }
+}
+
+#ifdef FAAD_MXU
+static void qmfa_window_mxu(real_t *u, const real_t *x)
+{
+    const real_t *c = qmf_c;
+    int16_t n;
+
+    for (n = 0; n < 64; n++)
+    {
+        S32MUL(xr1, xr2, x[0], c[0]);
+        S32MADD(xr1, xr2, x[64], c[128]);
+        S32MADD(xr1, xr2, x[128], c[256]);
+        S32MADD(xr1, xr2, x[192], c[384]);
+        S32MADD(xr1, xr2, x[256], c[512]);
+        u[n] = MXU_ACC_F();
+        x++;
+        c += 2;
+    }
+}
+#endif
+
 void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
                          qmf_t X[MAX_NTSRHFG][64], uint8_t offset, uint8_t kx)
 {
@@ -95,14 +130,9 @@ void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
         }
 
         /* window and summation to create array u */
-        for (n = 0; n < 64; n++)
-        {
-            u[n] = MUL_F(qmfa->x[qmfa->x_index + n], qmf_c[2*n]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 64], qmf_c[2*(n + 64)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 128], qmf_c[2*(n + 128)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 192], qmf_c[2*(n + 192)]) +
-                MUL_F(qmfa->x[qmfa->x_index + n + 256], qmf_c[2*(n + 256)]);
-        }
+        FAAD_KERNEL(MXU_BENCH_QMFA_WINDOW, NULL, 0, u, 64,
+            qmfa_window_c(u, qmfa->x + qmfa->x_index),
+            qmfa_window_mxu(u, qmfa->x + qmfa->x_index));
 
 		/* update ringbuffer index */
 		qmfa->x_index -= 32;
@@ -451,6 +481,98 @@ void sbr_qmf_synthesis_32(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
     }
 }
 
+/* window the ring buffer v into 64 output samples */
+static void qmfs_window_c(real_t *output, real_t *pring_buffer_1)
+{
+#ifdef PREFER_POINTERS
+    // These pointers are used if target platform has autoinc address generators
+    real_t * pring_buffer_2, * pring_buffer_3, * pring_buffer_4;
+    real_t * pring_buffer_5, * pring_buffer_6;
+    real_t * pring_buffer_7, * pring_buffer_8;
+    real_t * pring_buffer_9, * pring_buffer_10;
+    const real_t * pqmf_c_1, * pqmf_c_2, * pqmf_c_3, * pqmf_c_4;
+    const real_t * pqmf_c_5, * pqmf_c_6, * pqmf_c_7, * pqmf_c_8;
+    const real_t * pqmf_c_9, * pqmf_c_10;
+#endif // #ifdef PREFER_POINTERS
+    int16_t k, out = 0;
+
+#ifdef PREFER_POINTERS
+    pring_buffer_2 = pring_buffer_1 + 192;
+    pring_buffer_3 = pring_buffer_1 + 256;
+    pring_buffer_4 = pring_buffer_1 + (256 + 192);
+    pring_buffer_5 = pring_buffer_1 + 512;
+    pring_buffer_6 = pring_buffer_1 + (512 + 192);
+    pring_buffer_7 = pring_buffer_1 + 768;
+    pring_buffer_8 = pring_buffer_1 + (768 + 192);
+    pring_buffer_9 = pring_buffer_1 + 1024;
+    pring_buffer_10 = pring_buffer_1 + (1024 + 192);
+    pqmf_c_1 = qmf_c;
+    pqmf_c_2 = qmf_c + 64;
+    pqmf_c_3 = qmf_c + 128;
+    pqmf_c_4 = qmf_c + 192;
+    pqmf_c_5 = qmf_c + 256;
+    pqmf_c_6 = qmf_c + 320;
+    pqmf_c_7 = qmf_c + 384;
+    pqmf_c_8 = qmf_c + 448;
+    pqmf_c_9 = qmf_c + 512;
+    pqmf_c_10 = qmf_c + 576;
+#endif // #ifdef PREFER_POINTERS
+
+    for (k = 0; k < 64; k++)
+    {
+#ifdef PREFER_POINTERS
+        output[out++] =
+            MUL_F(*pring_buffer_1++,  *pqmf_c_1++) +
+            MUL_F(*pring_buffer_2++,  *pqmf_c_2++) +
+            MUL_F(*pring_buffer_3++,  *pqmf_c_3++) +
+            MUL_F(*pring_buffer_4++,  *pqmf_c_4++) +
+            MUL_F(*pring_buffer_5++,  *pqmf_c_5++) +
+            MUL_F(*pring_buffer_6++,  *pqmf_c_6++) +
+            MUL_F(*pring_buffer_7++,  *pqmf_c_7++) +
+            MUL_F(*pring_buffer_8++,  *pqmf_c_8++) +
+            MUL_F(*pring_buffer_9++,  *pqmf_c_9++) +
+            MUL_F(*pring_buffer_10++, *pqmf_c_10++);
+#else // #ifdef PREFER_POINTERS
+        output[out++] =
+            MUL_F(pring_buffer_1[k+0],          qmf_c[k+0])   +
+            MUL_F(pring_buffer_1[k+192],        qmf_c[k+64])  +
+            MUL_F(pring_buffer_1[k+256],        qmf_c[k+128]) +
+            MUL_F(pring_buffer_1[k+(256+192)],  qmf_c[k+192]) +
+            MUL_F(pring_buffer_1[k+512],        qmf_c[k+256]) +
+            MUL_F(pring_buffer_1[k+(512+192)],  qmf_c[k+320]) +
+            MUL_F(pring_buffer_1[k+768],        qmf_c[k+384]) +
+            MUL_F(pring_buffer_1[k+(768+192)],  qmf_c[k+448]) +
+            MUL_F(pring_buffer_1[k+1024],       qmf_c[k+512]) +
+            MUL_F(pring_buffer_1[k+(1024+192)], qmf_c[k+576]);
+#endif // #ifdef PREFER_POINTERS
+    }
+}
+
+#ifdef FAAD_MXU
+static void qmfs_window_mxu(real_t *output, real_t *v)
+{
+    const real_t *c = qmf_c;
+    int16_t k;
+
+    for (k = 0; k < 64; k++)
+    {
+        S32MUL(xr1, xr2, v[0], c[0]);
+        S32MADD(xr1, xr2, v[192], c[64]);
+        S32MADD(xr1, xr2, v[256], c[128]);
+        S32MADD(xr1, xr2, v[256+192], c[192]);
+        S32MADD(xr1, xr2, v[512], c[256]);
+        S32MADD(xr1, xr2, v[512+192], c[320]);
+        S32MADD(xr1, xr2, v[768], c[384]);
+        S32MADD(xr1, xr2, v[768+192], c[448]);
+        S32MADD(xr1, xr2, v[1024], c[512]);
+        S32MADD(xr1, xr2, v[1024+192], c[576]);
+        output[k] = MXU_ACC_F();
+        v++;
+        c++;
+    }
+}
+#endif
+
 void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][64],
                           real_t *output)
 {
@@ -465,12 +587,6 @@ void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
 #ifdef PREFER_POINTERS
     // These pointers are used if target platform has autoinc address generators
     real_t * pring_buffer_2, * pring_buffer_4;
-    real_t * pring_buffer_5, * pring_buffer_6;
-    real_t * pring_buffer_7, * pring_buffer_8;
-    real_t * pring_buffer_9, * pring_buffer_10;
-    const real_t * pqmf_c_1, * pqmf_c_2, * pqmf_c_3, * pqmf_c_4;
-    const real_t * pqmf_c_5, * pqmf_c_6, * pqmf_c_7, * pqmf_c_8;
-    const real_t * pqmf_c_9, * pqmf_c_10;
 #endif // #ifdef PREFER_POINTERS
 #ifndef FIXED_POINT
     real_t scale = 1.f/64.f;
@@ -567,60 +683,13 @@ void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
             pring_buffer_1[127-(2*n+1)] = pring_buffer_3[127-(2*n+1)] = out_imag2[31-n] - out_imag1[31-n];
         }
 
-#endif // #ifdef PREFER_POINTERS
-
-        pring_buffer_1 = qmfs->v + qmfs->v_index;
-#ifdef PREFER_POINTERS
-        pring_buffer_2 = pring_buffer_1 + 192;
-        pring_buffer_3 = pring_buffer_1 + 256;
-        pring_buffer_4 = pring_buffer_1 + (256 + 192);
-        pring_buffer_5 = pring_buffer_1 + 512;
-        pring_buffer_6 = pring_buffer_1 + (512 + 192);
-        pring_buffer_7 = pring_buffer_1 + 768;
-        pring_buffer_8 = pring_buffer_1 + (768 + 192);
-        pring_buffer_9 = pring_buffer_1 + 1024;
-        pring_buffer_10 = pring_buffer_1 + (1024 + 192);
-        pqmf_c_1 = qmf_c;
-        pqmf_c_2 = qmf_c + 64;
-        pqmf_c_3 = qmf_c + 128;
-        pqmf_c_4 = qmf_c + 192;
-        pqmf_c_5 = qmf_c + 256;
-        pqmf_c_6 = qmf_c + 320;
-        pqmf_c_7 = qmf_c + 384;
-        pqmf_c_8 = qmf_c + 448;
-        pqmf_c_9 = qmf_c + 512;
-        pqmf_c_10 = qmf_c + 576;
 #endif // #ifdef PREFER_POINTERS
 
         /* calculate 64 output samples and window */
-        for (k = 0; k < 64; k++)
-        {
-#ifdef PREFER_POINTERS
-            output[out++] =
-                MUL_F(*pring_buffer_1++,  *pqmf_c_1++) +
-                MUL_F(*pring_buffer_2++,  *pqmf_c_2++) +
-                MUL_F(*pring_buffer_3++,  *pqmf_c_3++) +
-                MUL_F(*pring_buffer_4++,  *pqmf_c_4++) +
-                MUL_F(*pring_buffer_5++,  *pqmf_c_5++) +
-                MUL_F(*pring_buffer_6++,  *pqmf_c_6++) +
-                MUL_F(*pring_buffer_7++,  *pqmf_c_7++) +
-                MUL_F(*pring_buffer_8++,  *pqmf_c_8++) +
-                MUL_F(*pring_buffer_9++,  *pqmf_c_9++) +
-                MUL_F(*pring_buffer_10++, *pqmf_c_10++);
-#else // #ifdef PREFER_POINTERS
-            output[out++] =
-                MUL_F(pring_buffer_1[k+0],          qmf_c[k+0])   +
-                MUL_F(pring_buffer_1[k+192],        qmf_c[k+64])  +
-                MUL_F(pring_buffer_1[k+256],        qmf_c[k+128]) +
-                MUL_F(pring_buffer_1[k+(256+192)],  qmf_c[k+192]) +
-                MUL_F(pring_buffer_1[k+512],        qmf_c[k+256]) +
-                MUL_F(pring_buffer_1[k+(512+192)],  qmf_c[k+320]) +
-                MUL_F(pring_buffer_1[k+768],        qmf_c[k+384]) +
-                MUL_F(pring_buffer_1[k+(768+192)],  qmf_c[k+448]) +
-                MUL_F(pring_buffer_1[k+1024],       qmf_c[k+512]) +
-                MUL_F(pring_buffer_1[k+(1024+192)], qmf_c[k+576]);
-#endif // #ifdef PREFER_POINTERS
-        }
+        FAAD_KERNEL(MXU_BENCH_QMFS_WINDOW, NULL, 0, output + out, 64,
+            qmfs_window_c(output + out, qmfs->v + qmfs->v_index),
+            qmfs_window_mxu(output + out, qmfs->v + qmfs->v_index));
+        out += 64;
 
         /* update ringbuffer index */
         qmfs->v_index -= 128;
@@ -662,7 +662,8 @@ static av_cold void common_init(H264Context *h){
    }
    ////for android PREFETCHER_DEPACK_NAL...
 
-   if(h->sps.bitstream_restriction_flag && s->avctx->has_b_frames < h->sps.num_reorder_frames){
+   if(h->sps.bitstream_restriction_flag && s->avctx->has_b_frames < h->sps.num_reorder_frames
+      && !(avctx->flags & CODEC_FLAG_LOW_DELAY)){
      s->avctx->has_b_frames = h->sps.num_reorder_frames;
      s->low_delay = 0;
    }
@@ -2227,14 +2228,19 @@ static int decode_frame(AVCodecContext *avctx,
 
             /* Sort B-frames into display order */
 
-            if(h->sps.bitstream_restriction_flag
+            /* CODEC_FLAG_LOW_DELAY: the caller wants decode order, never
+               grow the reorder delay for it */
+            if(s->flags & CODEC_FLAG_LOW_DELAY)
+                { }
+            else if(h->sps.bitstream_restriction_flag
                && s->avctx->has_b_frames < h->sps.num_reorder_frames){
                 s->avctx->has_b_frames = h->sps.num_reorder_frames;
                 s->low_delay = 0;
             }
 
             if(   s->avctx->strict_std_compliance >= FF_COMPLIANCE_STRICT
-               && !h->sps.bitstream_restriction_flag){
+               && !h->sps.bitstream_restriction_flag
+               && !(s->flags & CODEC_FLAG_LOW_DELAY)){
                 s->avctx->has_b_frames= MAX_DELAYED_PIC_COUNT;
                 s->low_delay= 0;
             }
@@ -2259,7 +2265,9 @@ static int decode_frame(AVCodecContext *avctx,
                 h->outputed_poc= INT_MIN;
             out_of_order = out->poc < h->outputed_poc;
 
-            if(h->sps.bitstream_restriction_flag && s->avctx->has_b_frames >= h->sps.num_reorder_frames)
+            if(s->flags & CODEC_FLAG_LOW_DELAY)
+                { }
+            else if(h->sps.bitstream_restriction_flag && s->avctx->has_b_frames >= h->sps.num_reorder_frames)
                 { }
             else if((out_of_order && pics-1 == s->avctx->has_b_frames && s->avctx->has_b_frames < MAX_DELAYED_PIC_COUNT)
                || (s->low_delay &&
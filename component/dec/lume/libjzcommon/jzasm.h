@@ -88,6 +88,17 @@
   i_sync(); \
 }
 
+/* write back the dirty lines of [addr, addr + size) only, they stay valid */
+#define jz_dcache_wb_range(addr, size)		\
+{ \
+  unsigned int va = (unsigned int)(addr) & ~31; \
+  unsigned int end = (unsigned int)(addr) + (size); \
+  for(; va < end; va += 32) { \
+    i_dcache_hit_wb(va, 0); \
+  } \
+  i_sync(); \
+}
+
 #define i_clz(rs)				\
   __extension__( {				\
 	unsigned long __dst__ = 0;		\
@@ -106,6 +106,17 @@ typedef mad_fixed_t mad_sample_t;
 # define mad_f_add(x, y)	((x) + (y))
 # define mad_f_sub(x, y)	((x) - (y))
 
+/*
+ * The XBurst MXU kernels of layer12.c, layer3.c and synth.c are built for
+ * a JZ47xx (JZ4750_OPT from libjzcommon/com_config.h) unless MAD_NO_MXU
+ * is defined. They keep the full 64-bit products and truncate them like
+ * mad_f_scale64(), so they need FPM_MIPS: FPM_DEFAULT turns on OPT_SSO,
+ * whose D[] table and scaling they do not follow.
+ */
+# if defined(JZ4750_OPT) && defined(FPM_MIPS) && !defined(MAD_NO_MXU)
+#  define MAD_MXU
+# endif
+
 # if defined(FPM_FLOAT)
 #  error "FPM_FLOAT not yet supported"
 
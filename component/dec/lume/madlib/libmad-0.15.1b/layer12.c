@@ -487,7 +487,7 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
     for (sb = 0; sb < bound; ++sb) {
       for (ch = 0; ch < nch; ++ch) {
 	if ((index = allocation[ch][sb])) {
-#ifdef JZ4750_OPT
+#ifdef MAD_MXU
           mad_fixed_t sf_val;
           mad_fixed_t *sb_ptr;
           sb_ptr = &(frame->sbsample[ch][3*gr-1][sb]);
@@ -531,7 +531,7 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
 	II_samples(&stream->ptr, &qc_table[index], samples);
 
 	for (ch = 0; ch < nch; ++ch) {
-#ifdef JZ4750_OPT
+#ifdef MAD_MXU
           mad_fixed_t sf_val;
           mad_fixed_t *sb_ptr;
           sb_ptr = &(frame->sbsample[ch][3*gr-1][sb]);
@@ -931,7 +931,21 @@ mad_fixed_t III_requantize(unsigned int value, signed int exp)
       requantized <<= exp;
   }
 
+# if defined(MAD_MXU)
+  if (frac) {
+    /* mad_f_scale64(): hi << 4 | lo >> 28 */
+    S32MUL(xr1, xr2, requantized, root_table[3 + frac]);
+    D32SLL(xr1, xr1, xr0, xr0, 32 - MAD_F_SCALEBITS);
+    D32SLR(xr2, xr2, xr0, xr0, MAD_F_SCALEBITS / 2);
+    D32SLR(xr2, xr2, xr0, xr0, MAD_F_SCALEBITS / 2);
+    S32OR(xr1, xr1, xr2);
+    requantized = S32M2I(xr1);
+  }
+
+  return requantized;
+# else
   return frac ? mad_f_mul(requantized, root_table[3 + frac]) : requantized;
+# endif
 }
 
 /* we must take care that sz >= bits and sz < sizeof(long) lest bits == 0 */
@@ -1553,7 +1567,7 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
  * DESCRIPTION:	perform frequency line alias reduction
  */
 
-#if defined(JZ4750_OPT)
+#if defined(MAD_MXU)
 static
 void III_aliasreduce(mad_fixed_t xr[576], int lines)
 {
@@ -1592,7 +1606,7 @@ void III_aliasreduce(mad_fixed_t xr[576], int lines)
     }
   }
 }
-#else /* ! defined(JZ4750_OPT) */
+#else /* ! defined(MAD_MXU) */
 
 static
 void III_aliasreduce(mad_fixed_t xr[576], int lines)
@@ -1629,13 +1643,13 @@ void III_aliasreduce(mad_fixed_t xr[576], int lines)
   }
 }
 #endif
-/* ! defined(JZ4750_OPT) */
+/* ! defined(MAD_MXU) */
 
 # if defined(ASO_IMDCT)
 void III_imdct_l(mad_fixed_t const [18], mad_fixed_t [36], unsigned int);
 # else
 #  if 1
-#   if defined(JZ4750_OPT)
+#   if defined(MAD_MXU)
 static
 void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[18])
 {
@@ -1794,7 +1808,7 @@ void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[18])
   S32STD(xr9,y,56);
   S32STD(xr5,y,64);
 }
-#   else /* ! defined(JZ4750_OPT) */
+#   else /* ! defined(MAD_MXU) */
 
 static
 void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[18])
@@ -1864,8 +1878,8 @@ void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[18])
   y[16] = a22 + m7;
 }
 #   endif
-/* ! defined(JZ4750_OPT) */
-#   if defined(JZ4750_OPT)
+/* ! defined(MAD_MXU) */
+#   if defined(MAD_MXU)
 static inline
 void sdctII(mad_fixed_t const x[18], mad_fixed_t X[18])
 {
@@ -1935,7 +1949,7 @@ void sdctII(mad_fixed_t const x[18], mad_fixed_t X[18])
   }
 
 }
-#   else /* ! defined(JZ4750_OPT) */
+#   else /* ! defined(MAD_MXU) */
 static inline
 void sdctII(mad_fixed_t const x[18], mad_fixed_t X[18])
 {
@@ -1980,9 +1994,9 @@ void sdctII(mad_fixed_t const x[18], mad_fixed_t X[18])
     X[i + 6] -= X[(i + 6) - 2];
   }
 }
-#endif /* ! defined(JZ4750_OPT) */
+#endif /* ! defined(MAD_MXU) */
 
-#   if defined(JZ4750_OPT)
+#   if defined(MAD_MXU)
 static inline
 void dctIV(mad_fixed_t const y[18], mad_fixed_t X[18])
 {
@@ -2059,7 +2073,7 @@ void dctIV(mad_fixed_t const y[18], mad_fixed_t X[18])
   }
   X[17] = X[17] / 2 - X[16];
 }
-#   else /* ! defined(JZ4750_OPT) */
+#   else /* ! defined(MAD_MXU) */
 static inline
 void dctIV(mad_fixed_t const y[18], mad_fixed_t X[18])
 {
@@ -2100,7 +2114,7 @@ void dctIV(mad_fixed_t const y[18], mad_fixed_t X[18])
   X[17] = (X[17] >> 1) - X[16];
 
 }
-#endif /* ! defined(JZ4750_OPT) */
+#endif /* ! defined(MAD_MXU) */
 
 /*
  * NAME:	imdct36
@@ -2431,7 +2445,7 @@ void imdct36(mad_fixed_t const X[18], mad_fixed_t x[36])
  * NAME:	III_imdct_l()
  * DESCRIPTION:	perform IMDCT and windowing for long blocks
  */
-#   if defined(JZ4750_OPT)
+#   if defined(MAD_MXU)
 static
 void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
                  unsigned int block_type)
@@ -2580,7 +2594,7 @@ void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
     break;
   }
 }
-#   else /* ! defined(JZ4750_OPT) */
+#   else /* ! defined(MAD_MXU) */
 static
 void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
 		 unsigned int block_type)
@@ -2662,14 +2676,14 @@ void III_imdct_l(mad_fixed_t const X[18], mad_fixed_t z[36],
     break;
   }
 }
-#endif /* ! defined(JZ4750_OPT) */
+#endif /* ! defined(MAD_MXU) */
 # endif  /* ASO_IMDCT */
 
 /*
  * NAME:	III_imdct_s()
  * DESCRIPTION:	perform IMDCT and windowing for short blocks
  */
-#if defined(JZ4750_OPT)
+#if defined(MAD_MXU)
 static
 void III_imdct_s(mad_fixed_t const X[18], mad_fixed_t z[36])
 {
@@ -2755,7 +2769,7 @@ void III_imdct_s(mad_fixed_t const X[18], mad_fixed_t z[36])
     ++wptr;
   }
 }
-#else /* ! defined(JZ4750_OPT) */
+#else /* ! defined(MAD_MXU) */
  
 static
 void III_imdct_s(mad_fixed_t const X[18], mad_fixed_t z[36])
@@ -2831,7 +2845,7 @@ void III_imdct_s(mad_fixed_t const X[18], mad_fixed_t z[36])
     ++wptr;
   }
 }
-#endif/* ! defined(JZ4750_OPT) */
+#endif/* ! defined(MAD_MXU) */
 
 /*
  * NAME:	III_overlap()
@@ -3135,7 +3149,9 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
 #endif
 
   /* allocate Layer III dynamic structures */
+# if defined(MAD_MXU)
   S32I2M(xr16, 0x3);
+# endif
   if (stream->main_data == 0) {
     stream->main_data = malloc(MAD_BUFFER_MDLEN);
     if (stream->main_data == 0) {
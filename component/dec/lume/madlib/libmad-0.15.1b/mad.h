@@ -887,6 +887,8 @@ void mad_synth_mute(struct mad_synth *);
 
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
 
+unsigned int mad_synth_pcm16(struct mad_synth const *, signed short *);
+
 # endif
 
 /* Id: decoder.h,v 1.1 2007-12-18 07:31:37 zpxu Exp */
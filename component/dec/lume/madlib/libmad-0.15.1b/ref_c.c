@@ -0,0 +1,49 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * frame.c, layer12.c, layer3.c and synth.c once more without the MXU
+ * kernels, for mad_mxu_check (dec/audio/tests). Their public functions
+ * take a mad_c_ prefix so the test links them next to the MXU build of
+ * libstagefright_mad; the bit reader, stream and Huffman tables are
+ * shared. The decoder itself never links this file.
+ */
+
+# ifndef MAD_NO_MXU
+#  define MAD_NO_MXU
+# endif
+
+# define mad_header_init	mad_c_header_init
+# define mad_header_decode	mad_c_header_decode
+# define mad_frame_init		mad_c_frame_init
+# define mad_frame_finish	mad_c_frame_finish
+# define mad_frame_decode	mad_c_frame_decode
+# define mad_frame_mute		mad_c_frame_mute
+# define mad_layer_I		mad_c_layer_I
+# define mad_layer_II		mad_c_layer_II
+# define mad_layer_III		mad_c_layer_III
+# define mad_synth_init		mad_c_synth_init
+# define mad_synth_mute		mad_c_synth_mute
+# define mad_synth_frame	mad_c_synth_frame
+# define mad_synth_pcm16	mad_c_synth_pcm16
+
+# include "frame.c"
+# include "layer12.c"
+# include "layer3.c"
+# include "synth.c"
@@ -0,0 +1,49 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+# ifndef LIBMAD_REF_C_H
+# define LIBMAD_REF_C_H
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+/*
+ * The plain C build of the frame decoding and synthesis (ref_c.c), the
+ * reference mad_mxu_check times and compares the MXU kernels against.
+ * It decodes a stream of its own.
+ */
+
+struct mad_stream;
+struct mad_frame;
+struct mad_synth;
+
+void mad_c_frame_init(struct mad_frame *);
+void mad_c_frame_finish(struct mad_frame *);
+int mad_c_frame_decode(struct mad_frame *, struct mad_stream *);
+
+void mad_c_synth_init(struct mad_synth *);
+void mad_c_synth_frame(struct mad_synth *, struct mad_frame const *);
+unsigned int mad_c_synth_pcm16(struct mad_synth const *, signed short *);
+
+# ifdef __cplusplus
+}
+# endif
+
+# endif
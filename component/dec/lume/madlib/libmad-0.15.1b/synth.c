@@ -121,7 +121,7 @@ void mad_synth_mute(struct mad_synth *synth)
  * NAME:	dct32()
  * DESCRIPTION:	perform fast in[32]->out[32] DCT
  */
-#if defined(JZ4750_OPT)
+#if defined(MAD_MXU)
 static
 void dct32(mad_fixed_t const in[32], unsigned int slot,
            mad_fixed_t lo[16][8], mad_fixed_t hi[16][8])
@@ -1262,7 +1262,7 @@ void dct32(mad_fixed_t const in[32], unsigned int slot,
 
 }
 
-#else //JZ4750_OPT
+#else //MAD_MXU
 
 static
 void dct32(mad_fixed_t const in[32], unsigned int slot,
@@ -1655,7 +1655,7 @@ void dct32(mad_fixed_t const in[32], unsigned int slot,
    *  49 shifts (not counting SSO)
    */
 }
-#endif //JZ4750_OPT
+#endif //MAD_MXU
 
 # undef MUL
 # undef SHIFT
@@ -1701,7 +1701,7 @@ void synth_full(struct mad_synth *, struct mad_frame const *,
  * NAME:	synth->full()
  * DESCRIPTION:	perform full frequency PCM synthesis
  */
-#if defined(JZ4750_OPT)
+#if defined(MAD_MXU)
 static
 void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
                 unsigned int nch, unsigned int ns)
@@ -1834,7 +1834,7 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
     }
   }
 }
-#  else   //JZ4750_OPT
+#  else   //MAD_MXU
 
 static
 void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
@@ -1965,14 +1965,14 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
     }
   }
 }
-#endif //JZ4750_OPT
+#endif //MAD_MXU
 # endif
 
 /*
  * NAME:	synth->half()
  * DESCRIPTION:	perform half frequency PCM synthesis
  */
-#if defined(JZ4750_OPT)
+#if defined(MAD_MXU)
 static
 void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
                 unsigned int nch, unsigned int ns)
@@ -2256,7 +2256,7 @@ void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
   }
 }
 
-#else//JZ4750_OPT
+#else//MAD_MXU
 
 static
 void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
@@ -2389,7 +2389,7 @@ void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
     }
   }
 }
-#endif//JZ4750_OPT
+#endif//MAD_MXU
 
 /*
  * NAME:	synth->frame()
@@ -2421,3 +2421,95 @@ void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
 
   synth->phase = (synth->phase + ns) % 16;
 }
+
+/*
+ * NAME:	pcm16()
+ * DESCRIPTION:	round, clip and quantize one sample to 16 bits
+ */
+static inline
+signed short pcm16(mad_fixed_t sample)
+{
+  /* round */
+  sample += 1L << (MAD_F_FRACBITS - 16);
+
+  /* clip */
+  if (sample >= MAD_F_ONE)
+    sample = MAD_F_ONE - 1;
+  else if (sample < -MAD_F_ONE)
+    sample = -MAD_F_ONE;
+
+  /* quantize */
+  return sample >> (MAD_F_FRACBITS + 1 - 16);
+}
+
+/*
+ * NAME:	synth->pcm16()
+ * DESCRIPTION:	put out the synthesized PCM as interleaved 16-bit samples,
+ *		return the number of samples written
+ */
+unsigned int mad_synth_pcm16(struct mad_synth const *synth, signed short *out)
+{
+  struct mad_pcm const *pcm = &synth->pcm;
+  mad_fixed_t const *left, *right;
+  unsigned int n;
+
+  left  = pcm->samples[0];
+  right = pcm->samples[1];
+  n     = pcm->length;
+
+# if defined(MAD_MXU)
+  /* two samples per word store: the same rounding and clip as pcm16() */
+  if (((unsigned long) out & 3) == 0) {
+    unsigned int *dst = (unsigned int *) out - 1;
+
+    S32I2M(xr13, 1L << (MAD_F_FRACBITS - 16));
+    S32I2M(xr14, MAD_F_ONE - 1);
+    S32I2M(xr15, -MAD_F_ONE);
+    --left;
+    --right;
+
+    if (pcm->channels == 2) {
+      for (; n; --n) {
+	S32LDI(xr1, left, 4);
+	S32LDI(xr2, right, 4);
+	D32ASUM_AA(xr1, xr13, xr13, xr2);
+	S32MIN(xr1, xr1, xr14);
+	S32MIN(xr2, xr2, xr14);
+	S32MAX(xr1, xr1, xr15);
+	S32MAX(xr2, xr2, xr15);
+	D32SARL(xr3, xr2, xr1, MAD_F_FRACBITS + 1 - 16);
+	S32SDI(xr3, dst, 4);
+      }
+      return 2 * pcm->length;
+    }
+
+    for (; n >= 2; n -= 2) {
+      S32LDI(xr1, left, 4);
+      S32LDI(xr2, left, 4);
+      D32ASUM_AA(xr1, xr13, xr13, xr2);
+      S32MIN(xr1, xr1, xr14);
+      S32MIN(xr2, xr2, xr14);
+      S32MAX(xr1, xr1, xr15);
+      S32MAX(xr2, xr2, xr15);
+      D32SARL(xr3, xr2, xr1, MAD_F_FRACBITS + 1 - 16);
+      S32SDI(xr3, dst, 4);
+    }
+
+    out = (signed short *) (dst + 1);
+    ++left;
+  }
+# endif
+
+  if (pcm->channels == 2) {
+    while (n--) {
+      *out++ = pcm16(*left++);
+      *out++ = pcm16(*right++);
+    }
+    return 2 * pcm->length;
+  }
+
+  while (n--)
+    *out++ = pcm16(*left++);
+
+  return pcm->length;
+}
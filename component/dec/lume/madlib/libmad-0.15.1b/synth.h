@@ -66,4 +66,6 @@ void mad_synth_mute(struct mad_synth *);
 
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
 
+unsigned int mad_synth_pcm16(struct mad_synth const *, signed short *);
+
 # endif
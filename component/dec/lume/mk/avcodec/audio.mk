@@ -29,7 +29,8 @@ OBJS      := $(addprefix $(SUBDIR)/,$(OBJS))
 
 MY_SRC_FILES := $(OBJS:.o=.c)
 MY_SRC_FILES += lumecodecs.c \
-		../../libaf/reorder_ch.c
+		../../libaf/reorder_ch.c \
+		../../libaf/af_convert.c
 
 MXU-COMMON-SRC =$(sort $(MXU-COMMON) )
 LOCAL_SRC_FILES = $(MXU-COMMON-SRC)
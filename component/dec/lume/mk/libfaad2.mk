@@ -60,7 +60,27 @@ LOCAL_SRC_FILES = $(filter-out $(LOCAL_MXU_SRC_FILES),$(MY_SRC_FILES_SORT))
 LOCAL_MODULE := libstagefright_faad2
 JZC_CFG = $(LUME_PATH)/libjzcommon/com_config.h
 
-LOCAL_CFLAGS := $(PV_CFLAGS) -DHAVE_CONFIG_H -DHAVE_AV_CONFIG_H -ffunction-sections  -Wmissing-prototypes -Wundef -Wdisabled-optimization -Wno-pointer-sign -Wdeclaration-after-statement -std=gnu99 -Wall -Wno-switch -Wpointer-arith -Wredundant-decls -O2 -pipe -ffast-math -UNDEBUG -UDEBUG -fno-builtin -D_GNU_SOURCE -DFIXED_POINT -imacros $(JZC_CFG)
+# fixed-sbr: fixed point with SBR and PS decoding (HE-AAC v1/v2), the
+#            MXU kernels on JZ47xx (fixed_mxu.h)
+# fixed: fixed point AAC LC only, HE-AAC plays at half rate without SBR
+# float: the reference floating point decoder
+FAAD2_BACKEND ?= fixed-sbr
+# log the C and MXU kernel times side by side
+FAAD2_MXU_BENCH ?= false
+
+ifeq ($(FAAD2_BACKEND),float)
+FAAD2_CFLAGS :=
+else ifeq ($(FAAD2_BACKEND),fixed-sbr)
+FAAD2_CFLAGS := -DFIXED_POINT -DFIXED_POINT_SBR
+else
+FAAD2_CFLAGS := -DFIXED_POINT
+endif
+
+ifeq ($(FAAD2_MXU_BENCH),true)
+FAAD2_CFLAGS += -DFAAD_MXU_BENCH
+endif
+
+LOCAL_CFLAGS := $(PV_CFLAGS) -DHAVE_CONFIG_H -DHAVE_AV_CONFIG_H -ffunction-sections  -Wmissing-prototypes -Wundef -Wdisabled-optimization -Wno-pointer-sign -Wdeclaration-after-statement -std=gnu99 -Wall -Wno-switch -Wpointer-arith -Wredundant-decls -O2 -pipe -ffast-math -UNDEBUG -UDEBUG -fno-builtin -D_GNU_SOURCE $(FAAD2_CFLAGS) -imacros $(JZC_CFG)
 
 LOCAL_MXU_CFLAGS = $(LOCAL_CFLAGS)
 LOCAL_MXU_ASFLAGS = $(LOCAL_CFLAGS)
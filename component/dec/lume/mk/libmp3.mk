@@ -12,11 +12,23 @@ LUME_PATH := $(LUME_TOP)
 MLOCAL_SRC_FILES := version.c fixed.c bit.c timer.c stream.c frame.c  \
 			synth.c decoder.c layer12.c layer3.c huffman.c 
 
-JZC_CFG = jzconfig.h
+JZC_CFG = $(LUME_PATH)/libjzcommon/com_config.h
+
+# the MXU synthesis, IMDCT and requantisation on JZ47xx (MAD_MXU in
+# fixed.h), false builds the plain C decoder. mad_mxu_check in
+# dec/audio/tests decodes with both and fails on any difference.
+MAD_MXU ?= true
+
+ifeq ($(MAD_MXU),true)
+MAD_CFLAGS :=
+else
+MAD_CFLAGS := -DMAD_NO_MXU
+endif
+
 LOCAL_SRC_FILES := $(addprefix $(MPTOP),$(MLOCAL_SRC_FILES)) 
 LOCAL_MODULE := libstagefright_mad
 
-LOCAL_CFLAGS := $(PV_CFLAGS) -ffunction-sections  -Wmissing-prototypes -Wundef -Wdisabled-optimization -Wno-pointer-sign -Wdeclaration-after-statement -std=gnu99 -Wall -Wno-switch -Wpointer-arith -Wredundant-decls -O2 -pipe -ffast-math -UNDEBUG -UDEBUG -fno-builtin -DAUDIO_CODEC -D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64 -D_LARGEFILE64_SOURCE -DHAVE_CONFIG_H -D__LINUX__  -D_REENTRANT -D_LITTLE_ENDIAN=1 -fomit-frame-pointer -DFPM_DEFAULT -imacros $(JZC_CFG)
+LOCAL_CFLAGS := $(PV_CFLAGS) -ffunction-sections  -Wmissing-prototypes -Wundef -Wdisabled-optimization -Wno-pointer-sign -Wdeclaration-after-statement -std=gnu99 -Wall -Wno-switch -Wpointer-arith -Wredundant-decls -O2 -pipe -ffast-math -UNDEBUG -UDEBUG -fno-builtin -DAUDIO_CODEC -D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64 -D_LARGEFILE64_SOURCE -DHAVE_CONFIG_H -D__LINUX__  -D_REENTRANT -D_LITTLE_ENDIAN=1 -fomit-frame-pointer -DFPM_MIPS -DHAVE_MADD_ASM $(MAD_CFLAGS) -imacros $(JZC_CFG)
 
 
 LOCAL_STATIC_LIBRARIES := 
@@ -0,0 +1,37 @@
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+MPTOP := ../tremor/
+LUME_PATH := $(LUME_TOP)
+
+MLOCAL_SRC_FILES := bitwise.c block.c codebook.c floor0.c floor1.c framing.c \
+			info.c mapping0.c mdct.c registry.c res012.c sharedbook.c \
+			synthesis.c window.c
+
+LOCAL_SRC_FILES := $(addprefix $(MPTOP),$(MLOCAL_SRC_FILES))
+LOCAL_MODULE := libstagefright_tremor
+JZC_CFG = $(LUME_PATH)/libjzcommon/com_config.h
+
+# the MXU wide math and residue unpacking on JZ47xx (asm_mxu.h), false
+# builds the plain C integer decoder
+TREMOR_MXU ?= true
+
+ifeq ($(TREMOR_MXU),true)
+TREMOR_CFLAGS :=
+else
+TREMOR_CFLAGS := -DTREMOR_NO_MXU
+endif
+
+LOCAL_CFLAGS := $(PV_CFLAGS) -DHAVE_CONFIG_H -ffunction-sections -Wundef -Wdisabled-optimization -Wno-pointer-sign -std=gnu99 -Wall -Wno-switch -Wpointer-arith -O2 -pipe -UNDEBUG -UDEBUG -fno-builtin -D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64 -D_LARGEFILE64_SOURCE -D_REENTRANT -DHAVE_ALLOCA_H -fomit-frame-pointer $(TREMOR_CFLAGS) -imacros $(JZC_CFG)
+
+LOCAL_STATIC_LIBRARIES :=
+
+LOCAL_SHARED_LIBRARIES :=
+
+LOCAL_C_INCLUDES := \
+	$(LUME_PATH)/tremor  \
+	$(LUME_PATH)  \
+	$(LUME_PATH)/libavutil \
+	$(PV_INCLUDES)
+
+include $(BUILD_STATIC_LIBRARY)
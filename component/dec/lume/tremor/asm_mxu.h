@@ -0,0 +1,165 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis 'TREMOR' CODEC SOURCE CODE.   *
+ *                                                                  *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis 'TREMOR' SOURCE CODE IS (C) COPYRIGHT 1994-2002    *
+ * BY THE Xiph.Org FOUNDATION http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: XBurst MXU wide math functions
+
+ The MXU versions are picked when building for a JZ47xx (JZ4750_OPT
+ from libjzcommon/com_config.h) unless TREMOR_NO_MXU is defined. Like
+ the arm7 ones, the cross products sum both 64 bit products in the
+ xr1:xr2 accumulator before they take the high word, where the C code
+ truncates each product: results differ by an LSB or two.
+
+ ********************************************************************/
+
+#if defined(JZ4750_OPT) && !defined(TREMOR_NO_MXU)
+#define TREMOR_MXU
+#endif
+
+#ifdef TREMOR_MXU
+
+#include "../libjzcommon/jzmedia.h"
+
+#if !defined(_V_WIDE_MATH) && !defined(_LOW_ACCURACY_)
+#define _V_WIDE_MATH
+
+static inline ogg_int32_t MULT32(ogg_int32_t x, ogg_int32_t y) {
+  S32MUL(xr1, xr2, x, y);
+  return S32M2I(xr1);
+}
+
+static inline ogg_int32_t MULT31(ogg_int32_t x, ogg_int32_t y) {
+  return MULT32(x,y)<<1;
+}
+
+static inline ogg_int32_t MULT31_SHIFT15(ogg_int32_t x, ogg_int32_t y) {
+  ogg_int32_t hi;
+  ogg_uint32_t lo;
+  S32MUL(xr1, xr2, x, y);
+  hi = S32M2I(xr1);
+  lo = S32M2I(xr2);
+  return (lo>>15) | (hi<<17);
+}
+
+/* the MXU instructions are volatile asm, the compiler keeps their order */
+#define MB()
+
+static inline void XPROD32(ogg_int32_t  a, ogg_int32_t  b,
+			   ogg_int32_t  t, ogg_int32_t  v,
+			   ogg_int32_t *x, ogg_int32_t *y)
+{
+  ogg_int32_t x1;
+  S32MUL(xr1, xr2, a, t);
+  S32MADD(xr1, xr2, b, v);
+  x1 = S32M2I(xr1);
+  S32MUL(xr1, xr2, b, t);
+  S32MSUB(xr1, xr2, a, v);
+  *x = x1;
+  *y = S32M2I(xr1);
+}
+
+static inline void XPROD31(ogg_int32_t  a, ogg_int32_t  b,
+			   ogg_int32_t  t, ogg_int32_t  v,
+			   ogg_int32_t *x, ogg_int32_t *y)
+{
+  ogg_int32_t x1;
+  S32MUL(xr1, xr2, a, t);
+  S32MADD(xr1, xr2, b, v);
+  x1 = S32M2I(xr1);
+  S32MUL(xr1, xr2, b, t);
+  S32MSUB(xr1, xr2, a, v);
+  *x = x1 << 1;
+  *y = S32M2I(xr1) << 1;
+}
+
+static inline void XNPROD31(ogg_int32_t  a, ogg_int32_t  b,
+			    ogg_int32_t  t, ogg_int32_t  v,
+			    ogg_int32_t *x, ogg_int32_t *y)
+{
+  ogg_int32_t x1;
+  S32MUL(xr1, xr2, a, t);
+  S32MSUB(xr1, xr2, b, v);
+  x1 = S32M2I(xr1);
+  S32MUL(xr1, xr2, b, t);
+  S32MADD(xr1, xr2, a, v);
+  *x = x1 << 1;
+  *y = S32M2I(xr1) << 1;
+}
+
+#endif
+
+/*
+ * Residue unpacking: a[j]+=t[j]>>shift for an even n, a left shift for
+ * a negative one. Two words are loaded, shifted and added per step.
+ */
+static inline void mxu_add_shifted(ogg_int32_t *a, const ogg_int32_t *t,
+				   int n, int shift)
+{
+  int j;
+  if(shift>=0){
+    for(j=0;j<n;j+=2,a+=2,t+=2){
+      S32LDD(xr1, t, 0);
+      S32LDD(xr2, t, 4);
+      S32LDD(xr3, a, 0);
+      S32LDD(xr4, a, 4);
+      D32SARV(xr1, xr2, shift);
+      D32ASUM_AA(xr3, xr1, xr2, xr4);
+      S32STD(xr3, a, 0);
+      S32STD(xr4, a, 4);
+    }
+  }else{
+    shift=-shift;
+    for(j=0;j<n;j+=2,a+=2,t+=2){
+      S32LDD(xr1, t, 0);
+      S32LDD(xr2, t, 4);
+      S32LDD(xr3, a, 0);
+      S32LDD(xr4, a, 4);
+      D32SLLV(xr1, xr2, shift);
+      D32ASUM_AA(xr3, xr1, xr2, xr4);
+      S32STD(xr3, a, 0);
+      S32STD(xr4, a, 4);
+    }
+  }
+}
+
+/* The same for stereo residue 2: even words of t to a0, odd ones to a1. */
+static inline void mxu_add_shifted2(ogg_int32_t *a0, ogg_int32_t *a1,
+				    const ogg_int32_t *t, int n, int shift)
+{
+  int j;
+  if(shift>=0){
+    for(j=0;j<n;j+=2,a0++,a1++,t+=2){
+      S32LDD(xr1, t, 0);
+      S32LDD(xr2, t, 4);
+      S32LDD(xr3, a0, 0);
+      S32LDD(xr4, a1, 0);
+      D32SARV(xr1, xr2, shift);
+      D32ASUM_AA(xr3, xr1, xr2, xr4);
+      S32STD(xr3, a0, 0);
+      S32STD(xr4, a1, 0);
+    }
+  }else{
+    shift=-shift;
+    for(j=0;j<n;j+=2,a0++,a1++,t+=2){
+      S32LDD(xr1, t, 0);
+      S32LDD(xr2, t, 4);
+      S32LDD(xr3, a0, 0);
+      S32LDD(xr4, a1, 0);
+      D32SLLV(xr1, xr2, shift);
+      D32ASUM_AA(xr3, xr1, xr2, xr4);
+      S32STD(xr3, a0, 0);
+      S32STD(xr4, a1, 0);
+    }
+  }
+}
+
+#endif
@@ -256,6 +256,17 @@ long vorbis_book_decodev_add(codebook *book,ogg_int32_t *a,
   ogg_int32_t *t;
   int shift=point-book->binarypoint;
 
+#ifdef TREMOR_MXU
+  if(!(book->dim&1)){
+    for(i=0;i<n;i+=book->dim){
+      entry = decode_packed_entry_number(book,b);
+      if(entry==-1)return(-1);
+      mxu_add_shifted(a+i,book->valuelist+entry*book->dim,book->dim,shift);
+    }
+    return(0);
+  }
+#endif
+
   if(shift>=0){
     for(i=0;i<n;){
       entry = decode_packed_entry_number(book,b);
@@ -313,6 +324,19 @@ long vorbis_book_decodevv_add(codebook *book,ogg_int32_t **a,\
   int chptr=0;
   int shift=point-book->binarypoint;
 
+#ifdef TREMOR_MXU
+  /* stereo with an even dim: every entry ends on the second channel */
+  if(ch==2 && !(book->dim&1)){
+    for(i=offset;i<offset+n;i+=book->dim>>1){
+      entry = decode_packed_entry_number(book,b);
+      if(entry==-1)return(-1);
+      mxu_add_shifted2(a[0]+i,a[1]+i,book->valuelist+entry*book->dim,
+		       book->dim,shift);
+    }
+    return(0);
+  }
+#endif
+
   if(shift>=0){
 
     for(i=offset;i<offset+n;){
@@ -22,6 +22,7 @@
 #include "os_types.h"
 
 #include "asm_arm.h"
+#include "asm_mxu.h"
 
 #ifndef _V_WIDE_MATH
 #define _V_WIDE_MATH
@@ -21,6 +21,7 @@
 #include "HWDec.h"
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/IOMX.h>
@@ -31,6 +32,9 @@
 #include <LUMEDefs.h>
 #include <HardwareAPI.h>
 #include <ui/GraphicBufferMapper.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
 #include "HardwareRenderer_FrameBuffer.h"
 extern "C"{
 #include "stream.h"
@@ -38,6 +42,8 @@ extern "C"{
 #include "stheader.h"
 }
 
+// file HWDec appends one "pts latency" line per output picture to, in us
+#define PROP_VIDEO_LATENCY_FILE      "media.lume.videolatency"
 
 using namespace android;
 
@@ -53,7 +59,8 @@ extern "C" {
 		       OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
 		       OMX_U8** aInputBuf, OMX_U32* aInBufSize,
 		       OMX_PARAM_PORTDEFINITIONTYPE* aPortParam,
-		       OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_BOOL *aResizeFlag);
+		       OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_U32 aDropLevel,
+		       OMX_BOOL *aResizeFlag);
 }
 
 namespace android {
@@ -115,10 +122,34 @@ HWDec::HWDec(
       mOutputPortSettingsChange(NONE),
       mRenderer(NULL),
       mVContextNeedFree(false),
-      mDecInited(false){
+      mDecInited(false),
+      mDecoding(false),
+      mDecodePaused(false),
+      mDecodeExit(false),
+      mDecodeFlushing(false),
+      mSeekPending(false),
+      mCopyWindowStartUs(0),
+      mCopyWindowBytes(0),
+      mDecoderThreads(1),
+      mLowLatency(false),
+      mClockValid(false),
+      mClockMediaUs(0),
+      mClockRealUs(0),
+      mDropLevel(DROP_NONE),
+      mDropRecover(0),
+      mStarvedDecodes(0),
+      mDecodeAhead(kDefaultDecodeAhead),
+      mPendingUnheld(false),
+      mDrained(false),
+      mResizePending(false),
+      mResizeWidth(0),
+      mResizeHeight(0){
   ALOGV("HWDec construct");
+    memset(&mDecodeStats, 0, sizeof(mDecodeStats));
+    InitOMXParams(&mDecodeStats);
+    mDecodeStats.nPortIndex = kOutputPortIndex;
+    property_get(PROP_VIDEO_LATENCY_FILE, mLatencyFile, "");
     initPorts();
-    mOutputBuf = (PlanarImage *)malloc(sizeof(PlanarImage));
     //CHECK_EQ(initDecoder(), (status_t)OK);
   ALOGV("HWDec construct out");
 }
@@ -126,6 +157,8 @@ HWDec::HWDec(
 HWDec::~HWDec() {
   ALOGV("~HWDec ");
 
+  stopDecodeThread();
+
   /**/
   if(mVideoDecoder){
     delete mVideoDecoder;
@@ -153,11 +186,6 @@ HWDec::~HWDec() {
       delete vContext;
       vContext = NULL;
     }
-
-    if(mOutputBuf){
-      free(mOutputBuf);
-      mOutputBuf = NULL;
-    }
   ALOGV("~HWDec out");
 }
 
@@ -237,6 +265,11 @@ status_t HWDec::initDecoder() {
   mVideoDecoder = CreateLUMESoftVideoDecoder();//(VideoDecorder*)fnc();
   CHECK(mVideoDecoder);
 
+  mVideoDecoder->SetThreadCount(mDecoderThreads);
+  mVideoDecoder->SetLowLatency(mLowLatency ? OMX_TRUE : OMX_FALSE);
+  // The renderer takes every frame in the VPU's tiled layout.
+  mVideoDecoder->SetTiledOutput(getRenderer() != NULL ? OMX_TRUE : OMX_FALSE);
+
   /**/
   if(DecInit(mVideoDecoder) != OMX_ErrorNone)
     return OMX_ErrorUndefined;
@@ -331,6 +364,46 @@ OMX_ERRORTYPE HWDec::internalGetParameter(
             return OMX_ErrorNone;
         }
 
+        case OMX_IndexParamLumeDecoderThreads:
+        {
+            OMX_PARAM_LUME_DECODERTHREADSTYPE *threadParams =
+                (OMX_PARAM_LUME_DECODERTHREADSTYPE *)params;
+
+            if (threadParams->nPortIndex != kInputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            threadParams->nThreadCount = mDecoderThreads;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeDecodeAhead:
+        {
+            OMX_PARAM_LUME_DECODEAHEADTYPE *aheadParams =
+                (OMX_PARAM_LUME_DECODEAHEADTYPE *)params;
+
+            if (aheadParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mDecodeLock);
+            aheadParams->nDecodeAhead = mDecodeAhead;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeLowLatency:
+        {
+            OMX_PARAM_LUME_LOWLATENCYTYPE *latencyParams =
+                (OMX_PARAM_LUME_LOWLATENCYTYPE *)params;
+
+            if (latencyParams->nPortIndex != kInputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            latencyParams->bEnable = mLowLatency ? OMX_TRUE : OMX_FALSE;
+            return OMX_ErrorNone;
+        }
+
         case OMX_IndexParamVideoProfileLevelQuerySupported:
         {
             OMX_VIDEO_PARAM_PROFILELEVELTYPE *profileLevel =
@@ -358,6 +431,18 @@ OMX_ERRORTYPE HWDec::internalGetParameter(
     }
 }
 
+bool HWDec::isSetParameterAllowed(
+        OMX_INDEXTYPE index, const OMX_PTR params) const {
+    switch ((int)index) {
+        // Takes effect at the decode thread's next picture.
+        case OMX_IndexParamLumeDecodeAhead:
+            return true;
+
+        default:
+            return SimpleHardOMXComponent::isSetParameterAllowed(index, params);
+    }
+}
+
 OMX_ERRORTYPE HWDec::internalSetParameter(
         OMX_INDEXTYPE index, const OMX_PTR params) {
   ALOGV("internalSetParameter in index = %x, %x ",index, OMX_IndexParamStandardComponentRole);
@@ -370,6 +455,7 @@ OMX_ERRORTYPE HWDec::internalSetParameter(
 	             && pANBParams->enable == OMX_TRUE) {
 	      OMX_PARAM_PORTDEFINITIONTYPE *def = &editPortInfo(pANBParams->nPortIndex)->mDef;
 	      def->format.video.eColorFormat = (OMX_COLOR_FORMATTYPE) HAL_PIXEL_FORMAT_RGBA_8888;
+	      Mutex::Autolock autoLock(mRendererLock);
 	      if(mRenderer == NULL)
 		mRenderer = new HardwareRenderer_FrameBuffer(def->format.video);
 	    }
@@ -423,6 +509,67 @@ OMX_ERRORTYPE HWDec::internalSetParameter(
 
             return OMX_ErrorNone;
         }
+
+        case OMX_IndexParamLumeDecoderThreads:
+        {
+            const OMX_PARAM_LUME_DECODERTHREADSTYPE *threadParams =
+                (const OMX_PARAM_LUME_DECODERTHREADSTYPE *)params;
+
+            if (threadParams->nPortIndex != kInputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            mDecoderThreads = threadParams->nThreadCount;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeDecodeAhead:
+        {
+            const OMX_PARAM_LUME_DECODEAHEADTYPE *aheadParams =
+                (const OMX_PARAM_LUME_DECODEAHEADTYPE *)params;
+
+            if (aheadParams->nPortIndex != kOutputPortIndex
+                    || aheadParams->nDecodeAhead > kMaxDecodeAhead) {
+                return OMX_ErrorBadParameter;
+            }
+
+            Mutex::Autolock autoLock(mDecodeLock);
+            mDecodeAhead = aheadParams->nDecodeAhead;
+            mDecodeCondition.signal();
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexParamLumeLowLatency:
+        {
+            const OMX_PARAM_LUME_LOWLATENCYTYPE *latencyParams =
+                (const OMX_PARAM_LUME_LOWLATENCYTYPE *)params;
+
+            if (latencyParams->nPortIndex != kInputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+            // The decoder is opened with it on the first buffer.
+            if (mDecInited) {
+                return OMX_ErrorIncorrectStateOperation;
+            }
+
+            mLowLatency = latencyParams->bEnable == OMX_TRUE;
+
+            OMX_PARAM_PORTDEFINITIONTYPE *inDef =
+                &editPortInfo(kInputPortIndex)->mDef;
+            OMX_PARAM_PORTDEFINITIONTYPE *outDef =
+                &editPortInfo(kOutputPortIndex)->mDef;
+            inDef->nBufferCountMin =
+                mLowLatency ? kNumLowLatencyInputBuffers : kNumInputBuffers;
+            inDef->nBufferCountActual = inDef->nBufferCountMin;
+            outDef->nBufferCountMin =
+                mLowLatency ? kNumLowLatencyOutputBuffers : kNumOutputBuffers;
+            outDef->nBufferCountActual = outDef->nBufferCountMin;
+
+            // A picture goes out as soon as it is decoded.
+            Mutex::Autolock autoLock(mDecodeLock);
+            mDecodeAhead = mLowLatency ? 0 : kDefaultDecodeAhead;
+            return OMX_ErrorNone;
+        }
 #if 1
 	/*add by gysun : get w*h from ACodec.cpp*/
         case OMX_IndexParamPortDefinition:
@@ -457,15 +604,130 @@ OMX_ERRORTYPE HWDec::getConfig(
             return OMX_ErrorNone;
         }
 
+        case OMX_IndexConfigLumeVideoDecStats:
+        {
+            OMX_CONFIG_LUME_VIDEODECSTATSTYPE *statsParams =
+                (OMX_CONFIG_LUME_VIDEODECSTATSTYPE *)params;
+
+            if (statsParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mDecodeLock);
+            memcpy(statsParams, &mDecodeStats, sizeof(mDecodeStats));
+            statsParams->nPortIndex = kOutputPortIndex;
+
+            return OMX_ErrorNone;
+        }
+
         default:
             return OMX_ErrorUnsupportedIndex;
     }
 }
-#if 1
+
+OMX_ERRORTYPE HWDec::setConfig(
+        OMX_INDEXTYPE index, const OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexConfigLumeMediaClock:
+        {
+            const OMX_TIME_CONFIG_TIMESTAMPTYPE *clockParams =
+                (const OMX_TIME_CONFIG_TIMESTAMPTYPE *)params;
+
+            if (clockParams->nPortIndex != kOutputPortIndex) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mDecodeLock);
+            mClockMediaUs = clockParams->nTimestamp;
+            mClockRealUs = ALooper::GetNowUs();
+            mClockValid = true;
+
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_ERRORTYPE HWDec::allocateBuffer(
+        OMX_BUFFERHEADERTYPE **header,
+        OMX_U32 portIndex,
+        OMX_PTR appPrivate,
+        OMX_U32 size) {
+  if (portIndex != kInputPortIndex) {
+    return SimpleHardOMXComponent::allocateBuffer(
+        header, portIndex, appPrivate, size);
+  }
+
+  // The tail past nAllocLen is the zero padding the bitstream readers
+  // may run into.
+  OMX_U8 *ptr = (OMX_U8 *)mInputMem.vpu_mem_alloc(
+      size + FF_INPUT_BUFFER_PADDING_SIZE);
+  if (ptr == NULL) {
+    return OMX_ErrorInsufficientResources;
+  }
+
+  OMX_ERRORTYPE err = useBuffer(header, portIndex, appPrivate, size, ptr);
+  if (err != OMX_ErrorNone) {
+    mInputMem.vpu_mem_free(ptr);
+    return err;
+  }
+
+  Mutex::Autolock autoLock(mInputMemLock);
+  mVpuInputBuffers.add(*header, ptr);
+
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE HWDec::freeBuffer(
+        OMX_U32 portIndex,
+        OMX_BUFFERHEADERTYPE *header) {
+  OMX_U8 *vpuPtr = NULL;
+
+  if (portIndex == kInputPortIndex) {
+    Mutex::Autolock autoLock(mInputMemLock);
+    ssize_t index = mVpuInputBuffers.indexOfKey(header);
+    if (index >= 0) {
+      vpuPtr = mVpuInputBuffers.valueAt(index);
+      mVpuInputBuffers.removeItemsAt(index);
+    }
+  }
+
+  // The renderer keeps each native buffer dmmu mapped, drop the mapping
+  // with the buffer instead of leaving it for the next port disable.
+  sp<HardwareRenderer> renderer = getRenderer();
+  if (portIndex == kOutputPortIndex && renderer != NULL) {
+    renderer->releaseBuffer((buffer_handle_t)header->pBuffer);
+  }
+
+  OMX_ERRORTYPE err = SimpleHardOMXComponent::freeBuffer(portIndex, header);
+
+  if (vpuPtr != NULL) {
+    mInputMem.vpu_mem_free(vpuPtr);
+  }
+
+  return err;
+}
+
+// mRenderer is replaced on the looper while freeBuffer runs on the
+// client's thread, take a reference under the lock.
+sp<HardwareRenderer> HWDec::getRenderer() {
+  Mutex::Autolock autoLock(mRendererLock);
+  return mRenderer;
+}
+
+bool HWDec::isVpuInputBuffer(OMX_BUFFERHEADERTYPE *header) {
+  Mutex::Autolock autoLock(mInputMemLock);
+  return mVpuInputBuffers.indexOfKey(header) >= 0;
+}
+
 void HWDec::onQueueFilled(OMX_U32 portIndex) {
   if(!mDecInited){
     ALOGE("onQueueFilled initDecoder");
     status_t ret = initDecoder();
+    if(ret == OK)
+      ret = startDecodeThread();
     if(ret != OK){
       ALOGE("Failed to initdecoder!!!");
       notify(OMX_EventError, OMX_ErrorUndefined, ret, NULL);
@@ -474,6 +736,8 @@ void HWDec::onQueueFilled(OMX_U32 portIndex) {
     mDecInited = true;
   }
 
+  processDecodedJobs();
+
   if (mOutputPortSettingsChange != NONE) {
     return;
   }
@@ -484,161 +748,495 @@ void HWDec::onQueueFilled(OMX_U32 portIndex) {
 
   List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
   List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-  //    H264SwDecRet ret = H264SWDEC_PIC_RDY;
-  status_t err = OK;
-  bool portSettingsChanged = false;
-  while ((mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
-	 && !outQueue.empty()) {
-
-    if (mEOSStatus == INPUT_EOS_SEEN) {
-      drainAllOutputBuffers();
-      return;
-    }
 
+  Mutex::Autolock autoLock(mDecodeLock);
+  bool queued = false;
+  while (mEOSStatus == INPUT_DATA_AVAILABLE && !inQueue.empty()
+	 && mDecodeInQueue.size() < kMaxDecodeInputDepth) {
     BufferInfo *inInfo = *inQueue.begin();
-    OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+    inQueue.erase(inQueue.begin());
     ++mPicId;
-    if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-      inQueue.erase(inQueue.begin());
-      inInfo->mOwnedByUs = false;
-      notifyEmptyBufferDone(inHeader);
+
+    if (inInfo->mHeader->nFlags & OMX_BUFFERFLAG_EOS) {
       mEOSStatus = INPUT_EOS_SEEN;
-      continue;
+    } else {
+      mInputTakenUs.add(inInfo->mHeader->nTimeStamp, ALooper::GetNowUs());
+      if (mInputTakenUs.size() > kMaxLatencyInputs) {
+	mInputTakenUs.removeItemsAt(0);
+      }
     }
+    mDecodeInQueue.push_back(inInfo);
+    queued = true;
+  }
 
-    OMX_BUFFERHEADERTYPE *header = new OMX_BUFFERHEADERTYPE;
-    memset(header, 0, sizeof(OMX_BUFFERHEADERTYPE));
-    header->nTimeStamp = inHeader->nTimeStamp;
-    header->nFlags = inHeader->nFlags;
-    
-    inQueue.erase(inQueue.begin());
-    //	OMX_U8 outBuf[1280*1280];
-    OMX_U32 outLength = 0;
-    OMX_U8 * pStream = inHeader->pBuffer + inHeader->nOffset;
-    OMX_U32 inLength = inHeader->nFilledLen;
-    OMX_BOOL drop_frame = OMX_FALSE;
-    OMX_S32 frameCount = 0;
-    OMX_PARAM_PORTDEFINITIONTYPE PortParam;
-    PortParam.format.video.nFrameWidth = mCropWidth;
-    PortParam.format.video.nFrameHeight = mCropHeight;
-
-    /**/
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-    BufferInfo *outInfo = *outQueue.begin();
-    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
-    OMX_U8 *outBuf = outHeader->pBuffer + outHeader->nOffset;
-    ////
-    uint64_t mPts = inHeader->nTimeStamp; 
-    if(mRenderer != NULL)
-      outBuf = (OMX_U8*)mOutputBuf;
+  while (!outQueue.empty()) {
+    mDecodeOutQueue.push_back(*outQueue.begin());
+    outQueue.erase(outQueue.begin());
+    queued = true;
+  }
+
+  updateQueueStatsLocked();
+  if (mDecodeStats.nInputQueueDepth > mDecodeStats.nMaxInputQueueDepth) {
+    mDecodeStats.nMaxInputQueueDepth = mDecodeStats.nInputQueueDepth;
+  }
+
+  if (queued) {
+    mDecodeCondition.signal();
+  }
+}
+
+status_t HWDec::startDecodeThread() {
+  {
+    Mutex::Autolock autoLock(mDecodeLock);
+    mDecodeExit = false;
+    mDecodePaused = false;
+  }
+
+  mDecodeThread = new DecodeThread(this);
+  status_t err = mDecodeThread->run("HWDecDecode", ANDROID_PRIORITY_FOREGROUND);
+  if (err != OK) {
+    mDecodeThread.clear();
+  }
+  return err;
+}
+
+void HWDec::stopDecodeThread() {
+  if (mDecodeThread == NULL) {
+    return;
+  }
+
+  {
+    Mutex::Autolock autoLock(mDecodeLock);
+    mDecodeExit = true;
+    mDecodeCondition.signal();
+  }
+
+  mDecodeThread->requestExitAndWait();
+  mDecodeThread.clear();
+}
+
+bool HWDec::canOutputLocked() {
+  if (mDecodeOutQueue.empty()) {
+    return false;
+  }
+  return !mPendingPictures.empty() || (mDrained && !mDecodeInQueue.empty());
+}
+
+bool HWDec::canDecodeLocked() {
+  if (mResizePending || mDrained || mPendingUnheld || mDecodeInQueue.empty()) {
+    return false;
+  }
+  // Each free output buffer takes one pending picture, mDecodeAhead more
+  // may wait for the client to return buffers.
+  return mPendingPictures.size() < mDecodeOutQueue.size() + mDecodeAhead;
+}
+
+void HWDec::updateQueueStatsLocked() {
+  mDecodeStats.nInputQueueDepth = mDecodeInQueue.size();
+  mDecodeStats.nOutputQueueDepth = mDecodeOutQueue.size();
+  mDecodeStats.nPendingPictures = mPendingPictures.size();
+  if (mDecodeStats.nPendingPictures > mDecodeStats.nMaxPendingPictures) {
+    mDecodeStats.nMaxPendingPictures = mDecodeStats.nPendingPictures;
+  }
+}
+
+bool HWDec::decodeLoop() {
+  Mutex::Autolock autoLock(mDecodeLock);
+
+  bool resizeReady = mResizePending && mPendingPictures.empty();
+  if (!mDecodeExit && !mDecodePaused && !mDecodeFlushing && !resizeReady
+      && !canOutputLocked() && !canDecodeLocked()) {
+    if (mDecodeInQueue.empty()) {
+      ++mDecodeStats.nInputStalls;
+    } else {
+      ++mDecodeStats.nOutputStalls;
+    }
+  }
+
+  while (!mDecodeExit
+	 && (mDecodePaused || mDecodeFlushing
+	     || (!(mResizePending && mPendingPictures.empty())
+		 && !canOutputLocked() && !canDecodeLocked()))) {
+    mDecodeCondition.wait(mDecodeLock);
+  }
+
+  if (mDecodeExit) {
+    return false;
+  }
+
+  DecodeJob job;
+  job.mInInfo = NULL;
+  job.mOutInfo = NULL;
+  job.mResized = false;
+  job.mErr = OK;
+
+  if (mResizePending && mPendingPictures.empty()) {
+    // Everything decoded at the old size is out, reconfigure the port.
+    job.mResized = true;
+    job.mNewWidth = mResizeWidth;
+    job.mNewHeight = mResizeHeight;
+    mResizePending = false;
+    mDecodePaused = true;
+  } else if (canOutputLocked()) {
+    job.mOutInfo = *mDecodeOutQueue.begin();
+    mDecodeOutQueue.erase(mDecodeOutQueue.begin());
+    OMX_BUFFERHEADERTYPE *outHeader = job.mOutInfo->mHeader;
+
+    if (mPendingPictures.empty()) {
+      // The decoder gave up its last delayed picture, finish the stream.
+      job.mInInfo = *mDecodeInQueue.begin();
+      mDecodeInQueue.erase(mDecodeInQueue.begin());
+      mDrained = false;
+
+      outHeader->nTimeStamp = 0;
+      outHeader->nFilledLen = 0;
+      outHeader->nFlags = OMX_BUFFERFLAG_EOS;
+    } else {
+      PendingPicture pic = *mPendingPictures.begin();
+      mPendingPictures.erase(mPendingPictures.begin());
+      if (!pic.mHeld) {
+	mPendingUnheld = false;
+      }
+
+      mDecoding = true;
+      mDecodeLock.unlock();
+      outputPicture(&pic, outHeader);
+      mDecodeLock.lock();
+      mDecoding = false;
+    }
+  } else {
+    BufferInfo *inInfo = *mDecodeInQueue.begin();
+    OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+    bool drain = (inHeader->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+    bool seek = mSeekPending;
+    mSeekPending = false;
+
+    // The backlog counts the input about to be decoded, so it is taken
+    // before that input leaves the queue.
+    OMX_U32 dropLevel = DROP_NONE;
+    if (!drain) {
+      dropLevel = updateDropLevelLocked(inHeader->nTimeStamp,
+					ALooper::GetNowUs(),
+					mDecodeInQueue.size());
+    }
+
+    // An EOS input stays at the head until every delayed picture is out.
+    if (!drain) {
+      mDecodeInQueue.erase(mDecodeInQueue.begin());
+      job.mInInfo = inInfo;
+    }
+
+    mDecoding = true;
+    mDecodeLock.unlock();
+
+    PendingPicture pic;
+    int64_t startUs = ALooper::GetNowUs();
+    bool gotPicture = decodePicture(inHeader, drain, seek, dropLevel, &pic, &job);
+    int64_t nowUs = ALooper::GetNowUs();
+    uint64_t copied = mVideoDecoder->GetBytesCopied();
+    OMX_U32 reorderDepth = mVideoDecoder->GetReorderDepth();
+
+    mDecodeLock.lock();
+    mDecoding = false;
+
+    mDecodeStats.nDecodeTimeUs += nowUs - startUs;
+    mDecodeStats.nReorderDepth = reorderDepth;
+    mDecodeStats.nInputBytesCopied = copied;
+    if (mCopyWindowStartUs == 0) {
+      mCopyWindowStartUs = nowUs;
+      mCopyWindowBytes = copied;
+    } else if (nowUs - mCopyWindowStartUs >= 1000000ll) {
+      mDecodeStats.nInputBytesCopiedPerSec =
+	(OMX_U32)((copied - mCopyWindowBytes) * 1000000ll
+		  / (nowUs - mCopyWindowStartUs));
+      mCopyWindowStartUs = nowUs;
+      mCopyWindowBytes = copied;
+    }
+
+    if (dropLevel >= DROP_LOOP_FILTER) {
+      ++mDecodeStats.nLoopFilterSkips;
+    }
+    if (!gotPicture && dropLevel >= DROP_NONREF && job.mErr == OK) {
+      ++mDecodeStats.nFramesDropped;
+    }
+
+    if (gotPicture) {
+      ++mDecodeStats.nFramesDecoded;
+      mPendingPictures.push_back(pic);
+      if (!pic.mHeld) {
+	// The frame is only valid until the next decode call.
+	mPendingUnheld = true;
+      }
+    } else if (drain) {
+      mDrained = true;
+    }
+
+    if (job.mResized) {
+      mResizePending = true;
+      mResizeWidth = job.mNewWidth;
+      mResizeHeight = job.mNewHeight;
+      job.mResized = false;
+    }
+  }
+
+  if (job.mInInfo != NULL || job.mOutInfo != NULL || job.mResized
+      || job.mErr != OK) {
+    mDecodeDoneQueue.push_back(job);
+    postQueueFilled(kOutputPortIndex);
+  }
+  updateQueueStatsLocked();
+  mDecodeIdleCondition.broadcast();
+
+  return true;
+}
+
+/*
+ * Pick how much work the next decode may skip. With a media clock the
+ * input pts is compared with the extrapolated presentation time; without
+ * one, a full input queue while the client waits on free output buffers
+ * means the decoder cannot keep up, which is only worth skipping the
+ * deblocking. Raising the level is immediate, it comes down one step
+ * after kDropRecoverFrames decodes that would not need it.
+ */
+OMX_U32 HWDec::updateDropLevelLocked(int64_t ptsUs, int64_t nowUs,
+				     size_t inDepth) {
+  OMX_U32 target = DROP_NONE;
+
+  if (mClockValid && nowUs - mClockRealUs > kMediaClockStaleUs) {
+    // Paused or the client stopped feeding the clock.
+    mClockValid = false;
+  }
+
+  if (mClockValid) {
+    int64_t latenessUs = mClockMediaUs + (nowUs - mClockRealUs) - ptsUs;
+    mDecodeStats.nLatenessUs = latenessUs;
+
+    if (latenessUs > kDropNonKeyLateUs) {
+      target = DROP_NONKEY;
+    } else if (latenessUs > kDropNonRefLateUs) {
+      target = DROP_NONREF;
+    } else if (latenessUs > kDropLoopFilterLateUs) {
+      target = DROP_LOOP_FILTER;
+    }
+  } else {
+    mDecodeStats.nLatenessUs = 0;
+  }
+
+  if (inDepth >= kMaxDecodeInputDepth && mDecodeOutQueue.size() > 1) {
+    ++mStarvedDecodes;
+  } else {
+    mStarvedDecodes = 0;
+  }
+  if (mStarvedDecodes >= kDropRecoverFrames && target < DROP_LOOP_FILTER) {
+    target = DROP_LOOP_FILTER;
+  }
+
+  if (target >= mDropLevel) {
+    mDropLevel = target;
+    mDropRecover = 0;
+  } else if (++mDropRecover >= kDropRecoverFrames) {
+    --mDropLevel;
+    mDropRecover = 0;
+  }
+
+  mDecodeStats.nDropLevel = mDropLevel;
+  if (mDropLevel > mDecodeStats.nMaxDropLevel) {
+    mDecodeStats.nMaxDropLevel = mDropLevel;
+  }
+  return mDropLevel;
+}
+
+bool HWDec::decodePicture(OMX_BUFFERHEADERTYPE *inHeader, bool drain, bool seek,
+			  OMX_U32 dropLevel, PendingPicture *pic, DecodeJob *job) {
+  OMX_U32 outLength = 0;
+  OMX_U8 * pStream = NULL;
+  OMX_U32 inLength = 0;
+  OMX_BOOL resized = OMX_FALSE;
+  OMX_S32 frameCount = 0;
+  OMX_PARAM_PORTDEFINITIONTYPE PortParam;
+  PortParam.format.video.nFrameWidth = mCropWidth;
+  PortParam.format.video.nFrameHeight = mCropHeight;
+
+  if (drain) {
+    // No data asks the decoder for the pictures it still holds back.
+    mVideoDecoder->SetInputMapped(OMX_FALSE);
+    mVideoDecoder->shContext->seekFlag = 0;
+  } else {
+    pStream = inHeader->pBuffer + inHeader->nOffset;
+    inLength = inHeader->nFilledLen;
+    mVideoDecoder->SetInputMapped(
+	isVpuInputBuffer(inHeader) ? OMX_TRUE : OMX_FALSE);
     mVideoDecoder->shContext->pts=((double)inHeader->nTimeStamp)/1000000.0;
-    if(header->nFlags & OMX_BUFFERFLAG_SEEKFLAG)
+    if((inHeader->nFlags & OMX_BUFFERFLAG_SEEKFLAG) || seek)
       mVideoDecoder->shContext->seekFlag = 1;
     else
       mVideoDecoder->shContext->seekFlag = 0;
-    OMX_BOOL ret = DecodeVideo(mVideoDecoder,
-      			       (OMX_U8*)outBuf,
-      			       (OMX_U32*)&outLength,		 
-      			       (OMX_U8**)(&pStream),
-      			       &inLength,
-      			       &PortParam,
-      			       &frameCount,
-      			       (OMX_BOOL)1,
-      			       &drop_frame);
-    mPts=((PlanarImage*)outBuf)->pts;
-    //ALOGE("mPts:%lld", mPts);
-    if(ret == OMX_TRUE){
-      if (((int)PortParam.format.video.nFrameWidth != mCropWidth )
-	  || ((int)PortParam.format.video.nFrameHeight != mCropHeight)) {
-	ALOGE("w h changed (%d * %d)!!",
-	     (int)PortParam.format.video.nFrameWidth,(int)PortParam.format.video.nFrameHeight);
-
-	mWidth  = (int)PortParam.format.video.nFrameWidth;
-	mHeight = (int)PortParam.format.video.nFrameHeight;
-	mPictureSize = mWidth * mHeight * 3 / 2;
-	mCropWidth = mWidth;
-	mCropHeight = mHeight;
-	updatePortDefinitions();
-	notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-	mOutputPortSettingsChange = AWAITING_DISABLED;		  
-	portSettingsChanged = true;
-
-	//
-	notify(OMX_EventPortSettingsChanged, 1,
-	       OMX_IndexConfigCommonOutputCrop, NULL);
-
-	if(mRenderer != NULL){
-	  mRenderer.clear();
-	  mRenderer = new HardwareRenderer_FrameBuffer(PortParam.format.video);
-	}
-      }else if (outLength == 0){
-	ALOGV("decode failed ,try next mpts = %lld",mPts);
-	inInfo->mOwnedByUs = false;
-	notifyEmptyBufferDone(inHeader);
-	return;
-      }else if (mRenderer != NULL){
-	RenderData rdata;
-	//rdata.input = const_cast<void*>(mOutputBuf);//damn ugly.
-	rdata.input = mOutputBuf;//damn ugly.
-	rdata.inputSize = outLength;
-	rdata.platformPrivate = NULL;
-	//rdata.state = state;
-	rdata.needReinit = false;
-	rdata.bufferHandle = (buffer_handle_t) outHeader->pBuffer;
-	  
-	mRenderer->render(&rdata);
-      }
-    }else{
-      ALOGV("H264 video decode failed !!");
-      err = ERROR_MALFORMED;
+  }
+
+  OMX_BOOL ret = DecodeVideo(mVideoDecoder,
+			     (OMX_U8*)&pic->mImage,
+			     (OMX_U32*)&outLength,
+			     (OMX_U8**)(&pStream),
+			     &inLength,
+			     &PortParam,
+			     &frameCount,
+			     (OMX_BOOL)1,
+			     dropLevel,
+			     &resized);
+  if(ret != OMX_TRUE){
+    ALOGV("H264 video decode failed !!");
+    if (!drain) {
+      job->mErr = ERROR_MALFORMED;
     }
-	  
-    inInfo->mOwnedByUs = false;
-    notifyEmptyBufferDone(inHeader);
+    return false;
+  }
 
-    if (portSettingsChanged) {
-      portSettingsChanged = false;
+  if (((int)PortParam.format.video.nFrameWidth != mCropWidth )
+      || ((int)PortParam.format.video.nFrameHeight != mCropHeight)) {
+    ALOGE("w h changed (%d * %d)!!",
+	  (int)PortParam.format.video.nFrameWidth,(int)PortParam.format.video.nFrameHeight);
+    job->mResized = true;
+    job->mNewWidth = PortParam.format.video.nFrameWidth;
+    job->mNewHeight = PortParam.format.video.nFrameHeight;
+    return false;
+  }
 
-      return;
+  if (outLength == 0){
+    ALOGV("decode failed ,try next mpts = %lld",inHeader->nTimeStamp);
+    return false;
+  }
+
+  pic->mLength = outLength;
+  pic->mFlags = inHeader->nFlags & ~OMX_BUFFERFLAG_EOS;
+  pic->mHeld = mVideoDecoder->HoldFrame(&pic->mImage) == OMX_TRUE;
+  return true;
+}
+
+void HWDec::outputPicture(PendingPicture *pic, OMX_BUFFERHEADERTYPE *outHeader) {
+  sp<HardwareRenderer> renderer = getRenderer();
+  if (renderer != NULL){
+    RenderData rdata;
+    rdata.input = &pic->mImage;
+    rdata.inputSize = pic->mLength;
+    rdata.platformPrivate = NULL;
+    rdata.needReinit = false;
+    rdata.bufferHandle = (buffer_handle_t) outHeader->pBuffer;
+
+    renderer->render(&rdata);
+  } else {
+    memcpy(outHeader->pBuffer + outHeader->nOffset,
+	   &pic->mImage, sizeof(PlanarImage));
+  }
+
+  mVideoDecoder->FrameDisplayed(&pic->mImage);
+  if (pic->mHeld) {
+    mVideoDecoder->ReleaseFrame(&pic->mImage);
+  }
+
+  outHeader->nTimeStamp = pic->mImage.pts;
+  outHeader->nFlags = pic->mFlags;
+  outHeader->nFilledLen = mPictureSize;
+}
+
+void HWDec::dropPendingPicturesLocked() {
+  while (!mPendingPictures.empty()) {
+    PendingPicture &pic = *mPendingPictures.begin();
+    if (pic.mHeld) {
+      mVideoDecoder->ReleaseFrame(&pic.mImage);
+    }
+    mPendingPictures.erase(mPendingPictures.begin());
+  }
+  mPendingUnheld = false;
+}
+
+void HWDec::processDecodedJobs() {
+  List<DecodeJob> done;
+  {
+    Mutex::Autolock autoLock(mDecodeLock);
+    while (!mDecodeDoneQueue.empty()) {
+      done.push_back(*mDecodeDoneQueue.begin());
+      mDecodeDoneQueue.erase(mDecodeDoneQueue.begin());
     }
+  }
 
-    if (mFirstPicture && !outQueue.empty()) {
-      drainOneOutputBuffer(mFirstPictureId, mFirstPicture);
-      delete[] mFirstPicture;
-      mFirstPicture = NULL;
-      mFirstPictureId = -1;
-    }else{
-      //            drainOneOutputBuffer(mPicId, (uint8_t*)outBuf);
-      /*drain a frame */
-      outQueue.erase(outQueue.begin());
-#if 0
-      OMX_BUFFERHEADERTYPE *header = mPicToHeaderMap.valueFor(mPicId);
-      uint64_t mPts = inHeader->nTimeStamp; 
-      int index=0;
-      for(int i = 0; i< mPicToHeaderMap.size();i++){
-	if((mPicToHeaderMap.valueAt(i))->nTimeStamp <= mPts){
-	  header = mPicToHeaderMap.valueAt(i);
-	  mPts = header->nTimeStamp;
-	  index = i;
-	}
+  while (!done.empty()) {
+    DecodeJob job = *done.begin();
+    done.erase(done.begin());
+
+    if (job.mInInfo != NULL) {
+      job.mInInfo->mOwnedByUs = false;
+      notifyEmptyBufferDone(job.mInInfo->mHeader);
+    }
+
+    if (job.mResized) {
+      // The decode thread stays paused until the output port is back.
+      mWidth  = job.mNewWidth;
+      mHeight = job.mNewHeight;
+      mPictureSize = mWidth * mHeight * 3 / 2;
+      mCropWidth = mWidth;
+      mCropHeight = mHeight;
+      updatePortDefinitions();
+      notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
+      mOutputPortSettingsChange = AWAITING_DISABLED;
+
+      notify(OMX_EventPortSettingsChanged, 1,
+	     OMX_IndexConfigCommonOutputCrop, NULL);
+
+      if(getRenderer() != NULL){
+	sp<HardwareRenderer> renderer = new HardwareRenderer_FrameBuffer(
+		editPortInfo(kOutputPortIndex)->mDef.format.video);
+	Mutex::Autolock autoLock(mRendererLock);
+	mRenderer = renderer;
       }
-#endif
-      //ALOGE("mPts=%lld",mPts);
-      outHeader->nTimeStamp = mPts;
-      outHeader->nFlags = header->nFlags;
-      outHeader->nFilledLen = mPictureSize;
+    }
 
-      outInfo->mOwnedByUs = false;
-      notifyFillBufferDone(outHeader);
+    if (job.mOutInfo != NULL) {
+      if (job.mOutInfo->mHeader->nFlags & OMX_BUFFERFLAG_EOS) {
+	mEOSStatus = OUTPUT_FRAMES_FLUSHED;
+      }
+      job.mOutInfo->mOwnedByUs = false;
+      noteOutputLatency(job.mOutInfo->mHeader);
+      notifyFillBufferDone(job.mOutInfo->mHeader);
     }
 
-    if (err != OK) {
-      notify(OMX_EventError, OMX_ErrorUndefined, err, NULL);
+    if (job.mErr != OK) {
+      notify(OMX_EventError, OMX_ErrorUndefined, job.mErr, NULL);
     }
   }
 }
-#else
-#endif
+
+void HWDec::noteOutputLatency(const OMX_BUFFERHEADERTYPE *outHeader) {
+  if (outHeader->nFilledLen == 0) {
+    return;
+  }
+  ssize_t index = mInputTakenUs.indexOfKey(outHeader->nTimeStamp);
+  if (index < 0) {
+    return;
+  }
+  OMX_U32 latencyUs = ALooper::GetNowUs() - mInputTakenUs.valueAt(index);
+  mInputTakenUs.removeItemsAt(index);
+
+  {
+    Mutex::Autolock autoLock(mDecodeLock);
+    ++mDecodeStats.nLatencyFrames;
+    mDecodeStats.nLastLatencyUs = latencyUs;
+    if (latencyUs > mDecodeStats.nMaxLatencyUs) {
+      mDecodeStats.nMaxLatencyUs = latencyUs;
+    }
+    mDecodeStats.nTotalLatencyUs += latencyUs;
+  }
+
+  if (mLatencyFile[0]) {
+    FILE *fp = fopen(mLatencyFile, "a");
+    if (!fp) {
+      ALOGW("can not append video latency to %s: %s", mLatencyFile, strerror(errno));
+      mLatencyFile[0] = '\0';
+      return;
+    }
+    fprintf(fp, "%lld %u\n", (long long)outHeader->nTimeStamp, (unsigned)latencyUs);
+    fclose(fp);
+  }
+}
 
 #if 0
 bool HWDec::handlePortSettingChangeEvent(const H264SwDecInfo *info) {
@@ -705,72 +1303,59 @@ void HWDec::drainOneOutputBuffer(int32_t picId, uint8_t* data) {
     notifyFillBufferDone(outHeader);
 }
 
-bool HWDec::drainAllOutputBuffers() {
-  ALOGV("drainAllOutputBuffers in");
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-    ALOGV("outQueue.size = %d",outQueue.size());
-#if 1 
-    for(int i = 0;i< (outQueue.size()-1);i++){
-      BufferInfo *outInfo = *outQueue.begin();
-      outQueue.erase(outQueue.begin());
+void HWDec::onPortFlushPrepare(OMX_U32 portIndex) {
+    if (mDecodeThread == NULL) {
+        return;
     }
-    /*last*/
-    BufferInfo *outInfo = *outQueue.begin();
-    outQueue.erase(outQueue.begin());
-    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
-
-    outHeader->nTimeStamp = 0;
-    outHeader->nFilledLen = 0;
-    outHeader->nFlags = OMX_BUFFERFLAG_EOS;
-    mEOSStatus = OUTPUT_FRAMES_FLUSHED;
 
-    outInfo->mOwnedByUs = false;
-    notifyFillBufferDone(outHeader);
-#else
-    H264SwDecPicture decodedPicture;
-    while (!outQueue.empty()) {
-        BufferInfo *outInfo = *outQueue.begin();
-        outQueue.erase(outQueue.begin());
-        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
-        if (mHeadersDecoded &&
-            H264SWDEC_PIC_RDY ==
-                H264SwDecNextPicture(mHandle, &decodedPicture, 1 /* flush */)) {
-
-            int32_t picId = decodedPicture.picId;
-            CHECK(mPicToHeaderMap.indexOfKey(picId) >= 0);
-
-            memcpy(outHeader->pBuffer + outHeader->nOffset,
-                decodedPicture.pOutputPicture,
-                mPictureSize);
-
-            OMX_BUFFERHEADERTYPE *header = mPicToHeaderMap.valueFor(picId);
-            outHeader->nTimeStamp = header->nTimeStamp;
-            outHeader->nFlags = header->nFlags;
-            outHeader->nFilledLen = mPictureSize;
-            mPicToHeaderMap.removeItem(picId);
-            delete header;
-        } else {
-            outHeader->nTimeStamp = 0;
-            outHeader->nFilledLen = 0;
-            outHeader->nFlags = OMX_BUFFERFLAG_EOS;
-            mEOSStatus = OUTPUT_FRAMES_FLUSHED;
+    // Let the frame in flight finish and keep the thread from starting
+    // another one while the port's buffers are taken back.
+    {
+        Mutex::Autolock autoLock(mDecodeLock);
+        mDecodeFlushing = true;
+        while (mDecoding) {
+            mDecodeIdleCondition.wait(mDecodeLock);
         }
+    }
+
+    processDecodedJobs();
 
-        outInfo->mOwnedByUs = false;
-        notifyFillBufferDone(outHeader);
+    Mutex::Autolock autoLock(mDecodeLock);
+    if (portIndex == kInputPortIndex) {
+        mDecodeInQueue.clear();
+        mDrained = false;
+        // The clock jumps with a seek, wait for the client's next update.
+        mClockValid = false;
+        mDropLevel = DROP_NONE;
+        mDropRecover = 0;
+        mStarvedDecodes = 0;
+        // Pictures decoded ahead belong to the stream position being left.
+        dropPendingPicturesLocked();
+    } else {
+        mDecodeOutQueue.clear();
     }
-#endif
-    return true;
+    updateQueueStatsLocked();
+    mDecodeFlushing = false;
+    mDecodeCondition.signal();
 }
 
 void HWDec::onPortFlushCompleted(OMX_U32 portIndex) {
     if (portIndex == kInputPortIndex) {
         mEOSStatus = INPUT_DATA_AVAILABLE;
-	mVideoDecoder->shContext->seekFlag = 1;
+        mInputTakenUs.clear();
+
+        Mutex::Autolock autoLock(mDecodeLock);
+        mSeekPending = true;
     }
 }
 
 void HWDec::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
+    sp<HardwareRenderer> renderer = getRenderer();
+    if (portIndex == kOutputPortIndex && !enabled && renderer != NULL) {
+        // The native buffers are gone, drop their mappings.
+        renderer->releaseBuffers();
+    }
+
     switch (mOutputPortSettingsChange) {
         case NONE:
             break;
@@ -787,6 +1372,10 @@ void HWDec::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
             CHECK_EQ((int)mOutputPortSettingsChange, (int)AWAITING_ENABLED);
             CHECK(enabled);
             mOutputPortSettingsChange = NONE;
+
+            Mutex::Autolock autoLock(mDecodeLock);
+            mDecodePaused = false;
+            mDecodeCondition.signal();
             break;
         }
     }
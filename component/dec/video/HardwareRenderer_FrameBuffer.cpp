@@ -129,6 +129,8 @@ HardwareRenderer_FrameBuffer::HardwareRenderer_FrameBuffer(const OMX_VIDEO_PORTD
   
 HardwareRenderer_FrameBuffer::~HardwareRenderer_FrameBuffer() 
 {  
+  releaseBuffers();
+
   if (mIPUHandler) {
     mIPU_inited = false;
     ipu_close(&mIPUHandler);
@@ -136,22 +138,59 @@ HardwareRenderer_FrameBuffer::~HardwareRenderer_FrameBuffer()
   }    
 }
   
-void HardwareRenderer_FrameBuffer::initIPUDestBuffer(void* data/*, struct VideoWindowState *state*/)
+bool HardwareRenderer_FrameBuffer::mapDestBuffer(buffer_handle_t handle, void *vaddr)
+{
+  Mutex::Autolock autoLock(mMapLock);
+  ssize_t index = mMappedBuffers.indexOfKey(handle);
+  if (index >= 0) {
+    if (mMappedBuffers.valueAt(index).vaddr == vaddr)
+      return true;
+
+    //gralloc handed out a different mapping for this handle, start over.
+    dmmu_unmap_user_memory(&mMappedBuffers.editValueAt(index));
+    mMappedBuffers.removeItemsAt(index);
+  }
+
+  dmmu_mem_info info;
+  memset(&info, 0, sizeof(dmmu_mem_info));
+  info.vaddr = vaddr;
+  info.size = mBuffer_Height * mBuffer_Width * mBytesPerDstPixel;
+
+  int ret = dmmu_map_user_memory(&info);
+  if (ret < 0) {
+    ALOGE("ERROR: !!!!dst dmmu_map_user_memory failed!\n");
+    return false;
+  }
+
+  mMappedBuffers.add(handle, info);
+  return true;
+}
 
+void HardwareRenderer_FrameBuffer::releaseBuffer(buffer_handle_t handle)
 {
-  {//demmu map the dst.
-    memset(&dst_mem_info, 0, sizeof(dmmu_mem_info));
-    dst_mem_info.vaddr = data;
-    dst_mem_info.size = mBuffer_Height * mBuffer_Width * mBytesPerDstPixel;
-    
-    int ret = dmmu_map_user_memory(&dst_mem_info);
-    if (ret < 0) {
-      ALOGE("ERROR: !!!!dst dmmu_map_user_memory failed!\n");
-      memset(&dst_mem_info, 0, sizeof(dmmu_mem_info));
-      return;
-    }
+  Mutex::Autolock autoLock(mMapLock);
+  ssize_t index = mMappedBuffers.indexOfKey(handle);
+  if (index < 0)
+    return;
+
+  if (dmmu_unmap_user_memory(&mMappedBuffers.editValueAt(index)) < 0)
+    ALOGE("ERROR: !!!!dst dmmu_unmap_user_memory failed!\n");
+  mMappedBuffers.removeItemsAt(index);
+}
+
+void HardwareRenderer_FrameBuffer::releaseBuffers()
+{
+  Mutex::Autolock autoLock(mMapLock);
+  for (size_t i = 0; i < mMappedBuffers.size(); i++) {
+    if (dmmu_unmap_user_memory(&mMappedBuffers.editValueAt(i)) < 0)
+      ALOGE("ERROR: !!!!dst dmmu_unmap_user_memory failed!\n");
   }
+  mMappedBuffers.clear();
+}
 
+void HardwareRenderer_FrameBuffer::initIPUDestBuffer(void* data/*, struct VideoWindowState *state*/)
+
+{
   struct dest_data_info *dst = &mIPUHandler->dst_info;
   unsigned int output_mode;
   struct ipu_data_buffer *dstBuf = &dst->dstBuf;
@@ -285,6 +324,11 @@ void HardwareRenderer_FrameBuffer::render(RenderData* data)
 
   initIPUSourceBuffer(data->input, mWidth, mHeight, mCropLeft, mCropTop, mCropRight, mCropBottom);
   
+  if (!mapDestBuffer(bufferHandle, dst)) {
+    CHECK_EQ(0, mapper.unlock(bufferHandle));
+    return;
+  }
+
   initIPUDestBuffer(dst/*, (data->state)*/);
     
   if (mIPU_inited == false) {
@@ -298,16 +342,8 @@ void HardwareRenderer_FrameBuffer::render(RenderData* data)
   
   ipu_postBuffer(mIPUHandler);
 
-  {//clean up the mapped dmmu mem. but still it looks ok even without it...
+  {//clean up the mapped src dmmu mem, dst stays mapped until releaseBuffers().
     int ret;
-    
-    if(dst_mem_info.vaddr != NULL){
-      ret = dmmu_unmap_user_memory(&dst_mem_info);//memset 0 at init is the best to cover all the other data members of dst_mem_info.
-      if (ret < 0) {
-	ALOGE("ERROR: !!!!dst dmmu_unmap_user_memory failed!\n");
-	return;
-      }
-    }
 
     if(!mUseJzBuf && src_mem_info.vaddr != NULL){
       ret = dmmu_unmap_user_memory(&src_mem_info);
@@ -19,9 +19,13 @@
 #define HARD_AVC_H_
 
 #include "SimpleHardOMXComponent.h"
+#include <cutils/properties.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/threads.h>
 
 #include "basetype.h"
+#include "HardOMXVendorExt.h"
 #include "HardwareRenderer.h"
 #include "lume_dec.h"
 #include "PlanarImage.h"
@@ -62,9 +66,26 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    virtual bool isSetParameterAllowed(
+            OMX_INDEXTYPE index, const OMX_PTR params) const;
+
     virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
 
+    virtual OMX_ERRORTYPE setConfig(
+            OMX_INDEXTYPE index, const OMX_PTR params);
+
+    virtual OMX_ERRORTYPE allocateBuffer(
+            OMX_BUFFERHEADERTYPE **header,
+            OMX_U32 portIndex,
+            OMX_PTR appPrivate,
+            OMX_U32 size);
+
+    virtual OMX_ERRORTYPE freeBuffer(
+            OMX_U32 portIndex,
+            OMX_BUFFERHEADERTYPE *header);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
 
@@ -89,6 +110,36 @@ private:
         //kNumOutputBuffers = 2,
 	//kNumInputBuffers = 4,
 	kNumOutputBuffers = 16,
+        // Most input buffers handed to the decode thread at a time, the
+        // rest stay on the port queue until the thread catches up.
+        kMaxDecodeInputDepth = 4,
+        // Pictures the decode thread may keep ahead of the free output
+        // buffers, so reordering streams do not stall on the client.
+        kMaxDecodeAhead = 4,
+        kDefaultDecodeAhead = 2,
+        // Port buffers in low latency mode, each one queued is a frame
+        // of delay.
+        kNumLowLatencyInputBuffers = 4,
+        kNumLowLatencyOutputBuffers = 4,
+        // Input lateness against the media clock that raises the drop
+        // level, and the decodes below a level it takes to lower it.
+        kDropLoopFilterLateUs = 40000,
+        kDropNonRefLateUs = 80000,
+        kDropNonKeyLateUs = 250000,
+        kDropRecoverFrames = 8,
+        kMediaClockStaleUs = 1000000,
+        // Input timestamps remembered for the latency stats; outputs the
+        // decoder drops leave theirs behind until this many are newer.
+        kMaxLatencyInputs = 64,
+    };
+
+    // Work the drop controller gives up, in the order it escalates.
+    // DecodeVideo takes the level as its aDropLevel argument.
+    enum DropLevel {
+        DROP_NONE,
+        DROP_LOOP_FILTER,  // skip deblocking
+        DROP_NONREF,       // skip non-reference frames
+        DROP_NONKEY,       // decode key frames only
     };
 
     enum EOSStatus {
@@ -127,18 +178,105 @@ private:
     void initPorts();
     status_t initDecoder();
     void updatePortDefinitions();
-    bool drainAllOutputBuffers();
     void drainOneOutputBuffer(int32_t picId, uint8_t *data);
     void saveFirstOutputBuffer(int32_t pidId, uint8_t *data);
     bool handleCropRectEvent(const CropParams* crop);
+
+    // The decoder runs on its own thread so the looper (and with it
+    // getParameter, getState and buffer returns) never waits for a frame.
+    // The looper only moves buffers into mDecodeInQueue/mDecodeOutQueue
+    // and hands finished jobs back to the client.
+    struct DecodeThread : public Thread {
+        DecodeThread(HWDec *dec) : Thread(false), mDec(dec) {}
+        virtual bool threadLoop() { return mDec->decodeLoop(); }
+    private:
+        HWDec *mDec;
+    };
+
+    struct DecodeJob {
+        BufferInfo *mInInfo;   // NULL if no input goes back
+        BufferInfo *mOutInfo;  // NULL if no picture went out
+        bool mResized;
+        uint32_t mNewWidth, mNewHeight;
+        status_t mErr;
+    };
+
+    // A decoded picture waiting for an output buffer, in output order.
+    struct PendingPicture {
+        PlanarImage mImage;
+        OMX_U32 mLength;
+        OMX_U32 mFlags;
+        bool mHeld;            // frame pinned in the decoder's pool
+    };
+
+    sp<DecodeThread> mDecodeThread;
+    Mutex mDecodeLock;
+    Condition mDecodeCondition;
+    Condition mDecodeIdleCondition;
+    List<BufferInfo *> mDecodeInQueue;
+    List<BufferInfo *> mDecodeOutQueue;
+    List<DecodeJob> mDecodeDoneQueue;
+    List<PendingPicture> mPendingPictures;
+    OMX_U32 mDecodeAhead;
+    bool mPendingUnheld;  // the last pending picture is not pinned
+    bool mDrained;        // EOS input at the head, decoder emptied
+    bool mResizePending;
+    uint32_t mResizeWidth, mResizeHeight;
+    bool mDecoding;
+    bool mDecodePaused;   // waiting for the output port reconfiguration
+    bool mDecodeExit;
+    bool mDecodeFlushing;
+    bool mSeekPending;
+    OMX_CONFIG_LUME_VIDEODECSTATSTYPE mDecodeStats;
+    int64_t mCopyWindowStartUs;
+    uint64_t mCopyWindowBytes;
+
+    // Drop controller: the client's media clock as of mClockRealUs, and
+    // how long the decoder has been behind (starved) or caught up.
+    bool mClockValid;
+    int64_t mClockMediaUs;
+    int64_t mClockRealUs;
+    OMX_U32 mDropLevel;
+    OMX_U32 mDropRecover;
+    OMX_U32 mStarvedDecodes;
+
+    // Latency stats: when the looper handed each input to the decode
+    // thread, by timestamp, matched against the output that carries the
+    // same timestamp when it goes back to the client. Looper thread only.
+    KeyedVector<int64_t, int64_t> mInputTakenUs;
+    char mLatencyFile[PROPERTY_VALUE_MAX];  // media.lume.videolatency, empty for none
+    void noteOutputLatency(const OMX_BUFFERHEADERTYPE *outHeader);
+
+    // Input buffers handed out by allocateBuffer live in DMMU mapped VPU
+    // memory, so the decoder reads them in place instead of copying.
+    VpuMem mInputMem;
+    Mutex mInputMemLock;
+    KeyedVector<OMX_BUFFERHEADERTYPE *, OMX_U8 *> mVpuInputBuffers;
+    bool isVpuInputBuffer(OMX_BUFFERHEADERTYPE *header);
+    sp<HardwareRenderer> getRenderer();
+
+    status_t startDecodeThread();
+    void stopDecodeThread();
+    bool decodeLoop();
+    bool canOutputLocked();
+    bool canDecodeLocked();
+    bool decodePicture(OMX_BUFFERHEADERTYPE *inHeader, bool drain, bool seek,
+                       OMX_U32 dropLevel, PendingPicture *pic, DecodeJob *job);
+    OMX_U32 updateDropLevelLocked(int64_t ptsUs, int64_t nowUs, size_t inDepth);
+    void outputPicture(PendingPicture *pic, OMX_BUFFERHEADERTYPE *outHeader);
+    void dropPendingPicturesLocked();
+    void updateQueueStatsLocked();
+    void processDecodedJobs();
     //    bool handlePortSettingChangeEvent(const H264SwDecInfo *info);
 
+    OMX_U32 mDecoderThreads;
+    bool mLowLatency;
     bool mDecInited;
     uint32_t mNumSamplesOutput;
     VideoFormat mVideoFormat;
     DISALLOW_EVIL_CONSTRUCTORS(HWDec);
-    sp<HardwareRenderer> mRenderer;
-    PlanarImage *mOutputBuf;
+    Mutex mRendererLock;
+    sp<HardwareRenderer> mRenderer;	// under mRendererLock
     bool mVContextNeedFree;
 };
 
@@ -42,6 +42,14 @@ public:
     HardwareRenderer(){}
 
     virtual void render(RenderData* data) = 0;
+
+    // Drops whatever per output buffer state the renderer keeps, called
+    // when the output buffers go away.
+    virtual void releaseBuffers() {}
+
+    // The same for the one output buffer freed with handle, may be called
+    // from the client's thread while another frame is rendered.
+    virtual void releaseBuffer(buffer_handle_t handle) {}
 protected:
     virtual ~HardwareRenderer(){}
 
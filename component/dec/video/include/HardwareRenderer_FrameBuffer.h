@@ -20,6 +20,8 @@
 #include <media/stagefright/MediaBuffer.h>
 #include <media/IMediaPlayerService.h>
 #include <utils/RefBase.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
 #include <ui/ANativeObjectBase.h>
 #include <sys/ioctl.h>
 
@@ -56,6 +58,8 @@ public:
     virtual ~HardwareRenderer_FrameBuffer();
 
     virtual void render(RenderData* data);
+    virtual void releaseBuffers();
+    virtual void releaseBuffer(buffer_handle_t handle);
 private:
     OMX_COLOR_FORMATTYPE mColorFormat, mDstFormat;
     int32_t mWidth, mHeight;
@@ -64,6 +68,13 @@ private:
     bool mRegionChanged, mIPU_inited;
     //struct VideoWindowState mOldState;
 
+    // Output buffers are dmmu mapped the first time they are rendered to
+    // and stay mapped until they are freed or releaseBuffers(), so a frame
+    // costs no mapping syscalls in steady state.
+    Mutex mMapLock;
+    KeyedVector<buffer_handle_t, dmmu_mem_info> mMappedBuffers;
+    bool mapDestBuffer(buffer_handle_t handle, void *vaddr);
+
     void initIPUDestBuffer(void* dst_addr/* , struct VideoWindowState *state */);
     void initIPUSourceBuffer(void *data, size_t srcWidth, size_t srcHeight, size_t srcCropLeft,
 			     size_t srcCropTop, size_t srcCropRight, size_t srcCropBottom); 
@@ -10,6 +10,7 @@ typedef struct{
     int      is_dechw;
     void* memheapbase[4];
     uint32_t memheapbase_offset[4];
+    void*    frame;      /* decoder's mp_image_t, for HoldFrame/ReleaseFrame */
 }PlanarImage;
 
 #endif
@@ -23,6 +23,7 @@
 #endif
 #include "binder/MemoryHeapBase.h"
 #include "dmmu.h"
+#include "PlanarImage.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -48,6 +49,14 @@ extern "C"{
 #define NUM_STATIC_MPI 2
 #define NUM_TEMP_MPI 1
 #define NUM_EXPORT_MPI 1
+/* IP/IPB frame pool: worst case H.264 DPB (16) + current + display holds */
+#define NUM_POOL_MPI 24
+/* frames kept on screen by the IPU through mode (disp_buf0/1/2) */
+#define NUM_DISP_HOLD 3
+/* decoded frames HWDec may pin while they wait for an output buffer */
+#define NUM_AHEAD_HOLD 4
+/* 16x16 tiled copies of software decoded frames, one being written */
+#define NUM_TILE_MPI (NUM_DISP_HOLD + NUM_AHEAD_HOLD + 1)
 
 #define CONTROL_OK 1
 #define CONTROL_TRUE 1
@@ -93,9 +102,20 @@ namespace android
 
 	class mpDecorder{
 	public:
-	    mpDecorder(){}
+	    mpDecorder():mInputMapped(0),mBytesCopied(0),mThreadCount(0),mLowDelay(0),mTiledOutput(0){}
 	    virtual ~mpDecorder(){}
 	    int * mVpuMem_ptr;
+	    /* the next packet sits in DMMU mapped memory with
+	       FF_INPUT_BUFFER_PADDING_SIZE bytes to spare behind it */
+	    int mInputMapped;
+	    /* bitstream bytes copied because the packet was not mapped */
+	    uint64_t mBytesCopied;
+	    /* worker threads for software decoding, 0 = one per cpu */
+	    int mThreadCount;
+	    /* output pictures in decode order, no B-frame reorder delay */
+	    int mLowDelay;
+	    /* hand out software decoded frames in the VPU's tiled layout */
+	    int mTiledOutput;
 	    virtual int preinit(sh_video_t *sh){return 0;}
 	    virtual int init(sh_video_t *sh){return 0;}
 	    virtual void uninit(sh_video_t *sh){};
@@ -103,6 +123,8 @@ namespace android
 	    virtual int decode_video(sh_video_t *sh_audio,unsigned char **inbuf,int *inlen,unsigned char* outbuf,int *outlen, int drop_frame){
 		return 0;
 	    }
+	    /* pictures held back for reordering, *inbuf == NULL drains them */
+	    virtual int get_reorder_depth(sh_video_t *sh){return 0;}
 	};
 
     class VpuMem{
@@ -114,6 +136,7 @@ namespace android
       int32_t mHeapBasesCount;
 
       void* vpu_mem_alloc(int size);
+      void vpu_mem_free(void* vaddr);
     };
 
     class LumeMemory
@@ -123,9 +146,18 @@ namespace android
       ~LumeMemory();
       int muse_jz_buf;
       mp_image_t* get_image(int * VpuMem_ptr,unsigned int outfmt, int mp_imgtype, int mp_imgflag, int w, int h);
+      /* dpb: frames the decoder may hold at once, including the one being decoded */
+      void set_pool_size(int dpb);
+      /* A frame in the VPU (muse_jz_buf) tiled layout, free of holds and
+	 off screen; type IP so HoldFrame can pin it. */
+      mp_image_t* get_tile_image(int * VpuMem_ptr,int w,int h);
     private:
+      mp_image_t* get_pool_image(int * VpuMem_ptr,int w,int h);
+      bool is_display_held(mp_image_t* mpi);
+
       mp_image_t* new_mp_image(int w,int h);
       void free_mp_image(mp_image_t* mpi);
+      void free_vpu_planes(int * VpuMem_ptr,mp_image_t *mpi);
 
       void mp_image_setfmt(mp_image_t* mpi,unsigned int out_fmt);
 	
@@ -134,8 +166,13 @@ namespace android
 	mp_image_t* temp_images[NUM_TEMP_MPI];
 	mp_image_t* export_images[1];
 	mp_image_t* numbered_images[NUM_NUMBERED_MPI];
-	int static_idx;
-        int static_fix0, static_fix1;
+	/* IP/IPB frames, reused once usage_count drops to 0 and off screen */
+	mp_image_t* pool_images[NUM_POOL_MPI];
+	int pool_count;
+	int pool_limit;
+	int pool_idx;
+	mp_image_t* tile_images[NUM_TILE_MPI];
+	int tile_idx;
       } vf_image_context_t;
       int iWidth,iHeight;
       vf_image_context_t imgctx;
@@ -173,10 +210,24 @@ namespace android
       OMX_BOOL DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
 			   OMX_U8** aInputBuf, OMX_U32* aInBufSize,
 			   OMX_PARAM_PORTDEFINITIONTYPE* aPortParam,
-			   OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_BOOL *aResizeFlag);
+			   OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_U32 aDropLevel,
+			   OMX_BOOL *aResizeFlag);
 	
       OMX_ERRORTYPE DecDeinit();
       OMX_BOOL VideoDecSetConext(sh_video_t *sh);
+      void SetInputMapped(OMX_BOOL mapped);
+      void SetThreadCount(OMX_U32 count);
+      void SetLowLatency(OMX_BOOL enable);
+      void SetTiledOutput(OMX_BOOL enable);
+      uint64_t GetBytesCopied();
+      /* Keep a decoded frame out of the pool until ReleaseFrame, so it
+	 survives further decode calls. Only pool (IP/IPB) frames can be
+	 held; returns OMX_FALSE for the rest. */
+      OMX_BOOL HoldFrame(PlanarImage *p);
+      void ReleaseFrame(PlanarImage *p);
+      /* the frame went out for display */
+      void FrameDisplayed(PlanarImage *p);
+      int GetReorderDepth();
       sh_video_t *shContext;
 
     private:
@@ -186,6 +237,9 @@ namespace android
       mpDecorder *vd_dec;
       int startiframe;
       int dropped_frames;
+      int mThreadCount;
+      int mLowLatency;
+      int mTiledOutput;
     
       static int get_buffer(AVCodecContext *avctx, AVFrame *pic);
       static void release_buffer(struct AVCodecContext *avctx, AVFrame *pic);
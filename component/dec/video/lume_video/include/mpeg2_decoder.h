@@ -13,6 +13,10 @@ typedef struct {
     double aspect;
     unsigned char *pending_buffer;
     int pending_length;
+    /* libmpeg2 never releases custom buffers, so keep the pool reference
+       of the last three (two references + current) and drop the oldest */
+    mp_image_t *held_images[3];
+    int held_idx;
 } vd_libmpeg2_ctx_t;
 
 class mpeg2Decoder: public mpDecorder
@@ -83,11 +83,12 @@ OMX_BOOL DecodeVideo(VideoDecorder*videoD,
 		     OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
 		     OMX_U8** aInputBuf, OMX_U32* aInBufSize,
 		     OMX_PARAM_PORTDEFINITIONTYPE* aPortParam,
-		     OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_BOOL *aResizeFlag){
+		     OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_U32 aDropLevel,
+		     OMX_BOOL *aResizeFlag){
   return videoD->DecodeVideo(aOutBuffer,aOutputLength,
 			     aInputBuf,aInBufSize,
 			     aPortParam,
-			     aFrameCount,aMarkerFlag,aResizeFlag);
+			     aFrameCount,aMarkerFlag,aDropLevel,aResizeFlag);
 }
 
 unsigned int get_phy_addr (unsigned int vaddr){
@@ -181,6 +182,7 @@ LumeMemory::LumeMemory(int w,int h){
     iWidth = w;
     iHeight = h;
     memset(&imgctx,0,sizeof(imgctx));
+    imgctx.pool_limit = USE_FBUF_NUM;
 }
 
 #define free_imgmems(x,y)                       \
@@ -199,6 +201,8 @@ LumeMemory::LumeMemory(int w,int h){
 LumeMemory::~LumeMemory(){
     free_imgmems(imgctx.numbered_images,NUM_NUMBERED_MPI);
     free_imgmems(imgctx.static_images,NUM_STATIC_MPI);
+    free_imgmems(imgctx.pool_images,NUM_POOL_MPI);
+    free_imgmems(imgctx.tile_images,NUM_TILE_MPI);
     free_imgmems(imgctx.temp_images,NUM_TEMP_MPI);
     free_imgmems(imgctx.export_images,NUM_EXPORT_MPI);
 }
@@ -349,53 +353,10 @@ mp_image_t* LumeMemory::get_image(int * VpuMem_ptr,unsigned int outfmt, int mp_i
 	if(!imgctx.temp_images[0]) imgctx.temp_images[0] = new_mp_image(w2,h);
 	mpi = imgctx.temp_images[0];
 	break;
-#ifdef USE_IPU_THROUGH_MODE
     case MP_IMGTYPE_IPB:
     case MP_IMGTYPE_IP:
-	  /* skip (I, P) or (P, P) frame since B Frame referenced */
-	  //while (imgctx.static_idx == imgctx.static_fix0 || imgctx.static_idx == imgctx.static_fix1) {
-	  if(imgctx.static_images[imgctx.static_idx])
-	  {
-	      while ((get_disp_buf0() && (uint32_t)imgctx.static_images[imgctx.static_idx]->planes[0] == get_disp_buf0())
-		     || (get_disp_buf1() && (uint32_t)imgctx.static_images[imgctx.static_idx]->planes[0] == get_disp_buf1())
-		     || (get_disp_buf2() && (uint32_t)imgctx.static_images[imgctx.static_idx]->planes[0] == get_disp_buf2())
-		     || (imgctx.static_idx == imgctx.static_fix0 || imgctx.static_idx == imgctx.static_fix1)) {
-              imgctx.static_idx++;
-              if (imgctx.static_idx >= USE_FBUF_NUM)
-		  imgctx.static_idx = 0;
-	      }
-	  }
-	  
-	  if(!imgctx.static_images[imgctx.static_idx]) imgctx.static_images[imgctx.static_idx]=new_mp_image(w2,h);
-	  mpi=imgctx.static_images[imgctx.static_idx];
-	  
-	  /* roll fix buf (I,P or P,P) */
-	  
-	  if (mp_imgtype == MP_IMGTYPE_IP || (mp_imgflag&MP_IMGFLAG_READABLE))
-	  {
-	      imgctx.static_fix0 = imgctx.static_fix1;
-	      imgctx.static_fix1 = imgctx.static_idx;
-	  }
-	  
-	  /* Buf idx + 1  */
-	  imgctx.static_idx++;
-	  if (imgctx.static_idx >= USE_FBUF_NUM)
-	      imgctx.static_idx = 0;
-	  break;
-#else
-    case MP_IMGTYPE_IPB:
-	if(!(mp_imgflag&MP_IMGFLAG_READABLE)){ // B frame:
-	    if(!imgctx.temp_images[0]) imgctx.temp_images[0] = new_mp_image(w2,h);
-	    mpi = imgctx.temp_images[0];
-	    break;
-	}
-    case MP_IMGTYPE_IP:
-        EL("w2: %d, h: %d",w2,h);
-	if(!imgctx.static_images[imgctx.static_idx]) imgctx.static_images[imgctx.static_idx]=new_mp_image(w2,h);
-	mpi=imgctx.static_images[imgctx.static_idx];
-	imgctx.static_idx ^= 1;
+	mpi = get_pool_image(VpuMem_ptr,w2,h);
 	break;
-#endif
     case MP_IMGTYPE_NUMBERED:
 	if (number == -1) {
 	    int i;
@@ -460,13 +421,130 @@ mp_image_t* LumeMemory::get_image(int * VpuMem_ptr,unsigned int outfmt, int mp_i
             
 	}
 	mpi->qscale = NULL;
+	mpi->usage_count++;
     }
     
-    mpi->usage_count++;
-    
     return mpi;
 }
     
+void LumeMemory::set_pool_size(int dpb){
+    int limit = dpb + NUM_DISP_HOLD + NUM_AHEAD_HOLD;
+
+    if(limit > NUM_POOL_MPI)
+	limit = NUM_POOL_MPI;
+    if(limit < USE_FBUF_NUM)
+	limit = USE_FBUF_NUM;
+    if(limit != imgctx.pool_limit)
+	ALOGV("frame pool: dpb %d, limit %d -> %d",dpb,imgctx.pool_limit,limit);
+    imgctx.pool_limit = limit;
+}
+
+// Gives the planes alloc_planes took from the VPU heap back to it.
+void LumeMemory::free_vpu_planes(int * VpuMem_ptr,mp_image_t *mpi){
+    VpuMem * vmem = (VpuMem*)VpuMem_ptr;
+
+    for(int i = 0; i < 4; i++){
+	if(mpi->planes[i] && mpi->memheapbase[i]){
+	    vmem->vpu_mem_free(mpi->planes[i] - mpi->memheapbase_offset[i]);
+	    mpi->planes[i] = NULL;
+	    mpi->memheapbase[i] = NULL;
+	}
+    }
+}
+
+mp_image_t* LumeMemory::get_tile_image(int * VpuMem_ptr,int w,int h){
+    int w2 = (w + 15) & (~15);
+    int i, idx;
+
+    for(i = 0; i < NUM_TILE_MPI; i++){
+	idx = (imgctx.tile_idx + i) % NUM_TILE_MPI;
+	mp_image_t* mpi = imgctx.tile_images[idx];
+
+	if(mpi && (mpi->usage_count || is_display_held(mpi)))
+	    continue;
+	if(mpi && (mpi->width != w2 || mpi->height != h)){
+	    free_vpu_planes(VpuMem_ptr,mpi);
+	    free_mp_image(mpi);
+	    mpi = imgctx.tile_images[idx] = NULL;
+	}
+	if(!mpi){
+	    mpi = new_mp_image(w2,h);
+	    if(!mpi)
+		return NULL;
+	    mp_image_setfmt(mpi,IMGFMT_I420);
+	    int jz_buf = muse_jz_buf;
+	    muse_jz_buf = 1;
+	    alloc_planes(VpuMem_ptr,mpi);
+	    muse_jz_buf = jz_buf;
+	    if(!mpi->planes[0] || !mpi->planes[1]){
+		free_vpu_planes(VpuMem_ptr,mpi);
+		free_mp_image(mpi);
+		return NULL;
+	    }
+	    imgctx.tile_images[idx] = mpi;
+	}
+	mpi->type = MP_IMGTYPE_IP;
+	mpi->w = w;
+	mpi->h = h;
+	imgctx.tile_idx = (idx + 1) % NUM_TILE_MPI;
+	return mpi;
+    }
+
+    ALOGE("no free tiled frame");
+    return NULL;
+}
+
+bool LumeMemory::is_display_held(mp_image_t* mpi){
+#ifdef USE_IPU_THROUGH_MODE
+    uint32_t y = (uint32_t)mpi->planes[0];
+
+    if(!y)
+	return false;
+    return y == get_disp_buf0() || y == get_disp_buf1() || y == get_disp_buf2();
+#else
+    return false;
+#endif
+}
+
+/*
+ * A pool frame is free once the decoder dropped its last reference
+ * (usage_count, taken in get_image and dropped in release_buffer) and
+ * the IPU is no longer scanning it out. The pool grows on demand up to
+ * pool_limit; running past it means the decoder holds more than the
+ * stream's DPB allows, and the caller has to do without a pool frame
+ * (lumeDecoder falls back to lavc's internal buffers) rather than take
+ * VPU memory the stream should not need. A free frame of another size
+ * gives its planes back to the VPU heap, get_image allocates new ones.
+ */
+mp_image_t* LumeMemory::get_pool_image(int * VpuMem_ptr,int w,int h){
+    int i, idx;
+
+    for(i = 0; i < imgctx.pool_count; i++){
+	idx = (imgctx.pool_idx + i) % imgctx.pool_count;
+	mp_image_t* mpi = imgctx.pool_images[idx];
+	if(!mpi->usage_count && !is_display_held(mpi)){
+	    if((mpi->flags & MP_IMGFLAG_ALLOCATED) && (mpi->width != w || mpi->height != h)){
+		free_vpu_planes(VpuMem_ptr,mpi);
+		mpi->flags &= ~MP_IMGFLAG_ALLOCATED;
+	    }
+	    imgctx.pool_idx = (idx + 1) % imgctx.pool_count;
+	    return mpi;
+	}
+    }
+
+    if(imgctx.pool_count >= imgctx.pool_limit){
+	ALOGE("frame pool exhausted (%d frames in use, limit %d)",imgctx.pool_count,imgctx.pool_limit);
+	return NULL;
+    }
+
+    mp_image_t* mpi = new_mp_image(w,h);
+    if(!mpi)
+	return NULL;
+    imgctx.pool_images[imgctx.pool_count++] = mpi;
+    imgctx.pool_idx = 0;
+    return mpi;
+}
+
 void LumeMemory::alloc_planes(int * VpuMem_ptr,mp_image_t *mpi) {
 
     unsigned char* data;
@@ -632,6 +710,9 @@ VideoDecorder::VideoDecorder(){
     dec_frame_state = -1;
     startiframe = 1;
     vd_dec = NULL;
+    mThreadCount = 0;
+    mLowLatency = 0;
+    mTiledOutput = 0;
 }
     
 VideoDecorder::~VideoDecorder(){
@@ -673,7 +754,8 @@ int extra_time;
 OMX_BOOL VideoDecorder::DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
 				    OMX_U8** aInputBuf, OMX_U32* aInBufSize,
 				    OMX_PARAM_PORTDEFINITIONTYPE* aPortParam,
-				    OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_BOOL *aResizeFlag){
+				    OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_U32 aDropLevel,
+				    OMX_BOOL *aResizeFlag){
 
     OMX_BOOL Status = OMX_TRUE;
     OMX_S32 OldWidth, OldHeight, OldFrameSize;
@@ -689,7 +771,7 @@ OMX_BOOL VideoDecorder::DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
     *aOutputLength = 0;
     EL("OldWidth = %d OldHeight = %d *aInBufSize = %d,avctx->width=%d, avctx->height=%d ",OldWidth,OldHeight,*aInBufSize,avctx->width,avctx->height);
     
-    int drop_frame = *aResizeFlag;
+    int drop_frame = aDropLevel;
 
     *aResizeFlag = OMX_FALSE;
     
@@ -741,25 +823,15 @@ OMX_BOOL VideoDecorder::DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
     ALOGE("%s", out_str);
 #endif
     
-#ifdef USE_IPU_THROUGH_MODE
-    if(mpi){				
-	disp_buf0 = disp_buf1;
-
-	if(tFrameWidth < 1280){
-	    disp_buf1 = disp_buf2;
-	    disp_buf2 = (unsigned int)((mp_image_t *)mpi)->planes[0];
-        }else{//phy mem not enough
-	    disp_buf1 = (unsigned int)((mp_image_t *)mpi)->planes[0];
-	}
-    }
-#endif 
     if(mpi)
     {	
-        if(((startiframe && startiframe < 10) || shContext->mSeek)&& mpi->pict_type != 1)
+        // real-time streams would rather show a damaged frame than wait for an I frame
+        if(!mLowLatency && ((startiframe && startiframe < 10) || shContext->mSeek)&& mpi->pict_type != 1)
 	  {
 	    PlanarImage *p = (PlanarImage *)aOutBuffer;
 	    p->isvalid = 0;
 	    p->is_dechw = t_is_dechw;
+	    p->frame = NULL;
 	    
 	    *aOutputLength = 0;
 	    *aInBufSize = 0;
@@ -821,6 +893,7 @@ OMX_BOOL VideoDecorder::DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
 	
 	p->stride[3] = (mpi->height+15)/16*128;      
 	p->isvalid = 1;
+	p->frame = mpi;
 	
 	*aOutputLength = sizeof(PlanarImage);
 	//memcpy(aOutBuffer,mpi->planes[0],shContext->disp_w*shContext->disp_h*3/2);
@@ -834,6 +907,7 @@ OMX_BOOL VideoDecorder::DecodeVideo(OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
     {
 	PlanarImage *p = (PlanarImage *)aOutBuffer;
 	p->isvalid = 0;
+	p->frame = NULL;
 	
 	*aOutputLength = 0;//sizeof(PlanarImage);	
 	*aInBufSize = 0;
@@ -868,6 +942,9 @@ OMX_S32 VideoDecorder::FindVideoCodec(sh_video_t *sh_video){
 	vd_dec = decFactor.CreateVideoDecorder(sh_video->codec->drv);
 	if(vd_dec){
 	    vd_dec->mVpuMem_ptr=(int*)(&mVpuMem);
+	    vd_dec->mThreadCount=mThreadCount;
+	    vd_dec->mLowDelay=mLowLatency;
+	    vd_dec->mTiledOutput=mTiledOutput;
 	    vd_dec->init(sh_video);
 	    break;
 	}
@@ -929,6 +1006,72 @@ OMX_BOOL VideoDecorder::VideoDecSetConext(sh_video_t *sh){
 }
 
 
+void VideoDecorder::SetInputMapped(OMX_BOOL mapped){
+    if(vd_dec)
+	vd_dec->mInputMapped = (mapped == OMX_TRUE);
+}
+
+void VideoDecorder::SetThreadCount(OMX_U32 count){
+    mThreadCount = count;
+}
+
+void VideoDecorder::SetLowLatency(OMX_BOOL enable){
+    mLowLatency = (enable == OMX_TRUE);
+}
+
+void VideoDecorder::SetTiledOutput(OMX_BOOL enable){
+    mTiledOutput = (enable == OMX_TRUE);
+}
+
+uint64_t VideoDecorder::GetBytesCopied(){
+    return vd_dec ? vd_dec->mBytesCopied : 0;
+}
+
+OMX_BOOL VideoDecorder::HoldFrame(PlanarImage *p){
+    mp_image_t *mpi = (mp_image_t *)p->frame;
+
+    if(!mpi)
+	return OMX_FALSE;
+    if((mpi->type&0xff) != MP_IMGTYPE_IP && (mpi->type&0xff) != MP_IMGTYPE_IPB)
+	return OMX_FALSE;
+    mpi->usage_count++;
+    return OMX_TRUE;
+}
+
+void VideoDecorder::ReleaseFrame(PlanarImage *p){
+    mp_image_t *mpi = (mp_image_t *)p->frame;
+
+    if(mpi)
+	mpi->usage_count--;
+}
+
+/*
+ * The IPU through mode scans out of the decoded frame itself, so the
+ * frames on screen stay out of the pool (see is_display_held) until
+ * they rotate off here. Done at display rather than decode time, a
+ * frame decoded ahead does not push one still on screen out early.
+ */
+void VideoDecorder::FrameDisplayed(PlanarImage *p){
+#ifdef USE_IPU_THROUGH_MODE
+    mp_image_t *mpi = (mp_image_t *)p->frame;
+
+    if(!mpi)
+	return;
+    disp_buf0 = disp_buf1;
+
+    if(mpi->width < 1280){
+	disp_buf1 = disp_buf2;
+	disp_buf2 = (unsigned int)mpi->planes[0];
+    }else{//phy mem not enough
+	disp_buf1 = (unsigned int)mpi->planes[0];
+    }
+#endif
+}
+
+int VideoDecorder::GetReorderDepth(){
+    return vd_dec ? vd_dec->get_reorder_depth(shContext) : 0;
+}
+
 VpuMem::VpuMem()
   :mHeapBasesCount(0){
   for(int i=0; i<MAX_MEMHEAP_NUM; ++i){
@@ -937,12 +1080,20 @@ VpuMem::VpuMem()
 }
 
 void* VpuMem::vpu_mem_alloc(int size){
+  int32_t curIndex = 0;
+  /* reuse a slot given back by vpu_mem_free */
+  while (curIndex < mHeapBasesCount && mHeapBases[curIndex] != NULL)
+    ++curIndex;
+  if (curIndex >= MAX_MEMHEAP_NUM) {
+    ALOGE("vpu_mem_alloc: out of heap slots");
+    return NULL;
+  }
   mDevBuffers.push();
   MemoryHeapBase** devbuf = &mDevBuffers.editItemAt(mDevBuffers.size() - 1);
   EL("devbuf=0x%x,*devbuf=0x%x, mHeapBasesCount:%d",devbuf,*devbuf, mHeapBasesCount);
-  int32_t curIndex = mHeapBasesCount;
   mHeapBases[curIndex] = new MemoryHeapBase(size);
-  ++mHeapBasesCount;
+  if (curIndex == mHeapBasesCount)
+    ++mHeapBasesCount;
   *devbuf = mHeapBases[curIndex].get();
   EL("MemoryHeapBase base=0x%x,size=0x%x",(*devbuf)->getBase(),(*devbuf)->getSize());
   int ret_size=(*devbuf)->getSize();
@@ -969,6 +1120,30 @@ void* VpuMem::vpu_mem_alloc(int size){
   return vaddr;
 }
 
+void VpuMem::vpu_mem_free(void* vaddr){
+  for (int i = 0; i < mDevBuffers.size(); i++) {
+    MemoryHeapBase* mptr = mDevBuffers.editItemAt(i);
+    if (mptr->getBase() != vaddr)
+      continue;
+
+    dmmu_mem_info meminfo;
+    meminfo.size=mptr->getSize();
+    meminfo.vaddr=mptr->getBase();
+    meminfo.pages_phys_addr_table=NULL;
+    dmmu_unmap_user_memory(&meminfo);
+    mDevBuffers.removeAt(i);
+
+    for (int j = 0; j < mHeapBasesCount; j++) {
+      if (mHeapBases[j].get() == mptr) {
+	mHeapBases[j] = NULL;
+	break;
+      }
+    }
+    return;
+  }
+  ALOGE("vpu_mem_free: %p was not allocated here", vaddr);
+}
+
 VpuMem::~VpuMem(){
   dmmu_mem_info meminfo;
   ALOGE("VpuMem::~VpuMem mDevBuffers.size()=%d",mDevBuffers.size());
@@ -3,6 +3,7 @@
 #include "jzasm.h"
 
 #include <utils/Log.h>
+#include <pthread.h>
 
 #define EL(x,y...) //{ALOGE("%s %d",__FILE__,__LINE__); LOGE(x,##y);}
 
@@ -25,7 +26,12 @@ int lumeDecoder::get_buffer(AVCodecContext *avctx, AVFrame *pic){
     int type= MP_IMGTYPE_IPB;
     int width= avctx->width;
     int height= avctx->height;
-    avcodec_align_dimensions(avctx, &width, &height);
+    // use_jz_buf (H.264, ...): the VPU writes its tiled layout with the
+    // stride it derives from mb_width, so the frame is sized from the
+    // coded size like avcodec_default_get_buffer's, in alloc_planes' tiles.
+    if(!avctx->use_jz_buf)
+        avcodec_align_dimensions(avctx, &width, &height);
+    vdec->mFrame_Mem->muse_jz_buf = avctx->use_jz_buf;
     //printf("get_buffer %d %d %d\n", pic->reference, ctx->ip_count, ctx->b_count);
     if (pic->buffer_hints) {
         mp_msg(MSGT_DECVIDEO, MSGL_DBG2, "Buffer hints: %u\n", pic->buffer_hints);
@@ -64,13 +70,9 @@ int lumeDecoder::get_buffer(AVCodecContext *avctx, AVFrame *pic){
     if (IMGFMT_IS_XVMC(ctx->best_csp) || IMGFMT_IS_VDPAU(ctx->best_csp)) {
         type =  MP_IMGTYPE_NUMBERED | (0xffff << 16);
     } else if (!pic->buffer_hints) {
-	if(ctx->b_count>1 || ctx->ip_count>2){
-	     if(avctx->codec_id != CODEC_ID_MPEG1VIDEO && avctx->codec_id != CODEC_ID_MPEG2VIDEO){
-            ctx->do_dr1=0; //FIXME
-            avctx->get_buffer= avcodec_default_get_buffer;
-            return avctx->get_buffer(avctx, pic);
-	    }
-	}
+	// frames come from LumeMemory's refcounted pool, so any number of
+	// references and delayed B frames can stay in DR1.
+	vdec->mFrame_Mem->set_pool_size(FFMAX(avctx->refs, 2) + avctx->has_b_frames + 1);
 	
 	if(avctx->has_b_frames){
 	    type= MP_IMGTYPE_IPB;
@@ -86,7 +88,18 @@ int lumeDecoder::get_buffer(AVCodecContext *avctx, AVFrame *pic){
     //mpi= mpcodecs_get_image(sh, type, flags, width, height);
     
     mpi = vdec->mFrame_Mem->get_image(avctx->VpuMem_ptr,sh->codec->outfmt[sh->outfmtidx],type,flags,width,height);
-    if (!mpi) return -1;
+    if (!mpi) {
+        // pool exhausted: take this one frame from lavc's internal buffers,
+        // release_buffer tells them apart by pic->type.
+        if(!pic->buffer_hints){
+            if(pic->reference)
+                ctx->ip_count--;
+            else
+                ctx->b_count--;
+        }
+        pic->opaque = NULL;
+        return avcodec_default_get_buffer(avctx, pic);
+    }
     
     avctx->draw_horiz_band= NULL;
     if(IMGFMT_IS_VDPAU(mpi->imgfmt)) {
@@ -108,6 +121,13 @@ int lumeDecoder::get_buffer(AVCodecContext *avctx, AVFrame *pic){
     pic->linesize[2]= mpi->stride[2];
     pic->linesize[3]= mpi->stride[3];
     
+    // libh264 tells its references apart by base[0]
+    for(int i = 0; i < 4; i++){
+        pic->base[i]= mpi->planes[i];
+        pic->memheapbase[i]= mpi->memheapbase[i];
+        pic->memheapbase_offset[i]= mpi->memheapbase_offset[i];
+    }
+    
     pic->opaque = mpi;
     if(pic->reference){
         pic->age= ctx->ip_age[0];
@@ -123,6 +143,8 @@ int lumeDecoder::get_buffer(AVCodecContext *avctx, AVFrame *pic){
         ctx->b_age=1;
     }
     pic->type= FF_BUFFER_TYPE_USER;
+    if(avctx->use_jz_buf)
+        jz_dcache_wb();
     return 0;
 }
     
@@ -133,14 +155,17 @@ void lumeDecoder::release_buffer(struct AVCodecContext *avctx, AVFrame *pic){
     vd_lume_ctx *ctx = (vd_lume_ctx *)sh->context;
     int i;
       
-    if(ctx->ip_count <= 2 && ctx->b_count<=1){
+    if(pic->type!=FF_BUFFER_TYPE_USER){
+        avcodec_default_release_buffer(avctx, pic);
+        return;
+    }
+    
+    if (mpi) {
         if(mpi->flags&MP_IMGFLAG_PRESERVE)
             ctx->ip_count--;
         else
             ctx->b_count--;
-    }
-    
-    if (mpi) {
+        
         // Palette support: free palette buffer allocated in get_buffer
         if (mpi->bpp == 8)
             av_freep(&mpi->planes[1]);
@@ -158,17 +183,23 @@ void lumeDecoder::release_buffer(struct AVCodecContext *avctx, AVFrame *pic){
         mpi->usage_count--;
     }
 
-    if(pic->type!=FF_BUFFER_TYPE_USER){
-        avcodec_default_release_buffer(avctx, pic);
-        return;
-    }
-    
+
     for(i=0; i<4; i++){
         pic->data[i]= NULL;
     }
 
 }
     
+// Same contract as avcodec_default_reget_buffer: keep the frame the
+// codec already owns, so its pool reference is not taken twice.
+int lumeDecoder::reget_buffer(AVCodecContext *avctx, AVFrame *pic){
+    if(pic->data[0] == NULL){
+        pic->buffer_hints |= FF_BUFFER_HINTS_READABLE;
+        return avctx->get_buffer(avctx, pic);
+    }
+    return 0;
+}
+    
 typedef struct dp_hdr_s {
     uint32_t chunks;        // number of chunks
     uint32_t timestamp; // timestamp from packet header
@@ -230,9 +261,20 @@ int lumeDecoder::init_vo(sh_video_t *sh, enum PixelFormat pix_fmt){
     return 0;
 }
     
+// The software decoders that split a frame over avctx->execute. H.264
+// and MPEG-2 call it too, but run on the VPU here.
+static int uses_slice_threads(enum CodecID id){
+    switch(id){
+    case CODEC_ID_MPEG1VIDEO:
+    case CODEC_ID_DVVIDEO:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
 lumeDecoder::lumeDecoder()
     :dropped_frames(0){
-    avcodec_initialized = 0;
     mFrame_Mem = 0;
     copy_bs = NULL;
 }
@@ -245,12 +287,20 @@ int lumeDecoder::preinit(sh_video_t *sh){
     return 1;
 }    
     
+// Registration rewrites libavcodec's codec list, which every decoder of
+// the process walks when it opens: do it once, and again only when isvp
+// changes the set of codecs registered.
+static pthread_mutex_t avcodec_lock = PTHREAD_MUTEX_INITIALIZER;
+static int avcodec_registered_isvp = -1;
+
 void lumeDecoder::init_avcodec(int isvp){
-    if (!avcodec_initialized) {
+    pthread_mutex_lock(&avcodec_lock);
+    if (avcodec_registered_isvp != isvp) {
 	avcodec_init();
 	video_avcodec_register_all(isvp);
-        avcodec_initialized = 1;
+        avcodec_registered_isvp = isvp;
     }
+    pthread_mutex_unlock(&avcodec_lock);
 }
     
 int lumeDecoder::init(sh_video_t *sh)
@@ -286,7 +336,9 @@ int lumeDecoder::init(sh_video_t *sh)
     if(lavc_codec->capabilities&CODEC_CAP_DRAW_HORIZ_BAND)
         ctx->do_slices=1;
 
-    if(lavc_codec->capabilities&CODEC_CAP_DR1 && !do_vis_debug && lavc_codec->id != CODEC_ID_H264 && lavc_codec->id != CODEC_ID_INTERPLAY_VIDEO && lavc_codec->id != CODEC_ID_ROQ && lavc_codec->id != CODEC_ID_VP8)
+    // INTERPLAY/ROQ/VP8 rely on reget_buffer keeping the previous contents,
+    // which pool frames do not guarantee.
+    if(lavc_codec->capabilities&CODEC_CAP_DR1 && !do_vis_debug && lavc_codec->id != CODEC_ID_INTERPLAY_VIDEO && lavc_codec->id != CODEC_ID_ROQ && lavc_codec->id != CODEC_ID_VP8)
         ctx->do_dr1=1;
     ctx->b_age= ctx->ip_age[0]= ctx->ip_age[1]= 256*256*256*64;
     ctx->ip_count= ctx->b_count= 0;
@@ -304,10 +356,12 @@ int lumeDecoder::init(sh_video_t *sh)
         avctx->flags|= CODEC_FLAG_EMU_EDGE;
         avctx->get_buffer= lumeDecoder::get_buffer;
         avctx->release_buffer= lumeDecoder::release_buffer;
-        avctx->reget_buffer= lumeDecoder::get_buffer;
+        avctx->reget_buffer= lumeDecoder::reget_buffer;
     }
 
     avctx->flags|= 0;
+    if(mLowDelay)
+        avctx->flags|= CODEC_FLAG_LOW_DELAY;
     avctx->is_dechw = 0;
     avctx->coded_width = sh->disp_w;
     avctx->coded_height= sh->disp_h;
@@ -412,6 +466,15 @@ int lumeDecoder::init(sh_video_t *sh)
     if(sh->bih)
         avctx->bits_per_coded_sample= sh->bih->biBitCount;
 
+    // Slice threading: the codec splits each frame across avctx->execute
+    // workers. This libavcodec predates frame threading, so the other
+    // codecs would only get idle threads. Must happen before avcodec_open
+    // since MPV_common_init sizes its thread contexts from thread_count.
+    if(mThreadCount > 1 && uses_slice_threads(lavc_codec->id)){
+        if(avcodec_thread_init(avctx, mThreadCount) < 0)
+            ALOGE("avcodec_thread_init(%d) failed, decoding single threaded", mThreadCount);
+    }
+
     /* open it */
     if (avcodec_open(avctx, lavc_codec) < 0) {
         mp_msg(MSGT_DECVIDEO, MSGL_ERR, "Can't Open Codec");
@@ -447,7 +510,6 @@ void lumeDecoder::uninit(sh_video_t *sh){
     if(mFrame_Mem)
 	delete mFrame_Mem;
     mFrame_Mem = NULL;
-    avcodec_initialized = 0;
 }
 
 static void dump_file(unsigned char *data,int len,unsigned int framenum){
@@ -479,6 +541,53 @@ static void dump_file(unsigned char *data,int len,unsigned int framenum){
 }
 
 //static char * copy_bs=NULL;
+#define COPY_BS_SIZE 0x100000
+
+/*
+ * Store a finished YUV420P frame in the layout the VPU decoders write
+ * (LumeMemory::alloc_planes with muse_jz_buf): luma in 16x16 tiles of
+ * 256 bytes, chroma in 16x8 tiles of 128 bytes whose rows hold 8 U then
+ * 8 V samples, one macroblock row per stride. The source rows are read
+ * whole macroblocks wide, lavc aligns linesize for that; rows past the
+ * picture repeat the last one.
+ */
+static void store_tile420(mp_image_t *dst, mp_image_t *src, int w, int h){
+    int mb_w = (w + 15) >> 4;
+    int mb_h = (h + 15) >> 4;
+    int ch = (h + 1) >> 1;
+    int x, y;
+
+    for(y = 0; y < mb_h * 16; y++){
+        const uint32_t *s = (const uint32_t *)(src->planes[0] + FFMIN(y, h - 1) * src->stride[0]);
+        uint32_t *d = (uint32_t *)(dst->planes[0] + (y >> 4) * dst->stride[0] + (y & 15) * 16);
+        for(x = 0; x < mb_w; x++){
+            d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = s[3];
+            s += 4;
+            d += 64;
+        }
+    }
+
+    for(y = 0; y < mb_h * 8; y++){
+        const uint32_t *u = (const uint32_t *)(src->planes[1] + FFMIN(y, ch - 1) * src->stride[1]);
+        const uint32_t *v = (const uint32_t *)(src->planes[2] + FFMIN(y, ch - 1) * src->stride[2]);
+        uint32_t *d = (uint32_t *)(dst->planes[1] + (y >> 3) * dst->stride[1] + (y & 7) * 16);
+        for(x = 0; x < mb_w; x++){
+            d[0] = u[0]; d[1] = u[1];
+            d[2] = v[0]; d[3] = v[1];
+            u += 2;
+            v += 2;
+            d += 32;
+        }
+    }
+}
+
+int lumeDecoder::get_reorder_depth(sh_video_t *sh){
+    vd_lume_ctx *ctx = (vd_lume_ctx *)sh->context;
+
+    if(!ctx || !ctx->avctx)
+	return 0;
+    return ctx->avctx->has_b_frames;
+}
 
 int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,unsigned char* outbuf,int *outlen, int drop_frame){
     int got_picture=0;
@@ -489,32 +598,39 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
     mp_image_t *mpi=NULL;
     int dr1= ctx->do_dr1;
     AVPacket pkt;
+    // no data at EOS: hand out the pictures held back for reordering
+    int draining = (*inbuf == NULL);
     
     *outlen = 0;
-    if(*inslen<=0) return NULL; // skipped frame
+    if(!draining && *inslen<=0) return NULL; // skipped frame
     
     //lume interlace (mpeg2) bug have been fixed. no need of -noslices
     
     avctx->opaque=sh;
     
+    // drop_frame is HWDec's drop level: 1 skips deblocking, 2 also
+    // non-reference frames, 3 everything but key frames.
     if(drop_frame > 0)
     {
         if(avctx)
         {
-            if(dropped_frames < 50)
-                avctx->skip_frame = AVDISCARD_NONREF;
-            else if(dropped_frames < 100)
+            avctx->skip_loop_filter = AVDISCARD_ALL;
+            if(drop_frame >= 3)
                 avctx->skip_frame = AVDISCARD_NONKEY;
+            else if(drop_frame >= 2)
+                avctx->skip_frame = AVDISCARD_NONREF;
             else
-                avctx->skip_frame = AVDISCARD_ALL;
-            avctx->hurry_up = 1;
-            dropped_frames++;
+                avctx->skip_frame = AVDISCARD_DEFAULT;
+            avctx->hurry_up = drop_frame >= 2;
+            if(drop_frame >= 2)
+                dropped_frames++;
         }
     }
     else
     {
         if(avctx)
         {
+            avctx->skip_loop_filter = AVDISCARD_DEFAULT;
             avctx->skip_frame = AVDISCARD_DEFAULT;
             avctx->hurry_up = 0;
             dropped_frames = 0;
@@ -538,14 +654,30 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
     }
 #endif
     
-    if(!copy_bs){
-      copy_bs=(char*)jz4740_alloc_frame(avctx->VpuMem_ptr,32,0x100000);
-    }
-    
     uint8_t *p = (uint8_t*)(/**((int *)*/*inbuf);
-       
-    memcpy(copy_bs,p,*inslen);
-    if(sh->ds){
+    uint8_t *bs = p;
+    
+    if(draining){
+      *inslen = 0;
+    }else if(mInputMapped){
+      // VPU memory from HWDec::allocateBuffer, decode it in place
+      memset(p + *inslen, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    }else{
+      if(!copy_bs){
+	copy_bs=(char*)jz4740_alloc_frame(avctx->VpuMem_ptr,32,COPY_BS_SIZE);
+      }
+      if(*inslen > COPY_BS_SIZE - FF_INPUT_BUFFER_PADDING_SIZE){
+	ALOGE("packet of %d bytes does not fit the bitstream buffer",*inslen);
+	*inbuf += *inslen;
+	*inslen = 0;
+	return NULL;
+      }
+      memcpy(copy_bs,p,*inslen);
+      memset(copy_bs + *inslen, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+      mBytesCopied += *inslen;
+      bs = (uint8_t*)copy_bs;
+    }
+    if(sh->ds && !draining){
     sh->ds->need_free += 1;
     if(sh->ds->seek_flag > 0){
       avcodec_flush_buffers(avctx);
@@ -554,7 +686,7 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
       sh->seekFlag = 0;
     }
     }
-    if(sh->seekFlag > 0){
+    if(!draining && sh->seekFlag > 0){
       avcodec_flush_buffers(avctx);
       sh->mSeek = 1;
       sh->seekFlag = 0;
@@ -562,7 +694,7 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
     {
       AVPacket avpkt;
       av_init_packet(&avpkt);
-      avpkt.data = (uint8_t*)copy_bs;
+      avpkt.data = bs;
       avpkt.size = *inslen;
       avpkt.pts = (int64_t)(sh->pts*1000000.0);
       //      ALOGE("avpkt.pts=%lld",avpkt.pts);
@@ -579,7 +711,8 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
     if(avctx->use_jz_buf_change)
       mFrame_Mem->muse_jz_buf=avctx->use_jz_buf;
 
-    *inbuf += *inslen;
+    if(!draining)
+      *inbuf += *inslen;
     *inslen = 0;
     if(ret<0){		
 #if  DUMP_DATA==1
@@ -647,6 +780,25 @@ int lumeDecoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,u
     if(pic->interlaced_frame) mpi->fields |= MP_IMGFIELD_INTERLACED;
     if(pic->top_field_first ) mpi->fields |= MP_IMGFIELD_TOP_FIRST;
     if(pic->repeat_pict == 1) mpi->fields |= MP_IMGFIELD_REPEAT_FIRST;
+
+    // Software decoded: hand the renderer the VPU's tiled layout so it
+    // has one source format for every codec.
+    if(mTiledOutput && !avctx->use_jz_buf
+       && (avctx->pix_fmt == PIX_FMT_YUV420P || avctx->pix_fmt == PIX_FMT_YUVJ420P)){
+        mp_image_t *tiled = mFrame_Mem->get_tile_image(avctx->VpuMem_ptr, avctx->width, avctx->height);
+        if(tiled){
+            store_tile420(tiled, mpi, avctx->width, avctx->height);
+            tiled->pts = mpi->pts;
+            tiled->pict_type = mpi->pict_type;
+            tiled->fields = mpi->fields;
+            tiled->qscale = NULL;
+            mpi = tiled;
+            /* the IPU reads it from memory */
+            int mb_h = (avctx->height + 15) >> 4;
+            jz_dcache_wb_range(tiled->planes[0], mb_h * tiled->stride[0]);
+            jz_dcache_wb_range(tiled->planes[1], mb_h * tiled->stride[1]);
+        }
+    }
     
     return (int)mpi;
 }
@@ -46,6 +46,9 @@ int mpeg2Decoder::init(sh_video_t *sh){
 
     if(sh->disp_w && sh->disp_h && (mFrame_Mem == NULL))
         mFrame_Mem = new LumeMemory(sh->disp_w,sh->disp_h);
+    // the frames in held_images[]: two references and the current one
+    if(mFrame_Mem)
+        mFrame_Mem->set_pool_size(3);
 
     accel = 0;
     #if HAVE_MVI
@@ -75,11 +78,23 @@ int mpeg2Decoder::init(sh_video_t *sh){
 
     return 1;
 }
+// Drops the pool references held for libmpeg2, once it no longer uses
+// those pictures as references.
+static void release_held_images(vd_libmpeg2_ctx_t *context){
+    for (int i = 0; i < 3; i++) {
+        if (context->held_images[i])
+            context->held_images[i]->usage_count--;
+        context->held_images[i] = NULL;
+    }
+    context->held_idx = 0;
+}
+
 void mpeg2Decoder::uninit(sh_video_t *sh){
     int i;
     vd_libmpeg2_ctx_t *context = (vd_libmpeg2_ctx_t*)sh->context;
     mpeg2dec_t * mpeg2dec = context->mpeg2dec;
     if (context->pending_buffer) free(context->pending_buffer);
+    release_held_images(context);
     mpeg2dec->decoder.convert=NULL;
     mpeg2dec->decoder.convert_id=NULL;
     mpeg2_close (mpeg2dec);
@@ -143,7 +158,8 @@ int mpeg2Decoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,
     vd_libmpeg2_ctx_t *context = (vd_libmpeg2_ctx_t*)sh->context;
     mpeg2dec_t * mpeg2dec = context->mpeg2dec;
     const mpeg2_info_t * info = mpeg2_info (mpeg2dec);
-    int drop_frame, framedrop=dropframe;
+    // no deblocking to skip at drop level 1, 2 drops B frames, 3 all
+    int drop_frame, framedrop=dropframe > 0 ? dropframe-1 : 0;
     int len = *inslen;
 
     uint8_t *p = (uint8_t*)(*inbuf);//(uint8_t*)(*((int *)*inbuf)?? hardly believe it could work in opencore...
@@ -166,10 +182,14 @@ int mpeg2Decoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,
     ((char*)p+len)[3]=0xff;
     len+=4;
 
-    if (sh->ds->seek_flag){
+    if (sh->ds->seek_flag || sh->seekFlag > 0){
       mpeg2dec->seek_flag = 1;
       EL("mpeg2dec->seek_flag set to 1");
       context->pending_length = 0;
+      // decoding restarts at the next I picture, nothing before the seek
+      // is referenced again
+      release_held_images(context);
+      sh->seekFlag = 0;
     }
 
     if (mpeg2dec->seek_flag == 1){
@@ -270,6 +290,10 @@ int mpeg2Decoder::decode_video(sh_video_t *sh,unsigned char **inbuf,int *inslen,
                 *inslen = 0;
                 return 0; // VO ERROR!!!!!!!!
             }
+            if(context->held_images[context->held_idx])
+                context->held_images[context->held_idx]->usage_count--;
+            context->held_images[context->held_idx] = mpi_new;
+            context->held_idx = (context->held_idx + 1) % 3;
             mpeg2_set_buf(mpeg2dec, mpi_new->planes, mpi_new);
             //mpi_new->stride[0] = info->sequence->width*16;
             //mpi_new->stride[1] = info->sequence->chroma_width;
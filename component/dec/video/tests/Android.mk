@@ -0,0 +1,54 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_ARM_MODE := arm
+
+LOCAL_SRC_FILES:= \
+        LumeDecodeBench.cpp
+
+LOCAL_C_INCLUDES += \
+        $(LOCAL_PATH)/../include \
+        $(LOCAL_PATH)/../../include \
+        frameworks/av/media/libstagefright/include \
+        frameworks/native/include/media/openmax \
+        hardware/ingenic/xb4780/xbdemux/lume/stream \
+        hardware/ingenic/xb4780/xbdemux/lume/libmpdemux \
+        hardware/ingenic/xb4780/xbomx/component/common \
+        hardware/ingenic/xb4780/xbomx/component/dec/video/lume_video/include \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavutil \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libavcodec \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libmpcodecs \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/libjzcommon \
+        hardware/ingenic/xb4780/xbomx/component/dec/lume/
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libstagefright                  \
+        libstagefright_foundation       \
+        libcutils                       \
+        libutils                        \
+        libbinder                       \
+        libdl                           \
+        libui                           \
+        libjzipu                        \
+        libdmmu
+
+LOCAL_STATIC_LIBRARIES :=               \
+        libstagefright_vlume_codec      \
+        libstagefright_mpeg2            \
+        libstagefright_vlumedecoder     \
+        libstagefright_vlumevc1         \
+        libstagefright_realvideo        \
+        libstagefright_mpeg4            \
+        libstagefright_vlumeh264        \
+        libstagefright_ffmpcommon       \
+        libstagefright_ffavutil         \
+        libstagefright_ffavcore         \
+        libOMX_Basecomponent            \
+        libstagefright_mphwapp          \
+        libstagefright_jzmpeg2
+
+LOCAL_MODULE:= lume_decode_bench
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
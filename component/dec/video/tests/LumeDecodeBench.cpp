@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how the lume software decoders scale with the thread count
+// HWDec passes to VideoDecorder::SetThreadCount. The first video track of
+// the file is read into memory up front, then decoded once per thread
+// count the way HWDec::decodePicture does (untiled output, unmapped
+// input), and the decode rate is printed for each run.
+//
+// Only MPEG-1 and DV split their frames across avctx->execute and get
+// slice workers; every other codec should come out the same at every
+// count.
+// The track's samples are fed as they are, so pick a container whose
+// extractor delivers self-contained frames. -f overrides the fourcc the
+// mime type maps to.
+//
+// usage: lume_decode_bench [-t threads] [-n frames] [-f fourcc] file
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "LumeDecodeBench"
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include "lume_dec.h"
+#include "PlanarImage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+extern "C"{
+#include "stream.h"
+#include "demuxer.h"
+#include "stheader.h"
+}
+
+extern "C" {
+  VideoDecorder* CreateLUMESoftVideoDecoder();
+  OMX_ERRORTYPE DecInit(VideoDecorder*videoD);
+  OMX_BOOL VideoDecSetConext(VideoDecorder*videoD,sh_video_t *sh);
+  OMX_BOOL DecodeVideo(VideoDecorder*videoD,
+		       OMX_U8* aOutBuffer, OMX_U32* aOutputLength,
+		       OMX_U8** aInputBuf, OMX_U32* aInBufSize,
+		       OMX_PARAM_PORTDEFINITIONTYPE* aPortParam,
+		       OMX_S32* aFrameCount, OMX_BOOL aMarkerFlag, OMX_U32 aDropLevel,
+		       OMX_BOOL *aResizeFlag);
+}
+
+namespace android {
+
+struct Sample {
+    MediaBuffer *mBuffer;
+    int64_t mTimeUs;
+};
+
+static const struct {
+    const char *mMime;
+    uint32_t mFourcc;
+} kMimeToFourcc[] = {
+    { MEDIA_MIMETYPE_VIDEO_MPEG4, mmioFOURCC('F', 'M', 'P', '4') },
+    { MEDIA_MIMETYPE_VIDEO_AVC,   mmioFOURCC('A', 'V', 'C', '1') },
+    { MEDIA_MIMETYPE_VIDEO_H263,  mmioFOURCC('H', '2', '6', '3') },
+    { MEDIA_MIMETYPE_VIDEO_VPX,   mmioFOURCC('V', 'P', '8', '0') },
+};
+
+static sp<MediaSource> openVideoTrack(
+        const char *path, int32_t *width, int32_t *height, uint32_t *fourcc) {
+    sp<DataSource> dataSource = DataSource::CreateFromURI(path);
+    if (dataSource == NULL) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return NULL;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    if (extractor == NULL) {
+        fprintf(stderr, "No extractor for %s\n", path);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<MetaData> meta = extractor->getTrackMetaData(i);
+        const char *mime;
+        if (!meta->findCString(kKeyMIMEType, &mime)
+                || strncasecmp(mime, "video/", 6)) {
+            continue;
+        }
+
+        CHECK(meta->findInt32(kKeyWidth, width));
+        CHECK(meta->findInt32(kKeyHeight, height));
+        if (*fourcc == 0) {
+            for (size_t j = 0;
+                 j < sizeof(kMimeToFourcc) / sizeof(kMimeToFourcc[0]); ++j) {
+                if (!strcasecmp(mime, kMimeToFourcc[j].mMime)) {
+                    *fourcc = kMimeToFourcc[j].mFourcc;
+                    break;
+                }
+            }
+        }
+        if (*fourcc == 0) {
+            fprintf(stderr, "No fourcc for %s, pass one with -f\n", mime);
+            return NULL;
+        }
+
+        return extractor->getTrack(i);
+    }
+
+    fprintf(stderr, "No video track in %s\n", path);
+    return NULL;
+}
+
+static void readSamples(
+        const sp<MediaSource> &source, int maxFrames, Vector<Sample> *samples) {
+    CHECK_EQ(source->start(), (status_t)OK);
+
+    while ((int)samples->size() < maxFrames) {
+        MediaBuffer *buffer;
+        status_t err = source->read(&buffer);
+        if (err == INFO_FORMAT_CHANGED) {
+            continue;
+        } else if (err != OK) {
+            break;
+        }
+
+        if (buffer->range_length() == 0) {
+            buffer->release();
+            continue;
+        }
+
+        Sample sample;
+        sample.mBuffer = buffer;
+        if (!buffer->meta_data()->findInt64(kKeyTime, &sample.mTimeUs)) {
+            sample.mTimeUs = 0;
+        }
+        samples->push(sample);
+    }
+
+    source->stop();
+}
+
+// Returns the decoded frames per second, or a negative value on error.
+static double decode(const Vector<Sample> &samples, int threads,
+                     int32_t width, int32_t height, uint32_t fourcc) {
+    VideoDecorder *decoder = CreateLUMESoftVideoDecoder();
+    CHECK(decoder);
+
+    decoder->SetThreadCount(threads);
+    decoder->SetTiledOutput(OMX_FALSE);
+    if (DecInit(decoder) != OMX_ErrorNone) {
+        delete decoder;
+        return -1;
+    }
+
+    sh_video_t sh;
+    memset(&sh, 0, sizeof(sh));
+    sh.bih = (BITMAPINFOHEADER *)malloc(sizeof(BITMAPINFOHEADER));
+    memset(sh.bih, 0, sizeof(BITMAPINFOHEADER));
+    sh.bih->biSize = sizeof(BITMAPINFOHEADER);
+    sh.format = sh.bih->biCompression = fourcc;
+    sh.is_rtsp = 1; //no extradata
+    sh.disp_w = sh.bih->biWidth = width;
+    sh.disp_h = sh.bih->biHeight = height;
+    sh.bih->biBitCount = 16; //YUV
+    sh.bih->biSizeImage = width * height * sh.bih->biBitCount / 8;
+
+    // The decoder keeps its own copy of sh; deleting it uninits the codec,
+    // as HWDec's destructor relies on.
+    if (VideoDecSetConext(decoder, &sh) == OMX_FALSE) {
+        delete decoder;
+        free(sh.bih);
+        return -1;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE portParam;
+    PlanarImage image;
+    int decoded = 0;
+
+    nsecs_t startNs = systemTime();
+    for (size_t i = 0; i <= samples.size(); ++i) {
+        OMX_U8 *stream = NULL;
+        OMX_U32 inLength = 0;
+        OMX_U32 outLength = 0;
+        OMX_S32 frameCount = 0;
+        OMX_BOOL resized = OMX_FALSE;
+
+        // One call past the last sample drains what the decoder holds back.
+        decoder->SetInputMapped(OMX_FALSE);
+        decoder->shContext->seekFlag = 0;
+        if (i < samples.size()) {
+            MediaBuffer *buffer = samples[i].mBuffer;
+            stream = (OMX_U8 *)buffer->data() + buffer->range_offset();
+            inLength = buffer->range_length();
+            decoder->shContext->pts = (double)samples[i].mTimeUs / 1000000.0;
+        }
+
+        portParam.format.video.nFrameWidth = width;
+        portParam.format.video.nFrameHeight = height;
+        if (DecodeVideo(decoder, (OMX_U8 *)&image, &outLength,
+                        &stream, &inLength, &portParam, &frameCount,
+                        OMX_TRUE, 0, &resized) == OMX_TRUE
+                && outLength > 0) {
+            ++decoded;
+        }
+    }
+    nsecs_t elapsedNs = systemTime() - startNs;
+
+    delete decoder;
+    free(sh.bih);
+
+    printf("%d thread(s): %d of %d frames in %lld ms, %.1f fps\n",
+           threads, decoded, (int)samples.size(),
+           (long long)(elapsedNs / 1000000), decoded * 1E9 / elapsedNs);
+
+    return decoded * 1E9 / elapsedNs;
+}
+
+}  // namespace android
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-t threads] [-n frames] [-f fourcc] file\n", me);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    int threads = 0;
+    int maxFrames = 300;
+    uint32_t fourcc = 0;
+
+    int res;
+    while ((res = getopt(argc, argv, "t:n:f:")) >= 0) {
+        switch (res) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+
+            case 'n':
+                maxFrames = atoi(optarg);
+                break;
+
+            case 'f':
+                if (strlen(optarg) != 4) {
+                    usage(argv[0]);
+                }
+                fourcc = mmioFOURCC(optarg[0], optarg[1], optarg[2], optarg[3]);
+                break;
+
+            default:
+                usage(argv[0]);
+                break;
+        }
+    }
+
+    if (optind + 1 != argc || threads < 0 || maxFrames <= 0) {
+        usage(argv[0]);
+    }
+
+    DataSource::RegisterDefaultSniffers();
+
+    int32_t width, height;
+    sp<MediaSource> source = openVideoTrack(argv[optind], &width, &height, &fourcc);
+    if (source == NULL) {
+        return 1;
+    }
+
+    Vector<Sample> samples;
+    readSamples(source, maxFrames, &samples);
+    if (samples.isEmpty()) {
+        fprintf(stderr, "No samples read from %s\n", argv[optind]);
+        return 1;
+    }
+
+    int ret = 0;
+    if (threads > 0) {
+        if (decode(samples, threads, width, height, fourcc) < 0) {
+            ret = 1;
+        }
+    } else {
+        double fps1 = decode(samples, 1, width, height, fourcc);
+        double fps2 = decode(samples, 2, width, height, fourcc);
+        if (fps1 <= 0 || fps2 < 0) {
+            ret = 1;
+        } else {
+            printf("scaling 1 -> 2 threads: %.2fx\n", fps2 / fps1);
+        }
+    }
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i].mBuffer->release();
+    }
+
+    return ret;
+}
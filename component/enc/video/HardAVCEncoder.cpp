@@ -32,6 +32,7 @@
 #include <ui/GraphicBufferMapper.h>
 
 #include "HardAVCEncoder.h"
+#include "HardOMXVendorExt.h"
 
 typedef struct {
     int b_progress;
@@ -53,6 +54,8 @@ extern "C" {
   int     Parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt );
   x264_t *x264_encoder_open( x264_param_t * );
   int     x264_encoder_encode ( x264_t *, x264_nal_t **, int *, x264_picture_t *, x264_picture_t * );
+  int     x264_encoder_retire( x264_t *, x264_nal_t **, int *, x264_picture_t * );
+  int     x264_encoder_delayed_frames( x264_t * );
   void    x264_encoder_close  ( x264_t * );
   short   crc(unsigned char * data_buf, int byte_num, short test);
   void *  jz4740_alloc_frame (int *VpuMem_ptr, int align, int size){
@@ -206,6 +209,7 @@ HardAVCEncoder::HardAVCEncoder(
       mVideoHeight(144),
       mVideoFrameRate(30),
       mVideoBitRate(512000),
+      mVideoControlRate(OMX_Video_ControlRateVariable),
       mVideoColorFormat(OMX_COLOR_FormatYUV420Planar),
       mStoreMetaDataInBuffers(false),
       mIDRFrameRefreshIntervalInSec(1),
@@ -217,7 +221,17 @@ HardAVCEncoder::HardAVCEncoder(
       mSawInputEOS(false),
       mSignalledError(false),
       mInputFrameData(NULL),
-      mSliceGroup(NULL) {
+      mSliceGroup(NULL),
+      mConfigChanged(false),
+      mKeyFrameRequested(false),
+      mMapCalls(0),
+      mUnmapCalls(0),
+      mMapFailures(0),
+      mPendingInput(NULL),
+      mPendingSrcBuffer(NULL),
+      mVpuLocked(false),
+      mRetiredLength(0),
+      mRetiredFlags(0) {
 
     initPorts();
     ALOGI("Construct HardAVCEncoder================");
@@ -226,6 +240,7 @@ HardAVCEncoder::HardAVCEncoder(
 HardAVCEncoder::~HardAVCEncoder() {
     ALOGV("Destruct HardAVCEncoder");
     releaseEncoder();
+    unmapAllInputs();
     List<BufferInfo *> &outQueue = getPortQueue(1);
     List<BufferInfo *> &inQueue = getPortQueue(0);
     CHECK(outQueue.empty());
@@ -259,6 +274,8 @@ OMX_ERRORTYPE HardAVCEncoder::initEncParams() {
     mParam.rc.i_fbr_bitrate=mVideoBitRate;
 
     cli_opt_t opt;
+    char keyint[16];
+    snprintf(keyint, sizeof(keyint), "%d", getIDRPeriod());
     char * argv[] = {
       "x264",
       "--bframes",        "0",
@@ -268,16 +285,34 @@ OMX_ERRORTYPE HardAVCEncoder::initEncParams() {
       "--weightp",        "0",
       "--ref",            "1",
       "--partition",      "none",
-      "--qp",             "26",
       "--sync-lookahead", "0",
       "--rc-lookahead",   "0",
       "--aq-mod",         "0",
       "--no-8x8dct",
       "--ratetol",        "1.0",
-      "--keyint",         "25"
+      "--keyint",         keyint,
+      NULL, NULL,   // --qp or --bitrate
+      NULL, NULL,   // --vbv-maxrate
+      NULL, NULL    // --vbv-bufsize
     };
-    
-    int argc = sizeof(argv)/sizeof(argv[0]);
+
+    int argc = sizeof(argv)/sizeof(argv[0]) - 6;
+    char bitrate[16], maxrate[16];
+    if (mVideoControlRate == OMX_Video_ControlRateDisable) {
+      argv[argc++] = "--qp";
+      argv[argc++] = "26";
+    } else {
+      int32_t kbps, peakKbps;
+      getRateKbps(&kbps, &peakKbps);
+      snprintf(bitrate, sizeof(bitrate), "%d", kbps);
+      snprintf(maxrate, sizeof(maxrate), "%d", peakKbps);
+      argv[argc++] = "--bitrate";
+      argv[argc++] = bitrate;
+      argv[argc++] = "--vbv-maxrate";
+      argv[argc++] = maxrate;
+      argv[argc++] = "--vbv-bufsize";
+      argv[argc++] = maxrate;
+    }
 
     if( Parse( argc, argv, &mParam, &opt ) < 0 ){
       ALOGE("Parse failed!");
@@ -296,6 +331,49 @@ OMX_ERRORTYPE HardAVCEncoder::initEncParams() {
     return OMX_ErrorNone;
 }
 
+// Same convention as the software AVC encoder: a negative interval codes
+// only the first frame as IDR, zero makes every frame an IDR.
+int32_t HardAVCEncoder::getIDRPeriod() const {
+    if (mIDRFrameRefreshIntervalInSec < 0) {
+        return 1 << 30;
+    } else if (mIDRFrameRefreshIntervalInSec == 0) {
+        return 1;
+    }
+    return mIDRFrameRefreshIntervalInSec * mVideoFrameRate;
+}
+
+// Target and VBV peak rate in kbit/s, with one second of VBV at the peak:
+// CBR never exceeds the target, VBR may burst to twice it while still
+// averaging the target.
+void HardAVCEncoder::getRateKbps(int32_t *bitrate, int32_t *maxrate) const {
+    int32_t kbps = (mVideoBitRate + 500) / 1000;
+    if (kbps < 1) {
+        kbps = 1;
+    }
+    *bitrate = kbps;
+    *maxrate = mVideoControlRate == OMX_Video_ControlRateConstant ? kbps : 2 * kbps;
+}
+
+// Called with mConfigLock held. x264 picks the new values up on the next
+// frame it encodes, which with no lookahead or B-frames is the next input.
+void HardAVCEncoder::reconfigEncoder() {
+    mParam.i_fps_num = mVideoFrameRate;
+    mParam.i_fps_den = 1;
+    mParam.i_keyint_max = getIDRPeriod();
+    if (mParam.rc.i_rc_method == X264_RC_ABR) {
+        int32_t kbps, peakKbps;
+        getRateKbps(&kbps, &peakKbps);
+        mParam.rc.i_bitrate = kbps;
+        mParam.rc.i_vbv_max_bitrate = peakKbps;
+        mParam.rc.i_vbv_buffer_size = peakKbps;
+    }
+
+    if (x264_encoder_reconfig(h, &mParam) < 0) {
+        ALOGW("x264 [warning]: reconfig to %d bps at %d fps rejected",
+              mVideoBitRate, mVideoFrameRate);
+    }
+}
+
 OMX_ERRORTYPE HardAVCEncoder::initEncoder() {
     CHECK(!mStarted);
 
@@ -324,7 +402,17 @@ OMX_ERRORTYPE HardAVCEncoder::releaseEncoder() {
     if(mCsdData)
       delete mCsdData;
 
+    // waits for a frame still on the VPU
     x264_encoder_close( h );
+    if (mVpuLocked) {
+        UnLock_Vpu();
+        mVpuLocked = false;
+    }
+    releaseGrallocData(mPendingSrcBuffer);
+    mPendingInput = NULL;
+    mPendingSrcBuffer = NULL;
+    mRetiredFrame.clear();
+    mRetiredLength = 0;
     
     VAE_unmap();
 
@@ -421,7 +509,7 @@ OMX_ERRORTYPE HardAVCEncoder::internalGetParameter(
                 return OMX_ErrorUndefined;
             }
 
-            bitRate->eControlRate = OMX_Video_ControlRateVariable;
+            bitRate->eControlRate = mVideoControlRate;
             bitRate->nTargetBitrate = mVideoBitRate;
             return OMX_ErrorNone;
         }
@@ -532,10 +620,13 @@ OMX_ERRORTYPE HardAVCEncoder::internalSetParameter(
                 (OMX_VIDEO_PARAM_BITRATETYPE *) params;
 
             if (bitRate->nPortIndex != 1 ||
-                bitRate->eControlRate != OMX_Video_ControlRateVariable) {
+                (bitRate->eControlRate != OMX_Video_ControlRateVariable &&
+                 bitRate->eControlRate != OMX_Video_ControlRateConstant &&
+                 bitRate->eControlRate != OMX_Video_ControlRateDisable)) {
                 return OMX_ErrorUndefined;
             }
 
+            mVideoControlRate = bitRate->eControlRate;
             mVideoBitRate = bitRate->nTargetBitrate;
             return OMX_ErrorNone;
         }
@@ -692,7 +783,12 @@ OMX_ERRORTYPE HardAVCEncoder::internalSetParameter(
 }
 
 void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
-    if (mSignalledError || mSawInputEOS) {
+    if (mSignalledError) {
+        return;
+    }
+
+    if (mSawInputEOS) {
+        drainEncoder();
         return;
     }
 
@@ -702,6 +798,8 @@ void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
         }
     }
 
+    emitRetiredFrame();
+
     List<BufferInfo *> &inQueue = getPortQueue(0);
     List<BufferInfo *> &outQueue = getPortQueue(1);
 
@@ -718,11 +816,10 @@ void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
         outHeader->nOffset = 0;
 
         uint8_t *outPtr = (uint8_t *) outHeader->pBuffer;
-        uint32_t dataLength = outHeader->nAllocLen;
 	uint8_t *inputData = NULL;
 
         int32_t type;
-        buffer_handle_t srcBuffer; // for MetaDataMode only
+        buffer_handle_t srcBuffer = NULL; // for MetaDataMode only
 
 	/*encode a frame*/
 	x264_picture_t pic_out;
@@ -789,32 +886,54 @@ void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
 
 	pic.i_pts = (int64_t)i_frame * 1;
     
-	/* Do not force any parameters */
+	/* Only force an IDR when one was requested through setConfig */
 	pic.i_type = X264_TYPE_AUTO;
 	pic.i_qpplus1 = 0;
+	{
+	  Mutex::Autolock autoLock(mConfigLock);
+	  if (mConfigChanged) {
+	    reconfigEncoder();
+	    mConfigChanged = false;
+	  }
+	  if (mKeyFrameRequested) {
+	    pic.i_type = X264_TYPE_IDR;
+	    mKeyFrameRequested = false;
+	  }
+	}
     
 	pic.img.i_plane = 0;
 	pic.param = NULL;
 
 	/*encode a frame*/
-	{
-	  mVideoWidth;
-	  int inHeaderSize = inHeader->nFilledLen - inHeader->nOffset;
-	  if (inHeaderSize != mVideoWidth * mVideoHeight * 3 / 2)
-	    ALOGW("x264 [warring]: inHeaderSize != encoder actual size %d %d", inHeaderSize, mVideoWidth * mVideoHeight * 3 / 2);
-	  dmmu_mem_info meminfo;
-	  meminfo.size=inHeaderSize;
-	  meminfo.vaddr=inputData;
-	  meminfo.pages_phys_addr_table=NULL;
-	  int err=dmmu_map_user_memory(&meminfo);
+	if (inputData != NULL) {
+	  bool mapped;
+	  if (mStoreMetaDataInBuffers) {
+	    inputData = extractGrallocData(inputData, &srcBuffer);
+	    mapped = inputData != NULL && mapGrallocBuffer(srcBuffer, inputData);
+	  } else {
+	    int inHeaderSize = inHeader->nFilledLen - inHeader->nOffset;
+	    if (inHeaderSize != mVideoWidth * mVideoHeight * 3 / 2)
+	      ALOGW("x264 [warring]: inHeaderSize != encoder actual size %d %d", inHeaderSize, mVideoWidth * mVideoHeight * 3 / 2);
+	    mapped = mapInputBuffer(inHeader);
+	  }
+	  if (!mapped) {
+	    mSignalledError = true;
+	    releaseGrallocData(srcBuffer);
+	    notify(OMX_EventError, OMX_ErrorUndefined, 0, 0);
+	    return;
+	  }
 	}
 	//pic.img.raw_yuv422_ptr = (uint32_t *)mInputBuffer->data();
 	pic.img.raw_yuv422_ptr = (uint32_t *)inputData;
 	//time0 = GetTimer();
 	    
-	Lock_Vpu();
+	if (!mVpuLocked) {
+	  Lock_Vpu();
+	  mVpuLocked = true;
+	}
 	if( x264_encoder_encode( h, &nal, &i_nal, &pic, &pic_out ) < 0 ){
 	  UnLock_Vpu();
+	  mVpuLocked = false;
 	  ALOGE("x264 [error]: x264_encoder_encode failed\n" );
 	  mSignalledError = true;
 	  releaseGrallocData(srcBuffer);
@@ -822,28 +941,77 @@ void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
 	  
 	  return;
 	}
-	UnLock_Vpu();
 	// time1 = GetTimer();
 
 	i_frame++;
-	dataLength = 0;
 
-	for(i=0;i<i_nal;i++){
+	// The previous frame is off the VPU now, this one may still be on it.
+	releasePendingInput();
+	inQueue.erase(inQueue.begin());
+	mPendingInput = inInfo;
+	mPendingSrcBuffer = srcBuffer;
+	unlockVpuIfIdle();
+
+	if (i_nal == 0) {
+	  // nothing retired yet, the output buffer waits for the next frame
+	  continue;
+	}
+
+	int32_t frameLength = copyFrameNals(
+	    outPtr, outHeader->nAllocLen, &outHeader->nFlags, nal, i_nal);
+	if (frameLength < 0) {
+	  return;
+	}
+	//time1 = GetTimer();
+#ifdef WRITE_H264RAW_STREAM
+	fclose(rawh264_f);
+#endif
+
+        outQueue.erase(outQueue.begin());
+        CHECK(!mInputBufferInfoVec.empty());
+        InputBufferInfo *inputBufInfo = mInputBufferInfoVec.begin();
+        outHeader->nTimeStamp = inputBufInfo->mTimeUs;
+        outHeader->nFlags |= (inputBufInfo->mFlags | OMX_BUFFERFLAG_ENDOFFRAME);
+        if (mSawInputEOS && !x264_encoder_delayed_frames(h)) {
+            outHeader->nFlags |= OMX_BUFFERFLAG_EOS;
+        }
+        outHeader->nFilledLen = frameLength;
+        outInfo->mOwnedByUs = false;
+        notifyFillBufferDone(outHeader);
+        mInputBufferInfoVec.erase(mInputBufferInfoVec.begin());
+    }
+
+    if (mSawInputEOS) {
+        drainEncoder();
+    } else if (inQueue.empty()) {
+        retireInFlightFrame();
+    }
+}
+
+// Copies the slice NALs of one frame into dst without their start codes
+// and marks an IDR frame in flags. Returns the length, or -1 after
+// signalling an overflow.
+int32_t HardAVCEncoder::copyFrameNals(
+        uint8_t *dst, uint32_t capacity, OMX_U32 *flags,
+        x264_nal_t *nal, int i_nal) {
+    uint8_t *outPtr = dst;
+    uint32_t dataLength = 0;
+
+	for(int i=0;i<i_nal;i++){
 #ifdef WRITE_H264RAW_STREAM
 	  fwrite(nal[i].p_payload, 1, nal[i].i_payload, rawh264_f);   
 #endif
 	  uint8_t type = (nal[i].p_payload)[4] & 0x1f;
 	  switch ( type ) {
 	  case 0x5://I nal
-	    outHeader->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+	    *flags |= OMX_BUFFERFLAG_SYNCFRAME;
 	  case 0x1://P nal
 	    int size = nal[i].i_payload - 4;
-	    if((dataLength + size) > outHeader->nAllocLen){
+	    if((dataLength + size) > capacity){
 	      ALOGE("x264 frame outputBuffer is underflow!!");
 	      mSignalledError = true;
-	      releaseGrallocData(srcBuffer);
 	      notify(OMX_EventError, OMX_ErrorOverflow, 0, 0);
-	      return;
+	      return -1;
 	    };
 
 	    memcpy(outPtr+dataLength, nal[i].p_payload + 4, size);
@@ -851,25 +1019,158 @@ void HardAVCEncoder::onQueueFilled(OMX_U32 portIndex) {
 	    break;
 	  }
 	}
-	//time1 = GetTimer();
-#ifdef WRITE_H264RAW_STREAM
-	fclose(rawh264_f);
-#endif
 
-        inQueue.erase(inQueue.begin());
-        inInfo->mOwnedByUs = false;
-        releaseGrallocData(srcBuffer);
-        notifyEmptyBufferDone(inHeader);
+    return dataLength;
+}
+
+void HardAVCEncoder::releasePendingInput() {
+    if (mPendingInput == NULL) {
+        return;
+    }
+
+    mPendingInput->mOwnedByUs = false;
+    releaseGrallocData(mPendingSrcBuffer);
+    notifyEmptyBufferDone(mPendingInput->mHeader);
+    mPendingInput = NULL;
+    mPendingSrcBuffer = NULL;
+}
+
+void HardAVCEncoder::unlockVpuIfIdle() {
+    if (x264_encoder_delayed_frames(h) > 0) {
+        return;
+    }
+
+    releasePendingInput();
+    if (mVpuLocked) {
+        UnLock_Vpu();
+        mVpuLocked = false;
+    }
+}
+
+// Nothing is left to overlap the frame on the VPU with, so finish it now
+// rather than hold its output, its input buffer and the VPU lock until
+// the next input arrives. Without an output buffer its NALs are kept in
+// mRetiredFrame until one is queued.
+void HardAVCEncoder::retireInFlightFrame() {
+    if (mSignalledError || x264_encoder_delayed_frames(h) == 0) {
+        return;
+    }
+
+    x264_picture_t pic_out;
+    x264_nal_t *nal;
+    int i_nal;
+
+    if (x264_encoder_retire(h, &nal, &i_nal, &pic_out) < 0) {
+        ALOGE("x264 [error]: x264_encoder_retire failed");
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorUndefined, 0, 0);
+        return;
+    }
+    unlockVpuIfIdle();
+
+    if (i_nal == 0) {
+        return;
+    }
+
+    // the NALs point into x264's bitstream buffer, which the next frame
+    // reuses
+    mRetiredFrame.resize(editPortInfo(1)->mDef.nBufferSize);
+    mRetiredFlags = 0;
+    mRetiredLength = copyFrameNals(
+            mRetiredFrame.editArray(), mRetiredFrame.size(), &mRetiredFlags,
+            nal, i_nal);
+    if (mRetiredLength < 0) {
+        mRetiredLength = 0;
+        return;
+    }
+
+    emitRetiredFrame();
+}
+
+// Hands a frame kept by retireInFlightFrame to the first queued output
+// buffer; it is older than anything x264 still holds.
+void HardAVCEncoder::emitRetiredFrame() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    if (mSignalledError || mRetiredLength == 0 || outQueue.empty()) {
+        return;
+    }
+
+    BufferInfo *outInfo = *outQueue.begin();
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+    if ((uint32_t)mRetiredLength > outHeader->nAllocLen) {
+        ALOGE("x264 frame outputBuffer is underflow!!");
+        mSignalledError = true;
+        notify(OMX_EventError, OMX_ErrorOverflow, 0, 0);
+        return;
+    }
+
+    memcpy(outHeader->pBuffer, mRetiredFrame.array(), mRetiredLength);
+    outQueue.erase(outQueue.begin());
+    CHECK(!mInputBufferInfoVec.empty());
+    InputBufferInfo *inputBufInfo = mInputBufferInfoVec.begin();
+    outHeader->nTimeStamp = inputBufInfo->mTimeUs;
+    outHeader->nOffset = 0;
+    outHeader->nFlags = mRetiredFlags | inputBufInfo->mFlags | OMX_BUFFERFLAG_ENDOFFRAME;
+    if (mSawInputEOS && !x264_encoder_delayed_frames(h)) {
+        outHeader->nFlags |= OMX_BUFFERFLAG_EOS;
+    }
+    outHeader->nFilledLen = mRetiredLength;
+    outInfo->mOwnedByUs = false;
+    notifyFillBufferDone(outHeader);
+    mInputBufferInfoVec.erase(mInputBufferInfoVec.begin());
+    mRetiredLength = 0;
+}
+
+// After input EOS, collects the frames x264 still holds, one output
+// buffer each; the last one carries the EOS flag.
+void HardAVCEncoder::drainEncoder() {
+    List<BufferInfo *> &outQueue = getPortQueue(1);
+
+    emitRetiredFrame();
+
+    while (!mSignalledError && x264_encoder_delayed_frames(h) > 0
+            && !outQueue.empty()) {
+        BufferInfo *outInfo = *outQueue.begin();
+        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+        x264_picture_t pic_out;
+        x264_nal_t *nal;
+        int i_nal;
+
+        outHeader->nTimeStamp = 0;
+        outHeader->nFlags = 0;
+        outHeader->nOffset = 0;
+        outHeader->nFilledLen = 0;
+
+        if (x264_encoder_encode(h, &nal, &i_nal, NULL, &pic_out) < 0) {
+            ALOGE("x264 [error]: x264_encoder_encode failed while draining");
+            mSignalledError = true;
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, 0);
+            return;
+        }
+        unlockVpuIfIdle();
+
+        if (i_nal == 0) {
+            continue;
+        }
+
+        int32_t frameLength = copyFrameNals(
+                outHeader->pBuffer, outHeader->nAllocLen, &outHeader->nFlags,
+                nal, i_nal);
+        if (frameLength < 0) {
+            return;
+        }
 
         outQueue.erase(outQueue.begin());
         CHECK(!mInputBufferInfoVec.empty());
         InputBufferInfo *inputBufInfo = mInputBufferInfoVec.begin();
         outHeader->nTimeStamp = inputBufInfo->mTimeUs;
         outHeader->nFlags |= (inputBufInfo->mFlags | OMX_BUFFERFLAG_ENDOFFRAME);
-        if (mSawInputEOS) {
+        if (!x264_encoder_delayed_frames(h)) {
             outHeader->nFlags |= OMX_BUFFERFLAG_EOS;
         }
-        outHeader->nFilledLen = dataLength;
+        outHeader->nFilledLen = frameLength;
         outInfo->mOwnedByUs = false;
         notifyFillBufferDone(outHeader);
         mInputBufferInfoVec.erase(mInputBufferInfoVec.begin());
@@ -905,6 +1206,130 @@ void HardAVCEncoder::signalBufferReturned(MediaBuffer *buffer) {
     ALOGV("signalBufferReturned: %p", buffer);
 }
 
+OMX_ERRORTYPE HardAVCEncoder::getConfig(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexConfigVideoBitrate:
+        {
+            OMX_VIDEO_CONFIG_BITRATETYPE *bitRate =
+                (OMX_VIDEO_CONFIG_BITRATETYPE *) params;
+
+            if (bitRate->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            bitRate->nEncodeBitrate = mVideoBitRate;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexConfigVideoFramerate:
+        {
+            OMX_CONFIG_FRAMERATETYPE *frameRate =
+                (OMX_CONFIG_FRAMERATETYPE *) params;
+
+            if (frameRate->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            frameRate->xEncodeFramerate = mVideoFrameRate << 16;  // Q16 format
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexConfigVideoIntraVOPRefresh:
+        {
+            OMX_CONFIG_INTRAREFRESHVOPTYPE *refresh =
+                (OMX_CONFIG_INTRAREFRESHVOPTYPE *) params;
+
+            if (refresh->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            refresh->IntraRefreshVOP = mKeyFrameRequested ? OMX_TRUE : OMX_FALSE;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexConfigLumeVideoEncStats:
+        {
+            OMX_CONFIG_LUME_VIDEOENCSTATSTYPE *statsParams =
+                (OMX_CONFIG_LUME_VIDEOENCSTATSTYPE *) params;
+
+            if (statsParams->nPortIndex != 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mMapLock);
+            statsParams->nFramesEncoded = mStarted ? i_frame : 0;
+            statsParams->nMapCalls = mMapCalls;
+            statsParams->nUnmapCalls = mUnmapCalls;
+            statsParams->nMapFailures = mMapFailures;
+            statsParams->nMappedBuffers =
+                mMappedInputs.size() + mMappedGralloc.size();
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+}
+
+OMX_ERRORTYPE HardAVCEncoder::setConfig(
+        OMX_INDEXTYPE index, const OMX_PTR params) {
+    switch (index) {
+        case OMX_IndexConfigVideoBitrate:
+        {
+            const OMX_VIDEO_CONFIG_BITRATETYPE *bitRate =
+                (const OMX_VIDEO_CONFIG_BITRATETYPE *) params;
+
+            if (bitRate->nPortIndex != 1 || bitRate->nEncodeBitrate == 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            mVideoBitRate = bitRate->nEncodeBitrate;
+            mConfigChanged = true;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexConfigVideoFramerate:
+        {
+            const OMX_CONFIG_FRAMERATETYPE *frameRate =
+                (const OMX_CONFIG_FRAMERATETYPE *) params;
+
+            if (frameRate->nPortIndex != 1 ||
+                (frameRate->xEncodeFramerate >> 16) == 0) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            mVideoFrameRate = frameRate->xEncodeFramerate >> 16;
+            mConfigChanged = true;
+            return OMX_ErrorNone;
+        }
+
+        case OMX_IndexConfigVideoIntraVOPRefresh:
+        {
+            const OMX_CONFIG_INTRAREFRESHVOPTYPE *refresh =
+                (const OMX_CONFIG_INTRAREFRESHVOPTYPE *) params;
+
+            if (refresh->nPortIndex != 1) {
+                return OMX_ErrorUndefined;
+            }
+
+            Mutex::Autolock autoLock(mConfigLock);
+            if (refresh->IntraRefreshVOP) {
+                mKeyFrameRequested = true;
+            }
+            return OMX_ErrorNone;
+        }
+
+        default:
+            return OMX_ErrorUnsupportedIndex;
+    }
+}
+
 OMX_ERRORTYPE HardAVCEncoder::getExtensionIndex(
         const char *name, OMX_INDEXTYPE *index) {
     if (!strcmp(name, "OMX.google.android.index.storeMetaDataInBuffers")) {
@@ -941,11 +1366,139 @@ uint8_t *HardAVCEncoder::extractGrallocData(void *data, buffer_handle_t *buffer)
 }
 
 void HardAVCEncoder::releaseGrallocData(buffer_handle_t buffer) {
-    if (mStoreMetaDataInBuffers) {
+    if (mStoreMetaDataInBuffers && buffer != NULL) {
         GraphicBufferMapper::get().unlock(buffer);
     }
 }
 
+bool HardAVCEncoder::mapInputBuffer(OMX_BUFFERHEADERTYPE *header) {
+    Mutex::Autolock autoLock(mMapLock);
+    if (mMappedInputs.indexOfKey(header) >= 0) {
+        return true;
+    }
+
+    dmmu_mem_info info;
+    if (!mapLocked(header->pBuffer, header->nAllocLen, &info)) {
+        return false;
+    }
+    mMappedInputs.add(header, info);
+    return true;
+}
+
+bool HardAVCEncoder::mapGrallocBuffer(buffer_handle_t handle, uint8_t *vaddr) {
+    Mutex::Autolock autoLock(mMapLock);
+    ssize_t index = mMappedGralloc.indexOfKey(handle);
+    if (index >= 0) {
+        if (mMappedGralloc.valueAt(index).vaddr == vaddr) {
+            return true;
+        }
+
+        // gralloc handed out a different mapping for this handle, start over.
+        unmapLocked(&mMappedGralloc.editValueAt(index));
+        mMappedGralloc.removeItemsAt(index);
+    }
+
+    // Same layout the input port advertises: 384 bytes per macroblock.
+    size_t size = (((mVideoWidth + 15) >> 4) * ((mVideoHeight + 15) >> 4) * 3) << 7;
+    dmmu_mem_info info;
+    if (!mapLocked(vaddr, size, &info)) {
+        return false;
+    }
+    mMappedGralloc.add(handle, info);
+    return true;
+}
+
+bool HardAVCEncoder::mapLocked(void *vaddr, size_t size, dmmu_mem_info *info) {
+    memset(info, 0, sizeof(dmmu_mem_info));
+    info->vaddr = vaddr;
+    info->size = size;
+
+    ++mMapCalls;
+    if (dmmu_map_user_memory(info) < 0) {
+        ++mMapFailures;
+        ALOGE("dmmu_map_user_memory failed for input %p, %d bytes", vaddr, size);
+        return false;
+    }
+    return true;
+}
+
+void HardAVCEncoder::unmapLocked(dmmu_mem_info *info) {
+    ++mUnmapCalls;
+    if (dmmu_unmap_user_memory(info) < 0) {
+        ALOGE("dmmu_unmap_user_memory failed for input %p", info->vaddr);
+    }
+}
+
+void HardAVCEncoder::unmapAllInputs() {
+    Mutex::Autolock autoLock(mMapLock);
+    for (size_t i = 0; i < mMappedInputs.size(); i++) {
+        unmapLocked(&mMappedInputs.editValueAt(i));
+    }
+    mMappedInputs.clear();
+    unmapGrallocLocked();
+}
+
+void HardAVCEncoder::unmapGrallocLocked() {
+    for (size_t i = 0; i < mMappedGralloc.size(); i++) {
+        unmapLocked(&mMappedGralloc.editValueAt(i));
+    }
+    mMappedGralloc.clear();
+}
+
+OMX_ERRORTYPE HardAVCEncoder::freeBuffer(
+        OMX_U32 portIndex,
+        OMX_BUFFERHEADERTYPE *header) {
+    if (portIndex == 0) {
+        Mutex::Autolock autoLock(mMapLock);
+        ssize_t index = mMappedInputs.indexOfKey(header);
+        if (index >= 0) {
+            unmapLocked(&mMappedInputs.editValueAt(index));
+            mMappedInputs.removeItemsAt(index);
+        }
+    }
+
+    return SimpleHardOMXComponent::freeBuffer(portIndex, header);
+}
+
+void HardAVCEncoder::onPortFlushPrepare(OMX_U32 portIndex) {
+    if (portIndex != 0 || !mStarted) {
+        return;
+    }
+
+    // A retired frame still waiting for an output buffer goes with it.
+    if (mRetiredLength > 0) {
+        mRetiredLength = 0;
+        mInputBufferInfoVec.clear();
+    }
+    if (mPendingInput == NULL) {
+        return;
+    }
+
+    // Take the frame off the VPU before its input goes back to the client,
+    // the output of a flushed frame is dropped.
+    x264_picture_t pic_out;
+    x264_nal_t *nal;
+    int i_nal;
+    x264_encoder_retire(h, &nal, &i_nal, &pic_out);
+    if (mVpuLocked) {
+        UnLock_Vpu();
+        mVpuLocked = false;
+    }
+    releaseGrallocData(mPendingSrcBuffer);
+    mPendingInput = NULL;   // still ours, the flush returns it
+    mPendingSrcBuffer = NULL;
+    mInputBufferInfoVec.clear();
+}
+
+void HardAVCEncoder::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
+    if (portIndex == 0 && !enabled) {
+        // The camera or surface may hand out new buffers once the port
+        // comes back, drop the mappings of the old ones.
+        Mutex::Autolock autoLock(mMapLock);
+        unmapGrallocLocked();
+    }
+}
+
   void* VpuMem::vpu_mem_alloc(int size){
     mDevBuffers.push();
     MemoryHeapBase** devbuf = &mDevBuffers.editItemAt(mDevBuffers.size() - 1);
@@ -19,6 +19,8 @@
 
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
 #include <utils/Vector.h>
 #include "binder/MemoryHeapBase.h"
 #include "dmmu.h"
@@ -88,6 +90,19 @@ struct HardAVCEncoder : public MediaBufferObserver,
 
     // Override HardOMXComponent methods
 
+    virtual OMX_ERRORTYPE freeBuffer(
+            OMX_U32 portIndex,
+            OMX_BUFFERHEADERTYPE *header);
+
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
+
+    virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+
+    virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
+
+    virtual OMX_ERRORTYPE setConfig(
+            OMX_INDEXTYPE index, const OMX_PTR params);
+
     virtual OMX_ERRORTYPE getExtensionIndex(
             const char *name, OMX_INDEXTYPE *index);
 
@@ -123,6 +138,7 @@ private:
     int32_t  mVideoHeight;
     int32_t  mVideoFrameRate;
     int32_t  mVideoBitRate;
+    OMX_VIDEO_CONTROLRATETYPE mVideoControlRate;
     int32_t  mVideoColorFormat;
     bool     mStoreMetaDataInBuffers;
     int32_t  mIDRFrameRefreshIntervalInSec;
@@ -159,14 +175,61 @@ private:
        int32_t mNALUHasStartCode;
        int32_t mEncArgQP;
 
+    // Bitrate, frame rate and IDR requests from setConfig, picked up by
+    // onQueueFilled before the next frame is encoded.
+    Mutex    mConfigLock;
+    bool     mConfigChanged;
+    bool     mKeyFrameRequested;
+
+    // Input memory is DMMU mapped the first time it is encoded and stays
+    // mapped until its buffer is freed; gralloc sources until the input
+    // port is disabled or the component goes away.
+    Mutex    mMapLock;
+    KeyedVector<OMX_BUFFERHEADERTYPE *, dmmu_mem_info> mMappedInputs;
+    KeyedVector<buffer_handle_t, dmmu_mem_info> mMappedGralloc;
+    uint32_t mMapCalls;
+    uint32_t mUnmapCalls;
+    uint32_t mMapFailures;
+
+    // With the x264 VPU pipeline a frame is still on the VPU when
+    // x264_encoder_encode returns and its output comes with the next call,
+    // or with x264_encoder_retire once the input queue has run empty.
+    // Its input buffer is held until then, and the VPU stays locked for as
+    // long as x264 has a frame on it.
+    BufferInfo      *mPendingInput;
+    buffer_handle_t  mPendingSrcBuffer;
+    bool             mVpuLocked;
+    // A frame retired while no output buffer was queued, without its
+    // start codes, waiting for the next output buffer.
+    Vector<uint8_t>  mRetiredFrame;
+    int32_t          mRetiredLength;
+    OMX_U32          mRetiredFlags;
+
     void initPorts();
     OMX_ERRORTYPE initEncParams();
     OMX_ERRORTYPE initEncoder();
     OMX_ERRORTYPE releaseEncoder();
+    void reconfigEncoder();
+    int32_t getIDRPeriod() const;
+    void getRateKbps(int32_t *bitrate, int32_t *maxrate) const;
     void releaseOutputBuffers();
 
     uint8_t* extractGrallocData(void *data, buffer_handle_t *buffer);
+    bool mapInputBuffer(OMX_BUFFERHEADERTYPE *header);
+    bool mapGrallocBuffer(buffer_handle_t handle, uint8_t *vaddr);
+    bool mapLocked(void *vaddr, size_t size, dmmu_mem_info *info);
+    void unmapLocked(dmmu_mem_info *info);
+    void unmapGrallocLocked();
+    void unmapAllInputs();
     void releaseGrallocData(buffer_handle_t buffer);
+    void releasePendingInput();
+    void unlockVpuIfIdle();
+    void retireInFlightFrame();
+    void emitRetiredFrame();
+    int32_t copyFrameNals(
+            uint8_t *dst, uint32_t capacity, OMX_U32 *flags,
+            x264_nal_t *nal, int i_nal);
+    void drainEncoder();
 
     DISALLOW_EVIL_CONSTRUCTORS(HardAVCEncoder);
 };
@@ -143,7 +143,12 @@ static inline int x264_pthread_create( x264_pthread_t *t, void *a, void *(*f)(vo
 #define X264_PTHREAD_MUTEX_INITIALIZER 0
 #endif
 
+#ifdef X264_VPU_HOST
+/* bs_write only has the 32-bit path of the device, keep it on a 64-bit host */
+#define WORD_SIZE 4
+#else
 #define WORD_SIZE sizeof(void*)
+#endif
 
 #if !defined(_WIN64) && !defined(__LP64__)
 #if defined(__INTEL_COMPILER)
@@ -51,8 +51,10 @@ static unsigned int GetTimer(void){
 /* ******************************  HW  **************************** */
 #include "soc/config_jz_soc.h"
 #include "soc/jz47_vae_map.h"
+#ifndef X264_VPU_HOST
 #include <jzmedia.h>
 #include <jzasm.h>
+#endif
 #include <jzm_vpu.h>
 
 // common include files
@@ -62,6 +64,14 @@ static unsigned int GetTimer(void){
 #include "soc/tile.c"
 #include "soc/pixel_check.c"
 
+#ifdef X264_VPU_HOST
+/* no cache to maintain when the "VPU" is the CPU itself */
+#undef jz_dcache_wb
+#define jz_dcache_wb()
+#include "soc/vpu_model.c"
+#include "soc/vpu_sim.c"
+#endif
+
 extern int tcsm_fd;
 extern volatile unsigned char * vpu_base;
 extern volatile unsigned char * sde_base;
@@ -117,6 +127,7 @@ extern void *jz4740_alloc_frame (int *VpuMem_ptr, int align, int size);
 static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
                                    x264_nal_t **pp_nal, int *pi_nal,
                                    x264_picture_t *pic_out );
+static const x264_vpu_backend_t *x264_vpu_backend_get( const char *name );
 
 /****************************************************************************
  *
@@ -893,6 +904,7 @@ static void x264_set_aspect_ratio( x264_t *h, x264_param_t *param, int initial )
 static int x264_init_jz4780(x264_t * h)
 {
     volatile uint8_t *ptr;
+    int i;
     int width = h->sps->i_mb_width;
     int height = h->sps->i_mb_height;
 
@@ -922,29 +934,44 @@ static int x264_init_jz4780(x264_t * h)
     s->H264E_SliceInfo.fb[1][1] = s->fb_ptr[1][1];
     //fprintf(stderr, "H264E_SliceInfo.fb[1]: %08x, %08x\n", s->H264E_SliceInfo.fb[1][0], s->H264E_SliceInfo.fb[1][1]);
     
-    // input
-    ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, ((width*16)*(height*16) + 1024) );
-    s->fb_ptr[2][0] = (uint8_t *)(ptr + 256);
+    // input, BS and vdma space, one set per pipeline slot
+    for( i = 0; i < 2; i++ ){
+        ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, ((width*16)*(height*16) + 1024) );
+        s->raw_ptr[i][0] = (uint8_t *)(ptr + 256);
+
+        ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, ((width*16)*(height*8) + 1024) );
+        s->raw_ptr[i][1] = (uint8_t *)(ptr + 256);
+
+        ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, X264_VPU_BS_SIZE );
+        s->bs_ptr[i] = (uint8_t *)ptr;
+
+        s->vdma_config[i] = (unsigned int *)jz4740_alloc_frame(h->param.VpuMem_ptr, 128, X264_VDMA_SIZE);
+        //fprintf(stderr, "vdma_config[%d]: %08x\n", i, (unsigned int)s->vdma_config[i]);
+        if( s->vdma_config[i] == NULL ){
+            printf("alloc vdma_config error!\n");
+            return -1;
+        }
+    }
+
+    s->i_slot = 0;
+    s->b_inflight = 0;
+    s->fb_ptr[2][0] = s->raw_ptr[0][0];
+    s->fb_ptr[2][1] = s->raw_ptr[0][1];
     s->H264E_SliceInfo.fb[2][0] = s->fb_ptr[2][0];
-    
-    ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, ((width*16)*(height*8) + 1024) );
-    s->fb_ptr[2][1] = (uint8_t *)(ptr + 256);
     s->H264E_SliceInfo.fb[2][1] = s->fb_ptr[2][1];
-    //fprintf(stderr, "H264E_SliceInfo.fb[2]: %08x, %08x\n", s->H264E_SliceInfo.fb[2][0], s->H264E_SliceInfo.fb[2][1]);
-
-    // BS
-    ptr = (uint8_t *)jz4740_alloc_frame(h->param.VpuMem_ptr, 256, (0x1<<20) );
-    s->bs_ptr = (uint8_t *)ptr;
-    s->H264E_SliceInfo.bs = s->bs_ptr;
-    //fprintf(stderr, "H264E_SliceInfo.bs: %08x\n", s->H264E_SliceInfo.bs);
-
-    // vdma space
-    s->vdma_config = (unsigned int *)jz4740_alloc_frame(h->param.VpuMem_ptr, 128, 0x5000);
-    //fprintf(stderr, "vdma_config: %08x\n", (unsigned int)s->vdma_config);
-    if( s->vdma_config == NULL ){
-        printf("alloc vdma_config error!\n");
+    s->H264E_SliceInfo.bs = s->bs_ptr[0];
+
+    s->i_nal_allocated = h->out.i_nals_allocated;
+    s->nal = x264_malloc( s->i_nal_allocated * sizeof(x264_nal_t) );
+    if( !s->nal )
+        return -1;
+
+    s->vpu = x264_vpu_backend_get( getenv("X264_VPU_BACKEND") );
+    if( !s->vpu ){
+        printf("unknown vpu backend %s!\n", getenv("X264_VPU_BACKEND"));
         return -1;
     }
+    ALOGI("x264 vpu backend: %s", s->vpu->name);
 
     return 0;
 }
@@ -1180,7 +1207,9 @@ x264_t *x264_encoder_open( x264_param_t *param )
 
 
     //****** vae map addr ********************************
+#ifndef X264_VPU_HOST
     S32I2M(xr16, 0x7);
+#endif
 
 #ifdef JZC_PMON_P0
     pmon_reset();
@@ -1254,11 +1283,28 @@ int x264_encoder_reconfig( x264_t *h, x264_param_t *param )
     COPY( i_slice_max_size );
     COPY( i_slice_max_mbs );
     COPY( i_slice_count );
+    COPY( i_keyint_max );
+    COPY( i_keyint_min );
+    COPY( i_fps_num );
+    COPY( i_fps_den );
+    /* bitrate and VBV can be retargeted, but not switched on or off */
+    if( h->param.rc.i_rc_method == X264_RC_ABR )
+    {
+        COPY( rc.i_bitrate );
+        if( h->param.rc.i_vbv_buffer_size && param->rc.i_vbv_buffer_size )
+        {
+            COPY( rc.i_vbv_max_bitrate );
+            COPY( rc.i_vbv_buffer_size );
+        }
+    }
 #undef COPY
 
     mbcmp_init( h );
 
-    return x264_validate_parameters( h );
+    if( x264_validate_parameters( h ) < 0 )
+        return -1;
+    x264_ratecontrol_init_reconfigure( h, 0 );
+    return 0;
 }
 
 /* internal usage */
@@ -1826,16 +1872,151 @@ static void dump_frame_data( x264_t * h, uint8_t * Y, uint8_t * C )
     return 0;
 }
 
-static int x264_slice_write_hw( x264_t *h )
+/* pick the pipeline slot for the next frame: the VPU may still be reading the other one */
+static void x264_vpu_next_slot( x264_t *h )
 {
-    int i, j; 
-    int bs_len = 0;
+    HwInfo_t * s = (HwInfo_t *)h->hwinfo;
+
+    s->i_slot ^= 1;
+    s->fb_ptr[2][0] = s->raw_ptr[s->i_slot][0];
+    s->fb_ptr[2][1] = s->raw_ptr[s->i_slot][1];
+    s->H264E_SliceInfo.fb[2][0] = s->fb_ptr[2][0];
+    s->H264E_SliceInfo.fb[2][1] = s->fb_ptr[2][1];
+    s->H264E_SliceInfo.bs = s->bs_ptr[s->i_slot];
+}
 
+#ifdef X264_VPU_PIPELINE
+/* tile a file/yuv input into the slot x264_vpu_next_slot will hand out,
+ * called while the VPU still encodes the previous frame */
+static void x264_vpu_load_input( x264_t *h, x264_frame_t *frame )
+{
     HwInfo_t * s = (HwInfo_t *)h->hwinfo;
-    _H264E_SliceInfo * sliceinfo = &s->H264E_SliceInfo;
+    int slot = s->i_slot ^ 1;
+
+#ifdef JZC_PMON_P0
+    PMON_ON(copy);
+#endif
+    tile_stuff((uint8_t *)s->raw_ptr[slot][0], (uint8_t *)s->raw_ptr[slot][1],
+	       frame->plane[0], frame->plane[1], frame->plane[2],
+	       frame->i_stride[0], frame->i_stride[1],
+	       h->sps->i_mb_height, h->sps->i_mb_width, 0);
+    jz_dcache_wb();
+#ifdef JZC_PMON_P0
+    PMON_OFF(copy);
+#endif
+}
+#endif
+
+#ifndef X264_VPU_HOST
+static void x264_vpu_mmio_kick( _H264E_SliceInfo *sliceinfo )
+{
     unsigned int tlb_addr = 0;
+
+    //clear state
+    //*(volatile unsigned int *)(dblk_base + 0x70) = 0x0;  //this way maybe not very clean
+    //*(volatile unsigned int *)(sde_base + 0x0) = 0x0;
+    //*(volatile unsigned int *)(vpu_base + 0x34) = 0x0;
+
+    EL("clear state...");
+    RST_VPU();
+
+    /* --------------- start ACFG config -------------- */
+    // open sch interrupt and close TLB before VDMA config, then VDMA will config regs without TLB
+    // Or we are not ensure the TLB is not enable, which may bring out error.
+    // write_vpu_reg(vpu_base+ REG_SCH_GLBC, (SCH_INTE_ACFGERR | SCH_INTE_BSERR | SCH_INTE_ENDF) );
+    EL("write state ....!");
+    write_vpu_reg(vpu_base + REG_SCH_GLBC, SCH_GLBC_HIAXI
+		  | SCH_GLBC_TLBE | SCH_GLBC_TLBINV
+		  | SCH_INTE_ACFGERR | SCH_INTE_TLBERR | SCH_INTE_BSERR | SCH_INTE_ENDF
+		  );
+
+    dmmu_get_page_table_base_phys(&tlb_addr);
+    EL("[ %s ] Get tlb phy addr : 0x%08x", __FUNCTION__, tlb_addr);
+    write_vpu_reg(vpu_base + REG_SCH_TLBA, tlb_addr);
+
+    EL("x264 start vdma!");
+    write_vpu_reg(gp0_base + 0x8, (VDMA_ACFG_DHA(sliceinfo->des_pa) | VDMA_ACFG_RUN));
+}
+
+/* wait for the kicked slice and return its bitstream length */
+static int x264_vpu_mmio_wait( void )
+{
     unsigned int vpu_status = 0;
 
+    //-------- waiting for end
+    //while( (read_vpu_reg(gp0_base + 0xC, 0) & 0x4) == 0x0 );
+/*  EL("config end [state] vdma=%x, sde=%x, vpu=%x\n", read_vpu_reg(gp0_base + 0xC, 0), read_vpu_reg(sde_base + 0x0, 0), read_vpu_reg(vpu_base + 0x34, 0)); */
+
+    //wait
+    unsigned int time, time1;
+    time = GetTimer();
+
+#ifdef X264_POLL
+    do {
+	vpu_status = (read_vpu_reg(vpu_base + 0x34, 0x0) & 0x1);
+	/* ALOGE("vpu status=0x%x,vdma status=0x%x,vdma dha=0x%x, sde status = 0x%08x, sde id=0x%x, sde bsaddr=0x%x, GEO = 0x%08x, efe status : 0x%08x", */
+	/*      *(volatile unsigned int *)(vpu_base + 0x34), */
+	/*      *(volatile unsigned int *)(gp0_base + 0xC), */
+	/*      *(volatile unsigned int *)(gp0_base + 0x8), */
+	/*      *(volatile unsigned int *)(sde_base + 0x0), */
+	/*      *(volatile unsigned int *)(sde_base + 0x10), */
+	/*      *(volatile unsigned int *)(sde_base + 0x24), */
+	/*      *(volatile unsigned int *)(dblk0_base + 0x7C), */
+	/*      *(volatile unsigned int *)(efe_base + 0x110) */
+	/*      ); */
+    } while( vpu_status == 0 );
+    time1 = GetTimer();
+    EL("[ Polling ]wait vpu %d us end ...", time1 - time);
+#else
+    ioctl(tcsm_fd, 0, &vpu_status);
+    time1 = GetTimer();
+    if( vpu_status & 0x1 ) {
+	EL("[ Interrupt ] wait vpu %d us end ...", time1 - time);
+    } else { // print error status
+	ALOGE("vpu status = 0x%x, vdma status = 0x%x, vdma dha = 0x%x, sde id = 0x%x, sde bsaddr = 0x%x",
+	     *(volatile unsigned int *)(vpu_base + 0x34),
+	     *(volatile unsigned int *)(gp0_base + 0xC),
+	     *(volatile unsigned int *)(gp0_base + 0x8),
+	     *(volatile unsigned int *)(sde_base + 0x10),
+	     *(volatile unsigned int *)(sde_base + 0x24)
+	     );
+    }
+#endif
+
+    return read_vpu_reg(sde_base + 0x38, 0x0) & 0xFFFFFF;
+}
+#endif //X264_VPU_HOST
+
+/* the first one built is the default, X264_VPU_BACKEND (environment) picks another */
+static const x264_vpu_backend_t x264_vpu_backends[] = {
+#ifndef X264_VPU_HOST
+    { "mmio",  x264_vpu_mmio_kick, x264_vpu_mmio_wait },
+#else
+    { "model", vpu_model_kick, vpu_model_wait },
+    { "sim",   vpu_sim_kick,   vpu_sim_wait },
+#endif
+};
+
+static const x264_vpu_backend_t *x264_vpu_backend_get( const char *name )
+{
+    int i;
+
+    if( !name || !*name )
+        return &x264_vpu_backends[0];
+    for( i = 0; i < (int)(sizeof(x264_vpu_backends)/sizeof(x264_vpu_backends[0])); i++ )
+        if( !strcmp( x264_vpu_backends[i].name, name ) )
+            return &x264_vpu_backends[i];
+    return NULL;
+}
+
+/* CPU half of a slice: header, input, descriptor chain, then start the VPU */
+static int x264_slice_start_hw( x264_t *h )
+{
+    int i, j; 
+
+    HwInfo_t * s = (HwInfo_t *)h->hwinfo;
+    _H264E_SliceInfo * sliceinfo = &s->H264E_SliceInfo;
+
     EL("start slice write");
       /* Slice */
     x264_nal_start( h, h->i_nal_type, h->i_nal_ref_idc );
@@ -1885,12 +2066,14 @@ static int x264_slice_write_hw( x264_t *h )
 	sliceinfo->fb[2][1] = h->raw_yuv422_ptr + h->sps->i_mb_height * h->sps->i_mb_width * 64;
 	  //ALOGE("Got h->param.i_csp == X264_CSP_YUYV, Y : 0x%08x, C : 0x%08x", s->fb_ptr[2][0], s->fb_ptr[2][1]);
     } else { // get from file *.yuv
+#ifndef X264_VPU_PIPELINE
 	tile_stuff((uint8_t *)s->fb_ptr[2][0], (uint8_t *)s->fb_ptr[2][1],
 		   h->fenc->plane[0], h->fenc->plane[1], h->fenc->plane[2], 
 		   h->fdec->i_stride[0], h->fdec->i_stride[1],
 		   h->sps->i_mb_height, h->sps->i_mb_width, 0);
 
 	jz_dcache_wb();
+#endif // otherwise already tiled by x264_vpu_load_input
     }
 
 #ifdef JZC_PMON_P0
@@ -1913,11 +2096,11 @@ static int x264_slice_write_hw( x264_t *h )
 
     // cabac init
     sliceinfo->state = &h->cabac.state[0];
+    // frame QP from x264_ratecontrol_start, set by x264_slice_init
     sliceinfo->qp = h->sh.i_qp;
-    //sliceinfo->qp = x264_ratecontrol_qp( h ); //h->rc->qpm
 
-    sliceinfo->des_va = s->vdma_config;
-    sliceinfo->des_pa = s->vdma_config;
+    sliceinfo->des_va = s->vdma_config[s->i_slot];
+    sliceinfo->des_pa = s->vdma_config[s->i_slot];
 
     for(j=0; j<4; j++)
         for(i=0; i<16; i++)
@@ -1927,96 +2110,51 @@ static int x264_slice_write_hw( x264_t *h )
     H264E_SliceInit(sliceinfo);
     jz_dcache_wb();
 
-    //clear state
-    //*(volatile unsigned int *)(dblk_base + 0x70) = 0x0;  //this way maybe not very clean
-    //*(volatile unsigned int *)(sde_base + 0x0) = 0x0;
-    //*(volatile unsigned int *)(vpu_base + 0x34) = 0x0;
-
-    EL("clear state...");
-    RST_VPU();
-
-    /* --------------- start ACFG config -------------- */
-    // open sch interrupt and close TLB before VDMA config, then VDMA will config regs without TLB
-    // Or we are not ensure the TLB is not enable, which may bring out error.
-    // write_vpu_reg(vpu_base+ REG_SCH_GLBC, (SCH_INTE_ACFGERR | SCH_INTE_BSERR | SCH_INTE_ENDF) );
-    EL("write state ....!");
-    write_vpu_reg(vpu_base + REG_SCH_GLBC, SCH_GLBC_HIAXI
-		  | SCH_GLBC_TLBE | SCH_GLBC_TLBINV
-		  | SCH_INTE_ACFGERR | SCH_INTE_TLBERR | SCH_INTE_BSERR | SCH_INTE_ENDF
-		  );
-
-    dmmu_get_page_table_base_phys(&tlb_addr);
-    EL("[ %s ] Get tlb phy addr : 0x%08x", __FUNCTION__, tlb_addr);
-    write_vpu_reg(vpu_base + REG_SCH_TLBA, tlb_addr);
-        
 #ifdef JZC_PMON_P0
     PMON_ON(hw);
 #endif
-    EL("x264 start vdma!");
-    write_vpu_reg(gp0_base + 0x8, (VDMA_ACFG_DHA(sliceinfo->des_pa) | VDMA_ACFG_RUN));
+    s->vpu->kick(sliceinfo);
+    s->b_inflight = 1;
 
-    //-------- waiting for end
-    //while( (read_vpu_reg(gp0_base + 0xC, 0) & 0x4) == 0x0 );
-/*  EL("config end [state] vdma=%x, sde=%x, vpu=%x\n", read_vpu_reg(gp0_base + 0xC, 0), read_vpu_reg(sde_base + 0x0, 0), read_vpu_reg(vpu_base + 0x34, 0)); */
+    return 0;
+}
 
-    //wait
-    unsigned int time, time1;
-    time = GetTimer();
+/* VPU half of a slice: wait for it and append its bitstream to h->out */
+static int x264_slice_finish_hw( x264_t *h )
+{
+    int bs_len = 0;
 
-#ifdef X264_POLL
-    do {
-	vpu_status = (read_vpu_reg(vpu_base + 0x34, 0x0) & 0x1);
-	/* ALOGE("vpu status=0x%x,vdma status=0x%x,vdma dha=0x%x, sde status = 0x%08x, sde id=0x%x, sde bsaddr=0x%x, GEO = 0x%08x, efe status : 0x%08x", */
-	/*      *(volatile unsigned int *)(vpu_base + 0x34), */
-	/*      *(volatile unsigned int *)(gp0_base + 0xC), */
-	/*      *(volatile unsigned int *)(gp0_base + 0x8), */
-	/*      *(volatile unsigned int *)(sde_base + 0x0), */
-	/*      *(volatile unsigned int *)(sde_base + 0x10), */
-	/*      *(volatile unsigned int *)(sde_base + 0x24), */
-	/*      *(volatile unsigned int *)(dblk0_base + 0x7C), */
-	/*      *(volatile unsigned int *)(efe_base + 0x110) */
-	/*      ); */
-    } while( vpu_status == 0 );
-    time1 = GetTimer();
-    EL("[ Polling ]wait vpu %d us end ...", time1 - time);
-#else
-    ioctl(tcsm_fd, 0, &vpu_status);
-    time1 = GetTimer();
-    if( vpu_status & 0x1 ) {
-	EL("[ Interrupt ] wait vpu %d us end ...", time1 - time);
-    } else { // print error status
-	ALOGE("vpu status = 0x%x, vdma status = 0x%x, vdma dha = 0x%x, sde id = 0x%x, sde bsaddr = 0x%x",
-	     *(volatile unsigned int *)(vpu_base + 0x34),
-	     *(volatile unsigned int *)(gp0_base + 0xC),
-	     *(volatile unsigned int *)(gp0_base + 0x8),
-	     *(volatile unsigned int *)(sde_base + 0x10),
-	     *(volatile unsigned int *)(sde_base + 0x24)
-	     );
-    }
-#endif
+    HwInfo_t * s = (HwInfo_t *)h->hwinfo;
+    unsigned char * bs_ptr = s->bs_ptr[s->i_slot];
 
-    bs_len = read_vpu_reg(sde_base + 0x38, 0x0) & 0xFFFFFF;
+    bs_len = s->vpu->wait();
+    s->b_inflight = 0;
 #ifdef JZC_PMON_P0
     PMON_OFF(hw);
 #endif
     EL("bs_len = 0x%x", bs_len);
+    if( bs_len < 0 ){
+        ALOGE("[ %s ] vpu %s failed the slice", __FUNCTION__, s->vpu->name);
+        return -1;
+    }
     jz_dcache_wb();
 
     if ( h->out.bs.i_left == 32 ){
-        memcpy(h->out.bs.p, s->bs_ptr, bs_len);
+        memcpy(h->out.bs.p, bs_ptr, bs_len);
         h->out.bs.p += bs_len;
         EL("[ bs ] fast copy complete", h->out.bs.i_left);
     } else {
         int length = bs_len;
-        volatile unsigned char * bit_ptr = s->bs_ptr;
+        volatile unsigned char * bit_ptr = bs_ptr;
         while( length-- )
             bs_write(&h->out.bs, 8, *bit_ptr++);
         bs_rbsp_trailing(&h->out.bs);
     }
 
 #ifdef CRC_CHECK_n
+    _H264E_SliceInfo * sliceinfo = &s->H264E_SliceInfo;
     bs_total_len += bs_len;
-    bs_crc = crc(s->bs_ptr, bs_len, bs_crc);
+    bs_crc = crc(bs_ptr, bs_len, bs_crc);
     EL("bs crc = %d", bs_crc);
     dec_y_crc = crc(s->fb_ptr[0][0], sliceinfo->mb_width*sliceinfo->mb_height*256, dec_y_crc);
     dec_c_crc = crc(s->fb_ptr[0][1], sliceinfo->mb_width*sliceinfo->mb_height*128, dec_c_crc);
@@ -2028,6 +2166,58 @@ static int x264_slice_write_hw( x264_t *h )
     return 0;
 }
 
+static int x264_slice_write_hw( x264_t *h )
+{
+    HwInfo_t * s = (HwInfo_t *)h->hwinfo;
+
+    /* an earlier slice of this frame, its NAL has to be closed before the next header */
+    if( s->b_inflight && x264_slice_finish_hw( h ) )
+        return -1;
+    if( x264_slice_start_hw( h ) )
+        return -1;
+#ifdef X264_VPU_PIPELINE
+    /* the last slice is collected by x264_vpu_retire once the next input is loaded */
+    return 0;
+#else
+    return x264_slice_finish_hw( h );
+#endif
+}
+
+#ifdef X264_VPU_PIPELINE
+/* finish the frame left on the VPU by the previous x264_encoder_encode call */
+static int x264_vpu_retire( x264_t *h, x264_nal_t **pp_nal, int *pi_nal,
+                            x264_picture_t *pic_out )
+{
+    HwInfo_t * s = (HwInfo_t *)h->hwinfo;
+    int frame_size;
+
+    if( !s->b_inflight )
+    {
+        pic_out->i_type = X264_TYPE_AUTO;
+        return 0;
+    }
+    if( x264_slice_finish_hw( h ) )
+        return -1;
+
+    frame_size = x264_encoder_frame_end( h, h, pp_nal, pi_nal, pic_out );
+    if( frame_size < 0 || !*pi_nal )
+        return frame_size;
+
+    if( s->i_nal_allocated < *pi_nal )
+    {
+        x264_free( s->nal );
+        s->nal = x264_malloc( *pi_nal * sizeof(x264_nal_t) );
+        if( !s->nal )
+            return -1;
+        s->i_nal_allocated = *pi_nal;
+    }
+    memcpy( s->nal, *pp_nal, *pi_nal * sizeof(x264_nal_t) );
+    *pp_nal = s->nal;
+
+    return frame_size;
+}
+#endif
+
 static void x264_thread_sync_context( x264_t *dst, x264_t *src )
 {
     if( dst == src )
@@ -2066,6 +2256,10 @@ static void *x264_slices_write( x264_t *h )
     memset( &h->stat.frame, 0, sizeof(h->stat.frame) );
     h->mb.b_reencode_mb = 0;
 
+#ifndef SW_VMAU
+    x264_vpu_next_slot( h );
+#endif
+
     while( h->sh.i_first_mb <= last_thread_mb )
     {
         h->sh.i_last_mb = last_thread_mb;
@@ -2174,6 +2368,7 @@ int     x264_encoder_encode( x264_t *h,
 {
     x264_t *thread_current, *thread_prev, *thread_oldest;
     int i_nal_type, i_nal_ref_idc, i_global_qp, i;
+    int i_frame_size = 0;
 
     if( h->param.i_threads > 1 && !h->param.b_sliced_threads )
     {
@@ -2191,16 +2386,19 @@ int     x264_encoder_encode( x264_t *h,
         thread_oldest  = h;
     }
 
+#ifndef X264_VPU_PIPELINE
     // ok to call this before encoding any frames, since the initial values of fdec have b_kept_as_ref=0
     if( x264_reference_update( h ) )
         return -1;
     h->fdec->i_lines_completed = -1;
+#endif
 
     /* no data out */
     *pi_nal = 0;
     *pp_nal = NULL;
 
-    pic_in->img.i_csp = h->param.i_csp;
+    if( pic_in != NULL )
+        pic_in->img.i_csp = h->param.i_csp;
 
     /* ------------------- Setup new frame from picture -------------------- */
     if( pic_in != NULL )
@@ -2240,6 +2438,9 @@ int     x264_encoder_encode( x264_t *h,
               h->param.i_height != 16 * h->sps->i_mb_height )
               x264_frame_expand_border_mod16( h, fenc );
 
+#ifdef X264_VPU_PIPELINE
+	  x264_vpu_load_input( h, fenc );
+#endif
 	}
 
         fenc->i_frame = h->frames.i_input++;
@@ -2280,13 +2481,29 @@ int     x264_encoder_encode( x264_t *h,
         x264_pthread_mutex_unlock( &h->lookahead->ifbuf.mutex );
     }
 
+#ifdef X264_VPU_PIPELINE
+    /* the input is loaded, now take the previous frame off the VPU.
+     * Its NALs are what this call returns. */
+    i_frame_size = x264_vpu_retire( h, pp_nal, pi_nal, pic_out );
+    if( i_frame_size < 0 )
+        return -1;
+
+    if( x264_reference_update( h ) )
+        return -1;
+    h->fdec->i_lines_completed = -1;
+#endif
+
     h->i_frame++;
     /* 3: The picture is analyzed in the lookahead */
      if( !h->frames.current[0] ) 
          x264_lookahead_get_frames( h ); 
 
      if( !h->frames.current[0] && x264_lookahead_is_empty( h ) ) 
+     {
+         if( *pi_nal )
+             return i_frame_size;
          return x264_encoder_frame_end( thread_oldest, thread_current, pp_nal, pi_nal, pic_out ); 
+     }
 
     /* ------------------- Get frame to be encoded ------------------------- */
     /* 4: get picture to encode */
@@ -2353,7 +2570,7 @@ int     x264_encoder_encode( x264_t *h,
     h->fenc->b_kept_as_ref =
     h->fdec->b_kept_as_ref = i_nal_ref_idc != NAL_PRIORITY_DISPOSABLE && h->param.i_keyint_max > 1;
 
-    if(pic_in->img.i_csp == X264_CSP_YUYV){
+    if(h->param.i_csp == X264_CSP_YUYV){
       h->fenc->b_kept_as_ref = 0;
     }
 
@@ -2493,7 +2710,12 @@ int     x264_encoder_encode( x264_t *h,
         if( (intptr_t)x264_slices_write( h ) )
             return -1;
 
+#ifdef X264_VPU_PIPELINE
+    /* left on the VPU, retired by the next call */
+    return i_frame_size;
+#else
     return x264_encoder_frame_end( thread_oldest, thread_current, pp_nal, pi_nal, pic_out );
+#endif
 }
 
 static int x264_encoder_frame_end( x264_t *h, x264_t *thread_current,
@@ -2732,6 +2954,14 @@ void    x264_encoder_close  ( x264_t *h )
 
     x264_lookahead_delete( h );
 
+#ifdef HW_4780
+    /* don't release buffers the VPU may still be writing */
+    if( ((HwInfo_t *)h->hwinfo)->b_inflight )
+        ((HwInfo_t *)h->hwinfo)->vpu->wait();
+    x264_free( ((HwInfo_t *)h->hwinfo)->nal );
+    free( h->hwinfo );
+#endif
+
     for( i = 0; i < h->param.i_threads; i++ )
     {
         // don't strictly have to wait for the other threads, but it's simpler than canceling them
@@ -3040,6 +3270,24 @@ void    x264_encoder_close  ( x264_t *h )
 
 }
 
+/****************************************************************************
+ * x264_encoder_retire:
+ ****************************************************************************/
+int x264_encoder_retire( x264_t *h, x264_nal_t **pp_nal, int *pi_nal,
+                         x264_picture_t *pic_out )
+{
+    *pi_nal = 0;
+    *pp_nal = NULL;
+#ifdef X264_VPU_PIPELINE
+    /* the next x264_encoder_encode finds nothing in flight and only
+     * starts its own frame */
+    return x264_vpu_retire( h, pp_nal, pi_nal, pic_out );
+#else
+    pic_out->i_type = X264_TYPE_AUTO;
+    return 0;
+#endif
+}
+
 /****************************************************************************
  * x264_encoder_delayed_frames:
  ****************************************************************************/
@@ -3049,6 +3297,9 @@ int x264_encoder_delayed_frames( x264_t *h )
     int i;
     for( i=0; i<h->param.i_threads; i++ )
         delayed_frames += h->thread[i]->b_thread_active;
+#ifdef HW_4780
+    delayed_frames += ((HwInfo_t *)h->hwinfo)->b_inflight;
+#endif
     h = h->thread[h->i_thread_phase];
     for( i=0; h->frames.current[i]; i++ )
         delayed_frames++;
@@ -3065,7 +3316,7 @@ int x264_encoder_delayed_frames( x264_t *h )
 
 static void zigzag_scan_4x4_hw( int16_t level[16], const int16_t dct[16] )
 {
-#if 0
+#ifdef X264_VPU_HOST
     level[0]  = dct[0]; level[1]  = dct[1];  level[2]  = dct[4];  level[3]  = dct[8]; 
     level[4]  = dct[5]; level[5]  = dct[2];  level[6]  = dct[3];  level[7]  = dct[6]; 
     level[8]  = dct[9]; level[9]  = dct[12]; level[10] = dct[13]; level[11] = dct[10];
@@ -3104,7 +3355,7 @@ static void zigzag_scan_4x4_hw( int16_t level[16], const int16_t dct[16] )
 
 static inline void zigzag_scan_2x2_dc_hw( int16_t level[4], const int16_t dct[4] )
 {
-#if 0
+#ifdef X264_VPU_HOST
     level[0] = dct[0];
     level[1] = dct[1];
     level[2] = dct[2];
@@ -103,6 +103,7 @@ struct x264_ratecontrol_t
     double cplxr_sum;           /* sum of bits*qscale/rceq */
     double expected_bits_sum;   /* sum of qscale2bits after rceq, ratefactor, and overflow, only includes finished frames */
     double wanted_bits_window;  /* target bitrate * window */
+    double wanted_bits;         /* target bits of the frames finished so far */
     double cbr_decay;
     double short_term_cplxsum;
     double short_term_cplxcount;
@@ -379,6 +380,61 @@ static char *x264_strcat_filename( char *input, char *suffix )
     return output;
 }
 
+/* Frame rate, bitrate and VBV state, recomputed when x264_encoder_reconfig
+ * changes them mid-stream. The buffer keeps its relative fullness, and the
+ * ABR window is rescaled so the next frame already aims at the new budget. */
+void x264_ratecontrol_init_reconfigure( x264_t *h, int b_init )
+{
+    x264_ratecontrol_t *rc = h->rc;
+    double old_frame_bits = rc->fps > 0 ? rc->bitrate / rc->fps : 0;
+    double old_fill = rc->buffer_size > 0 ? rc->buffer_fill_final / rc->buffer_size : 0;
+
+    /* FIXME: use integers */
+    if(h->param.i_fps_num > 0 && h->param.i_fps_den > 0)
+        rc->fps = (float) h->param.i_fps_num / h->param.i_fps_den;
+    else
+        rc->fps = 25.0;
+    rc->bitrate = h->param.rc.i_bitrate * 1000.;
+
+    if( h->param.rc.i_vbv_max_bitrate < h->param.rc.i_bitrate &&
+        h->param.rc.i_vbv_max_bitrate > 0)
+        x264_log(h, X264_LOG_WARNING, "max bitrate less than average bitrate, ignored.\n");
+    else if( h->param.rc.i_vbv_max_bitrate > 0 &&
+             h->param.rc.i_vbv_buffer_size > 0 )
+    {
+        if( h->param.rc.i_vbv_buffer_size < (int)(h->param.rc.i_vbv_max_bitrate / rc->fps) )
+        {
+            h->param.rc.i_vbv_buffer_size = h->param.rc.i_vbv_max_bitrate / rc->fps;
+            x264_log( h, X264_LOG_WARNING, "VBV buffer size cannot be smaller than one frame, using %d kbit\n",
+                      h->param.rc.i_vbv_buffer_size );
+        }
+        if( h->param.rc.f_vbv_buffer_init > 1. )
+            h->param.rc.f_vbv_buffer_init = x264_clip3f( h->param.rc.f_vbv_buffer_init / h->param.rc.i_vbv_buffer_size, 0, 1 );
+        rc->buffer_rate = h->param.rc.i_vbv_max_bitrate * 1000. / rc->fps;
+        rc->buffer_size = h->param.rc.i_vbv_buffer_size * 1000.;
+        rc->single_frame_vbv = rc->buffer_rate * 1.1 > rc->buffer_size;
+        h->param.rc.f_vbv_buffer_init = X264_MAX( h->param.rc.f_vbv_buffer_init, rc->buffer_rate / rc->buffer_size );
+        if( b_init )
+            rc->buffer_fill_final = rc->buffer_size * h->param.rc.f_vbv_buffer_init;
+        else
+            rc->buffer_fill_final = rc->buffer_size * old_fill;
+        rc->cbr_decay = 1.0 - rc->buffer_rate / rc->buffer_size
+                      * 0.5 * X264_MAX(0, 1.5 - rc->buffer_rate * rc->fps / rc->bitrate);
+        rc->b_vbv = 1;
+        rc->b_vbv_min_rate = !rc->b_2pass
+                          && h->param.rc.i_rc_method == X264_RC_ABR
+                          && h->param.rc.i_vbv_max_bitrate <= h->param.rc.i_bitrate;
+    }
+    else if( h->param.rc.i_vbv_max_bitrate )
+    {
+        x264_log(h, X264_LOG_WARNING, "VBV maxrate specified, but no bufsize.\n");
+        h->param.rc.i_vbv_max_bitrate = 0;
+    }
+
+    if( !b_init && rc->b_abr && !rc->b_2pass && old_frame_bits > 0 )
+        rc->wanted_bits_window *= rc->bitrate / rc->fps / old_frame_bits;
+}
+
 int x264_ratecontrol_new( x264_t *h )
 {
     x264_ratecontrol_t *rc;
@@ -392,11 +448,6 @@ int x264_ratecontrol_new( x264_t *h )
     rc->b_abr = h->param.rc.i_rc_method != X264_RC_CQP && !h->param.rc.b_stat_read;
     rc->b_2pass = h->param.rc.i_rc_method == X264_RC_ABR && h->param.rc.b_stat_read;
 
-    /* FIXME: use integers */
-    if(h->param.i_fps_num > 0 && h->param.i_fps_den > 0)
-        rc->fps = (float) h->param.i_fps_num / h->param.i_fps_den;
-    else
-        rc->fps = 25.0;
 #if 0
     if( h->param.rc.b_mb_tree )
     {
@@ -407,7 +458,6 @@ int x264_ratecontrol_new( x264_t *h )
 #endif//peng
         rc->qcompress = h->param.rc.f_qcompress;
 
-    rc->bitrate = h->param.rc.i_bitrate * 1000.;
     rc->rate_tolerance = h->param.rc.f_rate_tolerance;
     rc->nmb = h->mb.i_mb_count;
     rc->last_non_b_pict_type = -1;
@@ -432,37 +482,8 @@ int x264_ratecontrol_new( x264_t *h )
             h->param.rc.i_vbv_max_bitrate = h->param.rc.i_bitrate;
         }
     }
-    if( h->param.rc.i_vbv_max_bitrate < h->param.rc.i_bitrate &&
-        h->param.rc.i_vbv_max_bitrate > 0)
-        x264_log(h, X264_LOG_WARNING, "max bitrate less than average bitrate, ignored.\n");
-    else if( h->param.rc.i_vbv_max_bitrate > 0 &&
-             h->param.rc.i_vbv_buffer_size > 0 )
-    {
-        if( h->param.rc.i_vbv_buffer_size < (int)(h->param.rc.i_vbv_max_bitrate / rc->fps) )
-        {
-            h->param.rc.i_vbv_buffer_size = h->param.rc.i_vbv_max_bitrate / rc->fps;
-            x264_log( h, X264_LOG_WARNING, "VBV buffer size cannot be smaller than one frame, using %d kbit\n",
-                      h->param.rc.i_vbv_buffer_size );
-        }
-        if( h->param.rc.f_vbv_buffer_init > 1. )
-            h->param.rc.f_vbv_buffer_init = x264_clip3f( h->param.rc.f_vbv_buffer_init / h->param.rc.i_vbv_buffer_size, 0, 1 );
-        rc->buffer_rate = h->param.rc.i_vbv_max_bitrate * 1000. / rc->fps;
-        rc->buffer_size = h->param.rc.i_vbv_buffer_size * 1000.;
-        rc->single_frame_vbv = rc->buffer_rate * 1.1 > rc->buffer_size;
-        h->param.rc.f_vbv_buffer_init = X264_MAX( h->param.rc.f_vbv_buffer_init, rc->buffer_rate / rc->buffer_size );
-        rc->buffer_fill_final = rc->buffer_size * h->param.rc.f_vbv_buffer_init;
-        rc->cbr_decay = 1.0 - rc->buffer_rate / rc->buffer_size
-                      * 0.5 * X264_MAX(0, 1.5 - rc->buffer_rate * rc->fps / rc->bitrate);
-        rc->b_vbv = 1;
-        rc->b_vbv_min_rate = !rc->b_2pass
-                          && h->param.rc.i_rc_method == X264_RC_ABR
-                          && h->param.rc.i_vbv_max_bitrate <= h->param.rc.i_bitrate;
-    }
-    else if( h->param.rc.i_vbv_max_bitrate )
-    {
-        x264_log(h, X264_LOG_WARNING, "VBV maxrate specified, but no bufsize.\n");
-        h->param.rc.i_vbv_max_bitrate = 0;
-    }
+    x264_ratecontrol_init_reconfigure( h, 1 );
+
     if(rc->rate_tolerance < 0.01)
     {
         x264_log(h, X264_LOG_WARNING, "bitrate tolerance too small, using .01\n");
@@ -477,8 +498,6 @@ int x264_ratecontrol_new( x264_t *h )
 #define ABR_INIT_QP ( h->param.rc.i_rc_method == X264_RC_CRF ? h->param.rc.f_rf_constant : 24 )
         rc->accum_p_norm = .01;
         rc->accum_p_qp = ABR_INIT_QP * rc->accum_p_norm;
-        /* estimated ratio that produces a reasonable QP for the first I-frame */
-        rc->cplxr_sum = .01 * pow( 7.0e5, rc->qcompress ) * pow( h->mb.i_mb_count, 0.5 );
         rc->wanted_bits_window = 1.0 * rc->bitrate / rc->fps;
         rc->last_non_b_pict_type = SLICE_TYPE_I;
     }
@@ -520,6 +539,18 @@ int x264_ratecontrol_new( x264_t *h )
             rc->row_preds[i][j].offset= 0.0;
         }
     }
+    if( rc->b_abr )
+    {
+        /* There is no lowres SATD on the VPU path, so every macroblock is one
+         * unit of complexity (see rate_estimate_qscale) and the predictors
+         * start from typical coded bits*qscale per macroblock. */
+        rc->pred[SLICE_TYPE_P].coeff = 80.0;
+        rc->pred[SLICE_TYPE_B].coeff = 40.0;
+        rc->pred[SLICE_TYPE_I].coeff = 400.0;
+        /* estimated ratio that produces a reasonable QP for the first I-frame:
+         * the qscale at which the P predictor hits the average frame size */
+        rc->cplxr_sum = rc->pred[SLICE_TYPE_P].coeff * pow( rc->nmb, rc->qcompress );
+    }
     *rc->pred_b_from_p = rc->pred[0];
 
     if( parse_zones( h ) < 0 )
@@ -947,13 +978,23 @@ static x264_zone_t *get_zone( x264_t *h, int frame_num )
 void x264_ratecontrol_summary( x264_t *h )
 {
     x264_ratecontrol_t *rc = h->rc;
-    if( rc->b_abr && h->param.rc.i_rc_method == X264_RC_ABR && rc->cbr_decay > .9999 )
-    {
-        double base_cplx = h->mb.i_mb_count * (h->param.i_bframe ? 120 : 80);
-        double mbtree_offset = h->param.rc.b_mb_tree ? (1.0-h->param.rc.f_qcompress)*13.5 : 0;
-        x264_log( h, X264_LOG_INFO, "final ratefactor: %.2f\n",
-                  qscale2qp( pow( base_cplx, 1 - rc->qcompress )
-                             * rc->cplxr_sum / rc->wanted_bits_window ) - mbtree_offset );
+    /* complexity is counted in macroblocks rather than SATD, so a final
+     * ratefactor would not be comparable to CRF: report the rate error instead */
+    if( rc->b_abr && h->param.rc.i_rc_method == X264_RC_ABR )
+    {
+        int i_count = h->stat.i_frame_count[SLICE_TYPE_I]
+                    + h->stat.i_frame_count[SLICE_TYPE_P]
+                    + h->stat.i_frame_count[SLICE_TYPE_B];
+        int64_t i_size = h->stat.i_frame_size[SLICE_TYPE_I]
+                       + h->stat.i_frame_size[SLICE_TYPE_P]
+                       + h->stat.i_frame_size[SLICE_TYPE_B];
+        if( i_count > 0 && rc->wanted_bits > 0 )
+        {
+            double bitrate = 8. * i_size * rc->fps / i_count;
+            x264_log( h, X264_LOG_INFO, "achieved bitrate: %.2f kb/s, target %.2f kb/s (%+.1f%%)\n",
+                      bitrate / 1000, rc->wanted_bits * rc->fps / i_count / 1000,
+                      100. * (8. * i_size / rc->wanted_bits - 1) );
+        }
     }
 }
 
@@ -1229,13 +1270,15 @@ void x264_ratecontrol_start( x264_t *h, int i_force_qp, int overhead )
 
     q = x264_clip3f( q, h->param.rc.i_qp_min, h->param.rc.i_qp_max );
     
-    //rc->qpa_rc =
-    //rc->qpa_aq = 0;
     h->fdec->f_qp_avg_rc =
     h->fdec->f_qp_avg_aq =
     rc->qpm =
     rc->qp = x264_clip3( (int)(q + 0.5), 0, 51 );
     rc->f_qpm = q;
+    /* the VPU codes the whole frame at the slice QP, so that is the
+     * average x264_ratecontrol_end trains the predictors with */
+    rc->qpa_rc =
+    rc->qpa_aq = rc->qp;
     if( rce )
         rce->new_qp = rc->qp;
 
@@ -1540,7 +1583,6 @@ int x264_ratecontrol_end( x264_t *h, int bits )
     }
 #endif
 
-#if 0//peng
     if( rc->b_abr )
     {
         if( h->sh.i_type != SLICE_TYPE_B )
@@ -1554,8 +1596,11 @@ int x264_ratecontrol_end( x264_t *h, int bits )
         rc->cplxr_sum *= rc->cbr_decay;
         rc->wanted_bits_window += rc->bitrate / rc->fps;
         rc->wanted_bits_window *= rc->cbr_decay;
+        rc->wanted_bits += rc->bitrate / rc->fps;
     }
 
+#if 0//peng
+
     if( rc->b_2pass )
     {
         rc->expected_bits_sum += qscale2bits( rc->rce, qp2qscale(rc->rce->new_qp) );
@@ -2038,7 +2083,11 @@ static float rate_estimate_qscale( x264_t *h )
 
             double wanted_bits, overflow=1, lmin, lmax;
 
-            rcc->last_satd = x264_rc_analyse_slice( h );
+            /* The lowres planes are never built for the VPU (see
+             * x264_encoder_encode), so there is no SATD to analyse: each
+             * macroblock counts as one unit of complexity and the bits the VPU
+             * reports for every frame drive cplxr_sum and the predictors. */
+            rcc->last_satd = rcc->nmb;
             rcc->short_term_cplxsum *= 0.5;
             rcc->short_term_cplxcount *= 0.5;
             rcc->short_term_cplxsum += rcc->last_satd;
@@ -2063,8 +2112,9 @@ static float rate_estimate_qscale( x264_t *h )
 
                 q = get_qscale( h, &rce, rcc->wanted_bits_window / rcc->cplxr_sum, h->fenc->i_frame );
 
-                // FIXME is it simpler to keep track of wanted_bits in ratecontrol_end?
-                wanted_bits = i_frame_done * rcc->bitrate / rcc->fps;
+                /* kept in ratecontrol_end so a reconfigured bitrate or frame
+                 * rate only applies to the frames coded after the change */
+                wanted_bits = rcc->wanted_bits;
                 if( wanted_bits > 0 )
                 {
                     abr_buffer *= X264_MAX( 1, sqrt(i_frame_done/25) );
@@ -25,6 +25,7 @@
 #define X264_RATECONTROL_H
 
 int  x264_ratecontrol_new   ( x264_t * );
+void x264_ratecontrol_init_reconfigure( x264_t *h, int b_init );
 void x264_ratecontrol_delete( x264_t * );
 
 void x264_adaptive_quant_frame( x264_t *h, x264_frame_t *frame );
@@ -1056,9 +1056,12 @@ void x264_slicetype_analyse( x264_t *h, int keyframe )
      * there will be significant visual artifacts if the frames just before
      * go down in quality due to being referenced less, despite it being
      * more RD-optimal. */
+#if 0// nothing is costed on lowres for the VPU, so VBV keeps the keyframe limit too
     if( (h->param.analyse.b_psy && h->param.rc.b_mb_tree) || h->param.rc.i_vbv_buffer_size )
         num_frames = j;
-    else if( num_frames == 1 )
+    else
+#endif
+    if( num_frames == 1 )
     {
         frames[1]->i_type = X264_TYPE_P;
 /*         if( h->param.i_scenecut_threshold && scenecut( h, &a, frames, 0, 1, 1, orig_num_frames ) ) */
@@ -1075,11 +1078,13 @@ void x264_slicetype_analyse( x264_t *h, int keyframe )
     int max_bframes = X264_MIN(num_frames-1, h->param.i_bframe);
     int num_analysed_frames = num_frames;
     int reset_start;
+#if 0// lowres is never built for the VPU, a scenecut on it would make every frame an IDR
     if( h->param.i_scenecut_threshold && scenecut( h, &a, frames, 0, 1, 1, orig_num_frames ) )
     {
         frames[1]->i_type = idr_frame_type;
         return;
     }
+#endif
 
     {
         for( j = 1; j <= num_frames; j++ )
@@ -1184,6 +1189,7 @@ void x264_slicetype_decide( x264_t *h )
     }
 
     /* calculate the frame costs ahead of time for x264_rc_analyse_slice while we still have lowres */
+#if 0// lowres is never built for the VPU, ratecontrol works from the coded frame sizes
     if( h->param.rc.i_rc_method != X264_RC_CQP )
     {
         x264_mb_analysis_t a;
@@ -1221,6 +1227,7 @@ void x264_slicetype_decide( x264_t *h )
             }
         }
     }
+#endif
 
     /* Analyse for weighted P frames */
     if( !h->param.rc.b_stat_read && h->lookahead->next.list[bframes]->i_type == X264_TYPE_P
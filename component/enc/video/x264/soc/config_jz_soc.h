@@ -14,6 +14,13 @@
 
 #define HW_4780
 //#define CRC_CHECK
+/* tile and describe frame N+1 while the VPU encodes frame N, output lags one frame.
+ * Left off: only a backlogged input queue overlaps (x264-host-pipeline -r 0 on
+ * the sim backend, 720p: ~91 fps against ~86 fps), while camera input runs the
+ * queue empty after every frame and HardAVCEncoder retires it at once (-r 1: ~86 fps) */
+//#define X264_VPU_PIPELINE
+/* build the host VPU backends (soc/vpu_model.c, soc/vpu_sim.c) instead of the MMIO one */
+//#define X264_VPU_HOST
 /***********   PMON   ****************************/ 
 //#define JZC_PMON_P0
 
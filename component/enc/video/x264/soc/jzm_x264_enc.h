@@ -42,6 +42,9 @@
 
 #define __ALN32__ __attribute__ ((aligned(4)))
 
+#define X264_VDMA_SIZE      0x5000      /* one descriptor chain */
+#define X264_VPU_BS_SIZE    (0x1<<20)   /* one slice bitstream buffer */
+
 /*
   _H264E_SliceInfo:
   H264 Encoder Slice Level Information
@@ -83,10 +86,33 @@ typedef struct _H264E_SliceInfo {
 
 }_H264E_SliceInfo;
 
+/*
+  x264_vpu_backend_t:
+  what runs a descriptor chain, the VPU itself or a host stand-in of it
+ */
+typedef struct x264_vpu_backend_t {
+    const char *name;
+    void (*kick)( _H264E_SliceInfo *sliceinfo );   /* start the chain at des_va */
+    int  (*wait)( void );     /* bitstream length of the kicked slice, <0 if it failed */
+}x264_vpu_backend_t;
+
+/*
+  HwInfo:
+  the descriptor chain, tiled input and bitstream buffers are doubled so the
+  CPU can fill slot i_slot^1 while the VPU works on slot i_slot
+ */
 typedef struct HwInfo{
-    unsigned int * vdma_config;
+    unsigned int * vdma_config[2];
     unsigned char * fb_ptr[3][2];     /*{curr, ref, raw}{tile_y, tile_c}*/
-    unsigned char * bs_ptr;
+    unsigned char * raw_ptr[2][2];    /*{slot}{tile_y, tile_c}, fb_ptr[2] points at one of them*/
+    unsigned char * bs_ptr[2];
+    int i_slot;                       /* slot of the frame being encoded */
+    int b_inflight;                   /* a slice was kicked and not collected yet */
+    const x264_vpu_backend_t * vpu;
+
+    /* NAL list of the retired frame, h->out.nal is reused by the next one */
+    x264_nal_t * nal;
+    int i_nal_allocated;
     _H264E_SliceInfo H264E_SliceInfo;
 }HwInfo_t;
 
@@ -371,6 +371,7 @@ void check_expand( x264_t *h ) {
 /**************************************************
 SDE
 **************************************************/
+#ifndef X264_VPU_HOST
 void check_parser( x264_t *h ) {
     int sde_err = 0;
     unsigned int hw_low = *(volatile unsigned int *)(sde_base + 0x28);
@@ -403,12 +404,13 @@ void check_parser( x264_t *h ) {
         exit(1);
     }
 }
+#endif //X264_VPU_HOST
 
 void check_bitstream( x264_t *h , int bs_len, int hw_bs_len) {
     int i;
     uint8_t *std_bs_buf = h->cabac.p_start;
     HwInfo_t * hwinfo = h->hwinfo;
-    uint8_t *dut_out = (uint8_t *)hwinfo->bs_ptr;
+    uint8_t *dut_out = (uint8_t *)hwinfo->bs_ptr[hwinfo->i_slot];
 
     printf("[SDE] checking bitstream...\n");
     if( bs_len != hw_bs_len ) {
@@ -0,0 +1,367 @@
+/****************************************************************
+ * vpu_model.c: host model of the H.264 encode VPU
+ *
+ * The "model" backend of an X264_VPU_HOST build. A kick runs the
+ * VDMA descriptor chain H264E_SliceInit wrote, as the VDMA engine
+ * would, into a shadow register file, rejects a chain the VPU would
+ * not run correctly, then codes the slice from the registers alone:
+ * geometry and QP from EFE/SDE, the input from the EFE raw buffers,
+ * the reference from MCE, CABAC contexts from the SDE context table,
+ * the bitstream to SDE_CFG4 and the reconstruction to the DBLK
+ * output. The bitstream length is left in SDE_CFG9, where the MMIO
+ * backend reads it.
+ *
+ * There is no motion search or transform here. I slices are coded as
+ * I_PCM, or as flat I_16x16 DC when that would not fit the bitstream
+ * buffer, and P slices as P_SKIP. Either way the stream decodes to
+ * exactly the reconstruction the model writes, so a decoder CRC can
+ * be compared against it.
+ *
+ * VPU_MODEL_CRC (environment) prints the running CRCs of the
+ * bitstream and of the reconstruction after each slice.
+ ****************************************************************/
+#ifndef __VPU_MODEL_C__
+#define __VPU_MODEL_C__
+
+#include <stdlib.h>
+#include "crc_check.c"
+
+#define VPU_MODEL_NREG      (0x100000>>2)
+#define MREG(r)             (vpu_model.reg[(r)>>2])
+
+/* I_PCM: mb_type, 384 samples and the cabac restart, with room for the flush */
+#define VPU_MODEL_PCM_BYTES 392
+
+/* line size of the tiled reference/reconstruction, see tile_stuff(expand) */
+#define VPU_MODEL_LINESIZE(mb_width) ((mb_width)*16 + 32*2)
+
+static struct {
+    unsigned int *reg;
+    uint8_t *written;
+    uint8_t *buf;             /* cabac output, buf[0] catches the carry into p[-1] */
+    int b_busy;
+    int i_bs_len;
+    int b_crc;
+    int i_slice;
+    short bs_crc, y_crc, c_crc;
+} vpu_model;
+
+/* the slice as the registers describe it */
+typedef struct {
+    int i_type;               /* 0: I, 1: P */
+    int i_qp;
+    int i_mb_width, i_mb_height;
+    int i_first_mby, i_last_mby;
+    uint8_t *raw[2];          /* EFE input, {tile_y, tile_c} */
+    uint8_t *ref[2];          /* MCE reference */
+    uint8_t *dec[2];          /* DBLK output */
+    uint8_t *bs;
+    uint8_t state[460];
+} vpu_model_slice_t;
+
+static int vpu_model_init( void )
+{
+    const char *env = getenv("VPU_MODEL_CRC");
+
+    vpu_model.reg = calloc( VPU_MODEL_NREG, sizeof(unsigned int) );
+    vpu_model.written = calloc( VPU_MODEL_NREG, 1 );
+    vpu_model.buf = malloc( X264_VPU_BS_SIZE + 1 );
+    if( !vpu_model.reg || !vpu_model.written || !vpu_model.buf ){
+        ALOGE("[ vpu model ] out of memory");
+        return -1;
+    }
+    vpu_model.b_crc = env && atoi(env);
+    return 0;
+}
+
+/* what the VDMA engine does: write each entry to its register until TERM */
+static int vpu_model_run_chain( const unsigned int *chn )
+{
+    int i, idx;
+
+    memset( vpu_model.written, 0, VPU_MODEL_NREG );
+    for( i = 0; i < X264_VDMA_SIZE/8; i++, chn += 2 ){
+        if( !(chn[1] & VDMA_ACFG_VLD) ){
+            ALOGE("[ vpu model ] descriptor %d is not valid: %08x %08x", i, chn[0], chn[1]);
+            return -1;
+        }
+        idx = VDMA_ACFG_IDX(chn[1]);
+        vpu_model.reg[idx>>2] = chn[0];
+        vpu_model.written[idx>>2] = 1;
+        if( chn[1] & VDMA_ACFG_TERM ){
+            if( idx != REG_EFE_CTRL ){
+                ALOGE("[ vpu model ] chain ends on %05x, not on EFE_CTRL", idx);
+                return -1;
+            }
+            return i + 1;
+        }
+    }
+    ALOGE("[ vpu model ] no TERM in %d descriptors", X264_VDMA_SIZE/8);
+    return -1;
+}
+
+static int vpu_model_check_addr( const char *name, int reg, unsigned int want )
+{
+    unsigned int addr = MREG(reg);
+
+    if( !vpu_model.written[reg>>2] )
+        ALOGE("[ vpu model ] %s is not set", name);
+    else if( !addr || (addr & 0xFF) )
+        ALOGE("[ vpu model ] %s = %08x is not a 256 byte aligned buffer", name, addr);
+    else if( addr != want )
+        ALOGE("[ vpu model ] %s = %08x, the slice asked for %08x", name, addr, want);
+    else
+        return 0;
+    return -1;
+}
+
+/* read the slice back out of the registers and check it against what the CPU asked for */
+static int vpu_model_parse( _H264E_SliceInfo *sliceinfo, vpu_model_slice_t *sl )
+{
+    static const int regs[] = {
+        REG_EFE_CTRL, REG_EFE_GEOM, REG_SDE_SL_GEOM, REG_SDE_CFG1, REG_DBLK_CTRL,
+        REG_DBLK_GPIC_STR, REG_SDE_SL_CTRL,
+    };
+    unsigned int ctrl = MREG(REG_EFE_CTRL);
+    unsigned int geom = MREG(REG_EFE_GEOM);
+    unsigned int sde_geom = MREG(REG_SDE_SL_GEOM);
+    unsigned int cfg1 = MREG(REG_SDE_CFG1);
+    int i, k, i_err = 0;
+
+    for( i = 0; i < (int)(sizeof(regs)/sizeof(regs[0])); i++ )
+        if( !vpu_model.written[regs[i]>>2] ){
+            ALOGE("[ vpu model ] register %05x is not set", regs[i]);
+            i_err++;
+        }
+    if( i_err )
+        return -1;
+
+    if( (ctrl & (EFE_EN | EFE_RUN)) != (EFE_EN | EFE_RUN) ){
+        ALOGE("[ vpu model ] EFE_CTRL = %08x does not start the encoder", ctrl);
+        i_err++;
+    }
+    sl->i_type = (ctrl >> 4) & 0x1;
+    sl->i_qp = (ctrl >> 8) & 0x3F;
+    sl->i_mb_height = (sde_geom >> 24) & 0xFF;
+    sl->i_mb_width = (sde_geom >> 16) & 0xFF;
+    sl->i_first_mby = (geom >> 24) & 0xFF;
+    sl->i_last_mby = (geom >> 8) & 0xFF;
+
+    if( (cfg1 & 0x3) != sl->i_type + 1 || ((cfg1 >> 8) & 0x3F) != sl->i_qp ){
+        ALOGE("[ vpu model ] SDE slice type/qp %d/%d, EFE %d/%d",
+              (cfg1 & 0x3) - 1, (cfg1 >> 8) & 0x3F, sl->i_type, sl->i_qp);
+        i_err++;
+    }
+    if( sl->i_type != sliceinfo->frame_type || sl->i_qp != sliceinfo->qp ){
+        ALOGE("[ vpu model ] slice type/qp %d/%d, the slice asked for %d/%d",
+              sl->i_type, sl->i_qp, sliceinfo->frame_type, sliceinfo->qp);
+        i_err++;
+    }
+    if( sl->i_mb_width != sliceinfo->mb_width || sl->i_mb_height != sliceinfo->mb_height
+        || (geom & 0xFF) != sl->i_mb_width - 1 ){
+        ALOGE("[ vpu model ] frame %dx%d MBs (EFE last mbx %d), the slice asked for %dx%d",
+              sl->i_mb_width, sl->i_mb_height, geom & 0xFF, sliceinfo->mb_width, sliceinfo->mb_height);
+        i_err++;
+    }
+    if( sl->i_first_mby != ((sde_geom >> 8) & 0xFF) || sl->i_first_mby != sliceinfo->first_mby
+        || sl->i_last_mby != sliceinfo->last_mby
+        || sl->i_first_mby > sl->i_last_mby || sl->i_last_mby >= sl->i_mb_height ){
+        ALOGE("[ vpu model ] rows %d..%d (SDE first %d), the slice asked for %d..%d of %d",
+              sl->i_first_mby, sl->i_last_mby, (sde_geom >> 8) & 0xFF,
+              sliceinfo->first_mby, sliceinfo->last_mby, sl->i_mb_height);
+        i_err++;
+    }
+    if( MREG(REG_DBLK_GPIC_STR) != DBLK_GPIC_STR(sl->i_mb_width*128, sl->i_mb_width*256) ){
+        ALOGE("[ vpu model ] DBLK_GPIC_STR = %08x for %d MBs a row", MREG(REG_DBLK_GPIC_STR), sl->i_mb_width);
+        i_err++;
+    }
+
+    i_err -= vpu_model_check_addr( "EFE_RAWY_SBA", REG_EFE_RAWY_SBA, sliceinfo->fb[2][0] );
+    i_err -= vpu_model_check_addr( "EFE_RAWC_SBA", REG_EFE_RAWC_SBA, sliceinfo->fb[2][1] );
+    if( sl->i_type ){
+        i_err -= vpu_model_check_addr( "MCE_CH1_RLUT", REG_MCE_CH1_RLUT+4, sliceinfo->fb[1][0] );
+        i_err -= vpu_model_check_addr( "MCE_CH2_RLUT", REG_MCE_CH2_RLUT+4, sliceinfo->fb[1][1] );
+    }
+    if( !vpu_model.written[REG_SDE_CFG4>>2] || MREG(REG_SDE_CFG4) != sliceinfo->bs ){
+        ALOGE("[ vpu model ] SDE_CFG4 = %08x, the slice asked for %08x", MREG(REG_SDE_CFG4), sliceinfo->bs);
+        i_err++;
+    }
+    /* the DBLK output pointers are biased by a row and three MBs, see H264E_SliceInit */
+    if( !vpu_model.written[REG_DBLK_GPIC_YA>>2] || !vpu_model.written[REG_DBLK_GPIC_CA>>2]
+        || MREG(REG_DBLK_GPIC_YA) + (sl->i_mb_width+3)*256 != sliceinfo->fb[0][0]
+        || MREG(REG_DBLK_GPIC_CA) + (sl->i_mb_width+3)*128 != sliceinfo->fb[0][1] ){
+        ALOGE("[ vpu model ] DBLK output %08x/%08x, the slice asked for %08x/%08x",
+              MREG(REG_DBLK_GPIC_YA) + (sl->i_mb_width+3)*256, MREG(REG_DBLK_GPIC_CA) + (sl->i_mb_width+3)*128,
+              sliceinfo->fb[0][0], sliceinfo->fb[0][1]);
+        i_err++;
+    }
+
+    /* the context table holds the LPS ranges of each state, turn it back into x264 states */
+    for( i = 0; i < 460; i++ ){
+        unsigned int ctx = MREG(REG_SDE_CTX_TBL + i*4);
+        if( !vpu_model.written[(REG_SDE_CTX_TBL>>2) + i] ){
+            ALOGE("[ vpu model ] context %d is not set", i);
+            return -1;
+        }
+        for( k = 0; k < 64 && lps_range[k] != (ctx & ~0x1); k++ );
+        if( k == 64 ){
+            ALOGE("[ vpu model ] context %d = %08x is no cabac state", i, ctx);
+            return -1;
+        }
+        sl->state[i] = (ctx & 0x1) ? 64 + k : 63 - k;
+    }
+
+    if( i_err )
+        return -1;
+
+    sl->raw[0] = (uint8_t *)(uintptr_t)MREG(REG_EFE_RAWY_SBA);
+    sl->raw[1] = (uint8_t *)(uintptr_t)MREG(REG_EFE_RAWC_SBA);
+    sl->ref[0] = (uint8_t *)(uintptr_t)MREG(REG_MCE_CH1_RLUT+4);
+    sl->ref[1] = (uint8_t *)(uintptr_t)MREG(REG_MCE_CH2_RLUT+4);
+    sl->dec[0] = (uint8_t *)(uintptr_t)(MREG(REG_DBLK_GPIC_YA) + (sl->i_mb_width+3)*256);
+    sl->dec[1] = (uint8_t *)(uintptr_t)(MREG(REG_DBLK_GPIC_CA) + (sl->i_mb_width+3)*128);
+    sl->bs = (uint8_t *)(uintptr_t)MREG(REG_SDE_CFG4);
+    return 0;
+}
+
+/* I_PCM, the samples go out as they come in and are the reconstruction too */
+static void vpu_model_mb_pcm( x264_cabac_t *cb, vpu_model_slice_t *sl, int mb_x, int mb_y )
+{
+    int ls = VPU_MODEL_LINESIZE(sl->i_mb_width);
+    uint8_t *raw_y = sl->raw[0] + (mb_y*sl->i_mb_width + mb_x)*256;
+    uint8_t *raw_c = sl->raw[1] + (mb_y*sl->i_mb_width + mb_x)*128;
+    int ctx = (mb_x > 0) + (mb_y > sl->i_first_mby);
+    int i;
+
+    x264_cabac_encode_decision_noup( cb, 3+ctx, 1 );
+    x264_cabac_encode_flush( NULL, cb );
+
+    memcpy( cb->p, raw_y, 256 );
+    cb->p += 256;
+    for( i = 0; i < 8; i++ )
+        memcpy( cb->p + i*8, raw_c + i*16, 8 );
+    cb->p += 64;
+    for( i = 0; i < 8; i++ )
+        memcpy( cb->p + i*8, raw_c + i*16 + 8, 8 );
+    cb->p += 64;
+
+    cb->i_low   = 0;
+    cb->i_range = 0x01FE;
+    cb->i_queue = -1;
+    cb->i_bytes_outstanding = 0;
+
+    memcpy( sl->dec[0] + mb_y*16*ls + mb_x*256, raw_y, 256 );
+    memcpy( sl->dec[1] + mb_y*8*ls + mb_x*128, raw_c, 128 );
+}
+
+/* I_16x16 DC with no residual: nothing but grey can be predicted inside the slice */
+static void vpu_model_mb_flat( x264_cabac_t *cb, vpu_model_slice_t *sl, int mb_x, int mb_y )
+{
+    int ls = VPU_MODEL_LINESIZE(sl->i_mb_width);
+    int b_left = mb_x > 0;
+    int b_top = mb_y > sl->i_first_mby;
+    int i;
+
+    x264_cabac_encode_decision_noup( cb, 3 + b_left + b_top, 1 );
+    x264_cabac_encode_terminal( cb );
+    x264_cabac_encode_decision_noup( cb, 3+3, 0 );    /* cbp luma */
+    x264_cabac_encode_decision_noup( cb, 3+4, 0 );    /* cbp chroma */
+    x264_cabac_encode_decision( cb, 3+6, 1 );         /* pred DC */
+    x264_cabac_encode_decision_noup( cb, 3+7, 0 );
+    x264_cabac_encode_decision_noup( cb, 64, 0 );     /* chroma pred DC */
+    x264_cabac_encode_decision_noup( cb, 60, 0 );     /* qp delta */
+    x264_cabac_encode_decision_noup( cb, 85 + !b_left + 2*!b_top, 0 );  /* luma DC cbf */
+
+    for( i = 0; i < 16; i++ )
+        memset( sl->dec[0] + mb_y*16*ls + mb_x*256 + i*16, 0x80, 16 );
+    for( i = 0; i < 8; i++ )
+        memset( sl->dec[1] + mb_y*8*ls + mb_x*128 + i*16, 0x80, 16 );
+}
+
+/* P_SKIP, no neighbour is ever coded so the context is always 11 and the mv 0 */
+static void vpu_model_mb_skip( x264_cabac_t *cb, vpu_model_slice_t *sl, int mb_x, int mb_y )
+{
+    int ls = VPU_MODEL_LINESIZE(sl->i_mb_width);
+    int i;
+
+    x264_cabac_encode_decision( cb, 11, 1 );
+
+    for( i = 0; i < 16; i++ )
+        memcpy( sl->dec[0] + mb_y*16*ls + mb_x*256 + i*16, sl->ref[0] + mb_y*16*ls + mb_x*256 + i*16, 16 );
+    for( i = 0; i < 8; i++ )
+        memcpy( sl->dec[1] + mb_y*8*ls + mb_x*128 + i*16, sl->ref[1] + mb_y*8*ls + mb_x*128 + i*16, 16 );
+}
+
+static int vpu_model_encode( vpu_model_slice_t *sl )
+{
+    void (*mb_write)( x264_cabac_t *, vpu_model_slice_t *, int, int );
+    int i_mbs = (sl->i_last_mby - sl->i_first_mby + 1) * sl->i_mb_width;
+    int ls = VPU_MODEL_LINESIZE(sl->i_mb_width);
+    x264_cabac_t cb;
+    int mb_x, mb_y, i;
+
+    if( sl->i_type )
+        mb_write = vpu_model_mb_skip;
+    else if( i_mbs * VPU_MODEL_PCM_BYTES <= X264_VPU_BS_SIZE )
+        mb_write = vpu_model_mb_pcm;
+    else
+        mb_write = vpu_model_mb_flat;
+
+    memcpy( cb.state, sl->state, sizeof(cb.state) );
+    x264_cabac_encode_init( &cb, vpu_model.buf + 1, vpu_model.buf + 1 + X264_VPU_BS_SIZE );
+
+    for( mb_y = sl->i_first_mby; mb_y <= sl->i_last_mby; mb_y++ )
+        for( mb_x = 0; mb_x < sl->i_mb_width; mb_x++ ){
+            if( mb_y > sl->i_first_mby || mb_x > 0 )
+                x264_cabac_encode_terminal( &cb );    /* end_of_slice_flag 0 */
+            mb_write( &cb, sl, mb_x, mb_y );
+        }
+    x264_cabac_encode_flush( NULL, &cb );
+
+    vpu_model.i_bs_len = cb.p - (vpu_model.buf + 1);
+    memcpy( sl->bs, vpu_model.buf + 1, vpu_model.i_bs_len );
+    MREG(REG_SDE_CFG9) = vpu_model.i_bs_len;
+
+    if( vpu_model.b_crc ){
+        vpu_model.bs_crc = crc( sl->bs, vpu_model.i_bs_len, vpu_model.bs_crc );
+        for( i = sl->i_first_mby; i <= sl->i_last_mby; i++ ){
+            vpu_model.y_crc = crc( sl->dec[0] + i*16*ls, sl->i_mb_width*256, vpu_model.y_crc );
+            vpu_model.c_crc = crc( sl->dec[1] + i*8*ls, sl->i_mb_width*128, vpu_model.c_crc );
+        }
+        printf("vpu model: slice = %d, type = %c, qp = %d, bs_len = %d, bs crc = 0x%04x, dec crc = 0x%04x/0x%04x\n",
+               vpu_model.i_slice, sl->i_type ? 'P' : 'I', sl->i_qp, vpu_model.i_bs_len,
+               (unsigned short)vpu_model.bs_crc, (unsigned short)vpu_model.y_crc, (unsigned short)vpu_model.c_crc);
+    }
+    vpu_model.i_slice++;
+    return 0;
+}
+
+static void vpu_model_kick( _H264E_SliceInfo *sliceinfo )
+{
+    vpu_model_slice_t sl;
+
+    if( vpu_model.b_busy )
+        ALOGE("[ vpu model ] kicked while busy, the previous slice is lost");
+    vpu_model.b_busy = 1;
+    vpu_model.i_bs_len = -1;
+
+    if( !vpu_model.reg && vpu_model_init() )
+        return;
+    if( vpu_model_run_chain( sliceinfo->des_va ) < 0 )
+        return;
+    if( vpu_model_parse( sliceinfo, &sl ) )
+        return;
+    vpu_model_encode( &sl );
+}
+
+static int vpu_model_wait( void )
+{
+    if( !vpu_model.b_busy ){
+        ALOGE("[ vpu model ] wait without a kick");
+        return -1;
+    }
+    vpu_model.b_busy = 0;
+    return vpu_model.i_bs_len;
+}
+
+#endif //__VPU_MODEL_C__
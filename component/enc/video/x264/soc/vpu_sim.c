@@ -0,0 +1,79 @@
+/****************************************************************
+ * vpu_sim.c: software stand-in for the H.264 encode VPU
+ *
+ * The "sim" backend of an X264_VPU_HOST build. Unlike the "model"
+ * one (soc/vpu_model.c) it does not encode anything: a kick only
+ * records when the slice would be done and how many bytes it would
+ * leave in the bitstream buffer, and the wait sleeps until then. That
+ * is enough to run the kick/collect ordering of the pipelined encoder
+ * without /dev/jz-vpu.
+ *
+ * VPU_SIM_MB_NS (environment) overrides the cost of a macroblock.
+ ****************************************************************/
+#ifndef __VPU_SIM_C__
+#define __VPU_SIM_C__
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/* ~720p30 on the VPU with about two thirds of the frame time to spare */
+#define VPU_SIM_MB_NS_DEFAULT 3000
+
+/* 1024 * 2^(-i/6): the size of a slice follows its QP step by step */
+static const int vpu_sim_qscale[6] = { 1024, 912, 813, 724, 645, 575 };
+
+static struct {
+    int b_busy;
+    unsigned int i_done;      /* GetTimer() value the slice completes at */
+    int i_bs_len;
+    int i_mb_ns;
+} vpu_sim;
+
+static void vpu_sim_kick( _H264E_SliceInfo *sliceinfo )
+{
+    int i_mbs = (sliceinfo->last_mby - sliceinfo->first_mby + 1) * sliceinfo->mb_width;
+    int i_bits = sliceinfo->frame_type ? 12 : 48;   /* per MB at QP 26 */
+    int i_qp = sliceinfo->qp - 26 + 60;              /* size halves every 6 QP */
+    int i_shift = i_qp / 6 - 10;
+    int64_t i_size = (int64_t)i_mbs * i_bits * vpu_sim_qscale[i_qp % 6];
+    unsigned char *bs = (unsigned char *)sliceinfo->bs;
+    int i;
+
+    if( vpu_sim.b_busy )
+        ALOGE("[ vpu sim ] kicked while busy, the previous slice is lost");
+
+    if( !vpu_sim.i_mb_ns ){
+        const char *env = getenv("VPU_SIM_MB_NS");
+        vpu_sim.i_mb_ns = env ? atoi(env) : VPU_SIM_MB_NS_DEFAULT;
+    }
+
+    i_size = i_shift >= 0 ? i_size >> i_shift : i_size << -i_shift;
+    vpu_sim.i_bs_len = X264_MAX( i_size / (8*1024), 1 );
+    if( vpu_sim.i_bs_len > X264_VPU_BS_SIZE )
+        vpu_sim.i_bs_len = X264_VPU_BS_SIZE;
+
+    /* a byte pattern that needs no emulation prevention */
+    for( i = 0; i < vpu_sim.i_bs_len; i++ )
+        bs[i] = 0x5A;
+
+    vpu_sim.i_done = GetTimer() + (unsigned int)((int64_t)i_mbs * vpu_sim.i_mb_ns / 1000);
+    vpu_sim.b_busy = 1;
+}
+
+static int vpu_sim_wait( void )
+{
+    int i_left = (int)(vpu_sim.i_done - GetTimer());
+
+    if( !vpu_sim.b_busy ){
+        ALOGE("[ vpu sim ] wait without a kick");
+        return 0;
+    }
+    if( i_left > 0 )
+        usleep(i_left);
+    EL("[ vpu sim ] slice done, %d us left at wait", i_left);
+
+    vpu_sim.b_busy = 0;
+    return vpu_sim.i_bs_len;
+}
+
+#endif //__VPU_SIM_C__
@@ -0,0 +1,47 @@
+/*****************************************************************************
+ * host_vpu.c: what the device build gets from the OMX component and libjzcommon
+ *
+ * The VPU descriptors hold 32-bit addresses and the host "VPU" backends
+ * take them at face value, so everything the encoder hands to the VPU is
+ * carved out of one arena mapped below 4GB.
+ *****************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define HOST_ARENA_SIZE (256 << 20)
+
+static uint8_t *host_arena;
+static size_t host_arena_used;
+
+void *jz4740_alloc_frame( int *VpuMem_ptr, int align, int size )
+{
+    size_t off;
+
+    if( !host_arena ){
+        host_arena = mmap( NULL, HOST_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0 );
+        if( host_arena == MAP_FAILED ){
+            perror( "host arena" );
+            exit( 1 );
+        }
+    }
+    off = ( host_arena_used + align - 1 ) & ~(size_t)( align - 1 );
+    if( off + size > HOST_ARENA_SIZE ){
+        fprintf( stderr, "host arena: out of memory (%d bytes)\n", size );
+        return NULL;
+    }
+    host_arena_used = off + size;
+    return host_arena + off;
+}
+
+void VAE_map()
+{
+}
+
+void VAE_unmap()
+{
+}
@@ -0,0 +1,17 @@
+/*****************************************************************************
+ * utils/Log.h: stand-in for the Android log header in host builds
+ *****************************************************************************/
+#ifndef X264_HOST_LOG_H
+#define X264_HOST_LOG_H
+
+#include <stdio.h>
+
+#define X264_HOST_LOG(...) ( fprintf( stderr, __VA_ARGS__ ), fputc( '\n', stderr ) )
+
+#define ALOGE X264_HOST_LOG
+#define ALOGW X264_HOST_LOG
+#define ALOGI X264_HOST_LOG
+#define ALOGD(...)
+#define ALOGV(...)
+
+#endif
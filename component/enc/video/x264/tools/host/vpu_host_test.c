@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * vpu_host_test.c: drive the encoder on a host VPU backend
+ *
+ * Encodes a synthetic clip the way HardAVCEncoder does (same Parse
+ * arguments, tiled input, one output per input) and prints one line per
+ * coded frame with its type, size and the CRC of its NAL units. With
+ * X264_VPU_BACKEND=model the lines are stable across builds and are
+ * compared against tools/host/vpu_model.crc by "make check-host".
+ * With -b the rate is controlled as HardAVCEncoder does for
+ * OMX_Video_ControlRateConstant, and -t fails the run when the achieved
+ * bitrate is more than the given percentage off the target.
+ * -r 1 calls x264_encoder_retire after every frame, as HardAVCEncoder
+ * does whenever its input queue runs empty; the output must not change.
+ * The last line gives the wall-clock encode rate, which with
+ * X264_VPU_BACKEND=sim shows what X264_VPU_PIPELINE overlaps.
+ *
+ * usage: x264-host [-w width] [-h height] [-n frames] [-f fps]
+ *                  [-k keyint] [-b kbps] [-t tolerance] [-r retire]
+ *                  [-o out.264]
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "x264.h"
+#include "soc/crc.h"
+
+typedef struct {
+    int b_progress;
+    int i_seek;
+    void * hin;
+    void * hout;
+    FILE *qpfile;
+} cli_opt_t;
+
+void    x264_param_default( x264_param_t * );
+int     x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal );
+int     Parse( int argc, char **argv, x264_param_t *param, cli_opt_t *opt );
+x264_t *x264_encoder_open( x264_param_t * );
+int     x264_encoder_encode ( x264_t *, x264_nal_t **, int *, x264_picture_t *, x264_picture_t * );
+int     x264_encoder_retire( x264_t *, x264_nal_t **, int *, x264_picture_t * );
+int     x264_encoder_delayed_frames( x264_t * );
+void    x264_encoder_close  ( x264_t * );
+void *  jz4740_alloc_frame (int *VpuMem_ptr, int align, int size);
+
+/* a gradient sliding right and a bright square moving down, in the
+ * VPU's tiled 4:2:0 layout: 16x16 luma per MB, then per MB 8 rows of
+ * 8 U and 8 V samples */
+static void fill_frame( uint8_t *tile, int mb_width, int mb_height, int i_frame )
+{
+    int mb_count = mb_width * mb_height;
+    int sq_x = 3 * mb_width * 4 - 24, sq_y = (i_frame * 3) % (mb_height * 16);
+    int mbx, mby, x, y;
+
+    for( mby = 0; mby < mb_height; mby++ )
+        for( mbx = 0; mbx < mb_width; mbx++ ){
+            uint8_t *luma = tile + (mby * mb_width + mbx) * 256;
+            uint8_t *chroma = tile + mb_count * 256 + (mby * mb_width + mbx) * 128;
+            for( y = 0; y < 16; y++ )
+                for( x = 0; x < 16; x++ ){
+                    int px = mbx * 16 + x, py = mby * 16 + y;
+                    int in_sq = px >= sq_x && px < sq_x + 24 && py >= sq_y && py < sq_y + 24;
+                    luma[y * 16 + x] = in_sq ? 235 : (uint8_t)(px + 2 * py + 3 * i_frame);
+                }
+            for( y = 0; y < 8; y++ )
+                for( x = 0; x < 8; x++ ){
+                    chroma[y * 16 + x]     = 128 + ((mbx * 8 + x - i_frame) & 63);
+                    chroma[y * 16 + 8 + x] = 128 - ((mby * 8 + y) & 63);
+                }
+        }
+}
+
+static int write_frame( FILE *out, int i_frame, x264_nal_t *nal, int i_nal,
+                        x264_picture_t *pic_out, int64_t *p_bytes )
+{
+    int i, i_size = 0;
+    short i_crc = 0;
+
+    for( i = 0; i < i_nal; i++ ){
+        i_crc = crc( nal[i].p_payload, nal[i].i_payload, i_crc );
+        i_size += nal[i].i_payload;
+        if( out )
+            fwrite( nal[i].p_payload, 1, nal[i].i_payload, out );
+    }
+    printf( "frame %d: type %c, %d bytes, crc 0x%04x\n", i_frame,
+            IS_X264_TYPE_I( pic_out->i_type ) ? 'I' : 'P', i_size, i_crc & 0xffff );
+    *p_bytes += i_size;
+    return i_frame + 1;
+}
+
+int main( int argc, char **argv )
+{
+    int i_width = 176, i_height = 144, i_frames = 10, i_fps = 30, i_keyint = 5, i_kbps = 0, i_tol = 0;
+    int b_retire = 0;
+    const char *psz_out = NULL;
+    FILE *out = NULL;
+    x264_param_t param;
+    x264_picture_t pic, pic_out;
+    x264_nal_t *nal;
+    x264_t *h;
+    cli_opt_t opt;
+    uint8_t *tile;
+    int64_t i_bytes = 0;
+    int i_nal, i, i_out = 0;
+    struct timeval tv_start, tv_end;
+
+    for( i = 1; i + 1 < argc; i += 2 ){
+        int v = atoi( argv[i + 1] );
+        if( !strcmp( argv[i], "-w" ) )      i_width = v;
+        else if( !strcmp( argv[i], "-h" ) ) i_height = v;
+        else if( !strcmp( argv[i], "-n" ) ) i_frames = v;
+        else if( !strcmp( argv[i], "-f" ) ) i_fps = v;
+        else if( !strcmp( argv[i], "-k" ) ) i_keyint = v;
+        else if( !strcmp( argv[i], "-b" ) ) i_kbps = v;
+        else if( !strcmp( argv[i], "-t" ) ) i_tol = v;
+        else if( !strcmp( argv[i], "-r" ) ) b_retire = v;
+        else if( !strcmp( argv[i], "-o" ) ) psz_out = argv[i + 1];
+        else break;
+    }
+    if( i < argc || i_width % 16 || i_height % 16 ){
+        fprintf( stderr, "usage: %s [-w width] [-h height] [-n frames] [-f fps]"
+                 " [-k keyint] [-b kbps] [-t tolerance] [-r retire] [-o out.264]\n",
+                 argv[0] );
+        return 2;
+    }
+
+    char keyint[16], bitrate[16];
+    snprintf( keyint, sizeof(keyint), "%d", i_keyint );
+    snprintf( bitrate, sizeof(bitrate), "%d", i_kbps );
+    char *x264_argv[] = {
+        "x264",
+        "--bframes",        "0",
+        "--me",             "dia",
+        "--subme",          "1",
+        "--trellis",        "0",
+        "--weightp",        "0",
+        "--ref",            "1",
+        "--partition",      "none",
+        "--sync-lookahead", "0",
+        "--rc-lookahead",   "0",
+        "--aq-mod",         "0",
+        "--no-8x8dct",
+        "--ratetol",        "1.0",
+        "--keyint",         keyint,
+        "--qp",             "26",
+        "--vbv-maxrate",    bitrate,
+        "--vbv-bufsize",    bitrate,
+    };
+    int x264_argc = sizeof(x264_argv) / sizeof(x264_argv[0]) - 4;
+    if( i_kbps ){
+        x264_argv[x264_argc - 2] = "--bitrate";
+        x264_argv[x264_argc - 1] = bitrate;
+        x264_argc += 4;
+    }
+
+    x264_param_default( &param );
+    param.i_csp = X264_CSP_YUYV;
+    param.i_width = i_width;
+    param.i_height = i_height;
+    param.i_fps_num = i_fps;
+    param.rc.i_fbr_bitrate = i_kbps * 1000;
+    if( Parse( x264_argc, x264_argv, &param, &opt ) < 0 )
+        return 1;
+    param.i_frame_total = 0;
+
+    if( !( h = x264_encoder_open( &param ) ) ){
+        fprintf( stderr, "x264_encoder_open failed\n" );
+        return 1;
+    }
+    if( psz_out && !( out = fopen( psz_out, "wb" ) ) ){
+        perror( psz_out );
+        return 1;
+    }
+    if( out && x264_encoder_headers( h, &nal, &i_nal ) >= 0 )
+        for( i = 0; i < i_nal; i++ )
+            fwrite( nal[i].p_payload, 1, nal[i].i_payload, out );
+
+    tile = jz4740_alloc_frame( NULL, 256, i_width * i_height * 3 / 2 );
+    memset( &pic, 0, sizeof(pic) );
+    gettimeofday( &tv_start, NULL );
+    for( i = 0; i < i_frames; i++ ){
+        fill_frame( tile, i_width / 16, i_height / 16, i );
+        pic.img.raw_yuv422_ptr = (uint32_t *)tile;
+        pic.i_type = X264_TYPE_AUTO;
+        pic.i_qpplus1 = 0;
+        pic.i_pts = i;
+        if( x264_encoder_encode( h, &nal, &i_nal, &pic, &pic_out ) < 0 ){
+            fprintf( stderr, "x264_encoder_encode failed at frame %d\n", i );
+            return 1;
+        }
+        if( i_nal )
+            i_out = write_frame( out, i_out, nal, i_nal, &pic_out, &i_bytes );
+        if( b_retire ){
+            if( x264_encoder_retire( h, &nal, &i_nal, &pic_out ) < 0 ){
+                fprintf( stderr, "x264_encoder_retire failed at frame %d\n", i );
+                return 1;
+            }
+            if( i_nal )
+                i_out = write_frame( out, i_out, nal, i_nal, &pic_out, &i_bytes );
+        }
+    }
+    while( x264_encoder_delayed_frames( h ) ){
+        if( x264_encoder_encode( h, &nal, &i_nal, NULL, &pic_out ) < 0 )
+            return 1;
+        if( !i_nal )
+            break;
+        i_out = write_frame( out, i_out, nal, i_nal, &pic_out, &i_bytes );
+    }
+    gettimeofday( &tv_end, NULL );
+    x264_encoder_close( h );
+    if( out )
+        fclose( out );
+
+    if( i_out != i_frames ){
+        fprintf( stderr, "%d frames in, %d out\n", i_frames, i_out );
+        return 1;
+    }
+    double f_kbps = (double)i_bytes * 8 * i_fps / i_frames / 1000;
+    printf( "bitrate: %.1f kbps\n", f_kbps );
+    if( i_kbps && i_tol && fabs( f_kbps - i_kbps ) > i_kbps * i_tol / 100. ){
+        printf( "bitrate: %.1f kbps is more than %d%% off the %d kbps target\n",
+                f_kbps, i_tol, i_kbps );
+        return 1;
+    }
+    double f_secs = (tv_end.tv_sec - tv_start.tv_sec) + (tv_end.tv_usec - tv_start.tv_usec) / 1e6;
+    printf( "encode: %.1f fps\n", i_frames / f_secs );
+    return 0;
+}
@@ -477,7 +477,8 @@ typedef struct
 //x264_t *x264_encoder_open( x264_param_t * );
 
 /* x264_encoder_reconfig:
- *      analysis-related parameters from x264_param_t are copied.
+ *      analysis-related parameters from x264_param_t are copied, as are keyint,
+ *      fps and, in ABR mode, the bitrate and VBV size (VBV cannot be toggled).
  *      this takes effect immediately, on whichever frame is encoded next;
  *      due to delay, this may not be the next frame passed to encoder_encode.
  *      if the change should apply to some particular frame, use x264_picture_t->param instead.
@@ -498,6 +499,12 @@ int     x264_encoder_reconfig( x264_t *, x264_param_t * );
 /* x264_encoder_close:
  *      close an encoder handler */
 //void    x264_encoder_close  ( x264_t * );
+/* x264_encoder_retire:
+ *      finish the frame a pipelined VPU build leaves in flight when
+ *      x264_encoder_encode returns, and return its NALs as
+ *      x264_encoder_encode would have on the next call.
+ *      Without the pipeline there is never one and i_nal is 0. */
+int     x264_encoder_retire( x264_t *, x264_nal_t **, int *, x264_picture_t * );
 /* x264_encoder_delayed_frames:
  *      return the number of currently delayed (buffered) frames
  *      this should be used at the end of the stream, to know when you have all the encoded frames. */